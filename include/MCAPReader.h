@@ -13,6 +13,10 @@ namespace mcap_wrapper
 {
     class MCAPReaderImpl;
 
+    /**
+     * @brief Read channels of a MCAP file, each channel with its own cursor. Messages of a channel are given in file order, which
+     * is the order they were written, not sorted by their timestamp.
+     */
     class MCAPReader
     {
     public:
@@ -2,8 +2,11 @@
 #define MCAP_WRITER_HPP
 
 #include <string>
+#include <string_view>
+#include <future>
 #include <Eigen/Core>
 #include <opencv2/core.hpp>
+#include "define.h"
 
 namespace mcap_wrapper
 {
@@ -16,6 +19,16 @@ namespace mcap_wrapper
      * @return false could not create file
      */
     bool open_file_connection(std::string const &file_path, std::string const &reference_name = "");
+    /**
+     * @brief Create file for writting MCAP in it, with the given compression and chunking. The path must be valid.
+     *
+     * @param file_path path to the file to write
+     * @param options Compression, compression level, chunk size and checksum of chunks
+     * @param reference_name name refered to connection for future usage. This will be equal to `file_path` if empty
+     * @return true could create file
+     * @return false could not create file or compression is not available
+     */
+    bool open_file_connection(std::string const &file_path, FileConnectionOptions const &options, std::string const &reference_name = "");
     /**
      * @brief Create a network connection that could be used with foxglove studio.
      *
@@ -50,7 +63,9 @@ namespace mcap_wrapper
      */
     void close_all_network();
     /**
-     * @brief Set connection referenced with `connection_name` to be sync. Sync connection wait the end of it write for return
+     * @brief Set connection referenced with `connection_name` to be sync. Functions writing to a sync connection return once their
+     * data are written by the connection (data are encoded by the calling thread). Other connections and threads are not slowed down.
+     * Written data may still be in the chunk in progress, use `flush` for writing it to the file.
      *
      * @param connection_name connection to be sync
      * @param sync should the connection must be sync
@@ -58,6 +73,155 @@ namespace mcap_wrapper
      * @return false connection not found
      */
     bool set_connection_to_be_sync(std::string const &connection_name, bool sync);
+    /**
+     * @brief Wait until every data pushed so far to connection referenced with `connection_name` is written. For files the chunk in
+     * progress is written to the file and, unless fsync policy is `FsyncPolicy::NEVER`, data are forced to disk. Data pushed by
+     * other threads meanwhile are not waited for.
+     *
+     * @param connection_name connection to flush
+     * @return true data written
+     * @return false connection not found or closed
+     */
+    bool flush(std::string const &connection_name);
+    /**
+     * @brief Get a future that is ready once every data pushed so far to connection referenced with `connection_name` is written
+     * (or dropped by the backpressure policy), e.g. right after a write for knowing when this message is written. Data waiting
+     * to be encoded are encoded by the calling thread.
+     *
+     * @param connection_name connection to watch
+     * @param future filled with the future of the writes
+     * @return true connection found
+     * @return false connection not found
+     */
+    bool get_write_future(std::string const &connection_name, std::future<void> &future);
+    /**
+     * @brief Set when data written by file connection referenced with `connection_name` are forced to disk. Default is `FsyncPolicy::NEVER`.
+     *
+     * @param connection_name connection to configure
+     * @param policy fsync policy
+     * @return true connection found
+     * @return false connection not found
+     */
+    bool set_connection_fsync_policy(std::string const &connection_name, FsyncPolicy policy);
+    /**
+     * @brief Set the encoding used by connection referenced with `connection_name` for foxglove messages (images, logs,
+     * transforms, 3D objects, positions, calibrations, annotations). Default is `MessageEncoding::JSON`. Protobuf messages are
+     * smaller and faster to decode, images are stored without base64. Only channels created afterwards are affected, so it
+     * should be called right after opening the connection. Channels written with `write_JSON_to` always stay in JSON.
+     *
+     * @param connection_name connection to configure
+     * @param encoding message encoding, JSON or PROTOBUF
+     * @return true connection found
+     * @return false connection not found or encoding not supported
+     */
+    bool set_connection_message_encoding(std::string const &connection_name, MessageEncoding encoding);
+    /**
+     * @brief Set the encoding used by connection referenced with `connection_name` for raw JSON messages (`write_JSON_to`).
+     * Default is `MessageEncoding::JSON`. CBOR stores numbers in binary which is smaller and faster to serialize and parse than
+     * text. Only channels created afterwards are affected. `MCAPReader::get_next_message` gives back JSON text for both encodings.
+     *
+     * @param connection_name connection to configure
+     * @param encoding message encoding, JSON or CBOR
+     * @return true connection found
+     * @return false connection not found or encoding not supported
+     */
+    bool set_connection_raw_message_encoding(std::string const &connection_name, MessageEncoding encoding);
+    /**
+     * @brief Set the number of threads used for encoding images. Images of a same channel are always written in timestamp order.
+     *
+     * @param thread_number number of encoding threads. 0 mean one thread per core (default)
+     */
+    void set_image_encoding_thread_number(unsigned thread_number);
+    /**
+     * @brief Set the codec used for writing the images of channel `channel_name` with `write_image_to*`. Default is JPEG with quality 95.
+     * Codec must be chosen before the first image of the channel is written when switching to or from `ImageCodec::RAW`, because
+     * raw images use another message type. Images whose type is not supported by `write_raw_image_to*` are written in PNG by `ImageCodec::RAW`.
+     *
+     * @param channel_name channel of the images
+     * @param options codec and its parameters
+     * @return true options are valid
+     * @return false a parameter of the selected codec is out of range
+     */
+    bool set_image_channel_options(std::string const &channel_name, ImageChannelOptions const &options);
+    /**
+     * @brief Set the history written by position channel `position_channel_name` (`add_position_to*`) of connection referenced with
+     * `connection_name`: last poses, poses of a time window or one pose out of N. Default keep every pose.
+     *
+     * @param connection_name connection to configure
+     * @param position_channel_name name of position
+     * @param options history options
+     * @return true connection found
+     * @return false connection not found or decimation is 0
+     */
+    bool set_connection_trajectory_options(std::string const &connection_name, std::string const &position_channel_name, TrajectoryOptions const &options);
+    /**
+     * @brief Set the batching window of connection referenced with `connection_name`. Once data are pushed the connection
+     * wait this duration for gathering more data before writing them at once. 0 (default) mean data are written as soon as possible.
+     *
+     * @param connection_name connection to configure
+     * @param batching_window_us batching window in microseconds
+     * @return true connection found
+     * @return false connection not found
+     */
+    bool set_connection_batching_window(std::string const &connection_name, unsigned batching_window_us);
+    /**
+     * @brief Set the behaviour of connection referenced with `connection_name` when its write queue is full. Default is `BackpressurePolicy::BLOCK`.
+     *
+     * @param connection_name connection to configure
+     * @param policy backpressure policy
+     * @return true connection found
+     * @return false connection not found
+     */
+    bool set_connection_backpressure_policy(std::string const &connection_name, BackpressurePolicy policy);
+    /**
+     * @brief Set the capacity (number of messages) of the write queue of connections that will be opened afterwards. Default is 4096.
+     * Capacity is rounded up to the next power of two.
+     *
+     * @param capacity queue capacity
+     */
+    void set_default_connection_queue_capacity(unsigned capacity);
+    /**
+     * @brief Statistics of one connection. Latencies are measured between the moment data are given to the wrapper and the moment they are written.
+     *
+     */
+    typedef struct ConnectionStatistics
+    {
+        uint64_t written_messages = 0; // Number of messages written by the connection
+        uint64_t dropped_messages = 0; // Number of messages dropped by the backpressure policy
+        uint64_t queue_size = 0;       // Number of messages waiting in write queue
+        uint64_t queue_capacity = 0;   // Capacity of write queue
+        uint64_t latency_p50_ns = 0;   // Median latency in nanoseconds
+        uint64_t latency_p99_ns = 0;   // 99th percentile latency in nanoseconds
+    } ConnectionStatistics;
+    /**
+     * @brief Get statistics of connection referenced with `connection_name`
+     *
+     * @param connection_name connection to inspect
+     * @param statistics filled with statistics of the connection
+     * @return true connection found
+     * @return false connection not found
+     */
+    bool get_connection_statistics(std::string const &connection_name, ConnectionStatistics &statistics);
+    /**
+     * @brief Statistics of the pool recycling the buffers of serialized messages, shared by every connection.
+     *
+     */
+    typedef struct PayloadPoolStatistics
+    {
+        uint64_t number_of_acquisitions = 0; // Number of buffers asked to the pool for serializing messages
+        uint64_t number_of_hits = 0;         // Number of buffers asked and reused from already written messages
+        double hit_rate = 0.;                // `number_of_hits` / `number_of_acquisitions`
+        uint64_t pooled_bytes = 0;           // Memory kept by the pool for next messages
+        uint64_t max_pooled_bytes = 0;       // High-water mark of `pooled_bytes`
+        uint64_t payload_bytes = 0;          // Memory of serialized messages not written yet by every connection
+        uint64_t max_payload_bytes = 0;      // High-water mark of `payload_bytes`
+    } PayloadPoolStatistics;
+    /**
+     * @brief Get statistics of the pool of serialized messages
+     *
+     * @param statistics filled with statistics of the pool
+     */
+    void get_payload_pool_statistics(PayloadPoolStatistics &statistics);
     /**
      * @brief Write image into all MCAP connection. connection can be files or live foxglove-studio.
      *
@@ -90,6 +254,85 @@ namespace mcap_wrapper
      * @return false could not write image
      */
     bool write_image_to(std::string const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id = "");
+    /**
+     * @brief Write image without compression (foxglove.RawImage) into all MCAP connection. Used for depth maps, masks or lossless frames.
+     * Supported types are CV_8UC1 (mono8), CV_8UC3 (bgr8), CV_8UC4 (bgra8), CV_16UC1 (16UC1) and CV_32FC1 (32FC1).
+     * Image buffer is not copied until it is written: it must not be modified in place afterwards (use a new cv::Mat for each frame).
+     *
+     * @param identifier identifier to where write the input image
+     * @param image cv::Mat representing the image
+     * @param timestamp image's timestamp
+     * @param frame_id frame of reference of the image
+     * @return true could write image
+     * @return false could not write image (type not supported)
+     */
+    bool write_raw_image_to_all(std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id = "");
+    /**
+     * @brief Write image without compression (foxglove.RawImage) into to specifics connections. connection muste be refered by it names.
+     *
+     * @param connection_identifier list of connection names where data must be write.
+     * @param identifier identifier to where write the input image
+     * @param image cv::Mat representing the image
+     * @param timestamp image's timestamp
+     * @param frame_id frame of reference of the image
+     * @return true could write image
+     * @return false could not write image (connection not found or type not supported)
+     */
+    bool write_raw_image_to(std::vector<std::string> const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id = "");
+    /**
+     * @brief Write image without compression (foxglove.RawImage) into to specifics connections. connection muste be refered by it names.
+     *
+     * @param connection_identifier connection name where data must be write.
+     * @param identifier identifier to where write the input image
+     * @param image cv::Mat representing the image
+     * @param timestamp image's timestamp
+     * @param frame_id frame of reference of the image
+     * @return true could write image
+     * @return false could not write image (connection not found or type not supported)
+     */
+    bool write_raw_image_to(std::string const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id = "");
+    /**
+     * @brief Write an already compressed image (e.g. JPEG delivered by a camera) into all MCAP connection, as foxglove.CompressedImage.
+     * Image is neither decoded nor re-encoded: its bytes are copied once into the message before the function returns, `data` can be reused afterwards.
+     *
+     * @param identifier identifier to where write the input image
+     * @param data compressed image
+     * @param size size of compressed image in bytes
+     * @param format image format, as expected by foxglove ("jpeg", "png", "webp")
+     * @param timestamp image's timestamp
+     * @param frame_id frame of reference of the image
+     * @return true could write image
+     * @return false could not write image (empty image or format)
+     */
+    bool write_compressed_image_to_all(std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id = "");
+    /**
+     * @brief Write an already compressed image into to specifics connections, as foxglove.CompressedImage. connection muste be refered by it names.
+     *
+     * @param connection_identifier list of connection names where data must be write.
+     * @param identifier identifier to where write the input image
+     * @param data compressed image
+     * @param size size of compressed image in bytes
+     * @param format image format, as expected by foxglove ("jpeg", "png", "webp")
+     * @param timestamp image's timestamp
+     * @param frame_id frame of reference of the image
+     * @return true could write image
+     * @return false could not write image (connection not found, empty image or format)
+     */
+    bool write_compressed_image_to(std::vector<std::string> const &connection_identifier, std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id = "");
+    /**
+     * @brief Write an already compressed image into to specifics connections, as foxglove.CompressedImage. connection muste be refered by it names.
+     *
+     * @param connection_identifier connection name where data must be write.
+     * @param identifier identifier to where write the input image
+     * @param data compressed image
+     * @param size size of compressed image in bytes
+     * @param format image format, as expected by foxglove ("jpeg", "png", "webp")
+     * @param timestamp image's timestamp
+     * @param frame_id frame of reference of the image
+     * @return true could write image
+     * @return false could not write image (connection not found, empty image or format)
+     */
+    bool write_compressed_image_to(std::string const &connection_identifier, std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id = "");
 
     /**
      * @brief Write camera calibration. It is usefull for plotting image in 3D view and debug stereo programs.
@@ -174,6 +417,14 @@ namespace mcap_wrapper
                                      std::array<double, 9> const &R,
                                      std::array<double, 12> const &P);
 
+    /**
+     * @brief Enable or disable the validation of JSON given to `write_JSON_to*`. JSON messages are written as given, they are only parsed
+     * for inferring the schema of their channel (first message) and for CBOR connections. Other messages are checked to be valid JSON
+     * unless validation is disabled: invalid messages are then written as is. Default is enabled.
+     *
+     * @param validate true for dropping invalid JSON messages
+     */
+    void set_JSON_validation(bool validate);
     /**
      * @brief Write JSON into MCAP. Each JSON data "type" must have a property called "__foxglove_name__" in order to be interpretable by
      * Foxglove studio as valid data. This function is thread safe.
@@ -219,7 +470,7 @@ namespace mcap_wrapper
      * @param child Name of the child frame
      * @param pose Transform position
      */
-    bool add_frame_transform_to_all(std::string transform_name, uint64_t timestamp, std::string parent, std::string child, Eigen::Matrix4f pose);
+    bool add_frame_transform_to_all(std::string const &transform_name, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose);
     /**
      * @brief Add frame transform that could be used for 3D and image
      *
@@ -230,7 +481,7 @@ namespace mcap_wrapper
      * @param child Name of the child frame
      * @param pose Transform position
      */
-    bool add_frame_transform_to(std::vector<std::string> connection_identifier, std::string transform_name, uint64_t timestamp, std::string parent, std::string child, Eigen::Matrix4f pose);
+    bool add_frame_transform_to(std::vector<std::string> const &connection_identifier, std::string const &transform_name, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose);
     /**
      * @brief Add frame transform that could be used for 3D and image
      *
@@ -241,7 +492,7 @@ namespace mcap_wrapper
      * @param child Name of the child frame
      * @param pose Transform position
      */
-    bool add_frame_transform_to(std::string connection_identifier, std::string transform_name, uint64_t timestamp, std::string parent, std::string child, Eigen::Matrix4f pose);
+    bool add_frame_transform_to(std::string const &connection_identifier, std::string const &transform_name, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose);
 
     /**
      * @brief Create a 3D object that can own some primitives like triangle, rectangle, etc...
@@ -250,7 +501,7 @@ namespace mcap_wrapper
      * @param frame_id [optionnal] corresponding frame ID
      * @param frame_locked [optionnal] Is object should keep it position or move with the specified frame
      */
-    void create_3D_object(std::string object_name, std::string frame_id = "", bool frame_locked = false);
+    void create_3D_object(std::string const &object_name, std::string const &frame_id = "", bool frame_locked = false);
     /**
      * @brief Add metadata to 3D object
      *
@@ -259,7 +510,7 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_metadata_to_3d_object(std::string object_name, std::pair<std::string, std::string> metadata);
+    bool add_metadata_to_3d_object(std::string const &object_name, std::pair<std::string, std::string> const &metadata);
     /**
      * @brief Add arrow to 3D object
      *
@@ -273,13 +524,13 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_arrow_to_3d_object(std::string object_name,
-                                Eigen::Matrix4f pose,
+    bool add_arrow_to_3d_object(std::string const &object_name,
+                                Eigen::Matrix4f const &pose,
                                 double shaft_length,
                                 double shaft_diameter,
                                 double head_length,
                                 double head_diameter,
-                                std::array<double, 4> color = {0, 0, 0, 1});
+                                std::array<double, 4> const &color = {0, 0, 0, 1});
     /**
      * @brief Add cube to 3D object
      *
@@ -290,10 +541,10 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_cube_to_3d_object(std::string object_name,
-                               Eigen::Matrix4f pose,
-                               std::array<double, 3> size,
-                               std::array<double, 4> color = {0, 0, 0, 1});
+    bool add_cube_to_3d_object(std::string const &object_name,
+                               Eigen::Matrix4f const &pose,
+                               std::array<double, 3> const &size,
+                               std::array<double, 4> const &color = {0, 0, 0, 1});
     /**
      * @brief Add sphere to 3D object
      *
@@ -304,10 +555,10 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_sphere_to_3d_object(std::string object_name,
-                                 Eigen::Matrix4f pose,
-                                 std::array<double, 3> size,
-                                 std::array<double, 4> color = {0, 0, 0, 1});
+    bool add_sphere_to_3d_object(std::string const &object_name,
+                                 Eigen::Matrix4f const &pose,
+                                 std::array<double, 3> const &size,
+                                 std::array<double, 4> const &color = {0, 0, 0, 1});
     /**
      * @brief Add cylinder to the 3D object
      *
@@ -320,12 +571,12 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_cylinder_to_3d_object(std::string object_name,
-                                   Eigen::Matrix4f pose,
+    bool add_cylinder_to_3d_object(std::string const &object_name,
+                                   Eigen::Matrix4f const &pose,
                                    double bottom_scale,
                                    double top_scale,
-                                   std::array<double, 3> size,
-                                   std::array<double, 4> color = {0, 0, 0, 1});
+                                   std::array<double, 3> const &size,
+                                   std::array<double, 4> const &color = {0, 0, 0, 1});
     /**
      * @brief Add line to 3D object
      *
@@ -340,14 +591,14 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_line_to_3d_object(std::string object_name,
-                               Eigen::Matrix4f pose,
+    bool add_line_to_3d_object(std::string const &object_name,
+                               Eigen::Matrix4f const &pose,
                                double thickness,
                                bool scale_invariant,
-                               std::vector<Eigen::Vector3d> points,
-                               std::array<double, 4> color,
-                               std::vector<std::array<double, 4>> colors,
-                               std::vector<uint32_t> indices);
+                               std::vector<Eigen::Vector3d> const &points,
+                               std::array<double, 4> const &color,
+                               std::vector<std::array<double, 4>> const &colors,
+                               std::vector<uint32_t> const &indices);
     /**
      * @brief Add triangle to 3D object
      *
@@ -360,12 +611,12 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_triangle_to_3d_object(std::string object_name,
-                                   Eigen::Matrix4f pose,
-                                   std::vector<Eigen::Vector3d> points,
-                                   std::array<double, 4> color,
-                                   std::vector<std::array<double, 4>> colors,
-                                   std::vector<uint32_t> indices);
+    bool add_triangle_to_3d_object(std::string const &object_name,
+                                   Eigen::Matrix4f const &pose,
+                                   std::vector<Eigen::Vector3d> const &points,
+                                   std::array<double, 4> const &color,
+                                   std::vector<std::array<double, 4>> const &colors,
+                                   std::vector<uint32_t> const &indices);
     /**
      * @brief Add text to 3D object
      *
@@ -379,13 +630,13 @@ namespace mcap_wrapper
      * @return true The primitive was added
      * @return false The primitive was not added (error occur)
      */
-    bool add_text_to_3d_object(std::string object_name,
-                               Eigen::Matrix4f pose,
+    bool add_text_to_3d_object(std::string const &object_name,
+                               Eigen::Matrix4f const &pose,
                                bool billboard,
                                double font_size,
                                bool scale_invariant,
-                               std::array<double, 4> color,
-                               std::string text);
+                               std::array<double, 4> const &color,
+                               std::string const &text);
     /**
      * @brief Write 3D object into the file
      *
@@ -394,7 +645,7 @@ namespace mcap_wrapper
      * @return true Everything does fines.
      * @return false Everything does wrong.
      */
-    bool write_3d_object_to_all(std::string object_name, uint64_t timestamp);
+    bool write_3d_object_to_all(std::string const &object_name, uint64_t timestamp);
     /**
      * @brief Write 3D object into the file
      *
@@ -404,7 +655,7 @@ namespace mcap_wrapper
      * @return true Everything does fines.
      * @return false Everything does wrong.
      */
-    bool write_3d_object_to(std::vector<std::string> connection_identifier, std::string object_name, uint64_t timestamp);
+    bool write_3d_object_to(std::vector<std::string> const &connection_identifier, std::string const &object_name, uint64_t timestamp);
     /**
      * @brief Write 3D object into the file
      *
@@ -414,7 +665,7 @@ namespace mcap_wrapper
      * @return true Everything does fines.
      * @return false Everything does wrong.
      */
-    bool write_3d_object_to(std::string connection_identifier, std::string object_name, uint64_t timestamp);
+    bool write_3d_object_to(std::string const &connection_identifier, std::string const &object_name, uint64_t timestamp);
 
     /**
      * @brief Used by write_log_to_all. Specify the level of log
@@ -478,7 +729,7 @@ namespace mcap_wrapper
      * @return true  Everything does fines.
      * @return false Everything does wrong.
      */
-    bool add_position_to_all(std::string position_channel_name, uint64_t timestamp, Eigen::Matrix4f pose, std::string frame_id = "");
+    bool add_position_to_all(std::string const &position_channel_name, uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id = "");
     /**
      * @brief Add position that could be vizualized into 3D. Position could be linked to frame thanks to the `frame_id` parameter.
      *
@@ -490,7 +741,7 @@ namespace mcap_wrapper
      * @return true  Everything does fines.
      * @return false Everything does wrong.
      */
-    bool add_position_to(std::vector<std::string> connection_identifier, std::string position_channel_name, uint64_t timestamp, Eigen::Matrix4f pose, std::string frame_id = "");
+    bool add_position_to(std::vector<std::string> const &connection_identifier, std::string const &position_channel_name, uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id = "");
     /**
      * @brief Add position that could be vizualized into 3D. Position could be linked to frame thanks to the `frame_id` parameter.
      *
@@ -501,7 +752,7 @@ namespace mcap_wrapper
      * @return true  Everything does fines.
      * @return false Everything does wrong.
      */
-    bool add_position_to(std::string connection_identifier, std::string position_channel_name, uint64_t timestamp, Eigen::Matrix4f pose, std::string frame_id = "");
+    bool add_position_to(std::string const &connection_identifier, std::string const &position_channel_name, uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id = "");
 
     /**
      * @brief Describe a circle annotation
@@ -588,6 +839,133 @@ namespace mcap_wrapper
      */
     void add_image_annotation_to(std::string const &connection_identifier, std::string const& channel_name, std::vector<CircleAnnotation> const &circle_annotations, std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations, uint64_t timestamp);
 
+    /**
+     * @brief Open channel `channel_name` of connection `connection_identifier` for writing messages of type `type`. Connection, schema and
+     * channel are resolved once: writes taking the returned handle do not look up connections and channels by their names.
+     * Handle stays valid until the channel or its connection is closed, writes taking a closed handle fail. A channel should not be written
+     * both with its handle and with its name.
+     *
+     * @param connection_identifier connection name where data must be write
+     * @param channel_name Name of the channel
+     * @param type Type of messages written on the channel
+     * @return ChannelHandle handle of the channel, `INVALID_CHANNEL_HANDLE` if connection does not exist
+     */
+    ChannelHandle open_channel(std::string const &connection_identifier, std::string const &channel_name, ChannelType type);
+    /**
+     * @brief Close channel opened with `open_channel`, e.g. for a long-lived connection opening and closing channels. Its handle fails from
+     * now on and its slot is reused. Channels of a connection are closed with it.
+     *
+     * @param channel Handle returned by `open_channel`
+     * @return true channel closed, once messages written on it are pushed to its connection
+     * @return false handle is invalid or already closed
+     */
+    bool close_channel(ChannelHandle channel);
+    /**
+     * @brief Write serialized JSON on a `ChannelType::RAW_JSON` channel. Writes on opened channels do not allocate once the wrapper is warm
+     * (messages of raw JSON channels are validated with a parser that may allocate, see `set_JSON_validation`).
+     *
+     * @param channel Handle returned by `open_channel`
+     * @param serialized_json JSON serialized into string
+     * @param timestamp Timestamp of the message
+     * @return true message pushed
+     * @return false handle is invalid or is not a raw JSON channel
+     */
+    bool write_JSON(ChannelHandle channel, std::string const &serialized_json, uint64_t timestamp);
+    /**
+     * @brief Write serialized JSON on a `ChannelType::RAW_JSON` channel without copying it. `serialized_json` is left empty, with a capacity
+     * that could be reused for serializing the next message.
+     *
+     * @param channel Handle returned by `open_channel`
+     * @param serialized_json JSON serialized into string
+     * @param timestamp Timestamp of the message
+     * @return true message pushed
+     * @return false handle is invalid or is not a raw JSON channel
+     */
+    bool write_JSON(ChannelHandle channel, std::string &&serialized_json, uint64_t timestamp);
+    /**
+     * @brief Write serialized JSON on a `ChannelType::RAW_JSON` channel
+     *
+     * @param channel Handle returned by `open_channel`
+     * @param serialized_json JSON serialized into a buffer, without terminating null character
+     * @param size Size of `serialized_json`
+     * @param timestamp Timestamp of the message
+     * @return true message pushed
+     * @return false handle is invalid or is not a raw JSON channel
+     */
+    bool write_JSON(ChannelHandle channel, char const *serialized_json, size_t size, uint64_t timestamp);
+    /**
+     * @brief Write image on a `ChannelType::IMAGE` channel. Image is encoded with the codec of the channel (see `set_image_channel_options`).
+     *
+     * @param channel Handle returned by `open_channel`
+     * @param image Image to write
+     * @param timestamp Timestamp of the image
+     * @param frame_id Frame of reference of the image
+     * @return true image pushed
+     * @return false handle is invalid or is not an image channel
+     */
+    bool write_image(ChannelHandle channel, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id = "");
+    /**
+     * @brief Write log on a `ChannelType::LOG` channel
+     *
+     * @param channel Handle returned by `open_channel`
+     * @param timestamp Timestamp of log message
+     * @param log_level Log level
+     * @param message Log message
+     * @param name Process or node name
+     * @param file Filename
+     * @param line Line number in the file
+     * @return true log pushed
+     * @return false handle is invalid or is not a log channel
+     */
+    bool write_log(ChannelHandle channel, uint64_t timestamp, LOG_LEVEL log_level, std::string_view message, std::string_view name, std::string_view file, uint32_t line);
+    /**
+     * @brief Write frame transform on a `ChannelType::TRANSFORM` channel
+     *
+     * @param channel Handle returned by `open_channel`
+     * @param timestamp Timestamp of the transform
+     * @param parent Name of the parent frame
+     * @param child Name of the child frame
+     * @param pose Transform from parent frame to child frame
+     * @return true transform pushed
+     * @return false handle is invalid or is not a transform channel
+     */
+    bool add_frame_transform(ChannelHandle channel, uint64_t timestamp, std::string_view parent, std::string_view child, Eigen::Matrix4f const &pose);
+
+    /**
+     * @brief Message of `write_batch`. Fields used depend on `type`. Strings are only read during `write_batch`.
+     *
+     */
+    typedef struct BatchItem
+    {
+        ChannelType type = ChannelType::RAW_JSON;                // Type of the message
+        std::string_view channel_name;                           // Channel of the message
+        uint64_t timestamp = 0;                                  // Timestamp of the message
+        std::string_view text;                                   // RAW_JSON: serialized JSON. LOG: log message. TRANSFORM: parent frame
+        std::string_view name;                                   // LOG: process or node name. TRANSFORM: child frame. IMAGE: frame of reference
+        std::string_view file;                                   // LOG: filename
+        LOG_LEVEL log_level = LOG_LEVEL::INFO;                   // LOG: log level
+        uint32_t line = 0;                                       // LOG: line number in the file
+        Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();      // TRANSFORM: transform from parent frame to child frame
+        cv::Mat image;                                           // IMAGE: image encoded with the codec of the channel
+    } BatchItem;
+    /**
+     * @brief Write messages of several types and channels at once on connection referenced with `connection_identifier`. Messages are
+     * queued with one lock and one wake up of the encoding thread, which is cheaper than one `write_*` call per message
+     * (e.g. replaying a burst of sensor samples). Messages are queued in batch order, images included. On a sync connection the call
+     * waits once, until the whole batch is written. Channels are opened on first use, as with `open_channel`.
+     *
+     * @param connection_identifier connection to write to
+     * @param items messages to write
+     * @param number_of_items number of messages
+     * @return true messages pushed
+     * @return false connection not found or a channel could not be opened, nothing is pushed
+     */
+    bool write_batch(std::string const &connection_identifier, BatchItem const *items, size_t number_of_items);
+    /**
+     * @brief See `write_batch`
+     */
+    bool write_batch(std::string const &connection_identifier, std::vector<BatchItem> const &items);
+
 };
 
 #endif
\ No newline at end of file
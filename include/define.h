@@ -1,6 +1,10 @@
 #ifndef MCAP_WRAPPER_DEFINE_H
 #define MCAP_WRAPPER_DEFINE_H
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace mcap_wrapper
 {
     enum class MCAPReaderChannelType
@@ -9,8 +13,190 @@ namespace mcap_wrapper
         IMAGE = 1,
         OBJECT_3D = 2,
         LOG = 3,
-        TRANSFORM = 4
+        TRANSFORM = 4,
+        RAW_IMAGE = 5
+    };
+
+    /**
+     * @brief Behaviour of a connection when its write queue is full
+     *
+     */
+    enum class BackpressurePolicy
+    {
+        BLOCK = 0,                   // Producer wait until space is available
+        DROP_OLDEST = 1,             // Oldest waiting message is dropped
+        DROP_NEWEST = 2,             // Incoming message is dropped
+        KEEP_LATEST_PER_CHANNEL = 3  // Waiting messages of the incoming message channel are dropped, only its latest message is kept. If none of its messages is waiting, incoming message is dropped: messages of other channels are never dropped
+    };
+
+    /**
+     * @brief Encoding used by a connection for writing messages. Foxglove messages (images, logs, transforms...) can be
+     * written in JSON or protobuf, raw JSON messages (`write_JSON_to`) in JSON or CBOR.
+     *
+     */
+    enum class MessageEncoding
+    {
+        JSON = 0,     // JSON messages described by JSON schemas. Images are base64 encoded
+        PROTOBUF = 1, // Protobuf messages described by foxglove .proto definitions. Images are stored as raw bytes
+        CBOR = 2      // Binary JSON (RFC 8949) described by JSON schemas. Only for raw JSON messages
+    };
+
+    /**
+     * @brief Codec used for writing the images of a channel
+     *
+     */
+    enum class ImageCodec
+    {
+        JPEG = 0, // Lossy, smallest messages. Default
+        PNG = 1,  // Lossless
+        WEBP = 2, // Lossy or lossless
+        RAW = 3   // Lossless without compression, written as foxglove.RawImage. Fastest
+    };
+
+    /**
+     * @brief Chroma subsampling of JPEG images. Stronger subsampling gives smaller images with less accurate colors
+     *
+     */
+    enum class JpegChromaSubsampling
+    {
+        SUBSAMPLING_420 = 0, // Default of libjpeg
+        SUBSAMPLING_422 = 1,
+        SUBSAMPLING_444 = 2  // No subsampling
+    };
+
+    /**
+     * @brief Options used for writing the images of a channel. Only the options of the selected codec are used.
+     *
+     */
+    typedef struct ImageChannelOptions
+    {
+        ImageCodec codec = ImageCodec::JPEG;
+        int jpeg_quality = 95;                 // 0-100, higher is better quality
+        JpegChromaSubsampling jpeg_chroma_subsampling = JpegChromaSubsampling::SUBSAMPLING_420; // Needs OpenCV >= 4.5.5, ignored otherwise
+        int png_compression_level = 1;         // 0-9, higher is smaller and slower
+        int webp_quality = 90;                 // 1-100, higher is better quality. Above 100 mean lossless
+    } ImageChannelOptions;
+
+    /**
+     * @brief Type of the messages written on a channel opened with `open_channel`
+     *
+     */
+    enum class ChannelType
+    {
+        RAW_JSON = 0,  // Serialized JSON (`write_JSON`)
+        IMAGE = 1,     // Images encoded with the codec of the channel (`write_image`)
+        LOG = 2,       // foxglove.Log (`write_log`)
+        TRANSFORM = 3  // foxglove.FrameTransform (`add_frame_transform`)
+    };
+
+    /**
+     * @brief Channel of one connection opened with `open_channel`. Connection, schema and channel are resolved once when it is opened.
+     *
+     */
+    typedef uint32_t ChannelHandle;
+    static const ChannelHandle INVALID_CHANNEL_HANDLE = UINT32_MAX;
+
+    /**
+     * @brief Position of a message in the write queue of its connection. A message is written once every message with a smaller ticket is.
+     *
+     */
+    typedef uint64_t WriteTicket;
+
+    /**
+     * @brief When data written to a file connection are forced to disk (fsync). Until then written data may only be in OS caches and
+     * are lost if the system crashes.
+     *
+     */
+    enum class FsyncPolicy
+    {
+        NEVER = 0,         // OS writes data to disk when it wants
+        ON_FLUSH = 1,      // `flush` forces data to disk
+        ON_EVERY_WRITE = 2 // Writing thread forces data written to the file to disk after each batch of messages it writes. Chunks are not closed for it: messages of a chunk reach disk with the first batch after the chunk is compressed and written, so unchunked files (`chunk_size` 0) are needed for every batch to be on disk once written
+    };
+
+    /**
+     * @brief How a file connection writes its file
+     *
+     */
+    enum class FileWriteMethod
+    {
+        STDIO = 0,   // Buffered writes of the C library, the writing thread waits for each write system call. Default
+        IO_URING = 1 // Buffers handed to the kernel with io_uring and written while next data are filled. Fall back to STDIO if io_uring is not available (Linux >= 5.1)
+    };
+
+    /**
+     * @brief Compression of the chunks of a file connection
+     *
+     */
+    enum class FileCompression
+    {
+        NONE = 0, // Fastest, biggest files
+        LZ4 = 1,  // Fast with low CPU usage, e.g. for edge devices
+        ZSTD = 2  // Smallest files. Default
     };
+
+    /**
+     * @brief Compression level of the chunks of a file connection, mapped by MCAP onto the levels of each algorithm
+     * (zstd: -5, -3, 1, 5, 19. LZ4: fast acceleration, fast, HC default, HC optimal, HC max)
+     *
+     */
+    enum class FileCompressionLevel
+    {
+        FASTEST = 0,
+        FAST = 1,
+        DEFAULT = 2,
+        SLOW = 3,
+        SLOWEST = 4 // For archiving
+    };
+
+    /**
+     * @brief Channels of a file connection chunked together, apart from other channels, with their own compression and chunk size.
+     * E.g. images in big uncompressed chunks and telemetry in small zstd chunks, so a reader of telemetry skips image chunks.
+     * Small repetitive messages of a group, e.g. logs or JSON of a same schema, compress better with a dictionary trained on them.
+     *
+     */
+    typedef struct ChunkGroup
+    {
+        std::vector<std::string> channel_names; // Channels of the group
+        std::vector<std::string> schema_names;  // Channels whose schema has one of these names are in the group, e.g. "foxglove.RawImage"
+        FileCompression compression = FileCompression::ZSTD;
+        FileCompressionLevel compression_level = FileCompressionLevel::DEFAULT;
+        uint64_t chunk_size = 768 * 1024; // Chunks of the group are compressed and written once their uncompressed size reaches it. Can not be 0
+        unsigned dictionary_training_messages = 0; // With ZSTD, a dictionary is trained on this number of first messages of the group and compresses its next chunks. Worth it for small chunks (few KB) of small messages. Chunks compressed with it have compression "zstd_dictionary" and can only be read by MCAPReader, not by other MCAP tools. 0 mean no dictionary
+    } ChunkGroup;
+
+    /**
+     * @brief Options of a file connection (`open_file_connection`). Default are the ones of MCAP.
+     *
+     */
+    typedef struct FileConnectionOptions
+    {
+        FileCompression compression = FileCompression::ZSTD;
+        FileCompressionLevel compression_level = FileCompressionLevel::DEFAULT;
+        uint64_t chunk_size = 768 * 1024; // Chunks are compressed and written once their uncompressed size reaches it. Bigger chunks compress better. 0 mean messages are written without chunks
+        bool chunk_crc = true;            // Compute checksum of chunks, which costs a pass over their uncompressed data
+        unsigned compression_threads = 2; // Threads compressing filled chunks while next messages are written. 0 mean chunks are compressed by the writing thread
+        std::vector<ChunkGroup> chunk_groups; // A channel goes in the first group it matches. Channels matching no group use options above. Require chunks
+        unsigned dictionary_training_messages = 0; // Same as `ChunkGroup::dictionary_training_messages`, for channels matching no group. Require chunks
+        FileWriteMethod write_method = FileWriteMethod::STDIO;
+        bool direct_io = false;                // With IO_URING, bypass OS page cache (O_DIRECT), so recording does not evict other data from memory
+        uint64_t io_buffer_size = 1024 * 1024; // With IO_URING, size of each buffer written at once, rounded up to 4 KB
+        unsigned io_buffer_count = 8;          // With IO_URING, number of buffers, filled while others are written
+        uint64_t preallocation_size = 0;       // File is allocated by extents of this size ahead of writes (fallocate), which limits its fragmentation and metadata updates. Space not written is freed at close. 0 mean no preallocation. Linux only
+        uint64_t write_behind_size = 0;        // Written data are handed to disk by windows of this size (sync_file_range) and the window before is dropped from page cache (posix_fadvise), so dirty pages do not pile up and stall the system. 0 mean disabled. Linux only
+    } FileConnectionOptions;
+
+    /**
+     * @brief History kept by a position channel (`add_position_to*`). Each message holds the kept history followed by the latest pose.
+     * Default keep every pose.
+     *
+     */
+    typedef struct TrajectoryOptions
+    {
+        unsigned max_poses = 0;       // Only the last `max_poses` poses are kept. 0 mean no limit
+        uint64_t max_duration_ns = 0; // Only the poses of the last `max_duration_ns` nanoseconds are kept. 0 mean no limit
+        unsigned decimation = 1;      // One pose out of `decimation` is kept
+    } TrajectoryOptions;
 };
 
 #endif
\ No newline at end of file
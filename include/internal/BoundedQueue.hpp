@@ -0,0 +1,484 @@
+#ifndef MCAP_WRAPPER_BOUNDED_QUEUE_HPP
+#define MCAP_WRAPPER_BOUNDED_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include "define.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Bounded lock-free multi producers / multi consumers queue (Dmitry Vyukov's algorithm).
+     * Capacity is rounded up to the next power of two.
+     */
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        BoundedQueue(size_t capacity)
+        {
+            size_t real_capacity = 2;
+            while (real_capacity < capacity)
+                real_capacity *= 2;
+            _cells.reset(new Cell[real_capacity]);
+            for (size_t i = 0; i < real_capacity; i++)
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            _mask = real_capacity - 1;
+            _enqueue_position.store(0, std::memory_order_relaxed);
+            _dequeue_position.store(0, std::memory_order_relaxed);
+        }
+        /**
+         * @brief Push `value` into the queue. `value` is left untouched if the queue is full.
+         *
+         * @param value value to push
+         * @param position if not null, filled with the position of `value` in the order of the queue
+         * @return true value pushed
+         * @return false queue is full
+         */
+        bool try_push(T &&value, size_t *position_in_queue = nullptr)
+        {
+            size_t position = _enqueue_position.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (1)
+            {
+                cell = &_cells[position & _mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+                if (difference == 0)
+                {
+                    if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (difference < 0) // Queue is full
+                    return false;
+                else
+                    position = _enqueue_position.load(std::memory_order_relaxed);
+            }
+            cell->data = std::move(value);
+            cell->sequence.store(position + 1, std::memory_order_release);
+            if (position_in_queue)
+                *position_in_queue = position;
+            return true;
+        }
+        /**
+         * @brief Pop the oldest value of the queue
+         *
+         * @param value filled with the popped value
+         * @return true value popped
+         * @return false queue is empty
+         */
+        bool try_pop(T &value)
+        {
+            size_t position = _dequeue_position.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (1)
+            {
+                cell = &_cells[position & _mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+                if (difference == 0)
+                {
+                    if (_dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (difference < 0) // Queue is empty
+                    return false;
+                else
+                    position = _dequeue_position.load(std::memory_order_relaxed);
+            }
+            value = std::move(cell->data);
+            cell->data = T(); // Release resources kept by the cell
+            cell->sequence.store(position + _mask + 1, std::memory_order_release);
+            return true;
+        }
+        /**
+         * @brief Approximative number of values in the queue
+         */
+        size_t size() const
+        {
+            size_t enqueue_position = _enqueue_position.load(std::memory_order_seq_cst);
+            size_t dequeue_position = _dequeue_position.load(std::memory_order_seq_cst);
+            return enqueue_position > dequeue_position ? enqueue_position - dequeue_position : 0;
+        }
+        size_t capacity() const
+        {
+            return _mask + 1;
+        }
+        /**
+         * @brief Number of values pushed since the creation of the queue, including values being pushed
+         */
+        size_t get_enqueue_position() const
+        {
+            return _enqueue_position.load(std::memory_order_acquire);
+        }
+        /**
+         * @brief Number of values popped since the creation of the queue, including values being popped
+         */
+        size_t get_dequeue_position() const
+        {
+            return _dequeue_position.load(std::memory_order_acquire);
+        }
+
+    protected:
+        typedef struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T data;
+        } Cell;
+
+        // Attributes:
+        std::unique_ptr<Cell[]> _cells;                  // Ring buffer
+        size_t _mask;                                    // Capacity - 1
+        alignas(64) std::atomic<size_t> _enqueue_position; // Next position to write
+        alignas(64) std::atomic<size_t> _dequeue_position; // Next position to read
+    };
+
+    /**
+     * @brief Per channel state used by `KEEP_LATEST_PER_CHANNEL` policy
+     */
+    typedef struct ChannelQueueState
+    {
+        std::atomic<uint64_t> next_sequence{0};     // Sequence of the next message pushed on the channel
+        std::atomic<uint64_t> superseded_before{0}; // Waiting messages of the channel with a smaller sequence are outdated
+        std::atomic<uint64_t> waiting{0};           // Number of messages of the channel in the queue, or being pushed into it
+        std::atomic<bool> has_latest{false};        // Latest message of the channel is kept aside, written in place of its waiting messages
+    } ChannelQueueState;
+
+    /**
+     * @brief Type independent part of `ConnectionQueue`: backpressure policy, open state and counters.
+     */
+    class ConnectionQueueControl
+    {
+    public:
+        void set_policy(BackpressurePolicy policy) { _policy = policy; }
+        BackpressurePolicy get_policy() const { return _policy; }
+        /**
+         * @brief Number of messages that were dropped because of the backpressure policy
+         */
+        uint64_t get_number_of_dropped_messages() const { return _number_of_dropped_messages; }
+        /**
+         * @brief Number of dropped messages that were already in the queue (subset of dropped messages)
+         */
+        uint64_t get_number_of_evicted_messages() const { return _number_of_evicted_messages; }
+        virtual size_t size() const = 0;
+        virtual size_t capacity() const = 0;
+        /**
+         * @brief Ticket of the last pushed message. Messages get consecutive tickets in the order of the queue, starting at 1.
+         */
+        virtual WriteTicket get_last_ticket() const = 0;
+        /**
+         * @brief Every message with a smaller or equal ticket was popped, either by the consumer or dropped
+         */
+        virtual WriteTicket get_last_popped_ticket() const = 0;
+
+        /**
+         * @brief Accept pushes again
+         */
+        void open()
+        {
+            std::lock_guard<std::mutex> lg(_sleep_mtx);
+            _is_open = true;
+        }
+        /**
+         * @brief Reject new pushes and wake up every waiting thread. Messages already queued can still be popped.
+         */
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lg(_sleep_mtx);
+                _is_open = false;
+            }
+            _data_notifier.notify_all();
+            _space_notifier.notify_all();
+        }
+
+    protected:
+        virtual ~ConnectionQueueControl() = default;
+
+        // Attributes:
+        std::atomic<BackpressurePolicy> _policy{BackpressurePolicy::BLOCK}; // What to do when queue is full
+        std::atomic<bool> _is_open{false};                                   // Pushes are rejected when closed
+        std::atomic<bool> _consumer_is_sleeping{false};                      // Producers only notify a sleeping consumer
+        std::atomic<unsigned> _number_of_blocked_producers{0};               // Consumer only notify when producers are blocked
+        std::atomic<uint64_t> _number_of_dropped_messages{0};                // Messages dropped by the policy
+        std::atomic<uint64_t> _number_of_evicted_messages{0};                // Dropped messages that were already queued
+        std::mutex _sleep_mtx;                                               // Only used for sleeping, never taken on the fast path
+        std::condition_variable _data_notifier;                              // Wake up the consumer
+        std::condition_variable _space_notifier;                             // Wake up blocked producers
+    };
+
+    /**
+     * @brief Bounded write queue of one connection. Producers never take a lock unless they must block, the single consumer
+     * sleeps until data are pushed.
+     */
+    template <typename T>
+    class ConnectionQueue : public ConnectionQueueControl
+    {
+    public:
+        ConnectionQueue(size_t capacity) : _queue(capacity) {}
+
+        /**
+         * @brief Push `value`, applying the backpressure policy if the queue is full
+         *
+         * @param value value to push
+         * @param channel_state state of the channel of `value`, must outlive the queue
+         * @param ticket if not null, filled with the ticket of `value` (see `get_last_ticket`)
+         * @return true value was pushed
+         * @return false value was dropped or queue is closed
+         */
+        bool push(T &&value, ChannelQueueState &channel_state, WriteTicket *ticket = nullptr)
+        {
+            Entry entry;
+            entry.value = std::move(value);
+            entry.channel_state = &channel_state;
+            entry.channel_sequence = channel_state.next_sequence.fetch_add(1, std::memory_order_relaxed);
+            channel_state.waiting++;
+            while (1)
+            {
+                if (!_is_open)
+                {
+                    channel_state.waiting--;
+                    return false;
+                }
+                size_t position;
+                if (_queue.try_push(std::move(entry), &position))
+                {
+                    if (ticket)
+                        *ticket = position + 1;
+                    break;
+                }
+                // Queue is full:
+                BackpressurePolicy policy = _policy;
+                if (policy == BackpressurePolicy::DROP_NEWEST)
+                {
+                    _number_of_dropped_messages++;
+                    channel_state.waiting--;
+                    return false;
+                }
+                else if (policy == BackpressurePolicy::BLOCK)
+                {
+                    std::unique_lock<std::mutex> ul(_sleep_mtx);
+                    _number_of_blocked_producers++;
+                    _space_notifier.wait(ul, [this]()
+                                         { return _queue.size() < _queue.capacity() || !_is_open; });
+                    _number_of_blocked_producers--;
+                }
+                else if (policy == BackpressurePolicy::KEEP_LATEST_PER_CHANNEL)
+                {
+                    if (!keep_latest(std::move(entry)))
+                        return false;
+                    if (ticket)
+                        *ticket = _queue.get_enqueue_position();
+                    break;
+                }
+                else
+                {
+                    // Make room by dropping the oldest message
+                    Entry oldest_entry;
+                    if (_queue.try_pop(oldest_entry))
+                    {
+                        _number_of_dropped_messages++;
+                        _number_of_evicted_messages++;
+                        release_entry(oldest_entry);
+                    }
+                }
+            }
+            notify_consumer();
+            return true;
+        }
+        /**
+         * @brief Wait until data are available then pop all of them (at most `capacity()` values).
+         *
+         * @param out filled with popped values
+         * @param batching_window_us once woken up, wait this duration for gathering more data
+         * @return true queue is still in use
+         * @return false queue is closed and empty, consumer should stop
+         */
+        bool wait_and_pop_all(std::vector<T> &out, unsigned batching_window_us)
+        {
+            {
+                std::unique_lock<std::mutex> ul(_sleep_mtx);
+                _consumer_is_sleeping = true;
+                _data_notifier.wait(ul, [this]()
+                                    { std::atomic_thread_fence(std::memory_order_seq_cst);
+                                      return _queue.size() || !_is_open; });
+                _consumer_is_sleeping = false;
+                // Gather data that are pushed during batching window for processing them at once
+                if (batching_window_us && _is_open)
+                    _data_notifier.wait_for(ul, std::chrono::microseconds(batching_window_us), [this]()
+                                            { return !_is_open; });
+            }
+
+            Entry entry;
+            Entry latest_entry;
+            size_t number_of_popped_values = 0;
+            while (number_of_popped_values < _queue.capacity() && _queue.try_pop(entry))
+            {
+                number_of_popped_values++;
+                // Latest message of the channel, kept aside, is written in place of its first waiting message
+                bool has_latest = release_entry(entry, &latest_entry);
+                if (has_latest && latest_entry.channel_sequence < entry.channel_sequence)
+                {
+                    out.push_back(std::move(latest_entry.value));
+                    has_latest = false;
+                }
+                // Message was replaced by a more recent one of its channel
+                if (entry.channel_sequence < entry.channel_state->superseded_before.load(std::memory_order_acquire))
+                {
+                    _number_of_dropped_messages++;
+                    _number_of_evicted_messages++;
+                }
+                else
+                    out.push_back(std::move(entry.value));
+                if (has_latest)
+                    out.push_back(std::move(latest_entry.value));
+            }
+
+            // Space is available for blocked producers:
+            if (number_of_popped_values && _number_of_blocked_producers)
+            {
+                {
+                    std::lock_guard<std::mutex> lg(_sleep_mtx);
+                }
+                _space_notifier.notify_all();
+            }
+            return number_of_popped_values || _is_open || _queue.size();
+        }
+        /**
+         * @brief Drop values left in the queue, for releasing them once it is closed and its consumer stopped
+         */
+        void clear()
+        {
+            Entry entry;
+            while (_queue.try_pop(entry))
+            {
+                _number_of_dropped_messages++;
+                release_entry(entry);
+                entry = Entry();
+            }
+            std::lock_guard<std::mutex> lg(_latest_entries_mtx);
+            for (auto &kept_entry : _latest_entries)
+            {
+                _number_of_dropped_messages++;
+                kept_entry.first->has_latest = false;
+            }
+            _latest_entries.clear();
+        }
+        virtual size_t size() const override { return _queue.size(); }
+        virtual size_t capacity() const override { return _queue.capacity(); }
+        virtual WriteTicket get_last_ticket() const override { return _queue.get_enqueue_position(); }
+        virtual WriteTicket get_last_popped_ticket() const override { return _queue.get_dequeue_position(); }
+
+    protected:
+        typedef struct Entry
+        {
+            T value;
+            ChannelQueueState *channel_state = nullptr;
+            uint64_t channel_sequence = 0;
+        } Entry;
+
+        /**
+         * @brief Queue is full: keep `entry` aside, in place of waiting messages of its channel which are dropped. If no message of its
+         * channel is waiting, `entry` is dropped instead: messages of other channels are never dropped for it.
+         *
+         * @return true entry kept
+         * @return false entry dropped
+         */
+        bool keep_latest(Entry &&entry)
+        {
+            ChannelQueueState &channel_state = *entry.channel_state;
+            channel_state.waiting--; // Entry is not in the queue
+            std::lock_guard<std::mutex> lg(_latest_entries_mtx);
+            // Consumer checks `has_latest` after updating `waiting`, so one of both sees the update of the other
+            channel_state.has_latest = true;
+            auto latest_entry = _latest_entries.find(&channel_state);
+            if (!channel_state.waiting)
+            {
+                // A message kept aside can not be written in place of a waiting message anymore
+                if (latest_entry != _latest_entries.end())
+                {
+                    _latest_entries.erase(latest_entry);
+                    _number_of_dropped_messages++;
+                    _number_of_evicted_messages++;
+                }
+                channel_state.has_latest = false;
+                _number_of_dropped_messages++;
+                return false;
+            }
+            if (latest_entry == _latest_entries.end())
+                latest_entry = _latest_entries.emplace(&channel_state, Entry()).first;
+            else if (latest_entry->second.channel_sequence > entry.channel_sequence)
+            {
+                // A more recent message was kept by another producer
+                _number_of_dropped_messages++;
+                return false;
+            }
+            else
+            {
+                _number_of_dropped_messages++;
+                _number_of_evicted_messages++;
+            }
+            uint64_t superseded_before = channel_state.superseded_before.load(std::memory_order_relaxed);
+            while (superseded_before < entry.channel_sequence &&
+                   !channel_state.superseded_before.compare_exchange_weak(superseded_before, entry.channel_sequence, std::memory_order_release))
+                ;
+            latest_entry->second = std::move(entry);
+            return true;
+        }
+        /**
+         * @brief Update channel state of a popped entry
+         *
+         * @param entry Popped entry
+         * @param latest_entry if not null, filled with the latest message of the channel of `entry` if it was kept aside
+         * @return true `latest_entry` is filled
+         */
+        bool release_entry(Entry &entry, Entry *latest_entry = nullptr)
+        {
+            ChannelQueueState &channel_state = *entry.channel_state;
+            uint64_t waiting = --channel_state.waiting;
+            if (!channel_state.has_latest)
+                return false;
+            std::lock_guard<std::mutex> lg(_latest_entries_mtx);
+            auto kept_entry = _latest_entries.find(&channel_state);
+            if (kept_entry == _latest_entries.end())
+                return false;
+            if (latest_entry)
+                *latest_entry = std::move(kept_entry->second);
+            else if (waiting) // Message kept aside is written in place of the next waiting message
+                return false;
+            else // Last waiting message of the channel was dropped, message kept aside is dropped with it
+            {
+                _number_of_dropped_messages++;
+                _number_of_evicted_messages++;
+            }
+            _latest_entries.erase(kept_entry);
+            channel_state.has_latest = false;
+            return latest_entry != nullptr;
+        }
+
+        void notify_consumer()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_consumer_is_sleeping)
+            {
+                {
+                    std::lock_guard<std::mutex> lg(_sleep_mtx);
+                }
+                _data_notifier.notify_one();
+            }
+        }
+
+        // Attributes:
+        BoundedQueue<Entry> _queue;                             // Underlying lock-free queue
+        std::map<ChannelQueueState *, Entry> _latest_entries; // Latest messages kept aside by `KEEP_LATEST_PER_CHANNEL` policy when queue is full
+        std::mutex _latest_entries_mtx;                       // Only taken when queue is full, or for channels with a message kept aside
+    };
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef MCAP_WRAPPER_ENCODING_POOL_H
+#define MCAP_WRAPPER_ENCODING_POOL_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include "Payload.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Pool of threads encoding heavy samples (images) in parallel. Each worker owns a job queue and steals
+     * jobs from the other workers when its own queue is empty. Jobs of a same channel may be encoded concurrently
+     * but their payloads are always dispatched in the order the jobs were pushed.
+     */
+    class EncodingPool
+    {
+    public:
+        typedef std::function<EncodedSample()> EncodeFunction;                // Produce the payloads. Return empty payloads on failure
+        typedef std::function<void(EncodedSample const &)> DispatchFunction;  // Hand the payloads to the connections
+
+        /**
+         * @brief Construct a new Encoding Pool object
+         *
+         * @param thread_number Number of encoding threads. 0 mean one thread per core
+         */
+        EncodingPool(unsigned thread_number = 0);
+        ~EncodingPool();
+        /**
+         * @brief Queue a job. `dispatch` is called once `encode` is done and every job previously pushed on `channel_name` was dispatched.
+         * Wait if too many jobs are already pending (4 per thread).
+         *
+         * @param channel_name Channel of the job, jobs of a same channel are dispatched in push order
+         * @param encode Encoding function, executed by one of the workers
+         * @param dispatch Dispatch function, called with the result of `encode`
+         */
+        void push_job(std::string const &channel_name, EncodeFunction encode, DispatchFunction dispatch);
+        /**
+         * @brief Wait that every pushed job was encoded and dispatched
+         */
+        void wait_until_idle();
+        /**
+         * @brief Get the ticket of the last pushed job. Jobs get consecutive tickets in push order, starting at 1.
+         */
+        uint64_t get_last_job_ticket();
+        /**
+         * @brief Wait that every job with a smaller or equal ticket was dispatched, jobs pushed afterwards are not waited for
+         *
+         * @param ticket Ticket returned by `get_last_job_ticket`
+         */
+        void wait_for_jobs(uint64_t ticket);
+        /**
+         * @brief Change the number of encoding threads. Wait that pending jobs are done before resizing.
+         *
+         * @param thread_number Number of encoding threads. 0 mean one thread per core
+         */
+        void set_thread_number(unsigned thread_number);
+        /**
+         * @brief Get the number of encoding threads
+         *
+         * @return unsigned number of threads
+         */
+        unsigned get_thread_number();
+
+    protected:
+        typedef struct Job
+        {
+            std::string channel_name;
+            uint64_t sequence; // Position of the job in its channel
+            uint64_t ticket;   // Position of the job in the pool
+            EncodeFunction encode;
+            DispatchFunction dispatch;
+        } Job;
+
+        typedef struct Worker
+        {
+            std::deque<Job> jobs;    // Own jobs are taken from the front, stolen jobs from the back
+            std::mutex jobs_mtx;     // Mutex of `jobs`
+            std::thread *thread;     // Thread of the worker
+        } Worker;
+
+        typedef struct FinishedJob
+        {
+            EncodedSample encoded_sample;
+            DispatchFunction dispatch;
+            uint64_t ticket;
+        } FinishedJob;
+
+        typedef struct ChannelOrdering
+        {
+            uint64_t next_sequence_to_push = 0;                                   // Sequence given to the next pushed job
+            uint64_t next_sequence_to_dispatch = 0;                               // Sequence that must be dispatched next
+            std::map<uint64_t, FinishedJob> finished;                             // Encoded jobs waiting for previous ones
+            bool is_dispatching = false;                                          // A worker is dispatching jobs of the channel, others hand their jobs to it
+            std::mutex mtx;                                                       // Mutex of the ordering
+        } ChannelOrdering;
+
+        void start_workers(unsigned thread_number);
+        void stop_workers();
+        void run(unsigned worker_index); // Function executed by each worker
+        bool take_job(unsigned worker_index, Job &job);
+        void finish_job(Job &job, EncodedSample const &encoded_sample);
+
+        // Attributes:
+        std::vector<std::unique_ptr<Worker>> _workers;                            // All workers
+        std::atomic<unsigned> _next_worker;                                       // Worker receiving the next job (round robin)
+        std::map<std::string, std::shared_ptr<ChannelOrdering>> _channel_ordering; // Ordering of each channel
+        std::mutex _channel_ordering_mtx;                                         // Mutex of `_channel_ordering`
+        bool _continue_working;                                                   // Indicate to the workers if they must continue
+        unsigned _queued_jobs;                                                    // Number of jobs not yet taken by a worker
+        unsigned _pending_jobs;                                                   // Number of jobs not yet dispatched
+        unsigned _max_pending_jobs;                                               // Pushing wait above this number of pending jobs
+        uint64_t _last_job_ticket = 0;                                            // Ticket of the last pushed job
+        std::set<uint64_t> _pending_job_tickets;                                  // Tickets of jobs not yet dispatched
+        std::mutex _jobs_counter_mtx;                                             // Mutex of `_continue_working`, `_queued_jobs`, `_pending_jobs` and job tickets
+        std::condition_variable _job_notifier;                                    // Wake up workers when a job is pushed
+        std::condition_variable _idle_notifier;                                   // Notify when jobs were dispatched
+    };
+};
+
+#endif
@@ -0,0 +1,395 @@
+#ifndef MCAP_WRAPPER_ENCODING_STAGE_H
+#define MCAP_WRAPPER_ENCODING_STAGE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <atomic>
+#include <functional>
+#include <string_view>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include "json.hpp"
+#include "Payload.h"
+#include "IWriter.h"
+#include "EncodingPool.h"
+#include "OpenedChannel.h"
+#include "define.h"
+#include "MCAPWriter.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Function serializing a sample in the given message encoding (JSON or PROTOBUF), appending it to `out`
+     */
+    typedef std::function<void(MessageEncoding encoding, std::string &out)> SampleSerializer;
+
+    /**
+     * @brief Encoding stage shared by every connection. Each sample is encoded once into an immutable payload
+     * which is then handed to all the connections it must be written to. Encoding is performed by a dedicated
+     * thread so that pushing functions return immediately. Samples are encoded once per message encoding (JSON, protobuf)
+     * used by their connections. Images are encoded in parallel by a pool of threads, with the codec configured for their channel (JPEG by default).
+ * The number of waiting data is bounded: pushing functions wait when the encoding thread cannot keep up.
+     * Logs, raw JSON and messages of opened channels are staged per producer thread: producers do not share any lock for pushing them,
+     * the encoding thread merges the messages of all producers in the order they were pushed.
+     */
+    class EncodingStage
+    {
+    public:
+        EncodingStage();
+        ~EncodingStage();
+        /**
+         * @brief Queue an image that will be encoded once, with the codec of its channel, and written to all `targets`
+         *
+         * @param targets Connections where the image must be written
+         * @param identifier Channel name of the image
+         * @param image Image to encode
+         * @param timestamp Timestamp of the image
+         * @param frame_id Frame of reference of the image
+         */
+        void push_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id);
+        /**
+         * @brief Queue an image that will be written without compression (foxglove.RawImage) to all `targets`. Image buffer is
+         * shared, not copied: it must not be modified until the image is written. Its type must be supported by `get_raw_image_encoding`.
+         *
+         * @param targets Connections where the image must be written
+         * @param identifier Channel name of the image
+         * @param image Image to write
+         * @param timestamp Timestamp of the image
+         * @param frame_id Frame of reference of the image
+         */
+        void push_raw_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id);
+        /**
+         * @brief Queue an already compressed image that will be written as is (foxglove.CompressedImage) to all `targets`.
+         * Messages are built before returning, straight from `data`: it is the only copy of the image.
+         *
+         * @param targets Connections where the image must be written
+         * @param identifier Channel name of the image
+         * @param data Compressed image
+         * @param size Size of compressed image
+         * @param format Format of compressed image (e.g. "jpeg")
+         * @param timestamp Timestamp of the image
+         * @param frame_id Frame of reference of the image
+         */
+        void push_compressed_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id);
+        /**
+         * @brief Queue a camera calibration that will be serialized once and written to all `targets`
+         *
+         * @param targets Connections where the calibration must be written
+         * @param camera_identifier Channel name of the calibration
+         * @param timestamp Timestamp of the calibration
+         * @param frame_id Frame of reference for the camera
+         * @param image_width Image width
+         * @param image_height Image height
+         * @param distortion_model Name of distortion model
+         * @param D Distortion parameters
+         * @param K Intrinsic camera matrix
+         * @param R Rectification matrix
+         * @param P Projection/camera matrix
+         */
+        void push_camera_calibration(std::vector<std::shared_ptr<IWriter>> const &targets,
+                                     std::string const &camera_identifier,
+                                     uint64_t timestamp,
+                                     std::string const &frame_id,
+                                     unsigned image_width,
+                                     unsigned image_height,
+                                     std::string const &distortion_model,
+                                     std::array<double, 5> const &D,
+                                     std::array<double, 9> const &K,
+                                     std::array<double, 9> const &R,
+                                     std::array<double, 12> const &P);
+        /**
+         * @brief Queue a serialized JSON that will be written as is to all `targets`. It is only parsed when its
+         * schema must be inferred or when it must be converted into CBOR.
+         *
+         * @param targets Connections where the message must be written
+         * @param identifier Channel name of the message
+         * @param serialized_message JSON serialized into string
+         * @param timestamp Timestamp of the message
+         */
+        void push_raw_message(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, std::string const &serialized_message, uint64_t timestamp);
+        /**
+         * @brief Queue a log that will be serialized once and written to all `targets`
+         *
+         * @param targets Connections where the log must be written
+         * @param log_channel_name Channel name of the log
+         * @param timestamp Timestamp of the log
+         * @param log_level Log level
+         * @param message Log message
+         * @param name Process or node name
+         * @param file Filename
+         * @param line Line number in the file
+         */
+        void push_log(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &log_channel_name, uint64_t timestamp, int log_level, std::string const &message, std::string const &name, std::string const &file, uint32_t line);
+        /**
+         * @brief Queue a sample of a known foxglove type (transforms, scene updates, annotations...) that will be
+         * serialized once and written to all `targets`
+         *
+         * @param targets Connections where the sample must be written
+         * @param channel_name Channel name of the sample
+         * @param sample Sample of data
+         * @param serialized_schema Schema of the sample, from FoxgloveSchema.hpp (only its address is kept). Used for creating channel on JSON connections that does not have it yet
+         * @param protobuf_message_name Foxglove message of the sample (e.g. "foxglove.FrameTransform"). Used by protobuf connections
+         * @param timestamp Timestamp of the sample
+         */
+        void push_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, nlohmann::json const &sample, std::string const &serialized_schema, std::string const &protobuf_message_name, uint64_t timestamp);
+        /**
+         * @brief Queue a sample of a known foxglove type that will be serialized once per message encoding by `serializer`, without
+         * building a JSON document, and written to all `targets`
+         *
+         * @param targets Connections where the sample must be written
+         * @param channel_name Channel name of the sample
+         * @param serializer Function serializing the sample. Called from encoding thread: it must own the data of the sample
+         * @param serialized_schema Schema of the sample, from FoxgloveSchema.hpp (only its address is kept). Used for creating channel on JSON connections that does not have it yet
+         * @param protobuf_message_name Foxglove message of the sample (e.g. "foxglove.FrameTransform"). Used by protobuf connections
+         * @param timestamp Timestamp of the sample
+         */
+        void push_serializable_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, SampleSerializer &&serializer, std::string const &serialized_schema, std::string const &protobuf_message_name, uint64_t timestamp);
+        /**
+         * @brief Queue a log of a channel opened with `open_channel`. It is serialized in the encoding of the channel and written without
+         * looking up the channel. Queued messages are reused: pushing does not allocate once they are warm.
+         *
+         * @param channel Opened log channel, must be resolved and outlive the stage
+         * @param timestamp Timestamp of the log
+         * @param log_level Log level
+         * @param message Log message
+         * @param name Process or node name
+         * @param file Filename
+         * @param line Line number in the file
+         */
+        void push_channel_log(OpenedChannel &channel, uint64_t timestamp, int log_level, std::string_view message, std::string_view name, std::string_view file, uint32_t line);
+        /**
+         * @brief Queue a frame transform of a channel opened with `open_channel`. See `push_channel_log`.
+         *
+         * @param channel Opened transform channel, must be resolved and outlive the stage
+         * @param timestamp Timestamp of the transform
+         * @param parent Name of the parent frame
+         * @param child Name of the child frame
+         * @param pose Transform from parent frame to child frame
+         */
+        void push_channel_frame_transform(OpenedChannel &channel, uint64_t timestamp, std::string_view parent, std::string_view child, Eigen::Matrix4f const &pose);
+        /**
+         * @brief Queue a serialized JSON of a raw JSON channel opened with `open_channel`. The channel is resolved by the first message,
+         * once its schema is inferred. See `push_channel_log`.
+         *
+         * @param channel Opened channel, must outlive the stage
+         * @param serialized_message JSON serialized into string
+         * @param size Size of `serialized_message`
+         * @param timestamp Timestamp of the message
+         */
+        void push_channel_raw_message(OpenedChannel &channel, char const *serialized_message, size_t size, uint64_t timestamp);
+        /**
+         * @brief Queue a serialized JSON of a raw JSON channel without copying it. `serialized_message` is left empty, with a capacity
+         * that could be reused for the next message.
+         *
+         * @param channel Opened channel, must outlive the stage
+         * @param serialized_message JSON serialized into string
+         * @param timestamp Timestamp of the message
+         */
+        void push_channel_raw_message(OpenedChannel &channel, std::string &&serialized_message, uint64_t timestamp);
+        /**
+         * @brief Queue raw JSON, log and frame transform messages of a batch with one lock per `MAX_NUMBER_OF_STAGED_MESSAGES`
+         * messages. Images are queued in batch order, as with `push_image`. Sync connections are waited for once, after the last
+         * message. See `push_channel_log`.
+         *
+         * @param channels Opened channel of each message, of a same connection
+         * @param items Messages
+         * @param number_of_items Number of messages
+         */
+        void push_channel_batch(OpenedChannel *const *channels, BatchItem const *items, size_t number_of_items);
+        /**
+         * @brief Wait until data queued so far are encoded and handed to their connections. Data are encoded by the encoding
+         * thread, images pushed after this call are not waited for.
+         */
+        void flush();
+        /**
+         * @brief Wait until data pushed so far to sync connections of `targets` are written (see `IWriter::set_sync`). Only the
+         * calling thread waits: the encoding thread never waits for connections.
+         *
+         * @param targets Connections to which data were pushed
+         */
+        void wait_sync_targets(std::vector<std::shared_ptr<IWriter>> const &targets);
+        /**
+         * @brief Set the number of threads used for encoding images. Images of a same channel are still written in push order.
+         *
+         * @param thread_number Number of encoding threads. 0 mean one thread per core
+         */
+        void set_image_encoding_thread_number(unsigned thread_number);
+        /**
+         * @brief Set the options used for writing the images of a channel. Applied to images that are not encoded yet.
+         *
+         * @param channel_name Channel name of the images
+         * @param options Codec and its parameters
+         */
+        void set_image_channel_options(std::string const &channel_name, ImageChannelOptions const &options);
+        /**
+         * @brief Enable or disable the validation of serialized JSON messages that do not need to be parsed
+         *
+         * @param validate Invalid messages are dropped if true, written as is otherwise
+         */
+        void set_raw_message_validation(bool validate);
+
+    protected:
+        void run(); // Function used for encoding data asynchronously
+        void queue_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, uint64_t enqueue_time, std::string const &frame_id); // `push_image` without waiting for sync connections
+        void encode_all_waiting_data();
+        void take_staged_messages();
+        void encode_waiting_images();
+        void prepare_camera_calibration_messages();
+        void prepare_raw_message();
+        void prepare_log();
+        void prepare_samples();
+        void prepare_channel_messages();
+        bool encode_channel_raw_message(OpenedChannel &channel, std::string const &serialized_message, std::string &out);
+        void notify_new_data();
+        void notify_staged_data(bool staging_is_full);
+        void dispatch(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, std::string const &serialized_schema, std::string const &protobuf_message_name, EncodedSample const &encoded_sample, uint64_t timestamp, uint64_t enqueue_time);
+        static void get_needed_encodings(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, bool &json_needed, bool &protobuf_needed);
+        static EncodedSample encode_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, nlohmann::json const &sample, std::string const &protobuf_message_name);
+        static EncodedSample serialize_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, SampleSerializer const &serializer);
+
+        // Attributes:
+        std::thread *_encoding_thread;                                      // Encoding thread
+        bool _continue_encoding;                                            // Variable used for indicating to the encoding thread if encoding must continue
+        std::atomic<bool> _has_waiting_data{false};                         // Variable used for indicating to the encoding thread that data were pushed
+        unsigned _number_of_waiting_data = 0;                               // Number of data waiting to be encoded, staged messages excepted
+        static const unsigned MAX_NUMBER_OF_WAITING_DATA = 65536;           // Producers wait above this number of waiting data
+        uint64_t _number_of_staging_takes = 0;                              // Incremented each time the encoding thread takes the messages staged by producers
+        uint64_t _number_of_started_passes = 0;                             // Passes of the encoding thread over waiting data, see `flush`
+        uint64_t _number_of_finished_passes = 0;
+        uint64_t _last_job_ticket_of_finished_pass = 0;                     // Last image handed to the pool by the last finished pass
+        std::mutex _continue_encoding_mtx;                                  // Mutex of `_continue_encoding`, `_number_of_waiting_data`, `_number_of_staging_takes` and passes. Taken for setting `_has_waiting_data` only when it was false
+        std::condition_variable _encode_notifier;                           // Used for waking up the encoding thread
+        std::condition_variable _pass_notifier;                             // Notify when a pass of the encoding thread is finished
+        std::condition_variable _space_notifier;                            // Used for waking up producers waiting for space
+        std::mutex _encoding_is_being_process;                              // Mutex that is grab during the whole encoding process
+        EncodingPool _image_encoding_pool;                                  // Pool encoding images in parallel
+
+        // For async issue:
+        typedef struct ImageWaitingToBeEncoded
+        {
+            std::vector<std::shared_ptr<IWriter>> targets;
+            std::string identifier;
+            cv::Mat image;
+            uint64_t timestamp;
+            uint64_t enqueue_time;
+            std::string frame_id;
+            bool is_raw;                 // Written as foxglove.RawImage, without compression
+            ImageChannelOptions options; // Options of the channel, set when the image is handed to the pool
+            EncodedSample encoded_sample; // Messages of an image given already compressed, `image` is then empty
+        } ImageWaitingToBeEncoded;
+        std::vector<ImageWaitingToBeEncoded> _image_waiting_to_be_encoded;
+        std::mutex _image_waiting_to_be_encoded_mtx;
+        std::map<std::string, ImageChannelOptions> _image_channel_options; // Options of channels that do not use the default ones
+        std::mutex _image_channel_options_mtx;
+        static EncodedSample encode_image(ImageWaitingToBeEncoded const &image_data, bool json_needed, bool protobuf_needed);
+        static EncodedSample make_compressed_image_sample(uint64_t timestamp, std::string const &frame_id, uint8_t const *data, size_t size, std::string const &format, bool json_needed, bool protobuf_needed);
+        static EncodedSample encode_raw_image(ImageWaitingToBeEncoded const &image_data, bool json_needed, bool protobuf_needed);
+        static void get_image_codec_parameters(ImageChannelOptions const &options, std::string &extension, std::string &format, std::vector<int> &compression_params);
+
+        typedef struct CameraCalibration
+        {
+            std::vector<std::shared_ptr<IWriter>> targets;
+            std::string camera_identifier;
+            uint64_t timestamp;
+            uint64_t enqueue_time;
+            std::string frame_id;
+            unsigned image_width;
+            unsigned image_height;
+            std::string distortion_model;
+            std::array<double, 5> D;
+            std::array<double, 9> K;
+            std::array<double, 9> R;
+            std::array<double, 12> P;
+        } CameraCalibration;
+        std::vector<CameraCalibration> _camera_calibration_waiting_to_be_encoded;
+        std::mutex _camera_calibration_waiting_to_be_encoded_mtx;
+
+        typedef struct RawMessage
+        {
+            std::vector<std::shared_ptr<IWriter>> targets;
+            std::string identifier;
+            std::string serialized_message;
+            uint64_t timestamp;
+            uint64_t enqueue_time;
+        } RawMessage;
+        std::atomic<bool> _validate_raw_messages{true}; // Serialized JSON that are not parsed are validated
+        void encode_raw_message(RawMessage &raw_message, bool validate);
+
+        typedef struct Log
+        {
+            std::vector<std::shared_ptr<IWriter>> targets;
+            std::string identifier;
+            uint64_t timestamp;
+            uint64_t enqueue_time;
+            int log_level;
+            std::string message;
+            std::string name;
+            std::string file;
+            uint32_t line;
+        } Log;
+        void encode_log(Log &log_message);
+
+        typedef struct Sample
+        {
+            std::vector<std::shared_ptr<IWriter>> targets;
+            std::string channel_name;
+            nlohmann::json sample;
+            SampleSerializer serializer; // Used instead of `sample` when set
+            std::string const *serialized_schema; // Static schema of FoxgloveSchema.hpp
+            std::string protobuf_message_name;
+            uint64_t timestamp;
+            uint64_t enqueue_time;
+        } Sample;
+        std::vector<Sample> _sample_waiting_to_be_encoded;
+        std::mutex _sample_waiting_to_be_encoded_mtx;
+
+        typedef struct ChannelMessage
+        {
+            OpenedChannel *channel;
+            uint64_t timestamp;
+            uint64_t enqueue_time;
+            std::string text;     // Serialized JSON, log message or parent frame
+            std::string name;     // Log name or child frame
+            std::string file;     // Log file
+            int log_level;
+            uint32_t line;
+            Eigen::Matrix4f pose; // Frame transform
+        } ChannelMessage;
+        typedef struct ChannelMessageBatch
+        {
+            std::vector<ChannelMessage> messages; // Messages after `size` are kept for reusing their strings
+            size_t size = 0;                      // Number of queued messages
+        } ChannelMessageBatch;
+        static ChannelMessage &get_next_channel_message(ChannelMessageBatch &batch, OpenedChannel &channel, uint64_t timestamp, uint64_t enqueue_time);
+        void encode_channel_message(ChannelMessage &channel_message);
+
+        // Messages staged by a producer thread
+        typedef struct StagedMessages
+        {
+            std::vector<RawMessage> raw_messages;
+            std::vector<Log> logs;
+            ChannelMessageBatch channel_messages;
+        } StagedMessages;
+        typedef struct ProducerStaging
+        {
+            StagedMessages waiting;          // Filled by the producer, guarded by `mtx`
+            StagedMessages being_encoded;    // Only used by encoding thread
+            std::mutex mtx;                  // Only shared by the producer and the encoding thread
+            std::atomic<bool> in_use{true};  // Released when its producer thread ends, the staging is then reused by the next new producer thread
+        } ProducerStaging;
+        static const size_t MAX_NUMBER_OF_STAGED_MESSAGES = 4096; // A producer waits the encoding thread above this number of staged messages so that its staging stops growing
+        ProducerStaging &get_producer_staging();
+        static bool is_staging_full(ProducerStaging const &staging); // Must be called with `staging.mtx` locked
+        std::vector<std::unique_ptr<ProducerStaging>> _producer_stagings; // Stagings of every producer thread, never removed
+        std::mutex _producer_stagings_mtx;
+        std::vector<ProducerStaging *> _stagings_being_encoded; // Only used by encoding thread
+        std::vector<std::pair<uint64_t, size_t>> _staging_merge_heap; // Only used by encoding thread
+    };
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef MCAP_WRAPPER_FILE_WRITABLE_H
+#define MCAP_WRAPPER_FILE_WRITABLE_H
+
+#include <string>
+#include <cstdio>
+#include "mcap/writer.hpp"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Output file of `MCAPFileWriter`. Same as `mcap::FileWriter` but written data can be pushed to the OS and forced to disk.
+     * The file can be preallocated by large extents as it grows and written data handed to disk behind the writes (Linux only).
+     */
+    class FileWritable : public mcap::IWritable
+    {
+    public:
+        /**
+         * @brief Construct a new file
+         *
+         * @param preallocation_size File is allocated by extents of this size ahead of writes, space not written is freed by `end`. 0 mean no preallocation
+         * @param write_behind_size Written data are handed to disk by windows of this size and the window before is dropped from page cache. 0 mean disabled
+         */
+        FileWritable(uint64_t preallocation_size = 0, uint64_t write_behind_size = 0);
+        ~FileWritable() override;
+        /**
+         * @brief Create file (erase previous one if it existed)
+         *
+         * @param file_name path of the file
+         * @return mcap::Status success or reason of the failure
+         */
+        virtual mcap::Status open(std::string const &file_name);
+        void handleWrite(const std::byte *data, uint64_t size) override;
+        void end() override;
+        uint64_t size() const override;
+        /**
+         * @brief Give buffered data to the OS. Data survive a crash of the process, not of the system.
+         *
+         * @return true data flushed
+         * @return false file is not open or flush failed
+         */
+        virtual bool flush();
+        /**
+         * @brief Flush then force data to disk (fsync)
+         *
+         * @return true data are on disk
+         * @return false file is not open or sync failed
+         */
+        virtual bool sync();
+
+    protected:
+        void preallocate(int fd, uint64_t end_offset);          // Allocate next extent of the file if `end_offset` passes allocated space
+        void write_behind(int fd, uint64_t end_offset);         // Hand to disk windows of data before `end_offset`, drop the previous ones from page cache
+        void free_preallocated_space(int fd, uint64_t size);    // Free allocated space beyond the `size` bytes of the file
+
+        // Attributes:
+        std::FILE *_file = nullptr;    // Opened file
+        uint64_t _size = 0;            // Number of bytes written
+        uint64_t _preallocation_size;  // Size of allocated extents, 0 for none
+        uint64_t _write_behind_size;   // Size of write behind windows, 0 for none
+        uint64_t _allocated_size = 0;  // End of allocated space
+        uint64_t _write_behind_offset = 0; // End of data handed to disk
+    };
+};
+
+#endif
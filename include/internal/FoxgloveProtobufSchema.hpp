@@ -0,0 +1,42 @@
+#ifndef FOXGLOVE_PROTOBUF_SCHEMA_HPP
+#define FOXGLOVE_PROTOBUF_SCHEMA_HPP
+
+#include <string>
+#include <cstdint>
+#include "internal/json.hpp"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Get the protobuf schema of a foxglove message: a serialized `google.protobuf.FileDescriptorSet` containing
+     * the message and all its dependencies, as expected by MCAP "protobuf" schema encoding.
+     *
+     * @param message_name Full name of the message (e.g. "foxglove.CompressedImage")
+     * @return std::string const& Serialized descriptor set. Empty if message is not known
+     */
+    std::string const &get_foxglove_protobuf_schema(std::string const &message_name);
+    /**
+     * @brief Serialize into protobuf a sample of a foxglove message given in the JSON layout used by the wrapper.
+     * Unknown keys and keys whose type does not match the message definition are ignored.
+     *
+     * @param message_name Full name of the message (e.g. "foxglove.Log")
+     * @param sample Sample in JSON
+     * @param out Serialized message, appended to it
+     * @return true Sample serialized
+     * @return false Message is not known
+     */
+    bool foxglove_json_to_protobuf(std::string const &message_name, nlohmann::json const &sample, std::string &out);
+    /**
+     * @brief Parse a protobuf serialized foxglove message into the JSON layout used by the wrapper. Bytes fields are base64 encoded.
+     *
+     * @param message_name Full name of the message (e.g. "foxglove.Log")
+     * @param data Serialized message
+     * @param size Size of serialized message
+     * @param out Parsed sample
+     * @return true Message parsed
+     * @return false Message is not known or malformed
+     */
+    bool foxglove_protobuf_to_json(std::string const &message_name, uint8_t const *data, size_t size, nlohmann::json &out);
+};
+
+#endif
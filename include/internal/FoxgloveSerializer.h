@@ -0,0 +1,74 @@
+#ifndef MCAP_WRAPPER_FOXGLOVE_SERIALIZER_H
+#define MCAP_WRAPPER_FOXGLOVE_SERIALIZER_H
+
+#include <string>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <Eigen/Core>
+#include "MCAPWriter.h"
+#include "define.h"
+
+namespace mcap_wrapper
+{
+    //
+    // Serializers of foxglove messages whose layout is fixed. Messages are written straight into `out`, in JSON
+    // (same layout than the JSON schemas of FoxgloveSchema.hpp) or in protobuf (`encoding` is PROTOBUF).
+    //
+
+    /**
+     * @brief Serialize a foxglove.Log
+     *
+     * @param encoding Message encoding, JSON or PROTOBUF
+     * @param out Serialized message, appended to it
+     * @param timestamp Timestamp of the log
+     * @param level Log level
+     * @param message Log message
+     * @param name Process or node name
+     * @param file Filename
+     * @param line Line number in the file
+     */
+    void serialize_log(MessageEncoding encoding, std::string &out, uint64_t timestamp, int level, std::string const &message, std::string const &name, std::string const &file, uint32_t line);
+    /**
+     * @brief Serialize a foxglove.CameraCalibration
+     *
+     * @param encoding Message encoding, JSON or PROTOBUF
+     * @param out Serialized message, appended to it
+     * @param timestamp Timestamp of the calibration
+     * @param frame_id Frame of reference for the camera
+     * @param width Image width
+     * @param height Image height
+     * @param distortion_model Name of distortion model
+     * @param D Distortion parameters
+     * @param K Intrinsic camera matrix
+     * @param R Rectification matrix
+     * @param P Projection/camera matrix
+     */
+    void serialize_camera_calibration(MessageEncoding encoding, std::string &out, uint64_t timestamp, std::string const &frame_id, unsigned width, unsigned height,
+                                      std::string const &distortion_model, std::array<double, 5> const &D, std::array<double, 9> const &K,
+                                      std::array<double, 9> const &R, std::array<double, 12> const &P);
+    /**
+     * @brief Serialize a foxglove.FrameTransform. Frame ids of one character or less are omitted.
+     *
+     * @param encoding Message encoding, JSON or PROTOBUF
+     * @param out Serialized message, appended to it
+     * @param timestamp Timestamp of the transform
+     * @param parent Parent frame id
+     * @param child Child frame id
+     * @param pose Transform from parent to child
+     */
+    void serialize_frame_transform(MessageEncoding encoding, std::string &out, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose);
+    /**
+     * @brief Serialize a foxglove.ImageAnnotations
+     *
+     * @param encoding Message encoding, JSON or PROTOBUF
+     * @param out Serialized message, appended to it
+     * @param circle_annotations Circle annotations
+     * @param points_annotations Points annotations
+     * @param text_annotations Text annotations
+     */
+    void serialize_image_annotations(MessageEncoding encoding, std::string &out, std::vector<CircleAnnotation> const &circle_annotations,
+                                     std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations);
+};
+
+#endif
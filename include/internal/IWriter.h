@@ -6,20 +6,32 @@
 #include <queue>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
+#include <future>
 #include <map>
 #include <Eigen/Core>
-#include <opencv2/core.hpp>
-#include <opencv2/imgproc.hpp>
-#include <opencv2/imgcodecs.hpp>
-#include "internal/Base64.hpp"
 #include "mcap/writer.hpp"
 #include "json.hpp"
 #include "Internal3DObject.h"
+#include "Payload.h"
+#include "LatencyHistogram.h"
+#include "BoundedQueue.hpp"
 #include "utils.hpp"
+#include "define.h"
+#include "Trajectory.h"
 
 namespace mcap_wrapper
 {
+    /**
+     * @brief Channel of a connection resolved once, for pushing payloads without looking up the channel by its name
+     */
+    typedef struct ChannelRoute
+    {
+        mcap::ChannelId channel_id = 0;           // Id of the channel in the connection
+        ChannelQueueState *queue_state = nullptr; // Write queue state of the channel, lives as long as the connection
+    } ChannelRoute;
+
     class IWriter
     {
     public:
@@ -38,13 +50,40 @@ namespace mcap_wrapper
          */
         virtual bool is_open() = 0;
         /**
-         * @brief Push sample into file.
+         * @brief Push sample into file. The sample is serialized and its schema is infered if the channel does not have one yet.
          *
          * @param channel_name Channel to which data will be pushed.
          * @param sample Sample of data
          * @param timestamp Timestamp of data
          */
-        virtual void push_sample(std::string channel_name, nlohmann::json sample, uint64_t timestamp) = 0;
+        virtual void push_sample(std::string const &channel_name, nlohmann::json const &sample, uint64_t timestamp);
+        /**
+         * @brief Push already serialized sample into file. The schema of the channel must already be present.
+         *
+         * @param channel_name Channel to which data will be pushed.
+         * @param payload Serialized sample, may be shared with other connections
+         * @param timestamp Timestamp of data
+         * @param enqueue_time Steady time (see `get_steady_time_ns`) at which the sample entered the wrapper. Used for measuring write latency
+         */
+        void push_payload(std::string const &channel_name, Payload const &payload, uint64_t timestamp, uint64_t enqueue_time);
+        /**
+         * @brief Push already serialized sample into a channel resolved by `resolve_channel`
+         *
+         * @param route Channel to which data will be pushed
+         * @param payload Serialized sample, may be shared with other connections
+         * @param timestamp Timestamp of data
+         * @param enqueue_time Steady time (see `get_steady_time_ns`) at which the sample entered the wrapper. Used for measuring write latency
+         */
+        virtual void push_payload(ChannelRoute const &route, Payload const &payload, uint64_t timestamp, uint64_t enqueue_time) = 0;
+        /**
+         * @brief Resolve channel `channel_name` for pushing payloads to it without name lookup
+         *
+         * @param channel_name Name of the channel
+         * @param route Filled with the channel
+         * @return true Channel resolved
+         * @return false Channel does not exist yet (its schema is not present)
+         */
+        bool resolve_channel(std::string const &channel_name, ChannelRoute &route);
         /**
          * @brief Return true if one schema is already present in writer for dedicated channel. A schema is what will describe the data for foxglove studio.
          *
@@ -52,173 +91,70 @@ namespace mcap_wrapper
          * @return true One schema is already present
          * @return false No schema present
          */
-        virtual bool is_schema_present(std::string channel_name);
+        virtual bool is_schema_present(std::string const &channel_name);
         /**
          * @brief Create a schema by infering data type contained into data sample
          *
          * @param channel_name Channel name of data
          * @param sample Sample of data
          */
-        virtual void infer_schema(std::string channel_name, nlohmann::json sample);
+        virtual void infer_schema(std::string const &channel_name, nlohmann::json const &sample);
         /**
          * @brief Create a schema for data corresponding to `channel_name`
          *
          * @param channel_name Channel name of data
          * @param schema Schema of data
+         * @param message_encoding Encoding of messages of the channel, "json" or "cbor"
          */
-        virtual void create_schema(std::string channel_name, nlohmann::json schema) = 0;
-        /**
-         * @brief Create a 3D object that can own some primitives like triangle, rectangle, etc...
-         *
-         * @param object_name name of the 3D object
-         * @param frame_id [optionnal] corresponding frame ID
-         * @param frame_locked [optionnal] Is object should keep it position or move with the specified frame
-         */
-        virtual void create_3D_object(std::string object_name, std::string frame_id = "", bool frame_locked = false);
-        /**
-         * @brief Add metadata to 3D object
-         *
-         * @param object_name Name of associated 3D object
-         * @param metadata metadata that will be added to the object
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
-         */
-        virtual bool add_metadata_to_3d_object(std::string object_name, std::pair<std::string, std::string> metadata);
+        virtual void create_schema(std::string const &channel_name, nlohmann::json const &schema, std::string const &message_encoding) = 0;
         /**
-         * @brief Add arrow to 3D object
+         * @brief Create the schema of `channel_name` if it is not already present. Schema is only parsed when it must be created.
          *
-         * @param object_name Name of associated 3D object
-         * @param pose Position of the arrow in the space
-         * @param shaft_length Length of the arrow's shaft
-         * @param shaft_diameter Diameter of the arrow's shaft
-         * @param head_length Length of the arrow's head
-         * @param head_diameter Diameter of the arrow's head
-         * @param color Color of the object
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
-         */
-        virtual bool add_arrow_to_3d_object(std::string object_name,
-                                            Eigen::Matrix4f pose,
-                                            double shaft_length,
-                                            double shaft_diameter,
-                                            double head_length,
-                                            double head_diameter,
-                                            std::array<double, 4> color = {0, 0, 0, 1});
-        /**
-         * @brief Add cube to 3D object
-         *
-         * @param object_name Name of associated 3D object
-         * @param pose Position of the cube in the space
-         * @param size Size of the cube in the space
-         * @param color Color of the cube in the space
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
+         * @param channel_name Channel name of data
+         * @param serialized_schema Schema of data serialized into string
+         * @param message_encoding Encoding of messages of the channel, "json" or "cbor"
          */
-        virtual bool add_cube_to_3d_object(std::string object_name,
-                                           Eigen::Matrix4f pose,
-                                           std::array<double, 3> size,
-                                           std::array<double, 4> color = {0, 0, 0, 1});
+        void ensure_schema(std::string const &channel_name, std::string const &serialized_schema, std::string const &message_encoding = "json");
         /**
-         * @brief Add sphere to 3D object
+         * @brief Create a protobuf schema and channel for foxglove message `message_name`
          *
-         * @param object_name Name of associated 3D object
-         * @param pose Position of the sphere in the space
-         * @param size Size of the sphere in the space
-         * @param color Color of the sphere in the space
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
+         * @param channel_name Channel name of data
+         * @param message_name Full name of the foxglove message (e.g. "foxglove.CompressedImage")
          */
-        virtual bool add_sphere_to_3d_object(std::string object_name,
-                                             Eigen::Matrix4f pose,
-                                             std::array<double, 3> size,
-                                             std::array<double, 4> color = {0, 0, 0, 1});
+        virtual void create_protobuf_schema(std::string const &channel_name, std::string const &message_name) = 0;
         /**
-         * @brief Add cylinder to the 3D object
+         * @brief Create the protobuf schema of `channel_name` if it is not already present
          *
-         * @param object_name Name of associated 3D object
-         * @param pose Position of the cylinder in the space
-         * @param bottom_scale Scale of the bottom of cylinder
-         * @param top_scale Scale of the top of cylinder
-         * @param size Size of cylinder in the space
-         * @param color Color of the cylinder in the space
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
+         * @param channel_name Channel name of data
+         * @param message_name Full name of the foxglove message
          */
-        virtual bool add_cylinder_to_3d_object(std::string object_name,
-                                               Eigen::Matrix4f pose,
-                                               double bottom_scale,
-                                               double top_scale,
-                                               std::array<double, 3> size,
-                                               std::array<double, 4> color = {0, 0, 0, 1});
+        void ensure_protobuf_schema(std::string const &channel_name, std::string const &message_name);
         /**
-         * @brief Add line to 3D object
+         * @brief Set the encoding used for foxglove messages of channels that will be created afterwards
          *
-         * @param object_name Name of associated 3D object
-         * @param pose Position of the cylinder in the space
-         * @param thickness Thickness of the line
-         * @param scale_invariant Is the thickness must be specified in pixel and be fixed (true) or being scale relative to distance to the camera (false)
-         * @param points Points constituting the line
-         * @param color Color of the whole line
-         * @param colors Per point color. Erase the `color` definition. The size of `colors` must correspond to the size of `points`
-         * @param indices Indices into the points and colors attribute arrays, which can be used to avoid duplicating attribute data.
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
+         * @param encoding Message encoding
          */
-        virtual bool add_line_to_3d_object(std::string object_name,
-                                           Eigen::Matrix4f pose,
-                                           double thickness,
-                                           bool scale_invariant,
-                                           std::vector<Eigen::Vector3d> points,
-                                           std::array<double, 4> color,
-                                           std::vector<std::array<double, 4>> colors,
-                                           std::vector<uint32_t> indices);
+        void set_message_encoding(MessageEncoding encoding);
         /**
-         * @brief Add triangle to 3D object
+         * @brief Get the encoding of `channel_name`. For channels that do not exist yet, it is the encoding of the connection.
          *
-         * @param object_name Name of associated 3D object
-         * @param pose Position of the triangle in the space
-         * @param points Vertices to use for triangles, interpreted as a list of triples (0-1-2, 3-4-5, ...)
-         * @param color Color of the whole triangle
-         * @param colors Per vertex color. Erase the `color` definition. The size of `colors` must correspond to the size of `points`
-         * @param indices Indices into the points and colors attribute arrays, which can be used to avoid duplicating attribute data.
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
+         * @param channel_name Name of the channel
+         * @return MessageEncoding Encoding of foxglove messages written on this channel
          */
-        virtual bool add_triangle_to_3d_object(std::string object_name,
-                                               Eigen::Matrix4f pose,
-                                               std::vector<Eigen::Vector3d> points,
-                                               std::array<double, 4> color,
-                                               std::vector<std::array<double, 4>> colors,
-                                               std::vector<uint32_t> indices);
+        MessageEncoding get_channel_message_encoding(std::string const &channel_name);
         /**
-         * @brief Add text to 3D object
+         * @brief Set the encoding used for raw JSON messages of channels that will be created afterwards
          *
-         * @param object_name Name of associated 3D object
-         * @param pose Position of the text in the space
-         * @param billboard Whether the text should respect pose.orientation (false) or always face the camera (true)
-         * @param font_size Font size (height of one line of text)
-         * @param scale_invariant Indicates whether font_size is a fixed size in screen pixels (true), or specified in world coordinates and scales with distance from the camera (false)
-         * @param color Color of the text
-         * @param text Text
-         * @return true The primitive was added
-         * @return false The primitive was not added (error occur)
+         * @param encoding Message encoding, JSON or CBOR
          */
-        virtual bool add_text_to_3d_object(std::string object_name,
-                                           Eigen::Matrix4f pose,
-                                           bool billboard,
-                                           double font_size,
-                                           bool scale_invariant,
-                                           std::array<double, 4> color,
-                                           std::string text);
+        void set_raw_message_encoding(MessageEncoding encoding);
         /**
-         * @brief Write 3D object into the file
+         * @brief Get the encoding of raw JSON channel `channel_name`. For channels that do not exist yet, it is the raw message encoding of the connection.
          *
-         * @param object_name Name of the object to push
-         * @param timestamp Timestamp in which the object will be pushed
-         * @return true Everything does fines.
-         * @return false Everything does wrong.
+         * @param channel_name Name of the channel
+         * @return MessageEncoding Encoding of raw JSON messages written on this channel
          */
-        virtual bool write_3d_object_to_all(std::string object_name, uint64_t timestamp);
+        MessageEncoding get_raw_channel_message_encoding(std::string const &channel_name);
         /**
          * @brief Add position that could be vizualized into 3D. Position could be linked to frame thanks to the `frame_id` parameter.
          *
@@ -229,90 +165,108 @@ namespace mcap_wrapper
          * @return true  Everything does fines.
          * @return false Everything does wrong.
          */
-        virtual bool add_position_to_all(std::string position_channel_name, uint64_t timestamp, Eigen::Matrix4f pose, std::string frame_id);
+        virtual bool add_position_to_all(std::string const &position_channel_name, uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id);
+        /**
+         * @brief Set the history kept by position channel `position_channel_name`
+         *
+         * @param position_channel_name Name of position
+         * @param options History options
+         */
+        void set_trajectory_options(std::string const &position_channel_name, TrajectoryOptions const &options);
 
         /**
-         * @brief Set the sync mode. In sync mode every write must wait it end to return
+         * @brief Set the sync mode. In sync mode functions writing to this connection return once their data are written
+         * (see `EncodingStage::wait_sync_targets`)
          *
          * @param sync Is suposed to be sync
          */
         virtual void set_sync(bool sync);
-
-        // For pushing function zeros runtime:
-        void write_image(std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id = "");
-        void write_camera_calibration(std::string const & camera_identifier,
-                                     uint64_t timestamp,
-                                     std::string const & frame_id,
-                                     unsigned image_width,
-                                     unsigned image_height,
-                                     std::string const & distortion_model,
-                                     std::array<double, 5> const & D,
-                                     std::array<double, 9> const & K,
-                                     std::array<double, 9> const & R,
-                                     std::array<double, 12> const & P);
-        void write_raw_message(std::string const & identifier, std::string const & serialized_message, uint64_t timestamp);
-        void write_log(std::string const &log_channel_name, uint64_t timestamp, int log_level, std::string const &message, std::string const &name, std::string const &file, uint32_t line);
+        /**
+         * @brief Return true if the connection is in sync mode
+         */
+        bool is_sync();
+        /**
+         * @brief Get the ticket of the last message pushed to the write queue
+         *
+         * @return WriteTicket ticket, 0 if no message was pushed
+         */
+        WriteTicket get_last_write_ticket();
+        /**
+         * @brief Get a future that is ready once messages up to `ticket` are written (or dropped by the backpressure policy).
+         * Only the waiter of a ticket is woken up when it is written.
+         *
+         * @param ticket ticket of a pushed message
+         * @return std::future<void> future of the write
+         */
+        std::future<void> get_write_future(WriteTicket ticket);
+        /**
+         * @brief Wait until messages up to `ticket` are written (or dropped by the backpressure policy)
+         *
+         * @param ticket ticket of a pushed message
+         */
+        void wait_written(WriteTicket ticket);
+        /**
+         * @brief Wait until every message pushed so far is written
+         *
+         * @return true messages written
+         * @return false messages could not be flushed to their destination
+         */
+        virtual bool flush();
+        /**
+         * @brief Set when written data are forced to disk. Only file connections are concerned.
+         *
+         * @param policy fsync policy
+         */
+        void set_fsync_policy(FsyncPolicy policy);
+        /**
+         * @brief Set the batching window. Once woken up by new data the writing thread wait this duration for
+         * gathering more data before writing. 0 mean that data are written as soon as they are pushed.
+         *
+         * @param batching_window_us Batching window in microseconds
+         */
+        virtual void set_batching_window(unsigned batching_window_us);
+        /**
+         * @brief Get the latencies between the moment samples entered the wrapper and the moment they were written
+         *
+         * @return LatencyHistogram const& histogram of latencies
+         */
+        LatencyHistogram const &get_write_latency();
+        /**
+         * @brief Get the write queue of the connection. Used for setting its backpressure policy and reading its drop counters.
+         *
+         * @return ConnectionQueueControl& write queue
+         */
+        virtual ConnectionQueueControl &get_queue() = 0;
+        /**
+         * @brief Destroy the IWriter object
+         */
+        virtual ~IWriter() = default;
 
     protected:
-        void encode_waiting_images(); // Encode image into mcap message
-        void prepare_camera_calibration_messages(); 
-        void prepare_raw_message();
-        void prepare_log();
+        ChannelQueueState &get_channel_queue_state(std::string const &channel_name); // Must be called with `_all_channels_mtx` locked
+        MessageEncoding get_channel_message_encoding(std::string const &channel_name, MessageEncoding default_encoding);
+        void notify_messages_written(WriteTicket last_written_ticket);                 // Called by writing thread once messages up to `last_written_ticket` are written
+        void complete_all_write_futures();                                             // Called once the writing thread stopped
 
         // Attributes:
         std::map<std::string, mcap::Channel> _all_channels;                 // All channels schema
-        std::map<std::string, Internal3DObject> _all_3d_object;             // Definition of all 3D objects.
-        std::map<std::string, std::vector<Eigen::Matrix4f>> _all_positions; // Keep track of all positions for a dedicated channel
-        bool is_write_sync = false;                                         // Attribute that is used for knowing if write should be sync
-
-        // For async issue:
-        typedef struct ImageWaitingToBeEncoded
-        {
-            std::string identifier;
-            cv::Mat image;
-            uint64_t timestamp;
-            std::string frame_id;
-        } ImageWaitingToBeEncoded;
-        std::vector<ImageWaitingToBeEncoded> _image_waiting_to_be_encoded;
-        std::mutex _image_waiting_to_be_encoded_mtx;
-
-        typedef struct CameraCalibration
-        {
-            std::string camera_identifier;
-            uint64_t timestamp;
-            std::string frame_id;
-            unsigned image_width;
-            unsigned image_height;
-            std::string distortion_model;
-            std::array<double, 5> D;
-            std::array<double, 9> K;
-            std::array<double, 9> R;
-            std::array<double, 12> P;
-        } CameraCalibration;
-        std::vector<CameraCalibration> _camera_calibration_waiting_to_be_encoded;
-        std::mutex _camera_calibration_waiting_to_be_encoded_mtx;
-
-        typedef struct RawMessage{
-            std::string identifier;
-            std::string serialized_message;
-            uint64_t timestamp;
-        } RawMessage;
-        std::vector<RawMessage> _raw_message_waiting_to_be_encoded;
-        std::mutex _raw_message_waiting_to_be_encoded_mtx;
-
-        typedef struct Log{
-            std::string identifier;
-            uint64_t timestamp;
-            int log_level;
-            std::string message;
-            std::string name;
-            std::string file;
-            uint32_t line;
-        } Log;
-        std::vector<Log> _log_waiting_to_be_encoded;
-        std::mutex _log_waiting_to_be_encoded_mtx;
+        std::map<std::string, ChannelQueueState> _channel_queue_states;     // Write queue state of each channel
+        std::mutex _all_channels_mtx;                                       // Mutex of `_all_channels` and `_channel_queue_states`
+        std::mutex _schema_creation_mtx;                                    // Avoid creating twice the same schema
+        std::map<std::string, Trajectory> _trajectories;                    // History of each position channel
+        std::mutex _trajectories_mtx;                                       // Mutex of `_trajectories`
+        std::atomic<bool> is_write_sync{false};                             // Attribute that is used for knowing if write should be sync
+        std::atomic<FsyncPolicy> _fsync_policy{FsyncPolicy::NEVER};         // When written data are forced to disk
+        std::atomic<unsigned> _batching_window_us{0};                       // Duration during which data are gathered before being written
+        std::atomic<MessageEncoding> _message_encoding{MessageEncoding::JSON}; // Encoding of foxglove messages for new channels
+        std::atomic<MessageEncoding> _raw_message_encoding{MessageEncoding::JSON}; // Encoding of raw JSON messages for new channels
+        LatencyHistogram _write_latency;                                    // Latencies between enqueue and write
+        std::atomic<WriteTicket> _last_written_ticket{0};                   // Messages up to this ticket are written
+        std::multimap<WriteTicket, std::promise<void>> _write_promises;     // Promises of futures waiting for their ticket, sorted by ticket
+        std::atomic<size_t> _number_of_write_promises{0};                   // Size of `_write_promises`, writing thread only lock when there are promises
+        std::mutex _write_promises_mtx;                                     // Mutex of `_write_promises`
     };
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,55 @@
+#ifndef MCAP_WRAPPER_INDEXED_CHANNEL_READER_H
+#define MCAP_WRAPPER_INDEXED_CHANNEL_READER_H
+
+#include <vector>
+#include "mcap/reader.hpp"
+#include "ZstdDictionary.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Read messages of one channel of an indexed MCAP file, in the order they were written. Only chunks holding messages
+     * of the channel are read, thanks to chunk and message indexes, and decompressed into a buffer of the reader.
+     * Zstd chunks compressed with a dictionary of the file are decompressed with it.
+     */
+    class IndexedChannelReader
+    {
+    public:
+        /**
+         * @brief Construct a reader positioned on the first message of the channel
+         *
+         * @param file_reader Reader of the file, its summary must be read. Must outlive this reader
+         * @param channel_id Channel to read
+         * @param dictionaries Zstd dictionaries of the file. Must outlive this reader
+         */
+        IndexedChannelReader(mcap::McapReader &file_reader, mcap::ChannelId channel_id, ZstdDecompressionDictionaries const &dictionaries);
+        /**
+         * @brief Get current message, its data stay valid until `next` is called
+         *
+         * @return mcap::Message const* Current message, nullptr once every message was read
+         */
+        mcap::Message const *get_message() const;
+        /**
+         * @brief Move to the next message of the channel
+         */
+        void next();
+
+    protected:
+        bool read_chunk(mcap::ChunkIndex const &chunk_index); // Decompress chunk and read message index of the channel
+        bool read_message();                                  // Parse message at `_next_message` of current chunk
+
+        // Attributes:
+        mcap::McapReader &_file_reader;
+        mcap::ChannelId _channel_id;
+        ZstdDecompressionDictionaries const &_dictionaries;
+        std::vector<mcap::ChunkIndex const *> _chunk_indexes; // Chunks holding messages of the channel, in file order
+        size_t _next_chunk = 0;                               // Index in `_chunk_indexes` of the chunk read after the current one
+        std::vector<std::byte> _chunk_records;                // Decompressed records of current chunk
+        mcap::MessageIndex _message_index;                    // Messages of the channel in current chunk
+        size_t _next_message = 0;                             // Index in `_message_index` of current message
+        mcap::Message _message;                               // Current message, pointing into `_chunk_records`
+        bool _has_message = false;                            // False once every message was read
+    };
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MCAP_WRAPPER_JSON_WRITER_H
+#define MCAP_WRAPPER_JSON_WRITER_H
+
+#include <string>
+#include <cstdint>
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Minimal JSON writer. Values are directly appended to a buffer, without building a document: used for
+     * messages whose layout is known. Separators between values are written automatically.
+     */
+    class JsonWriter
+    {
+    public:
+        /**
+         * @brief Construct a new Json Writer object
+         *
+         * @param buffer Buffer where JSON is appended
+         */
+        JsonWriter(std::string &buffer);
+        void begin_object();
+        void end_object();
+        void begin_array();
+        void end_array();
+        /**
+         * @brief Write the key of the next value of current object
+         *
+         * @param key Key, written without escaping: it must be a plain identifier
+         */
+        void write_key(char const *key);
+        void write_value(double value); // Non finite values are written as null
+        void write_value(int64_t value);
+        void write_value(uint64_t value);
+        void write_value(int value);
+        void write_value(unsigned value);
+        void write_value(std::string const &value);
+        /**
+         * @brief Write a timestamp as `{"sec": ..., "nsec": ...}`
+         *
+         * @param timestamp Timestamp in nanoseconds
+         */
+        void write_timestamp(uint64_t timestamp);
+
+    protected:
+        void write_separator();
+
+        std::string &_buffer;      // Buffer where JSON is appended
+        bool _needs_comma = false; // A value was written in current object or array
+    };
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef MCAP_WRAPPER_LATENCY_HISTOGRAM_H
+#define MCAP_WRAPPER_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Log-linear histogram of latencies in nanoseconds (8 buckets per power of two, ~12% resolution).
+     * Recording is wait-free so it could be done from the writing thread while another thread read percentiles.
+     */
+    class LatencyHistogram
+    {
+    public:
+        LatencyHistogram();
+        /**
+         * @brief Record one latency
+         *
+         * @param latency_ns latency in nanoseconds
+         */
+        void record(uint64_t latency_ns);
+        /**
+         * @brief Get the number of recorded latencies
+         *
+         * @return uint64_t number of latencies
+         */
+        uint64_t get_count() const;
+        /**
+         * @brief Get the latency under which `percentile` percent of the recorded latencies are
+         *
+         * @param percentile percentile between 0 and 100
+         * @return uint64_t latency in nanoseconds, 0 if nothing was recorded
+         */
+        uint64_t get_percentile(double percentile) const;
+
+    protected:
+        static unsigned get_bucket_index(uint64_t latency_ns);
+        static uint64_t get_bucket_upper_bound(unsigned bucket_index);
+
+        // Attributes:
+        static const unsigned NUMBER_OF_BUCKETS = 16 + 60 * 8;
+        std::array<std::atomic<uint64_t>, NUMBER_OF_BUCKETS> _buckets; // Number of latencies in each bucket
+        std::atomic<uint64_t> _count;                                  // Number of recorded latencies
+    };
+};
+
+#endif
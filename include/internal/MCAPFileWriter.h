@@ -14,6 +14,9 @@
 #include "Internal3DObject.h"
 #include "utils.hpp"
 #include "IWriter.h"
+#include "FileWritable.h"
+#include "UringFileWritable.h"
+#include "PipelinedMcapWriter.h"
 
 namespace mcap_wrapper
 {
@@ -21,16 +24,17 @@ namespace mcap_wrapper
     {
     public:
         // Constructor / desctructor
-        MCAPFileWriter();
+        MCAPFileWriter(unsigned queue_capacity = 4096);
         ~MCAPFileWriter();
         /**
          * @brief Open MCAP file in write mode. Will create a dedicated write thread
          *
          * @param file_name path to file to write
+         * @param options Compression and chunking of the file
          * @return true Open succeed
          * @return false Open failed
          */
-        virtual bool open(std::string file_name);
+        virtual bool open(std::string file_name, FileConnectionOptions const &options = FileConnectionOptions());
         /**
          * @brief Close file and stop writing thread
          *
@@ -45,39 +49,68 @@ namespace mcap_wrapper
          * @return false File is closed
          */
         virtual bool is_open() override;
+        using IWriter::push_payload;
         /**
-         * @brief Push sample into file.
+         * @brief Push already serialized sample into file.
          *
-         * @param channel_name Channel to which data will be pushed.
-         * @param sample Sample of data
+         * @param route Channel to which data will be pushed, resolved by `resolve_channel`
+         * @param payload Serialized sample, may be shared with other connections
          * @param timestamp Timestamp of data
+         * @param enqueue_time Steady time at which the sample entered the wrapper
          */
-        virtual void push_sample(std::string channel_name, nlohmann::json sample, uint64_t timestamp) override;
+        virtual void push_payload(ChannelRoute const &route, Payload const &payload, uint64_t timestamp, uint64_t enqueue_time) override;
         /**
          * @brief Create a schema for data corresponding to `channel_name`
          *
          * @param channel_name Channel name of data
          * @param schema Schema of data
+         * @param message_encoding Encoding of messages of the channel, "json" or "cbor"
          */
-        virtual void create_schema(std::string channel_name, nlohmann::json schema) override;
+        virtual void create_schema(std::string const &channel_name, nlohmann::json const &schema, std::string const &message_encoding) override;
+        /**
+         * @brief Create a protobuf schema and channel for foxglove message `message_name`
+         *
+         * @param channel_name Channel name of data
+         * @param message_name Full name of the foxglove message
+         */
+        virtual void create_protobuf_schema(std::string const &channel_name, std::string const &message_name) override;
+        /**
+         * @brief Get the write queue of the file
+         *
+         * @return ConnectionQueueControl& write queue
+         */
+        virtual ConnectionQueueControl &get_queue() override;
+        /**
+         * @brief Wait until every message pushed so far is written, then write the chunk in progress to the file.
+         * Data are forced to disk unless fsync policy is `FsyncPolicy::NEVER`.
+         *
+         * @return true data written to the file
+         * @return false file is closed
+         */
+        virtual bool flush() override;
         
         // Deffine operator= for std::mutex and std::conditionnal variable
         MCAPFileWriter &operator=(const MCAPFileWriter &object);
 
     protected:
         void run(); // Function used for storing data into file
+        bool flush_file(bool sync_to_disk); // Write chunk in progress and give file data to the OS, forcing them to disk if `sync_to_disk`
+        bool sync_written_data();           // Force data already written to the file to disk, chunks in progress and being compressed are not waited for
 
         // Attributes:
-        mcap::McapWriter _file_writer;                                      // File writer object
+        std::unique_ptr<FileWritable> _file;                                // Output file, written by `_file_writer`. Written with io_uring if options ask for it
+        PipelinedMcapWriter _file_writer;                                   // File writer object, compress chunks in background
         std::mutex _file_writer_mtx;                                        // Mutex of `_file_writer`
-        std::queue<mcap::Message> _data_queue;                              // Data FIFO (used by write thread to get data)
-        std::mutex _data_queue_mtx;                                         // Mutex of `_data_queue`
+        typedef struct MessageToWrite
+        {
+            mcap::Message message;                                          // Message pointing to `payload` data
+            Payload payload;                                                // Keep serialized data alive until it is written
+            uint64_t enqueue_time;                                          // Steady time at which the sample entered the wrapper
+        } MessageToWrite;
+        ConnectionQueue<MessageToWrite> _data_queue;                        // Bounded data FIFO (used by write thread to get data)
         std::thread *_writing_thread;                                       // Writing thread
-        bool _continue_writing;                                             // Variable used for indicating to the writing thread if write must continue;
-        std::condition_variable _write_notifier;                            // Used for signaling new data to write for writing thread
+        std::atomic<bool> _continue_writing;                                // Variable used for indicating to the writing thread if write must continue;
         std::map<std::string, std::string> _defined_schema;                 // Is usefull for keeping trace of defined schema
-        std::mutex write_is_being_process;                                  // Mutex that is grab during the whole write process
-        std::condition_variable write_finished_adviser;                     // Conditional variable that is notified when whole data were wrote
     };
 
 };
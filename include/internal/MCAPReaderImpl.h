@@ -9,6 +9,11 @@
 #include <opencv2/imgcodecs.hpp>
 #include "internal/Base64.hpp"
 #include "internal/json.hpp"
+#include "internal/FoxgloveProtobufSchema.hpp"
+#include "internal/ProtobufSerializer.h"
+#include "internal/RawImage.h"
+#include "internal/IndexedChannelReader.h"
+#include "internal/ZstdDictionary.h"
 #include "mcap/reader.hpp"
 #include "define.h"
 
@@ -40,6 +45,15 @@ namespace mcap_wrapper
          * @return false Everythin goes bad.
          */
         bool get_next_message(std::string channel_name, std::string &out_message);
+        /**
+         * @brief Get the next message on this channel parsed as JSON, whatever its encoding (JSON, CBOR or protobuf)
+         *
+         * @param channel_name channel to look
+         * @param out_message output message
+         * @return true Everything goes well.
+         * @return false Everythin goes bad.
+         */
+        bool get_next_message(std::string channel_name, nlohmann::json &out_message);
         /**
          * @brief Get the next image present on this channel into MCAP file
          * 
@@ -60,11 +74,22 @@ namespace mcap_wrapper
         bool get_next_logs(std::string channel_name, std::string & out_log);
 
     protected:
+        mcap::Message const *get_current_message(std::string const &channel_name); // Current message of channel, nullptr once every message was read
+        void move_to_next_message(std::string const &channel_name);               // Move channel to its next message
+        void load_zstd_dictionaries();                                            // Read zstd dictionaries stored in metadata records of the file
+        bool read_next_json(std::string const &channel_name, nlohmann::json &out_json); // Read next message of channel as JSON whatever its encoding
+        bool read_next_raw_image(std::string const &channel_name, cv::Mat &out_image);   // Read next foxglove.RawImage of channel
+        static bool build_raw_image(uint32_t width, uint32_t height, std::string const &encoding, uint32_t step, uint8_t const *data, size_t size, cv::Mat &out_image);
+
         std::map<std::string, MCAPReaderChannelType> _channels_description;
+        std::map<std::string, std::string> _channels_message_encoding;                       // Message encoding of each channel ("json" or "protobuf")
+        std::map<std::string, std::string> _channels_schema_name;                            // Schema name of each channel
         mcap::McapReader _file_reader;
         bool _is_file_open = false;
         std::map<std::string, std::shared_ptr<mcap::LinearMessageView>> _channel_message_view;
         std::map<std::string, std::shared_ptr<mcap::LinearMessageView::Iterator>> _channel_iterator;
+        std::map<std::string, std::shared_ptr<IndexedChannelReader>> _channel_readers; // Readers of channels of indexed files, used instead of iterators
+        ZstdDecompressionDictionaries _zstd_dictionaries;                                // Zstd dictionaries of the file, by id
     };
 
 }; // namespace mcap_wrapper
@@ -30,7 +30,7 @@ namespace mcap_wrapper
     {
     public:
         // Constructor / desctructor
-        MCAPWebSocketWriter();
+        MCAPWebSocketWriter(unsigned queue_capacity = 4096);
         ~MCAPWebSocketWriter();
         /**
          * @brief Open MCAP file in write mode. Will create a dedicated write thread
@@ -59,16 +59,32 @@ namespace mcap_wrapper
          *
          * @param channel_name Channel name of data
          * @param schema Schema of data
+         * @param message_encoding Encoding of messages of the channel, "json" or "cbor"
          */
-        virtual void create_schema(std::string channel_name, nlohmann::json schema) override;
+        virtual void create_schema(std::string const &channel_name, nlohmann::json const &schema, std::string const &message_encoding) override;
         /**
-         * @brief Push sample into file.
+         * @brief Create a protobuf schema and channel for foxglove message `message_name`
          *
-         * @param channel_name Channel to which data will be pushed.
-         * @param sample Sample of data
+         * @param channel_name Channel name of data
+         * @param message_name Full name of the foxglove message
+         */
+        virtual void create_protobuf_schema(std::string const &channel_name, std::string const &message_name) override;
+        using IWriter::push_payload;
+        /**
+         * @brief Push already serialized sample to remote clients.
+         *
+         * @param route Channel to which data will be pushed, resolved by `resolve_channel`
+         * @param payload Serialized sample, may be shared with other connections
          * @param timestamp Timestamp of data
+         * @param enqueue_time Steady time at which the sample entered the wrapper
+         */
+        virtual void push_payload(ChannelRoute const &route, Payload const &payload, uint64_t timestamp, uint64_t enqueue_time) override;
+        /**
+         * @brief Get the write queue of the server
+         *
+         * @return ConnectionQueueControl& write queue
          */
-        virtual void push_sample(std::string channel_name, nlohmann::json sample, uint64_t timestamp) override;
+        virtual ConnectionQueueControl &get_queue() override;
        
         // Deffine operator= for std::mutex and std::conditionnal variable
         MCAPWebSocketWriter &operator=(const MCAPWebSocketWriter &object);
@@ -84,19 +100,18 @@ namespace mcap_wrapper
         // Attributes:
         std::unique_ptr<foxglove::ServerInterface<websocketpp::connection_hdl>> _server_writer;  // File writer object
         std::mutex _server_writer_mtx;                                        // Mutex of `server_writer`
-        std::queue<std::pair<foxglove::ChannelId,nlohmann::json>> _data_queue;                              // Data FIFO (used by write thread to get data)
-        std::mutex _data_queue_mtx;                                         // Mutex of `_data_queue`
+        typedef struct MessageToWrite
+        {
+            foxglove::ChannelId channel_id;                                 // Channel of the message
+            Payload payload;                                                // Serialized message
+            uint64_t enqueue_time;                                          // Steady time at which the sample entered the wrapper
+        } MessageToWrite;
+        ConnectionQueue<MessageToWrite> _data_queue;                        // Bounded data FIFO (used by write thread to get data)
         std::thread *_writing_thread;                                       // Writing thread
-        bool _continue_writing;                                             // Variable used for indicating to the writing thread if write must continue;
-        std::condition_variable _write_notifier;                            // Used for signaling new data to write for writing thread
+        std::atomic<bool> _continue_writing{false};                         // Variable used for indicating to the writing thread if write must continue;
         std::map<std::string, std::string> _defined_schema;                 // Is usefull for keeping trace of defined schema
-        std::map<std::string, Internal3DObject> _all_3d_object;             // Definition of all 3D objects.
-        std::map<std::string, std::vector<Eigen::Matrix4f>> _all_positions; // Keep track of all positions for a dedicated channel
         std::vector<std::function<void(foxglove::WebSocketLogLevel, char const*)>> _all_server_callback; // Keep trace of all server callback function
         bool is_server_open = false;                                        // Is server open
-        bool is_write_sync = false;                                         // Attribute that is used for knowing if write should be sync
-        std::mutex write_is_being_process;                                  // Mutex that is grab during the whole write process
-        std::condition_variable write_finished_adviser;                     // Conditional variable that is notified when whole data were wrote
     };
 
 };
@@ -0,0 +1,29 @@
+#ifndef MCAP_WRAPPER_OPENED_CHANNEL_H
+#define MCAP_WRAPPER_OPENED_CHANNEL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "IWriter.h"
+#include "define.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Channel opened with `open_channel`. Everything needed for writing its messages is resolved once so that
+     * writes do not look up connections and channels by their names.
+     */
+    typedef struct OpenedChannel
+    {
+        std::shared_ptr<IWriter> writer;               // Connection of the channel
+        std::vector<std::shared_ptr<IWriter>> targets; // `writer` alone, for functions writing to several connections
+        std::string channel_name;                      // Name of the channel
+        ChannelType type;                              // Type of messages of the channel
+        MessageEncoding encoding;                      // Encoding of messages, fixed when the channel is opened
+        ChannelRoute route;                            // Channel in `writer`, valid once `is_resolved`
+        std::atomic<bool> is_resolved{false};          // Set when opened or, for raw JSON channels, by the encoding thread once the schema is inferred
+    } OpenedChannel;
+};
+
+#endif
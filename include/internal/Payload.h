@@ -0,0 +1,44 @@
+#ifndef MCAP_WRAPPER_PAYLOAD_H
+#define MCAP_WRAPPER_PAYLOAD_H
+
+#include <string>
+#include <memory>
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Serialized message. A payload is immutable once created and is shared (reference counted) between
+     * every connection it is written to, so a sample is only serialized once whatever the number of connections.
+     */
+    typedef std::shared_ptr<const std::string> Payload;
+
+    /**
+     * @brief Create a payload by taking ownership of serialized data. Once every connection released the payload, its buffer goes
+     * back to the pool of payload buffers (see `PayloadPool`).
+     *
+     * @param serialized_data serialized message
+     * @return Payload shared payload
+     */
+    Payload make_payload(std::string &&serialized_data);
+    /**
+     * @brief Get an empty buffer for serializing a message that will be given to `make_payload`. Buffers of released payloads are
+     * reused: serializing a message does not allocate once the pool is warm.
+     *
+     * @param expected_size size of the message, 0 if unknown
+     * @return std::string empty buffer with a capacity of at least `expected_size`
+     */
+    std::string acquire_payload_buffer(size_t expected_size = 0);
+
+    /**
+     * @brief Sample serialized for each message encoding needed by its connections. Payloads of encodings that
+     * no connection use are left empty.
+     */
+    typedef struct EncodedSample
+    {
+        Payload json_payload;     // Payload for JSON channels
+        Payload protobuf_payload; // Payload for protobuf channels
+        Payload cbor_payload;     // Payload for CBOR channels
+    } EncodedSample;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef MCAP_WRAPPER_PAYLOAD_POOL_H
+#define MCAP_WRAPPER_PAYLOAD_POOL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "Payload.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Pool of the memory used by payloads: buffers holding serialized messages and blocks holding payloads with their
+     * reference counts. Memory of released payloads is kept for the next ones, so creating a payload does not allocate once the pool is warm.
+     *
+     * Buffers are sorted in size classes (256 B, 1 KB, 4 KB, ... 4 MB): a buffer is kept in the biggest class it can hold, and a buffer
+     * asked for a given size is taken from the smallest class holding it. Each class keeps at most `MAX_POOLED_BYTES_PER_SIZE_CLASS`, bigger buffers are freed.
+     */
+    class PayloadPool
+    {
+    public:
+        /**
+         * @brief Get the pool shared by every payload. It is never destroyed: payloads may be released by static objects at exit.
+         *
+         * @return PayloadPool& payload pool
+         */
+        static PayloadPool &get_instance();
+        /**
+         * @brief Get an empty buffer with a capacity of at least `expected_size`, taken from released payloads if any
+         *
+         * @param expected_size size of the message that will be serialized in the buffer, 0 if unknown
+         * @return std::string empty buffer
+         */
+        std::string acquire_buffer(size_t expected_size = 0);
+        /**
+         * @brief Give back the buffer of a released payload
+         *
+         * @param buffer buffer to keep for next payloads
+         */
+        void release_buffer(std::string &&buffer);
+        /**
+         * @brief Create a payload whose buffer goes back to the pool once released
+         *
+         * @param serialized_data serialized message
+         * @return Payload shared payload
+         */
+        Payload make_payload(std::string &&serialized_data);
+        /**
+         * @brief Allocate a block of at least `size` bytes. Used for allocating payloads and their reference counts.
+         *
+         * @param size size of the block
+         * @return void* allocated block
+         */
+        void *allocate_block(size_t size);
+        /**
+         * @brief Release a block allocated by `allocate_block`
+         *
+         * @param block block to release
+         * @param size size given to `allocate_block`
+         */
+        void deallocate_block(void *block, size_t size);
+
+        // Statistics:
+        uint64_t get_number_of_acquisitions() const { return _number_of_acquisitions; } // Buffers asked with `acquire_buffer`
+        uint64_t get_number_of_hits() const { return _number_of_hits; }                 // Buffers asked and taken from released payloads
+        size_t get_pooled_bytes() const { return _pooled_bytes; }                       // Memory kept by the pool for next payloads
+        size_t get_max_pooled_bytes() const { return _max_pooled_bytes; }               // High-water mark of `get_pooled_bytes`
+        size_t get_payload_bytes() const { return _payload_bytes; }                     // Memory of the buffers of living payloads
+        size_t get_max_payload_bytes() const { return _max_payload_bytes; }             // High-water mark of `get_payload_bytes`
+
+    protected:
+        PayloadPool() = default;
+        static size_t get_size_class(size_t capacity);                // Biggest class whose size is at most `capacity`
+        static size_t get_size_class_size(size_t size_class);         // Size of the buffers of a class
+        static void update_high_water_mark(std::atomic<size_t> &high_water_mark, size_t value);
+
+        // Attributes:
+        static const size_t NUMBER_OF_SIZE_CLASSES = 8;                          // Classes of 256 B to 4 MB, each class being 4 times bigger
+        static const size_t SMALLEST_SIZE_CLASS = 256;                           // Smaller buffers are freed
+        static const size_t MAX_BUFFERS_PER_SIZE_CLASS = 1024;                   // Buffers kept at most per class
+        static const size_t MAX_POOLED_BYTES_PER_SIZE_CLASS = 16 * 1024 * 1024;  // Memory kept at most per class
+        static const size_t BLOCK_SIZE = 128;                                    // Size of blocks, enough for a payload and its reference counts
+        static const size_t MAX_NUMBER_OF_BLOCKS = 4096;                         // Blocks kept at most
+        std::vector<std::string> _buffers[NUMBER_OF_SIZE_CLASSES];               // Buffers of released payloads, per size class
+        std::mutex _buffers_mtx;                                                 // Mutex of `_buffers`
+        std::vector<void *> _blocks;                                             // Blocks of released payloads
+        std::mutex _blocks_mtx;                                                  // Mutex of `_blocks`
+        std::atomic<uint64_t> _number_of_acquisitions{0};
+        std::atomic<uint64_t> _number_of_hits{0};
+        std::atomic<size_t> _pooled_bytes{0};
+        std::atomic<size_t> _max_pooled_bytes{0};
+        std::atomic<size_t> _payload_bytes{0};
+        std::atomic<size_t> _max_payload_bytes{0};
+    };
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef MCAP_WRAPPER_PIPELINED_MCAP_WRITER_H
+#define MCAP_WRAPPER_PIPELINED_MCAP_WRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "mcap/writer.hpp"
+#include "define.h"
+#include "ZstdDictionary.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Write MCAP records like `mcap::McapWriter`, but filled chunks are compressed by a pool of threads while next messages
+     * are written. Compressed chunks are written to the output in the order they were filled, with their message indexes,
+     * so the file is the same as the one of `mcap::McapWriter`. Channels of each chunk group are written in their own chunks.
+     * Zstd chunks of a stream can be compressed with a dictionary trained on its first messages, stored in a metadata record.
+     * Their compression is `ZSTD_DICTIONARY_COMPRESSION`, only MCAPReader reads them.
+     */
+    class PipelinedMcapWriter
+    {
+    public:
+        PipelinedMcapWriter();
+        ~PipelinedMcapWriter();
+        /**
+         * @brief Start writing a MCAP file into `output` and start compression threads
+         *
+         * @param output Output of the records, must stay alive until `close`
+         * @param options Compression, chunking and number of compression threads
+         * @return true Writer opened
+         * @return false Compression of `options` is not available in this build or chunk groups are invalid
+         */
+        bool open(mcap::IWritable &output, FileConnectionOptions const &options);
+        /**
+         * @brief Write chunk in progress, summary and footer, end the output and stop compression threads
+         */
+        void close();
+        /**
+         * @brief Register a schema, its id is set
+         */
+        void addSchema(mcap::Schema &schema);
+        /**
+         * @brief Register a channel, its id is set. Its chunk group is resolved from its name and the name of its schema.
+         */
+        void addChannel(mcap::Channel &channel);
+        /**
+         * @brief Add a message to the chunk in progress. Data of the message are copied.
+         * Wait if too many chunks are waiting for compression.
+         *
+         * @param message Message to write
+         * @return mcap::Status success or reason of the failure
+         */
+        mcap::Status write(mcap::Message const &message);
+        /**
+         * @brief Hand the chunks in progress to compression and wait that every chunk is written to the output
+         */
+        void closeLastChunk();
+        /**
+         * @brief Prevent compressed chunks from being written to the output while the lock is held, e.g. for syncing the output
+         * without closing the chunks in progress
+         */
+        std::unique_lock<std::mutex> lock_output();
+
+    protected:
+        typedef struct PendingChunk
+        {
+            std::unique_ptr<mcap::IChunkWriter> records;                   // Uncompressed records, compressed by `end()`
+            std::map<mcap::ChannelId, mcap::MessageIndex> message_indexes; // Offset of messages in `records`, per channel
+            mcap::Timestamp start_time = mcap::MaxTime;                    // Smallest log time of the messages
+            mcap::Timestamp end_time = 0;                                  // Biggest log time of the messages
+            unsigned stream_index = 0;                                     // Chunk stream of the chunk
+            uint64_t sequence = 0;                                         // Position of the chunk in the file
+            bool compressed = false;                                       // `records` was compressed and the result is kept
+            uint32_t crc = 0;                                              // Checksum of the uncompressed records
+            std::string dictionary;                                        // Dictionary written in a metadata record before the chunk, empty for none
+            bool uses_dictionary = false;                                  // `records` are compressed with the dictionary of the stream
+        } PendingChunk;
+
+        typedef struct ChunkStream
+        {
+            mcap::Compression compression = mcap::Compression::None;      // Compression of the chunks
+            mcap::CompressionLevel compression_level = mcap::CompressionLevel::Default; // Compression level of the chunks
+            uint64_t chunk_size = 0;                                       // Chunks are submitted once their records reach this size
+            std::unique_ptr<PendingChunk> current_chunk;                   // Chunk receiving messages (writing thread only)
+            std::set<mcap::SchemaId> written_schemas;                      // Schemas already written in chunks of the stream
+            std::vector<std::unique_ptr<PendingChunk>> free_chunks;        // Written chunks, reused to keep their buffers and compression contexts. Under `_chunks_mtx`
+            unsigned number_of_chunks = 0;                                 // Number of allocated chunks. Under `_chunks_mtx`
+            unsigned dictionary_training_messages = 0;                     // Number of messages the dictionary is trained on, 0 once trained or without dictionary
+            std::string dictionary_samples;                                // Messages collected for training, one after the other
+            std::vector<size_t> dictionary_sample_sizes;                   // Size of each message of `dictionary_samples`
+            ZstdCompressionDictionary dictionary;                          // Dictionary of next submitted chunks, nullptr for none
+            std::string dictionary_to_write;                               // Trained dictionary, given to the next submitted chunk to be written
+        } ChunkStream;
+
+        void run();                                                        // Function executed by each compression thread
+        static bool get_chunk_stream(FileCompression compression, FileCompressionLevel compression_level, uint64_t chunk_size, unsigned dictionary_training_messages, ChunkStream &out); // False if compression is not available
+        void train_dictionary(ChunkStream &stream);                        // Train dictionary of the stream on its collected messages
+        std::unique_ptr<PendingChunk> take_free_chunk(unsigned stream_index); // Wait that a chunk of the stream is free if too many are in flight
+        void submit_current_chunk(ChunkStream &stream);                    // Hand chunk in progress of `stream` to compression
+        void compress_chunk(PendingChunk &chunk);                          // Compress and checksum records of the chunk
+        void finish_chunk(std::unique_ptr<PendingChunk> chunk);            // Write compressed chunks that are next in file order
+        void write_chunk(PendingChunk &chunk);                             // Write chunk and its message indexes to the output
+        void write_summary();                                              // Write data end, summary, footer and magic
+
+        // Attributes:
+        mcap::IWritable *_output = nullptr;                                // Output of the records
+        FileConnectionOptions _options;                                    // Options of the file
+        std::vector<ChunkStream> _streams;                                 // Chunks of channels matching no group, then chunks of each group
+        std::vector<unsigned> _channel_streams;                            // Chunk stream of each channel, index is channel id - 1
+        std::vector<mcap::Schema> _schemas;                                // All schemas, id is index + 1
+        std::vector<mcap::Channel> _channels;                              // All channels, id is index + 1
+        std::set<mcap::SchemaId> _written_schemas;                         // Schemas already written in data section
+        std::vector<mcap::ChunkIndex> _chunk_indexes;                      // Index of written chunks
+        std::vector<mcap::MetadataIndex> _metadata_indexes;                // Index of written metadata records
+        mcap::Statistics _statistics;                                      // Statistics of the file
+        uint64_t _next_chunk_sequence = 0;                                 // Sequence given to the next submitted chunk
+
+        std::vector<std::thread> _compression_threads;                     // Compression threads. None mean chunks are compressed by the writing thread
+        std::deque<std::unique_ptr<PendingChunk>> _chunks_to_compress;     // Submitted chunks, compressed in submission order
+        unsigned _max_number_of_chunks = 0;                                // Filling of a stream wait for a free chunk above this number of chunks
+        unsigned _chunks_in_flight = 0;                                    // Submitted chunks not yet written
+        bool _continue_compressing = false;                                // Indicate to compression threads if they must continue
+        std::mutex _chunks_mtx;                                            // Mutex of chunk queues and counters
+        std::condition_variable _chunk_submitted_notifier;                 // Wake up compression threads
+        std::condition_variable _chunk_written_notifier;                   // Notify that a chunk was written and is free
+
+        std::map<uint64_t, std::unique_ptr<PendingChunk>> _compressed_chunks; // Compressed chunks waiting for previous ones
+        uint64_t _next_chunk_to_write = 0;                                 // Sequence of the chunk that must be written next
+        bool _is_writing_chunks = false;                                   // A thread is writing chunks to the output
+        std::mutex _output_mtx;                                            // Mutex of `_compressed_chunks`, `_next_chunk_to_write` and `_is_writing_chunks`
+        std::mutex _output_write_mtx;                                      // Held while chunks are written to the output, see `lock_output`
+    };
+};
+
+#endif
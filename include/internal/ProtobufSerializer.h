@@ -0,0 +1,111 @@
+#ifndef MCAP_WRAPPER_PROTOBUF_SERIALIZER_H
+#define MCAP_WRAPPER_PROTOBUF_SERIALIZER_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Wire types of protobuf encoding
+     */
+    enum class ProtobufWireType
+    {
+        VARINT = 0,
+        FIXED64 = 1,
+        LENGTH_DELIMITED = 2,
+        FIXED32 = 5
+    };
+
+    /**
+     * @brief Minimal protobuf writer. Fields are directly appended to a buffer, nested messages are written in place
+     * and their length is patched once they are finished.
+     */
+    class ProtobufWriter
+    {
+    public:
+        /**
+         * @brief Construct a new Protobuf Writer object
+         *
+         * @param buffer Buffer where fields are appended
+         */
+        ProtobufWriter(std::string &buffer);
+        void write_varint(uint64_t value);
+        void write_tag(uint32_t field_number, ProtobufWireType wire_type);
+        void write_varint_field(uint32_t field_number, uint64_t value);
+        void write_double_field(uint32_t field_number, double value);
+        void write_fixed32_field(uint32_t field_number, uint32_t value);
+        void write_bytes_field(uint32_t field_number, void const *data, size_t size);
+        void write_string_field(uint32_t field_number, std::string const &value);
+        /**
+         * @brief Write a `google.protobuf.Timestamp` field
+         *
+         * @param field_number Number of the field
+         * @param timestamp Timestamp in nanoseconds
+         */
+        void write_timestamp_field(uint32_t field_number, uint64_t timestamp);
+        /**
+         * @brief Start a nested message (or a packed repeated field). Fields written until `end_nested_field` belong to it.
+         *
+         * @param field_number Number of the field
+         * @return size_t Position of the nested message, to give to `end_nested_field`
+         */
+        size_t begin_nested_field(uint32_t field_number);
+        /**
+         * @brief Finish a nested message started with `begin_nested_field`
+         *
+         * @param position Value returned by `begin_nested_field`
+         */
+        void end_nested_field(size_t position);
+        void write_raw_double(double value);  // Element of a packed repeated double
+        void write_raw_fixed32(uint32_t value); // Element of a packed repeated fixed32
+        void write_raw_bytes(void const *data, size_t size); // Content of a length delimited field written in several parts
+
+    protected:
+        std::string &_buffer; // Buffer where fields are appended
+    };
+
+    /**
+     * @brief Minimal protobuf reader iterating over the fields of a serialized message
+     */
+    class ProtobufReader
+    {
+    public:
+        /**
+         * @brief Construct a new Protobuf Reader object. `data` must outlive the reader.
+         *
+         * @param data Serialized message
+         * @param size Size of the message
+         */
+        ProtobufReader(uint8_t const *data, size_t size);
+        /**
+         * @brief Read the tag of the next field
+         *
+         * @param field_number Number of the field
+         * @param wire_type Wire type of the field
+         * @return true A field was read
+         * @return false End of message or malformed message
+         */
+        bool next_field(uint32_t &field_number, ProtobufWireType &wire_type);
+        bool read_varint(uint64_t &value);
+        bool read_fixed32(uint32_t &value);
+        bool read_fixed64(uint64_t &value);
+        bool read_length_delimited(uint8_t const *&data, size_t &size);
+        /**
+         * @brief Skip the value of a field that is not known
+         *
+         * @param wire_type Wire type of the field
+         * @return true Value skipped
+         * @return false Malformed message
+         */
+        bool skip(ProtobufWireType wire_type);
+        bool is_at_end() const;
+
+    protected:
+        uint8_t const *_data; // Current position
+        uint8_t const *_end;  // End of the message
+    };
+};
+
+#endif
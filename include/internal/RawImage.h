@@ -0,0 +1,29 @@
+#ifndef MCAP_WRAPPER_RAW_IMAGE_H
+#define MCAP_WRAPPER_RAW_IMAGE_H
+
+#include <string>
+#include <opencv2/core.hpp>
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Get the foxglove.RawImage encoding corresponding to an OpenCV matrix type
+     *
+     * @param opencv_type Type of the matrix (e.g. CV_8UC3)
+     * @param encoding Corresponding encoding (e.g. "bgr8")
+     * @return true Type is supported
+     * @return false Type can not be written as raw image
+     */
+    bool get_raw_image_encoding(int opencv_type, std::string &encoding);
+    /**
+     * @brief Get the OpenCV matrix type corresponding to a foxglove.RawImage encoding
+     *
+     * @param encoding Encoding of the raw image (e.g. "mono16")
+     * @param opencv_type Corresponding matrix type (e.g. CV_16UC1)
+     * @return true Encoding is supported
+     * @return false Encoding can not be read into a matrix
+     */
+    bool get_raw_image_opencv_type(std::string const &encoding, int &opencv_type);
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MCAP_WRAPPER_TRAJECTORY_H
+#define MCAP_WRAPPER_TRAJECTORY_H
+
+#include <deque>
+#include <string>
+#include <cstdint>
+#include <Eigen/Core>
+#include "define.h"
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief History of a position channel, written as foxglove.PosesInFrame. Kept poses are serialized once: their
+     * serialization is cached so that adding a pose only serializes this pose, whatever the length of the history.
+     */
+    class Trajectory
+    {
+    public:
+        /**
+         * @brief Set the history kept by the trajectory. Applied from the next added pose.
+         *
+         * @param options History options
+         */
+        void set_options(TrajectoryOptions const &options);
+        /**
+         * @brief Add a pose and build the PosesInFrame message of the trajectory
+         *
+         * @param timestamp Timestamp of pose
+         * @param pose Pose in 3D space
+         * @param frame_id Frame of reference for poses
+         * @param encoding Encoding of the message, JSON or PROTOBUF
+         * @return std::string Serialized message
+         */
+        std::string add_pose(uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id, MessageEncoding encoding);
+
+    protected:
+        static std::string serialize_pose(Eigen::Matrix4f const &pose, MessageEncoding encoding);
+        void remove_old_poses(uint64_t timestamp);
+        void rebuild_serialized_poses(MessageEncoding encoding);
+
+        typedef struct TrajectoryPose
+        {
+            uint64_t timestamp;
+            Eigen::Matrix4f pose;
+            size_t serialized_size; // Size of the pose in `_serialized_poses`
+        } TrajectoryPose;
+
+        // Attributes:
+        TrajectoryOptions _options;
+        std::deque<TrajectoryPose> _poses;                           // Kept poses, oldest first
+        uint64_t _number_of_added_poses = 0;                         // Used for decimation
+        std::string _serialized_poses;                               // Serialization of `_poses`, ready to be copied into messages
+        MessageEncoding _serialized_encoding = MessageEncoding::JSON; // Encoding of `_serialized_poses`
+    };
+};
+
+#endif
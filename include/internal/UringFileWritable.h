@@ -0,0 +1,96 @@
+#ifndef MCAP_WRAPPER_URING_FILE_WRITABLE_H
+#define MCAP_WRAPPER_URING_FILE_WRITABLE_H
+
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#include "FileWritable.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace mcap_wrapper
+{
+    /**
+     * @brief Output file written with io_uring. Written data are copied into a ring of aligned buffers, registered to the kernel
+     * when the locked memory limit of the process allows it.
+     * Each filled buffer is handed to the kernel and written while next buffers are filled, so the writing thread only waits
+     * when every buffer is being written. With direct IO the file bypasses OS page cache.
+     * Falls back to `FileWritable` if io_uring is not available.
+     */
+    class UringFileWritable : public FileWritable
+    {
+    public:
+        /**
+         * @brief Construct a new io_uring file
+         *
+         * @param buffer_size Size of each buffer, rounded up to 4 KB
+         * @param buffer_count Number of buffers
+         * @param direct_io Open file with O_DIRECT
+         * @param preallocation_size Same as `FileWritable`
+         * @param write_behind_size Same as `FileWritable`, unused with direct IO
+         */
+        UringFileWritable(uint64_t buffer_size = 1024 * 1024, unsigned buffer_count = 8, bool direct_io = false, uint64_t preallocation_size = 0, uint64_t write_behind_size = 0);
+        ~UringFileWritable() override;
+        mcap::Status open(std::string const &file_name) override;
+        void handleWrite(const std::byte *data, uint64_t size) override;
+        void end() override;
+        uint64_t size() const override;
+        /**
+         * @brief Wait that every buffer is written. Data survive a crash of the process, not of the system.
+         *
+         * @return true data written
+         * @return false file is not open or a write failed
+         */
+        bool flush() override;
+        bool sync() override;
+        /**
+         * @brief Get if io_uring is used, false if the file fell back to `FileWritable`
+         */
+        bool is_using_io_uring() const;
+
+    protected:
+        typedef struct Buffer
+        {
+            std::byte *data = nullptr; // Aligned memory, registered to the ring
+            uint64_t size = 0;         // Number of bytes filled
+            uint64_t file_offset = 0;  // Position of the buffer in the file
+            uint64_t written = 0;      // Number of bytes written while it is in flight
+            bool in_flight = false;    // Buffer is being written by the kernel
+            iovec vector = {};         // Part of the buffer being written, by vectored writes when buffers are not registered
+        } Buffer;
+
+        bool setup_ring();                          // Create ring and register buffers, false if io_uring is not available
+        void release_ring();                        // Close ring and free buffers
+        void submit_write(unsigned buffer_index);   // Hand part of buffer that is not written yet to the kernel
+        void wait_for_buffer(unsigned buffer_index); // Wait that buffer is not in flight
+        void wait_for_all_buffers();                // Wait that no buffer is in flight
+        void reap_completions(bool wait);           // Handle completed writes, waiting for one if `wait`
+        bool write_partial_buffer();                // Write filled part of current buffer and wait for it
+
+        // Attributes:
+        uint64_t _buffer_size;                      // Size of each buffer
+        unsigned _buffer_count;                     // Number of buffers
+        bool _direct_io;                            // Open file with O_DIRECT
+        int _fd = -1;                               // Opened file, -1 when io_uring is not used
+        int _buffered_fd = -1;                      // File opened without O_DIRECT, for writes of unaligned size. Same as `_fd` without direct IO
+        int _ring_fd = -1;                          // io_uring instance
+        void *_sq_ring = nullptr;                   // Submission queue ring, mapped
+        void *_cq_ring = nullptr;                   // Completion queue ring, mapped. Same as `_sq_ring` with single mmap
+        uint64_t _sq_ring_size = 0;
+        uint64_t _cq_ring_size = 0;
+        io_uring_sqe *_sqes = nullptr;              // Submission queue entries, mapped
+        uint64_t _sqes_size = 0;
+        unsigned *_sq_head = nullptr, *_sq_tail = nullptr, *_sq_mask = nullptr, *_sq_array = nullptr;
+        unsigned *_cq_head = nullptr, *_cq_tail = nullptr, *_cq_mask = nullptr;
+        io_uring_cqe *_cqes = nullptr;
+        bool _registered_buffers = false;           // Buffers are registered, fixed writes are used
+        std::byte *_memory = nullptr;               // Memory of all buffers
+        std::vector<Buffer> _buffers;               // Ring of buffers
+        unsigned _current_buffer = 0;               // Buffer being filled
+        uint64_t _uring_size = 0;                   // Number of bytes written
+        bool _write_failed = false;                 // A write failed since last flush
+    };
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef MCAP_WRAPPER_ZSTD_DICTIONARY_H
+#define MCAP_WRAPPER_ZSTD_DICTIONARY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include "mcap/writer.hpp"
+
+struct ZSTD_CCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace mcap_wrapper
+{
+    // Zstd dictionaries are stored in metadata records of this name, chunks compressed with them reference them by id
+    static const std::string ZSTD_DICTIONARY_METADATA_NAME = "zstd_dictionary";
+    // Compression of chunks compressed with a dictionary. Other MCAP readers report it as unsupported instead of failing to decompress them
+    static const std::string ZSTD_DICTIONARY_COMPRESSION = "zstd_dictionary";
+
+    typedef std::shared_ptr<ZSTD_CDict_s const> ZstdCompressionDictionary;
+    typedef std::map<uint32_t, std::shared_ptr<ZSTD_DDict_s const>> ZstdDecompressionDictionaries; // Dictionaries by id
+
+    /**
+     * @brief Chunk records compressed with zstd, with a dictionary once one is given
+     */
+    class ZstdDictionaryChunkWriter : public mcap::IChunkWriter
+    {
+    public:
+        ZstdDictionaryChunkWriter(mcap::CompressionLevel compression_level, uint64_t chunk_size);
+        ~ZstdDictionaryChunkWriter() override;
+        /**
+         * @brief Set dictionary used by next calls of `end`. Its compression level replaces the one of the writer.
+         *
+         * @param dictionary Dictionary built by `create_zstd_compression_dictionary`, nullptr for none
+         */
+        void set_dictionary(ZstdCompressionDictionary const &dictionary);
+        void handleWrite(const std::byte *data, uint64_t size) override;
+        void end() override;
+        uint64_t size() const override;
+        uint64_t compressedSize() const override;
+        bool empty() const override;
+        void handleClear() override;
+        const std::byte *data() const override;
+        const std::byte *compressedData() const override;
+
+    protected:
+        // Attributes:
+        std::vector<std::byte> _uncompressed_buffer; // Records of the chunk
+        std::vector<std::byte> _compressed_buffer;   // Result of `end`
+        ZSTD_CCtx_s *_context = nullptr;             // Compression context, reused between chunks
+        int _compression_level;                      // Zstd level used without dictionary
+        ZstdCompressionDictionary _dictionary;       // Dictionary used by `end`
+    };
+
+    /**
+     * @brief Get zstd level of a MCAP compression level, same mapping as MCAP
+     */
+    int get_zstd_compression_level(mcap::CompressionLevel compression_level);
+    /**
+     * @brief Train a zstd dictionary on samples
+     *
+     * @param samples Samples, one after the other
+     * @param sample_sizes Size of each sample in `samples`
+     * @param max_size Maximum size of the dictionary
+     * @param out_dictionary Trained dictionary
+     * @return true Dictionary trained
+     * @return false Training failed, e.g. because there are too few samples
+     */
+    bool train_zstd_dictionary(std::string const &samples, std::vector<size_t> const &sample_sizes, size_t max_size, std::string &out_dictionary);
+    /**
+     * @brief Digest a dictionary for compression at `compression_level`
+     *
+     * @return ZstdCompressionDictionary Dictionary, nullptr if it is invalid
+     */
+    ZstdCompressionDictionary create_zstd_compression_dictionary(std::string const &dictionary, mcap::CompressionLevel compression_level);
+    /**
+     * @brief Get id of a dictionary, referenced by frames compressed with it
+     */
+    uint32_t get_zstd_dictionary_id(std::string const &dictionary);
+    /**
+     * @brief Build the metadata record storing a dictionary
+     */
+    mcap::Metadata make_zstd_dictionary_metadata(std::string const &dictionary);
+    /**
+     * @brief Add dictionary stored in a metadata record written by `make_zstd_dictionary_metadata` to `dictionaries`
+     *
+     * @return true Dictionary added
+     * @return false Metadata record does not hold a valid dictionary
+     */
+    bool add_zstd_dictionary_from_metadata(mcap::Metadata const &metadata, ZstdDecompressionDictionaries &dictionaries);
+    /**
+     * @brief Decompress a zstd chunk, with the dictionary it was compressed with if any
+     *
+     * @param data Compressed records
+     * @param size Size of `data`
+     * @param uncompressed_size Size of the records once decompressed
+     * @param dictionaries Dictionaries of the file
+     * @param out_records Decompressed records
+     * @return true Chunk decompressed
+     * @return false Chunk is corrupted or its dictionary is missing
+     */
+    bool decompress_zstd_chunk(const std::byte *data, uint64_t size, uint64_t uncompressed_size, ZstdDecompressionDictionaries const &dictionaries, std::vector<std::byte> &out_records);
+};
+
+#endif
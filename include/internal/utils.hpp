@@ -5,6 +5,8 @@
 
 namespace mcap_wrapper{
     nlohmann::json infer_property_of_sample(nlohmann::json sample, bool recursive_call = false);
+    nlohmann::json infer_schema_of_sample(std::string const &channel_name, nlohmann::json const &sample);
+    uint64_t get_steady_time_ns(); // Monotonic time used for measuring latencies
 };
 
 #endif
\ No newline at end of file
@@ -4,26 +4,230 @@
 #include "internal/FoxgloveSchema.hpp"
 #include "internal/Base64.hpp"
 #include "internal/IWriter.h"
+#include "internal/EncodingStage.h"
+#include "internal/FoxgloveSerializer.h"
+#include "internal/OpenedChannel.h"
+#include "internal/Internal3DObject.h"
+#include "internal/RawImage.h"
+#include "internal/PayloadPool.h"
 
 #include <map>
+#include <tuple>
 #include <memory>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <condition_variable>
 #include <fstream>
 #include <opencv2/imgcodecs.hpp>
 
 namespace mcap_wrapper
 {
-    // Each file stream is stored into dictionnary for being called later.
-    std::map<std::string, std::shared_ptr<IWriter>> all_writers;
+    // Opened connections. A registry is never modified once published: opening or closing a connection publishes a
+    // modified copy (copy-on-write) and increments its version. Each thread keeps the last registry it has read and only
+    // takes the lock when the version changed, writes to connections do not take any lock. A replaced registry, and the
+    // connections it was the last to hold, is released once every thread that read it has refreshed its copy.
+    typedef struct ConnectionRegistry
+    {
+        std::map<std::string, std::shared_ptr<IWriter>> writers_by_name; // Connections by their name
+        std::vector<std::shared_ptr<IWriter>> writers;                   // Same connections, for writing to all of them
+    } ConnectionRegistry;
+    std::shared_ptr<const ConnectionRegistry> connection_registry = std::make_shared<const ConnectionRegistry>();
+    std::atomic<uint64_t> connection_registry_version{0};
+    std::mutex connection_registry_mtx; // Serializes modifications of the registry and refreshes of thread copies
+    // Channels opened with `open_channel`, in slots. A handle is the index of its slot plus the generation of the slot: once a channel
+    // or its connection is closed, its slot is released for another channel and handles of previous generations fail.
+    static const ChannelHandle MAX_NUMBER_OF_OPENED_CHANNELS = 4096;
+    typedef struct OpenedChannelSlot
+    {
+        std::unique_ptr<OpenedChannel> channel;     // Channel of the slot, null when the slot is free
+        std::atomic<uint32_t> generation{0};        // Incremented when the slot is released
+        std::atomic<uint32_t> users{0};             // Number of writes using the channel, a slot is released once they are done
+        std::atomic<bool> is_being_released{false}; // Handles already fail, slot is freed once its writes are done
+    } OpenedChannelSlot;
+    OpenedChannelSlot opened_channel_slots[MAX_NUMBER_OF_OPENED_CHANNELS];
+    std::vector<ChannelHandle> free_opened_channel_slots; // Released slots, reused before slots never used
+    ChannelHandle number_of_used_slots = 0;               // Slots used at least once
+    std::mutex opened_channels_mtx;
+    std::mutex opened_channel_users_mtx;                   // Mutex of `opened_channel_users_notifier`
+    std::condition_variable opened_channel_users_notifier; // Notify releases when the last write of a slot being released is done
+    // Channels opened by `write_batch`, by connection, channel name and type
+    std::map<std::tuple<IWriter *, std::string, ChannelType>, ChannelHandle, std::less<>> batch_channels;
+    std::mutex batch_channels_mtx;
+    // Every sample is encoded once by this stage then shared between all the connections it is written to.
+    EncodingStage encoding_stage;
+    // 3D objects are described once for all connections.
+    std::map<std::string, Internal3DObject> all_3d_objects;
+    std::mutex all_3d_objects_mtx;
+    // Capacity of write queue of new connections
+    std::atomic<unsigned> connection_queue_capacity{4096};
+
+    /**
+     * @brief Get the registry of opened connections as seen by calling thread. The reference stays valid until next call
+     * from the same thread, copy it for keeping the registry longer.
+     *
+     * @return std::shared_ptr<const ConnectionRegistry> const& Connections opened
+     */
+    std::shared_ptr<const ConnectionRegistry> const &get_connection_registry()
+    {
+        thread_local std::shared_ptr<const ConnectionRegistry> thread_registry;
+        thread_local uint64_t thread_registry_version = 0;
+        uint64_t version = connection_registry_version.load(std::memory_order_acquire);
+        if (!thread_registry || thread_registry_version != version)
+        {
+            std::lock_guard<std::mutex> registry_lg(connection_registry_mtx);
+            thread_registry = connection_registry;
+            thread_registry_version = connection_registry_version.load(std::memory_order_relaxed);
+        }
+        return thread_registry;
+    }
+
+    /**
+     * @brief Publish a modified copy of the registry of opened connections. Must be called with `connection_registry_mtx` held.
+     *
+     * @param modify Modification applied on the copy of connections by their name
+     */
+    void update_connection_registry(std::function<void(std::map<std::string, std::shared_ptr<IWriter>> &)> const &modify)
+    {
+        auto registry = std::make_shared<ConnectionRegistry>();
+        registry->writers_by_name = connection_registry->writers_by_name;
+        modify(registry->writers_by_name);
+        for (auto const &kv : registry->writers_by_name)
+            registry->writers.push_back(kv.second);
+        connection_registry = std::move(registry);
+        connection_registry_version.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Release slots of channels opened with `open_channel` matching `is_released`. Their handles fail from now on. Slots are
+     * only freed once the writes using them are done and data they pushed are encoded.
+     *
+     * @param is_released Select channels to release, from their handle and channel
+     * @return size_t Number of released channels
+     */
+    size_t release_opened_channels(std::function<bool(ChannelHandle, OpenedChannel const &)> const &is_released)
+    {
+        std::vector<ChannelHandle> released_slots;
+        {
+            std::lock_guard<std::mutex> lg(opened_channels_mtx);
+            for (ChannelHandle slot = 0; slot < number_of_used_slots; slot++)
+            {
+                OpenedChannelSlot &opened_channel_slot = opened_channel_slots[slot];
+                ChannelHandle handle = opened_channel_slot.generation.load() * MAX_NUMBER_OF_OPENED_CHANNELS + slot;
+                if (opened_channel_slot.channel && !opened_channel_slot.is_being_released && is_released(handle, *opened_channel_slot.channel))
+                {
+                    opened_channel_slot.generation.fetch_add(1);
+                    opened_channel_slot.is_being_released = true;
+                    released_slots.push_back(slot);
+                }
+            }
+        }
+        if (released_slots.empty())
+            return 0;
+        // Writes that got the channel before its generation changed are waited for, then what they pushed is encoded.
+        // No lock is held meanwhile: a write of a batch may be opening another channel.
+        {
+            std::unique_lock<std::mutex> ul(opened_channel_users_mtx);
+            for (ChannelHandle slot : released_slots)
+                opened_channel_users_notifier.wait(ul, [slot]()
+                                                   { return opened_channel_slots[slot].users.load() == 0; });
+        }
+        encoding_stage.flush();
+        std::lock_guard<std::mutex> lg(opened_channels_mtx);
+        for (ChannelHandle slot : released_slots)
+        {
+            opened_channel_slots[slot].channel.reset();
+            opened_channel_slots[slot].is_being_released = false;
+            free_opened_channel_slots.push_back(slot);
+        }
+        return released_slots.size();
+    }
+
+    /**
+     * @brief Close connections removed from the registry, with their opened channels
+     *
+     * @param writers Connections to close
+     */
+    void close_writers(std::vector<std::shared_ptr<IWriter>> const &writers)
+    {
+        {
+            std::lock_guard<std::mutex> lg(batch_channels_mtx);
+            for (auto it = batch_channels.begin(); it != batch_channels.end();)
+            {
+                if (std::any_of(writers.begin(), writers.end(), [&](std::shared_ptr<IWriter> const &writer)
+                                { return writer.get() == std::get<0>(it->first); }))
+                    it = batch_channels.erase(it);
+                else
+                    it++;
+            }
+        }
+        release_opened_channels([&](ChannelHandle, OpenedChannel const &channel)
+                                { return std::find(writers.begin(), writers.end(), channel.writer) != writers.end(); });
+        // Data waiting to be encoded must reach the connection before it is closed
+        encoding_stage.flush();
+        for (auto const &writer : writers)
+            writer->close();
+    }
+
+    void add_connection(std::string const &connection_name, std::shared_ptr<IWriter> const &writer)
+    {
+        std::shared_ptr<IWriter> replaced_writer;
+        {
+            std::lock_guard<std::mutex> registry_lg(connection_registry_mtx);
+            update_connection_registry([&](std::map<std::string, std::shared_ptr<IWriter>> &writers_by_name)
+                                       {
+                std::shared_ptr<IWriter> &registered_writer = writers_by_name[connection_name];
+                replaced_writer = registered_writer;
+                registered_writer = writer; });
+        }
+        // A connection opened with the same name is no more reachable:
+        if (replaced_writer)
+            close_writers({replaced_writer});
+    }
+
+    /**
+     * @brief Close connections and remove them from the registry
+     *
+     * @param connection_name Name of the connection to close, every connection if empty
+     */
+    void close_connections(std::string const &connection_name)
+    {
+        std::vector<std::shared_ptr<IWriter>> removed_writers;
+        {
+            std::lock_guard<std::mutex> registry_lg(connection_registry_mtx);
+            if (!connection_name.empty() && !connection_registry->writers_by_name.count(connection_name))
+                return;
+            update_connection_registry([&](std::map<std::string, std::shared_ptr<IWriter>> &writers_by_name)
+                                       {
+                for (auto it = writers_by_name.begin(); it != writers_by_name.end();)
+                {
+                    if (connection_name.empty() || it->first == connection_name)
+                    {
+                        removed_writers.push_back(it->second);
+                        it = writers_by_name.erase(it);
+                    }
+                    else
+                        it++;
+                } });
+        }
+        close_writers(removed_writers);
+    }
 
     bool open_file_connection(std::string const &file_path, std::string const &connection_name)
+    {
+        return open_file_connection(file_path, FileConnectionOptions(), connection_name);
+    }
+
+    bool open_file_connection(std::string const &file_path, FileConnectionOptions const &options, std::string const &connection_name)
     {
         std::string real_connection_name = connection_name;
         if (real_connection_name == "")
             real_connection_name = file_path;
-        auto file_writer = std::make_shared<MCAPFileWriter>();
-        if (file_writer->open(file_path))
+        auto file_writer = std::make_shared<MCAPFileWriter>(connection_queue_capacity.load());
+        if (file_writer->open(file_path, options))
         {
-            all_writers[real_connection_name] = file_writer;
+            add_connection(real_connection_name, file_writer);
             return true;
         }
         return false;
@@ -33,78 +237,313 @@ namespace mcap_wrapper
     {
         if (reference_name == "")
             return false;
-        auto websocket_writer = std::make_shared<MCAPWebSocketWriter>();
+        auto websocket_writer = std::make_shared<MCAPWebSocketWriter>(connection_queue_capacity.load());
         foxglove::ServerOptions server_options;
         websocket_writer->open(url, port, server_name, server_options);
-        all_writers[reference_name] = websocket_writer;
+        add_connection(reference_name, websocket_writer);
         return true;
     }
 
     void close_file_connection(std::string const &reference_name)
     {
-        if (all_writers.count(reference_name))
-            all_writers[reference_name]->close();
+        if (!reference_name.empty())
+            close_connections(reference_name);
     }
 
     void close_all_files()
     {
-        for (auto &kv : all_writers)
-            kv.second->close();
+        close_connections("");
     }
 
     void close_all_network()
     {
-        for (auto &kv : all_writers)
-            kv.second->close();
+        close_connections("");
     }
 
     void close_network_connection(std::string const &reference_name)
     {
-        if (all_writers.count(reference_name))
-            all_writers[reference_name]->close();
+        if (!reference_name.empty())
+            close_connections(reference_name);
+    }
+
+    /**
+     * @brief Get a connection from its name
+     *
+     * @param identifier Name of the connection
+     * @return std::shared_ptr<IWriter> Connection, nullptr if it does not exist
+     */
+    std::shared_ptr<IWriter> get_writer(std::string const &identifier)
+    {
+        auto const &writers_by_name = get_connection_registry()->writers_by_name;
+        auto it = writers_by_name.find(identifier);
+        return it == writers_by_name.end() ? nullptr : it->second;
+    }
+
+    /**
+     * @brief Get every opened connection
+     *
+     * @return std::vector<std::shared_ptr<IWriter>> const& Connections, valid until next read of the registry by calling thread
+     */
+    std::vector<std::shared_ptr<IWriter>> const &get_all_writers()
+    {
+        return get_connection_registry()->writers;
     }
 
-    unsigned get_number_of_connection_presents_for_identifier(std::string const &identifier)
+    bool get_writers(std::vector<std::string> const &connection_identifier, std::vector<std::shared_ptr<IWriter>> &out_writers)
     {
-        unsigned number_of_connection_presents = 0;
-        number_of_connection_presents += all_writers.count(identifier);
-        return number_of_connection_presents;
+        bool all_found = true;
+        auto const &writers_by_name = get_connection_registry()->writers_by_name;
+        for (auto &id : connection_identifier)
+        {
+            auto it = writers_by_name.find(id);
+            if (it == writers_by_name.end())
+                all_found = false;
+            else
+                out_writers.push_back(it->second);
+        }
+        return all_found;
     }
 
+
     bool write_image_to_all(std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-            out &= write_image_to(kv.first, identifier, image, timestamp, frame_id);
-        return out;
+        // Image is encoded once for all connections
+        encoding_stage.push_image(get_all_writers(), identifier, image, timestamp, frame_id);
+        return true;
     }
 
-    bool write_image_to_all(std::vector<std::string> const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
+    bool write_image_to(std::vector<std::string> const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
     {
-        bool out = true;
-        for (auto id : connection_identifier)
-            out &= write_image_to(id, identifier, image, timestamp, frame_id);
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_image(writers, identifier, image, timestamp, frame_id);
         return out;
     }
 
     bool write_image_to(std::string const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
+        return write_image_to(std::vector<std::string>{connection_identifier}, identifier, image, timestamp, frame_id);
+    }
+
+    bool is_raw_image_supported(cv::Mat const &image)
+    {
+        std::string encoding;
+        if (image.empty() || !get_raw_image_encoding(image.type(), encoding))
+        {
+            std::cerr << "[MCAPWrapper] ERROR: image type " << image.type() << " can not be written as raw image" << std::endl;
             return false;
-        all_writers[connection_identifier]->write_image(identifier, image, timestamp, frame_id);
+        }
         return true;
     }
 
+    bool write_raw_image_to_all(std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
+    {
+        if (!is_raw_image_supported(image))
+            return false;
+        encoding_stage.push_raw_image(get_all_writers(), identifier, image, timestamp, frame_id);
+        return true;
+    }
+
+    bool write_raw_image_to(std::vector<std::string> const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
+    {
+        if (!is_raw_image_supported(image))
+            return false;
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_raw_image(writers, identifier, image, timestamp, frame_id);
+        return out;
+    }
+
+    bool write_raw_image_to(std::string const &connection_identifier, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
+    {
+        return write_raw_image_to(std::vector<std::string>{connection_identifier}, identifier, image, timestamp, frame_id);
+    }
+
+    bool is_compressed_image_valid(std::string const &identifier, uint8_t const *data, size_t size, std::string const &format)
+    {
+        if (!data || size == 0 || format.empty())
+        {
+            std::cerr << "[MCAPWrapper] ERROR: compressed image of " << identifier << " has no data or no format" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool write_compressed_image_to_all(std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id)
+    {
+        if (!is_compressed_image_valid(identifier, data, size, format))
+            return false;
+        encoding_stage.push_compressed_image(get_all_writers(), identifier, data, size, format, timestamp, frame_id);
+        return true;
+    }
+
+    bool write_compressed_image_to(std::vector<std::string> const &connection_identifier, std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id)
+    {
+        if (!is_compressed_image_valid(identifier, data, size, format))
+            return false;
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_compressed_image(writers, identifier, data, size, format, timestamp, frame_id);
+        return out;
+    }
+
+    bool write_compressed_image_to(std::string const &connection_identifier, std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id)
+    {
+        return write_compressed_image_to(std::vector<std::string>{connection_identifier}, identifier, data, size, format, timestamp, frame_id);
+    }
+
     bool set_connection_to_be_sync(std::string const &connection_name, bool sync)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_name);
-        if (number_of_connection_presents == 0)
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        writer->set_sync(sync);
+        return true;
+    }
+
+    bool flush(std::string const &connection_name)
+    {
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        // Data waiting to be encoded must reach the connection first
+        encoding_stage.flush();
+        return writer->flush();
+    }
+
+    bool get_write_future(std::string const &connection_name, std::future<void> &future)
+    {
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        encoding_stage.flush();
+        future = writer->get_write_future(writer->get_last_write_ticket());
+        return true;
+    }
+
+    bool set_connection_fsync_policy(std::string const &connection_name, FsyncPolicy policy)
+    {
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        writer->set_fsync_policy(policy);
+        return true;
+    }
+
+    bool set_connection_message_encoding(std::string const &connection_name, MessageEncoding encoding)
+    {
+        if (encoding == MessageEncoding::CBOR)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: CBOR encoding is only available for raw JSON messages" << std::endl;
+            return false;
+        }
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        writer->set_message_encoding(encoding);
+        return true;
+    }
+
+    bool set_connection_raw_message_encoding(std::string const &connection_name, MessageEncoding encoding)
+    {
+        if (encoding == MessageEncoding::PROTOBUF)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: raw JSON messages can not be written in protobuf" << std::endl;
+            return false;
+        }
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        writer->set_raw_message_encoding(encoding);
+        return true;
+    }
+
+    void set_image_encoding_thread_number(unsigned thread_number)
+    {
+        encoding_stage.set_image_encoding_thread_number(thread_number);
+    }
+
+    bool set_image_channel_options(std::string const &channel_name, ImageChannelOptions const &options)
+    {
+        if ((options.codec == ImageCodec::JPEG && (options.jpeg_quality < 0 || options.jpeg_quality > 100)) ||
+            (options.codec == ImageCodec::PNG && (options.png_compression_level < 0 || options.png_compression_level > 9)) ||
+            (options.codec == ImageCodec::WEBP && options.webp_quality < 1))
+        {
+            std::cerr << "[MCAPWrapper] ERROR: invalid image options for channel " << channel_name << std::endl;
+            return false;
+        }
+        encoding_stage.set_image_channel_options(channel_name, options);
+        return true;
+    }
+
+    bool set_connection_trajectory_options(std::string const &connection_name, std::string const &position_channel_name, TrajectoryOptions const &options)
+    {
+        if (options.decimation == 0)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: decimation of trajectory " << position_channel_name << " must be at least 1" << std::endl;
+            return false;
+        }
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        writer->set_trajectory_options(position_channel_name, options);
+        return true;
+    }
+
+    bool set_connection_batching_window(std::string const &connection_name, unsigned batching_window_us)
+    {
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        writer->set_batching_window(batching_window_us);
+        return true;
+    }
+
+    bool set_connection_backpressure_policy(std::string const &connection_name, BackpressurePolicy policy)
+    {
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
+            return false;
+        writer->get_queue().set_policy(policy);
+        return true;
+    }
+
+    void set_default_connection_queue_capacity(unsigned capacity)
+    {
+        connection_queue_capacity.store(capacity);
+    }
+
+    bool get_connection_statistics(std::string const &connection_name, ConnectionStatistics &statistics)
+    {
+        std::shared_ptr<IWriter> writer = get_writer(connection_name);
+        if (!writer)
             return false;
-        all_writers[connection_name]->set_sync(sync);
+        LatencyHistogram const &write_latency = writer->get_write_latency();
+        ConnectionQueueControl &queue = writer->get_queue();
+        statistics.written_messages = write_latency.get_count();
+        statistics.dropped_messages = queue.get_number_of_dropped_messages();
+        statistics.queue_size = queue.size();
+        statistics.queue_capacity = queue.capacity();
+        statistics.latency_p50_ns = write_latency.get_percentile(50);
+        statistics.latency_p99_ns = write_latency.get_percentile(99);
         return true;
     }
 
+    void get_payload_pool_statistics(PayloadPoolStatistics &statistics)
+    {
+        PayloadPool &pool = PayloadPool::get_instance();
+        statistics.number_of_acquisitions = pool.get_number_of_acquisitions();
+        statistics.number_of_hits = pool.get_number_of_hits();
+        statistics.hit_rate = statistics.number_of_acquisitions == 0 ? 0. : (double)statistics.number_of_hits / statistics.number_of_acquisitions;
+        statistics.pooled_bytes = pool.get_pooled_bytes();
+        statistics.max_pooled_bytes = pool.get_max_pooled_bytes();
+        statistics.payload_bytes = pool.get_payload_bytes();
+        statistics.max_payload_bytes = pool.get_max_payload_bytes();
+    }
+
     bool write_camera_calibration_all(std::string const &camera_identifier,
                                       uint64_t timestamp,
                                       std::string const &frame_id,
@@ -116,12 +555,8 @@ namespace mcap_wrapper
                                       std::array<double, 9> const &R,
                                       std::array<double, 12> const &P)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            write_camera_calibration_to(kv.first, camera_identifier, timestamp, frame_id, image_width, image_height, distortion_model, D, K, R, P);
-        }
-        return out;
+        encoding_stage.push_camera_calibration(get_all_writers(), camera_identifier, timestamp, frame_id, image_width, image_height, distortion_model, D, K, R, P);
+        return true;
     }
 
     bool write_camera_calibration_to(std::vector<std::string> const &connection_identifier,
@@ -136,11 +571,10 @@ namespace mcap_wrapper
                                      std::array<double, 9> const &R,
                                      std::array<double, 12> const &P)
     {
-        bool out = true;
-        for (auto id : connection_identifier)
-        {
-            write_camera_calibration_to(id, camera_identifier, timestamp, frame_id, image_width, image_height, distortion_model, D, K, R, P);
-        }
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_camera_calibration(writers, camera_identifier, timestamp, frame_id, image_width, image_height, distortion_model, D, K, R, P);
         return out;
     }
 
@@ -156,429 +590,551 @@ namespace mcap_wrapper
                                      std::array<double, 9> const &R,
                                      std::array<double, 12> const &P)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
-            return false;
-
-        all_writers[connection_identifier]->write_camera_calibration(camera_identifier, timestamp, frame_id, image_width, image_height, distortion_model, D, K, R, P);
+        return write_camera_calibration_to(std::vector<std::string>{connection_identifier}, camera_identifier, timestamp, frame_id, image_width, image_height, distortion_model, D, K, R, P);
+    }
 
-        return true;
+    void set_JSON_validation(bool validate)
+    {
+        encoding_stage.set_raw_message_validation(validate);
     }
 
     bool write_JSON_to_all(std::string const &identifier, std::string const &serialized_json, uint64_t timestamp)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-            out &= write_JSON_to(kv.first, identifier, serialized_json, timestamp);
-        return out;
+        encoding_stage.push_raw_message(get_all_writers(), identifier, serialized_json, timestamp);
+        return true;
     }
 
     bool write_JSON_to(std::vector<std::string> const &connection_identifier, std::string const &identifier, std::string const &serialized_json, uint64_t timestamp)
     {
-        bool out = true;
-        for (auto id : connection_identifier)
-            out &= write_JSON_to(id, identifier, serialized_json, timestamp);
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_raw_message(writers, identifier, serialized_json, timestamp);
         return out;
     }
 
     bool write_JSON_to(std::string const &connection_identifier, std::string const &identifier, std::string const &serialized_json, uint64_t timestamp)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
-            return false;
-
-        all_writers[connection_identifier]->write_raw_message(identifier, serialized_json, timestamp);
+        return write_JSON_to(std::vector<std::string>{connection_identifier}, identifier, serialized_json, timestamp);
+    }
 
-        return true;
+    SampleSerializer create_frame_transform(uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose)
+    {
+        return [timestamp, parent, child, pose](MessageEncoding encoding, std::string &out)
+        {
+            serialize_frame_transform(encoding, out, timestamp, parent, child, pose);
+        };
     }
 
-    bool add_frame_transform_to_all(std::string transform_name, uint64_t timestamp, std::string parent, std::string child, Eigen::Matrix4f pose)
+    bool add_frame_transform_to_all(std::string const &transform_name, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-            out &= add_frame_transform_to(kv.first, transform_name, timestamp, parent, child, pose);
-        return out;
+        encoding_stage.push_serializable_sample(get_all_writers(), transform_name, create_frame_transform(timestamp, parent, child, pose), get_frame_transform_schema(), "foxglove.FrameTransform", timestamp);
+        return true;
     }
 
-    bool add_frame_transform_to(std::vector<std::string> connection_identifier, std::string transform_name, uint64_t timestamp, std::string parent, std::string child, Eigen::Matrix4f pose)
+    bool add_frame_transform_to(std::vector<std::string> const &connection_identifier, std::string const &transform_name, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose)
     {
-        bool out = true;
-        for (auto id : connection_identifier)
-            out &= add_frame_transform_to(id, transform_name, timestamp, parent, child, pose);
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_serializable_sample(writers, transform_name, create_frame_transform(timestamp, parent, child, pose), get_frame_transform_schema(), "foxglove.FrameTransform", timestamp);
         return out;
     }
 
-    bool add_frame_transform_to(std::string connection_identifier, std::string transform_name, uint64_t timestamp, std::string parent, std::string child, Eigen::Matrix4f pose)
+    bool add_frame_transform_to(std::string const &connection_identifier, std::string const &transform_name, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
-            return false;
-
-        // Create transform object
-        nlohmann::json frame_tranform;
-        frame_tranform["timestamp"] = nlohmann::json();
-        frame_tranform["timestamp"]["sec"] = (uint64_t)timestamp / (uint64_t)1e9;
-        frame_tranform["timestamp"]["nsec"] = (uint64_t)timestamp % (uint64_t)1e9;
-        if (parent.size() > 1)
-            frame_tranform["parent_frame_id"] = parent;
-        if (child.size() > 1)
-            frame_tranform["child_frame_id"] = child;
-        nlohmann::json serialized_pose = Internal3DObject::pose_serializer(pose);
-        frame_tranform["translation"] = serialized_pose["position"];
-        frame_tranform["rotation"] = serialized_pose["orientation"];
-
-        ////////////////////
-        //
-        //  File connection
-        //
-        //////////////////
-        // Create schema if not present:
-        if (!all_writers[connection_identifier]->is_schema_present(transform_name))
-        {
-            nlohmann::json schema_unserialized = nlohmann::json::parse(get_frame_transform_schema());
-            all_writers[connection_identifier]->create_schema(transform_name, schema_unserialized);
-        }
-        write_JSON_to(connection_identifier, transform_name, frame_tranform.dump(), timestamp);
-
-        return true;
+        return add_frame_transform_to(std::vector<std::string>{connection_identifier}, transform_name, timestamp, parent, child, pose);
     }
 
-    void create_3D_object(std::string object_name, std::string frame_id, bool frame_locked)
+    void create_3D_object(std::string const &object_name, std::string const &frame_id, bool frame_locked)
     {
-        for (auto &kv : all_writers)
-        {
-            kv.second->create_3D_object(object_name, frame_id, frame_locked);
-        }
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        all_3d_objects[object_name] = Internal3DObject(object_name, frame_id, frame_locked);
     }
 
-    bool add_metadata_to_3d_object(std::string object_name, std::pair<std::string, std::string> metadata)
+    bool add_metadata_to_3d_object(std::string const &object_name, std::pair<std::string, std::string> const &metadata)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_metadata_to_3d_object(object_name, metadata);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_metadata(metadata);
     }
 
-    bool add_arrow_to_3d_object(std::string object_name,
-                                Eigen::Matrix4f pose,
+    bool add_arrow_to_3d_object(std::string const &object_name,
+                                Eigen::Matrix4f const &pose,
                                 double shaft_length,
                                 double shaft_diameter,
                                 double head_length,
                                 double head_diameter,
-                                std::array<double, 4> color)
+                                std::array<double, 4> const &color)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_arrow_to_3d_object(object_name, pose, shaft_length, shaft_diameter, head_length, head_diameter, color);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_arrow(pose, shaft_length, shaft_diameter, head_length, head_diameter, color);
     }
 
-    bool add_cube_to_3d_object(std::string object_name,
-                               Eigen::Matrix4f pose,
-                               std::array<double, 3> size,
-                               std::array<double, 4> color)
+    bool add_cube_to_3d_object(std::string const &object_name,
+                               Eigen::Matrix4f const &pose,
+                               std::array<double, 3> const &size,
+                               std::array<double, 4> const &color)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_cube_to_3d_object(object_name, pose, size, color);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_cube(pose, size, color);
     }
 
-    bool add_sphere_to_3d_object(std::string object_name,
-                                 Eigen::Matrix4f pose,
-                                 std::array<double, 3> size,
-                                 std::array<double, 4> color)
+    bool add_sphere_to_3d_object(std::string const &object_name,
+                                 Eigen::Matrix4f const &pose,
+                                 std::array<double, 3> const &size,
+                                 std::array<double, 4> const &color)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_sphere_to_3d_object(object_name, pose, size, color);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_sphere(pose, size, color);
     }
 
-    bool add_cylinder_to_3d_object(std::string object_name,
-                                   Eigen::Matrix4f pose,
+    bool add_cylinder_to_3d_object(std::string const &object_name,
+                                   Eigen::Matrix4f const &pose,
                                    double bottom_scale,
                                    double top_scale,
-                                   std::array<double, 3> size,
-                                   std::array<double, 4> color)
+                                   std::array<double, 3> const &size,
+                                   std::array<double, 4> const &color)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_cylinder_to_3d_object(object_name, pose, bottom_scale, top_scale, size, color);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_cylinder(pose, bottom_scale, top_scale, size, color);
     }
 
-    bool add_line_to_3d_object(std::string object_name,
-                               Eigen::Matrix4f pose,
+    bool add_line_to_3d_object(std::string const &object_name,
+                               Eigen::Matrix4f const &pose,
                                double thickness,
                                bool scale_invariant,
-                               std::vector<Eigen::Vector3d> points,
-                               std::array<double, 4> color,
-                               std::vector<std::array<double, 4>> colors,
-                               std::vector<uint32_t> indices)
+                               std::vector<Eigen::Vector3d> const &points,
+                               std::array<double, 4> const &color,
+                               std::vector<std::array<double, 4>> const &colors,
+                               std::vector<uint32_t> const &indices)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_line_to_3d_object(object_name, pose, thickness, scale_invariant, points, color, colors, indices);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_line(pose, thickness, scale_invariant, points, color, colors, indices);
     }
 
-    bool add_triangle_to_3d_object(std::string object_name,
-                                   Eigen::Matrix4f pose,
-                                   std::vector<Eigen::Vector3d> points,
-                                   std::array<double, 4> color,
-                                   std::vector<std::array<double, 4>> colors,
-                                   std::vector<uint32_t> indices)
+    bool add_triangle_to_3d_object(std::string const &object_name,
+                                   Eigen::Matrix4f const &pose,
+                                   std::vector<Eigen::Vector3d> const &points,
+                                   std::array<double, 4> const &color,
+                                   std::vector<std::array<double, 4>> const &colors,
+                                   std::vector<uint32_t> const &indices)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_triangle_to_3d_object(object_name, pose, points, color, colors, indices);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_triangle(pose, points, color, colors, indices);
     }
 
-    bool add_text_to_3d_object(std::string object_name,
-                               Eigen::Matrix4f pose,
+    bool add_text_to_3d_object(std::string const &object_name,
+                               Eigen::Matrix4f const &pose,
                                bool billboard,
                                double font_size,
                                bool scale_invariant,
-                               std::array<double, 4> color,
-                               std::string text)
+                               std::array<double, 4> const &color,
+                               std::string const &text)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= kv.second->add_text_to_3d_object(object_name, pose, billboard, font_size, scale_invariant, color, text);
-        }
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        return all_3d_objects[object_name].add_text(pose, billboard, font_size, scale_invariant, color, text);
     }
 
-    bool write_3d_object_to_all(std::string object_name, uint64_t timestamp)
+    bool create_scene_update(std::string const &object_name, uint64_t timestamp, nlohmann::json &scene_update_json)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-            out &= write_3d_object_to(kv.first, object_name, timestamp);
-        return out;
+        std::lock_guard<std::mutex> lg(all_3d_objects_mtx);
+        if (all_3d_objects.count(object_name) == 0)
+            return false;
+        Internal3DObject &object = all_3d_objects[object_name];
+        // Set timestamp of current object:
+        object.set_timestamp(timestamp);
+        scene_update_json["deletions"] = std::vector<nlohmann::json>();
+        scene_update_json["entities"] = std::vector<nlohmann::json>();
+        // Delete entity if it was present before
+        nlohmann::json deletion_json;
+        deletion_json["timestamp"] = nlohmann::json();
+        deletion_json["timestamp"]["sec"] = (uint64_t)timestamp / (uint64_t)1e9;
+        deletion_json["timestamp"]["nsec"] = (uint64_t)timestamp % (uint64_t)1e9;
+        deletion_json["type"] = 0;
+        deletion_json["id"] = object.get_id();
+        scene_update_json["deletions"].push_back(deletion_json);
+        // Re-add entity in scene
+        scene_update_json["entities"].push_back(object.get_description());
+        return true;
     }
 
-    bool write_3d_object_to_all(std::vector<std::string> connection_identifier, std::string object_name, uint64_t timestamp)
+    bool write_3d_object_to_all(std::string const &object_name, uint64_t timestamp)
     {
-        bool out = true;
-        for (auto id : connection_identifier)
-            out &= write_3d_object_to(id, object_name, timestamp);
-        return out;
+        // Scene update is described once for all connections
+        nlohmann::json scene_update_json;
+        if (!create_scene_update(object_name, timestamp, scene_update_json))
+            return false;
+        encoding_stage.push_sample(get_all_writers(), object_name, scene_update_json, get_scene_update_schema(), "foxglove.SceneUpdate", timestamp);
+        return true;
     }
 
-    bool write_3d_object_to(std::string connection_identifier, std::string object_name, uint64_t timestamp)
+    bool write_3d_object_to(std::vector<std::string> const &connection_identifier, std::string const &object_name, uint64_t timestamp)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
+        nlohmann::json scene_update_json;
+        if (!create_scene_update(object_name, timestamp, scene_update_json))
             return false;
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_sample(writers, object_name, scene_update_json, get_scene_update_schema(), "foxglove.SceneUpdate", timestamp);
+        return out;
+    }
 
-        // Create schema if not present:
-        if (!all_writers[connection_identifier]->is_schema_present(object_name))
-        {
-            nlohmann::json schema_unserialized = nlohmann::json::parse(get_scene_update_schema());
-            all_writers[connection_identifier]->create_schema(object_name, schema_unserialized);
-        }
-        all_writers[connection_identifier]->write_3d_object_to_all(object_name, timestamp);
-
-        return true;
+    bool write_3d_object_to(std::string const &connection_identifier, std::string const &object_name, uint64_t timestamp)
+    {
+        return write_3d_object_to(std::vector<std::string>{connection_identifier}, object_name, timestamp);
     }
 
     bool write_log_to_all(std::string const &log_channel_name, uint64_t timestamp, LOG_LEVEL log_level, std::string const &message, std::string const &name, std::string const &file, uint32_t line)
     {
-        bool out = true;
-        for (auto &kv : all_writers)
-        {
-            out &= write_log_to(kv.first, log_channel_name, timestamp, log_level, message, name, file, line);
-        }
-        return out;
+        encoding_stage.push_log(get_all_writers(), log_channel_name, timestamp, (int)log_level, message, name, file, line);
+        return true;
     }
 
-    bool write_log_to_all(std::vector<std::string> const &connection_identifier, std::string const &log_channel_name, uint64_t timestamp, LOG_LEVEL log_level, std::string const &message, std::string const &name, std::string const &file, uint32_t line)
+    bool write_log_to(std::vector<std::string> const &connection_identifier, std::string const &log_channel_name, uint64_t timestamp, LOG_LEVEL log_level, std::string const &message, std::string const &name, std::string const &file, uint32_t line)
     {
-        bool out = true;
-        for (auto id : connection_identifier)
-        {
-            out &= write_log_to(id, log_channel_name, timestamp, log_level, message, name, file, line);
-        }
+        std::vector<std::shared_ptr<IWriter>> writers;
+        bool out = get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_log(writers, log_channel_name, timestamp, (int)log_level, message, name, file, line);
         return out;
     }
 
     bool write_log_to(std::string const &connection_identifier, std::string const &log_channel_name, uint64_t timestamp, LOG_LEVEL log_level, std::string const &message, std::string const &name, std::string const &file, uint32_t line)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
-            return false;
-        all_writers[connection_identifier]->write_log(log_channel_name, timestamp, (int)log_level, message, name, file, line);
-
-        return true;
+        return write_log_to(std::vector<std::string>{connection_identifier}, log_channel_name, timestamp, log_level, message, name, file, line);
     }
 
-    bool add_position_to_all(std::string position_channel_name, uint64_t timestamp, Eigen::Matrix4f pose, std::string frame_id)
+    bool add_position_to_all(std::string const &position_channel_name, uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id)
     {
         bool out = true;
-        for (auto &kv : all_writers)
+        // Registry is kept while positions are added, its connections are looked up again by their name
+        std::shared_ptr<const ConnectionRegistry> registry = get_connection_registry();
+        for (auto &kv : registry->writers_by_name)
         {
             out &= add_position_to(kv.first, position_channel_name, timestamp, pose, frame_id);
         }
         return out;
     }
 
-    bool add_position_to(std::vector<std::string> connection_identifier, std::string position_channel_name, uint64_t timestamp, Eigen::Matrix4f pose, std::string frame_id)
+    bool add_position_to(std::vector<std::string> const &connection_identifier, std::string const &position_channel_name, uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id)
     {
         bool out = true;
-        for (auto id : connection_identifier)
+        for (auto const &id : connection_identifier)
         {
             out &= add_position_to(id, position_channel_name, timestamp, pose, frame_id);
         }
         return out;
     }
 
-    bool add_position_to(std::string connection_identifier, std::string position_channel_name, uint64_t timestamp, Eigen::Matrix4f pose, std::string frame_id)
+    bool add_position_to(std::string const &connection_identifier, std::string const &position_channel_name, uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
+        std::shared_ptr<IWriter> writer = get_writer(connection_identifier);
+        if (!writer)
             return false;
 
-        // Create schema if not present:
-        if (!all_writers[connection_identifier]->is_schema_present(position_channel_name))
-        {
-            nlohmann::json schema_unserialized = nlohmann::json::parse(get_poses_in_frame_schema());
-            all_writers[connection_identifier]->create_schema(position_channel_name, schema_unserialized);
-        }
-
-        all_writers[connection_identifier]->add_position_to_all(position_channel_name, timestamp, pose, frame_id);
+        writer->add_position_to_all(position_channel_name, timestamp, pose, frame_id);
+        // Position is pushed directly to the connection:
+        if (writer->is_sync())
+            writer->wait_written(writer->get_last_write_ticket());
 
         return true;
     }
 
-    void add_image_annotation_to_all(std::string const& channel_name, std::vector<CircleAnnotation> const &circle_annotations, std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations, uint64_t timestamp)
+    SampleSerializer create_image_annotation(std::vector<CircleAnnotation> const &circle_annotations, std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations)
     {
-        for (auto &kv : all_writers)
+        return [circle_annotations, points_annotations, text_annotations](MessageEncoding encoding, std::string &out)
         {
-           add_image_annotation_to(kv.first, channel_name,  circle_annotations, points_annotations, text_annotations, timestamp);
-        }
+            serialize_image_annotations(encoding, out, circle_annotations, points_annotations, text_annotations);
+        };
+    }
+
+    void add_image_annotation_to_all(std::string const& channel_name, std::vector<CircleAnnotation> const &circle_annotations, std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations, uint64_t timestamp)
+    {
+        encoding_stage.push_serializable_sample(get_all_writers(), channel_name, create_image_annotation(circle_annotations, points_annotations, text_annotations), get_image_annotation_schema(), "foxglove.ImageAnnotations", timestamp);
     }
     void add_image_annotation_to(std::vector<std::string> const &connection_identifier, std::string const& channel_name, std::vector<CircleAnnotation> const &circle_annotations, std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations, uint64_t timestamp)
     {
-        for (auto id : connection_identifier)
-        {
-           add_image_annotation_to(id, channel_name,  circle_annotations, points_annotations, text_annotations, timestamp);
-        }
+        std::vector<std::shared_ptr<IWriter>> writers;
+        get_writers(connection_identifier, writers);
+        if (writers.size())
+            encoding_stage.push_serializable_sample(writers, channel_name, create_image_annotation(circle_annotations, points_annotations, text_annotations), get_image_annotation_schema(), "foxglove.ImageAnnotations", timestamp);
     }
     void add_image_annotation_to(std::string const &connection_identifier, std::string const& channel_name, std::vector<CircleAnnotation> const &circle_annotations, std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations, uint64_t timestamp)
     {
-        unsigned number_of_connection_presents = get_number_of_connection_presents_for_identifier(connection_identifier);
-        if (number_of_connection_presents == 0)
-            return ;
+        add_image_annotation_to(std::vector<std::string>{connection_identifier}, channel_name, circle_annotations, points_annotations, text_annotations, timestamp);
+    }
 
-        // Create schema if not present:
-        if (!all_writers[connection_identifier]->is_schema_present(channel_name))
+    /**
+     * @brief End a write using the channel of `slot`, waking up the release of the slot if it was its last write
+     */
+    void end_opened_channel_use(OpenedChannelSlot &slot)
+    {
+        // Both are sequentially consistent: either this sees the release, or the release sees no more writes
+        if (slot.users.fetch_sub(1) == 1 && slot.is_being_released.load())
         {
-            nlohmann::json schema_unserialized = nlohmann::json::parse(get_image_annotation_schema());
-            all_writers[connection_identifier]->create_schema(channel_name, schema_unserialized);
+            {
+                // Release is either waiting for being notified or will see no more writes before waiting
+                std::lock_guard<std::mutex> lg(opened_channel_users_mtx);
+            }
+            opened_channel_users_notifier.notify_all();
         }
+    }
 
-        nlohmann::json image_annotation;
-        image_annotation["circles"] = std::vector<nlohmann::json>();
-        for(auto circle : circle_annotations)
-        {
-            nlohmann::json circle_json;
-            circle_json["timestamp"] = nlohmann::json();
-            circle_json["timestamp"]["sec"] = (uint64_t)circle.timestamp / (uint64_t)1e9;
-            circle_json["timestamp"]["nsec"] = (uint64_t)circle.timestamp % (uint64_t)1e9;
-            circle_json["position"] = nlohmann::json();
-            circle_json["position"]["x"] = circle.position[0];
-            circle_json["position"]["y"] = circle.position[1];
-            circle_json["diameter"] = circle.diameter;
-            circle_json["thickness"] = circle.thickness;
-            circle_json["fill_color"]["r"] = circle.fill_color[0];
-            circle_json["fill_color"]["g"] = circle.fill_color[1];
-            circle_json["fill_color"]["b"] = circle.fill_color[2];
-            circle_json["fill_color"]["a"] = circle.fill_color[3];
-            circle_json["outline_color"] = nlohmann::json();
-            circle_json["outline_color"]["r"] = circle.outline_color[0];
-            circle_json["outline_color"]["g"] = circle.outline_color[1];
-            circle_json["outline_color"]["b"] = circle.outline_color[2];
-            circle_json["outline_color"]["a"] = circle.outline_color[3];
-            image_annotation["circles"].push_back(circle_json);
-        }
-        image_annotation["points"] = std::vector<nlohmann::json>();
-        for(auto point: points_annotations)
-        {
-            nlohmann::json point_json;
-            point_json["timestamp"] = nlohmann::json();
-            point_json["timestamp"]["sec"] = (uint64_t)point.timestamp / (uint64_t)1e9;
-            point_json["timestamp"]["nsec"] = (uint64_t)point.timestamp % (uint64_t)1e9;
-            point_json["type"] = (int)point.type;
-            for(auto point_position: point.points)
+    /**
+     * @brief Channel of a handle, kept opened while the object lives. No lock is taken: the slot of the channel counts its users
+     * and is not released before they are done.
+     */
+    class OpenedChannelUse
+    {
+    public:
+        OpenedChannelUse() = default;
+        OpenedChannelUse(ChannelHandle channel, ChannelType type)
+        {
+            if (channel == INVALID_CHANNEL_HANDLE)
             {
-                nlohmann::json position_json;
-                position_json["x"] = point_position[0];
-                position_json["y"] = point_position[1];
-                point_json["points"].push_back(position_json);
+                std::cerr << "[MCAPWrapper] ERROR: invalid channel handle " << channel << std::endl;
+                return;
             }
-            point_json["outline_color"] = nlohmann::json();
-            point_json["outline_color"]["r"] = point.outline_color[0];
-            point_json["outline_color"]["g"] = point.outline_color[1];
-            point_json["outline_color"]["b"] = point.outline_color[2];
-            point_json["outline_color"]["a"] = point.outline_color[3];
-            point_json["outline_colors"] = std::vector<nlohmann::json>();
-            for(auto outline_color: point.outline_colors)
+            OpenedChannelSlot &slot = opened_channel_slots[channel % MAX_NUMBER_OF_OPENED_CHANNELS];
+            slot.users.fetch_add(1);
+            if (slot.generation.load() != channel / MAX_NUMBER_OF_OPENED_CHANNELS)
             {
-                nlohmann::json outline_color_json;
-                outline_color_json["r"] = outline_color[0];
-                outline_color_json["g"] = outline_color[1];
-                outline_color_json["b"] = outline_color[2];
-                outline_color_json["a"] = outline_color[3];
-                point_json["outline_colors"].push_back(outline_color_json);
+                end_opened_channel_use(slot);
+                std::cerr << "[MCAPWrapper] ERROR: channel handle " << channel << " is closed" << std::endl;
+                return;
             }
-            point_json["fill_color"]["r"] = point.fill_color[0];
-            point_json["fill_color"]["g"] = point.fill_color[1];
-            point_json["fill_color"]["b"] = point.fill_color[2];
-            point_json["fill_color"]["a"] = point.fill_color[3];
-            point_json["thickness"] = point.thickness;
-            image_annotation["points"].push_back(point_json);
+            _slot = &slot;
+            if (slot.channel->type != type)
+            {
+                std::cerr << "[MCAPWrapper] ERROR: channel " << slot.channel->channel_name << " was not opened for this type of message" << std::endl;
+                return;
+            }
+            _channel = slot.channel.get();
+        }
+        OpenedChannelUse(OpenedChannelUse &&other) : _slot(other._slot), _channel(other._channel)
+        {
+            other._slot = nullptr;
+            other._channel = nullptr;
         }
-        image_annotation["texts"] = std::vector<nlohmann::json>();
-        for(auto text: text_annotations)
-        {
-            nlohmann::json text_json;
-            text_json["timestamp"] = nlohmann::json();
-            text_json["timestamp"]["sec"] = (uint64_t)text.timestamp / (uint64_t)1e9;
-            text_json["timestamp"]["nsec"] = (uint64_t)text.timestamp % (uint64_t)1e9;
-            text_json["position"] = nlohmann::json();
-            text_json["position"]["x"] = text.position[0];
-            text_json["position"]["y"] = text.position[1];
-            text_json["text"] = text.text;
-            text_json["font_size"] = text.font_size;
-            text_json["text_color"] = nlohmann::json();
-            text_json["text_color"]["r"] = text.text_color[0];
-            text_json["text_color"]["g"] = text.text_color[1];
-            text_json["text_color"]["b"] = text.text_color[2];
-            text_json["text_color"]["a"] = text.text_color[3];
-            text_json["background_color"] = nlohmann::json();
-            text_json["background_color"]["r"] = text.background_color[0];
-            text_json["background_color"]["g"] = text.background_color[1];
-            text_json["background_color"]["b"] = text.background_color[2];
-            text_json["background_color"]["a"] = text.background_color[3];
-            image_annotation["texts"].push_back(text_json);
+        OpenedChannelUse(OpenedChannelUse const &) = delete;
+        OpenedChannelUse &operator=(OpenedChannelUse const &) = delete;
+        ~OpenedChannelUse()
+        {
+            if (_slot)
+                end_opened_channel_use(*_slot);
         }
-        write_JSON_to(connection_identifier, channel_name, image_annotation.dump(), timestamp);
+        /**
+         * @brief Get the channel, null if the handle is invalid, closed or not opened for this type of message
+         */
+        OpenedChannel *get() const
+        {
+            return _channel;
+        }
+
+    private:
+        OpenedChannelSlot *_slot = nullptr;
+        OpenedChannel *_channel = nullptr;
+    };
+
+    /**
+     * @brief See `open_channel`, for a connection already looked up
+     */
+    ChannelHandle open_writer_channel(std::shared_ptr<IWriter> connection, std::string const &channel_name, ChannelType type)
+    {
+        std::unique_ptr<OpenedChannel> opened_channel(new OpenedChannel);
+        opened_channel->writer = std::move(connection);
+        opened_channel->targets.push_back(opened_channel->writer);
+        opened_channel->channel_name = channel_name;
+        opened_channel->type = type;
+        IWriter &writer = *opened_channel->writer;
+        // Schemas of foxglove types are known, channel is created now. Schema of raw JSON is inferred from its first message.
+        if (type == ChannelType::RAW_JSON)
+        {
+            opened_channel->encoding = writer.get_raw_channel_message_encoding(channel_name);
+            opened_channel->is_resolved = writer.resolve_channel(channel_name, opened_channel->route);
+        }
+        else if (type == ChannelType::LOG || type == ChannelType::TRANSFORM)
+        {
+            opened_channel->encoding = writer.get_channel_message_encoding(channel_name);
+            if (opened_channel->encoding == MessageEncoding::PROTOBUF)
+                writer.ensure_protobuf_schema(channel_name, type == ChannelType::LOG ? "foxglove.Log" : "foxglove.FrameTransform");
+            else
+                writer.ensure_schema(channel_name, type == ChannelType::LOG ? get_log_schema() : get_frame_transform_schema());
+            opened_channel->is_resolved = writer.resolve_channel(channel_name, opened_channel->route);
+            if (!opened_channel->is_resolved)
+            {
+                std::cerr << "[MCAPWrapper] ERROR: could not create channel " << channel_name << std::endl;
+                return INVALID_CHANNEL_HANDLE;
+            }
+        }
+        else // Images are dispatched by the encoding pool, with the codec of their channel
+            opened_channel->encoding = writer.get_channel_message_encoding(channel_name);
+
+        std::lock_guard<std::mutex> lg(opened_channels_mtx);
+        ChannelHandle slot;
+        if (!free_opened_channel_slots.empty())
+        {
+            slot = free_opened_channel_slots.back();
+            free_opened_channel_slots.pop_back();
+        }
+        else if (number_of_used_slots < MAX_NUMBER_OF_OPENED_CHANNELS)
+            slot = number_of_used_slots++;
+        else
+        {
+            std::cerr << "[MCAPWrapper] ERROR: too many opened channels" << std::endl;
+            return INVALID_CHANNEL_HANDLE;
+        }
+        OpenedChannelSlot &opened_channel_slot = opened_channel_slots[slot];
+        // Generations wrap around, skipping the one whose last handle is `INVALID_CHANNEL_HANDLE`
+        uint32_t generation = opened_channel_slot.generation.load();
+        if (generation >= INVALID_CHANNEL_HANDLE / MAX_NUMBER_OF_OPENED_CHANNELS)
+        {
+            generation = 0;
+            opened_channel_slot.generation.store(generation);
+        }
+        opened_channel_slot.channel = std::move(opened_channel);
+        return generation * MAX_NUMBER_OF_OPENED_CHANNELS + slot;
+    }
+
+    ChannelHandle open_channel(std::string const &connection_identifier, std::string const &channel_name, ChannelType type)
+    {
+        std::shared_ptr<IWriter> connection = get_writer(connection_identifier);
+        if (!connection)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: connection " << connection_identifier << " does not exist" << std::endl;
+            return INVALID_CHANNEL_HANDLE;
+        }
+        return open_writer_channel(std::move(connection), channel_name, type);
+    }
+
+    bool close_channel(ChannelHandle channel)
+    {
+        if (!release_opened_channels([&](ChannelHandle handle, OpenedChannel const &)
+                                     { return handle == channel; }))
+        {
+            std::cerr << "[MCAPWrapper] ERROR: channel handle " << channel << " is invalid or already closed" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool write_JSON(ChannelHandle channel, std::string const &serialized_json, uint64_t timestamp)
+    {
+        return write_JSON(channel, serialized_json.data(), serialized_json.size(), timestamp);
+    }
+
+    bool write_JSON(ChannelHandle channel, std::string &&serialized_json, uint64_t timestamp)
+    {
+        OpenedChannelUse channel_use(channel, ChannelType::RAW_JSON);
+        OpenedChannel *opened_channel = channel_use.get();
+        if (!opened_channel)
+            return false;
+        encoding_stage.push_channel_raw_message(*opened_channel, std::move(serialized_json), timestamp);
+        return true;
+    }
+
+    bool write_JSON(ChannelHandle channel, char const *serialized_json, size_t size, uint64_t timestamp)
+    {
+        OpenedChannelUse channel_use(channel, ChannelType::RAW_JSON);
+        OpenedChannel *opened_channel = channel_use.get();
+        if (!opened_channel)
+            return false;
+        encoding_stage.push_channel_raw_message(*opened_channel, serialized_json, size, timestamp);
+        return true;
+    }
+
+    bool write_image(ChannelHandle channel, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
+    {
+        OpenedChannelUse channel_use(channel, ChannelType::IMAGE);
+        OpenedChannel *opened_channel = channel_use.get();
+        if (!opened_channel)
+            return false;
+        encoding_stage.push_image(opened_channel->targets, opened_channel->channel_name, image, timestamp, frame_id);
+        return true;
+    }
+
+    bool write_log(ChannelHandle channel, uint64_t timestamp, LOG_LEVEL log_level, std::string_view message, std::string_view name, std::string_view file, uint32_t line)
+    {
+        OpenedChannelUse channel_use(channel, ChannelType::LOG);
+        OpenedChannel *opened_channel = channel_use.get();
+        if (!opened_channel)
+            return false;
+        encoding_stage.push_channel_log(*opened_channel, timestamp, (int)log_level, message, name, file, line);
+        return true;
+    }
+
+    bool add_frame_transform(ChannelHandle channel, uint64_t timestamp, std::string_view parent, std::string_view child, Eigen::Matrix4f const &pose)
+    {
+        OpenedChannelUse channel_use(channel, ChannelType::TRANSFORM);
+        OpenedChannel *opened_channel = channel_use.get();
+        if (!opened_channel)
+            return false;
+        encoding_stage.push_channel_frame_transform(*opened_channel, timestamp, parent, child, pose);
+        return true;
+    }
+
+    bool write_batch(std::string const &connection_identifier, BatchItem const *items, size_t number_of_items)
+    {
+        std::shared_ptr<IWriter> writer = get_writer(connection_identifier);
+        if (!writer)
+            return false;
+
+        // Channels are resolved before pushing anything, consecutive messages of a same channel are only resolved once.
+        // Channels are used until every message is pushed, so that closing the connection meanwhile waits for them.
+        std::vector<OpenedChannelUse> channel_uses;
+        std::vector<OpenedChannel *> channels(number_of_items);
+        {
+            std::lock_guard<std::mutex> lg(batch_channels_mtx);
+            // Connection closed since it was looked up: its channels are already released and would not be anymore
+            if (get_writer(connection_identifier) != writer)
+                return false;
+            for (size_t i = 0; i < number_of_items; i++)
+            {
+                BatchItem const &item = items[i];
+                if (i > 0 && item.type == items[i - 1].type && item.channel_name == items[i - 1].channel_name)
+                {
+                    channels[i] = channels[i - 1];
+                    continue;
+                }
+                auto batch_channel = batch_channels.find(std::make_tuple(writer.get(), item.channel_name, item.type));
+                ChannelHandle handle;
+                if (batch_channel != batch_channels.end())
+                    handle = batch_channel->second;
+                else
+                {
+                    handle = open_writer_channel(writer, std::string(item.channel_name), item.type);
+                    if (handle == INVALID_CHANNEL_HANDLE)
+                        return false;
+                    batch_channels.emplace(std::make_tuple(writer.get(), std::string(item.channel_name), item.type), handle);
+                }
+                channel_uses.emplace_back(handle, item.type);
+                channels[i] = channel_uses.back().get();
+            }
+        }
+
+        encoding_stage.push_channel_batch(channels.data(), items, number_of_items);
+        return true;
+    }
+
+    bool write_batch(std::string const &connection_identifier, std::vector<BatchItem> const &items)
+    {
+        return write_batch(connection_identifier, items.data(), items.size());
     }
-};
\ No newline at end of file
+};
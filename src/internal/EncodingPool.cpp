@@ -0,0 +1,218 @@
+#include "internal/EncodingPool.h"
+
+namespace mcap_wrapper
+{
+    EncodingPool::EncodingPool(unsigned thread_number)
+    {
+        _next_worker = 0;
+        _queued_jobs = 0;
+        _pending_jobs = 0;
+        start_workers(thread_number);
+    }
+
+    EncodingPool::~EncodingPool()
+    {
+        wait_until_idle();
+        stop_workers();
+    }
+
+    void EncodingPool::push_job(std::string const &channel_name, EncodeFunction encode, DispatchFunction dispatch)
+    {
+        Job job;
+        job.channel_name = channel_name;
+        job.encode = std::move(encode);
+        job.dispatch = std::move(dispatch);
+        {
+            std::lock_guard<std::mutex> lg(_channel_ordering_mtx);
+            std::shared_ptr<ChannelOrdering> &ordering = _channel_ordering[channel_name];
+            if (!ordering)
+                ordering = std::make_shared<ChannelOrdering>();
+            std::lock_guard<std::mutex> ordering_lg(ordering->mtx);
+            job.sequence = ordering->next_sequence_to_push++;
+        }
+        {
+            std::unique_lock<std::mutex> ul(_jobs_counter_mtx);
+            // Bound memory used by pending images
+            _idle_notifier.wait(ul, [this]()
+                                { return _pending_jobs < _max_pending_jobs; });
+            _pending_jobs++;
+            _queued_jobs++;
+            job.ticket = ++_last_job_ticket;
+            _pending_job_tickets.insert(job.ticket);
+            // Jobs are spread over workers, idle workers will steal them if needed
+            Worker &worker = *_workers[_next_worker++ % _workers.size()];
+            std::lock_guard<std::mutex> jobs_lg(worker.jobs_mtx);
+            worker.jobs.push_back(std::move(job));
+        }
+        _job_notifier.notify_one();
+    }
+
+    void EncodingPool::wait_until_idle()
+    {
+        std::unique_lock<std::mutex> ul(_jobs_counter_mtx);
+        _idle_notifier.wait(ul, [this]()
+                            { return _pending_jobs == 0; });
+    }
+
+    uint64_t EncodingPool::get_last_job_ticket()
+    {
+        std::lock_guard<std::mutex> lg(_jobs_counter_mtx);
+        return _last_job_ticket;
+    }
+
+    void EncodingPool::wait_for_jobs(uint64_t ticket)
+    {
+        std::unique_lock<std::mutex> ul(_jobs_counter_mtx);
+        _idle_notifier.wait(ul, [this, ticket]()
+                            { return _pending_job_tickets.empty() || *_pending_job_tickets.begin() > ticket; });
+    }
+
+    void EncodingPool::set_thread_number(unsigned thread_number)
+    {
+        wait_until_idle();
+        stop_workers();
+        start_workers(thread_number);
+    }
+
+    unsigned EncodingPool::get_thread_number()
+    {
+        return _workers.size();
+    }
+
+    //
+    // Protected methods
+    //
+    void EncodingPool::start_workers(unsigned thread_number)
+    {
+        if (thread_number == 0)
+            thread_number = std::max(1u, std::thread::hardware_concurrency());
+        {
+            std::lock_guard<std::mutex> lg(_jobs_counter_mtx);
+            _continue_working = true;
+        }
+        for (unsigned i = 0; i < thread_number; i++)
+            _workers.push_back(std::make_unique<Worker>());
+        _max_pending_jobs = 4 * thread_number;
+        for (unsigned i = 0; i < thread_number; i++)
+            _workers[i]->thread = new std::thread(&EncodingPool::run, this, i);
+    }
+
+    void EncodingPool::stop_workers()
+    {
+        {
+            std::lock_guard<std::mutex> lg(_jobs_counter_mtx);
+            _continue_working = false;
+        }
+        _job_notifier.notify_all();
+        for (auto &worker : _workers)
+        {
+            worker->thread->join();
+            delete worker->thread;
+        }
+        _workers.clear();
+    }
+
+    void EncodingPool::run(unsigned worker_index)
+    {
+        while (1)
+        {
+            {
+                std::unique_lock<std::mutex> ul(_jobs_counter_mtx);
+                _job_notifier.wait(ul, [this]()
+                                   { return _queued_jobs > 0 || !_continue_working; });
+                if (_queued_jobs == 0 && !_continue_working)
+                    break;
+            }
+            Job job;
+            if (!take_job(worker_index, job))
+                continue;
+            EncodedSample encoded_sample = job.encode();
+            finish_job(job, encoded_sample);
+        }
+    }
+
+    bool EncodingPool::take_job(unsigned worker_index, Job &job)
+    {
+        bool found = false;
+        // Own jobs first:
+        {
+            Worker &worker = *_workers[worker_index];
+            std::lock_guard<std::mutex> lg(worker.jobs_mtx);
+            if (worker.jobs.size())
+            {
+                job = std::move(worker.jobs.front());
+                worker.jobs.pop_front();
+                found = true;
+            }
+        }
+        // Otherwise steal the most recent job of another worker:
+        for (unsigned i = 1; !found && i < _workers.size(); i++)
+        {
+            Worker &victim = *_workers[(worker_index + i) % _workers.size()];
+            std::lock_guard<std::mutex> lg(victim.jobs_mtx);
+            if (victim.jobs.size())
+            {
+                job = std::move(victim.jobs.back());
+                victim.jobs.pop_back();
+                found = true;
+            }
+        }
+        if (found)
+        {
+            std::lock_guard<std::mutex> lg(_jobs_counter_mtx);
+            _queued_jobs--;
+        }
+        return found;
+    }
+
+    void EncodingPool::finish_job(Job &job, EncodedSample const &encoded_sample)
+    {
+        std::shared_ptr<ChannelOrdering> ordering;
+        {
+            std::lock_guard<std::mutex> lg(_channel_ordering_mtx);
+            ordering = _channel_ordering[job.channel_name];
+        }
+        std::vector<FinishedJob> jobs_to_dispatch;
+        {
+            std::lock_guard<std::mutex> lg(ordering->mtx);
+            ordering->finished[job.sequence] = FinishedJob{encoded_sample, std::move(job.dispatch), job.ticket};
+            // Another worker is dispatching the channel, it will dispatch this job too if it is next
+            if (ordering->is_dispatching)
+                return;
+            ordering->is_dispatching = true;
+        }
+        while (1)
+        {
+            {
+                // Take every job of the channel that is ready, in push order:
+                std::lock_guard<std::mutex> lg(ordering->mtx);
+                while (ordering->finished.size() && ordering->finished.begin()->first == ordering->next_sequence_to_dispatch)
+                {
+                    jobs_to_dispatch.push_back(std::move(ordering->finished.begin()->second));
+                    ordering->finished.erase(ordering->finished.begin());
+                    ordering->next_sequence_to_dispatch++;
+                }
+                if (jobs_to_dispatch.empty())
+                {
+                    ordering->is_dispatching = false;
+                    break;
+                }
+            }
+            // Dispatch outside of the lock: it can wait for a full connection queue, workers finishing other jobs of the channel
+            // hand them over instead of waiting
+            for (FinishedJob &finished_job : jobs_to_dispatch)
+            {
+                if (finished_job.encoded_sample.json_payload || finished_job.encoded_sample.protobuf_payload) // Failed encoding are skipped
+                    finished_job.dispatch(finished_job.encoded_sample);
+            }
+            {
+                std::lock_guard<std::mutex> lg(_jobs_counter_mtx);
+                _pending_jobs -= jobs_to_dispatch.size();
+                for (FinishedJob const &finished_job : jobs_to_dispatch)
+                    _pending_job_tickets.erase(finished_job.ticket);
+            }
+            _idle_notifier.notify_all();
+            jobs_to_dispatch.clear();
+        }
+    }
+};
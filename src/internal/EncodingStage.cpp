@@ -0,0 +1,1033 @@
+#include "internal/EncodingStage.h"
+#include "internal/FoxgloveSchema.hpp"
+#include "internal/FoxgloveProtobufSchema.hpp"
+#include "internal/ProtobufSerializer.h"
+#include "internal/Base64.hpp"
+#include "internal/RawImage.h"
+#include "internal/FoxgloveSerializer.h"
+
+#include <algorithm>
+
+namespace mcap_wrapper
+{
+    EncodingStage::EncodingStage()
+    {
+        _continue_encoding = true;
+        _encoding_thread = new std::thread(&EncodingStage::run, this);
+    }
+
+    EncodingStage::~EncodingStage()
+    {
+        {
+            std::lock_guard<std::mutex> lg(_continue_encoding_mtx);
+            _continue_encoding = false;
+        }
+        _encode_notifier.notify_all();
+        _space_notifier.notify_all();
+        _pass_notifier.notify_all();
+        _encoding_thread->join();
+        delete _encoding_thread;
+        // Wait the end of images encoding:
+        _image_encoding_pool.wait_until_idle();
+    }
+
+    void EncodingStage::flush()
+    {
+        uint64_t job_ticket;
+        {
+            std::unique_lock<std::mutex> continue_encoding_ul(_continue_encoding_mtx);
+            // Next pass of the encoding thread starts after this call: it takes every data pushed so far
+            uint64_t pass = _number_of_started_passes + 1;
+            _has_waiting_data = true;
+            _encode_notifier.notify_one();
+            _pass_notifier.wait(continue_encoding_ul, [this, pass]()
+                                { return _number_of_finished_passes >= pass || !_continue_encoding; });
+            job_ticket = _last_job_ticket_of_finished_pass;
+        }
+        // Only images handed to the pool until that pass are waited for, not the ones pushed since by other producers
+        _image_encoding_pool.wait_for_jobs(job_ticket);
+    }
+
+    void EncodingStage::wait_sync_targets(std::vector<std::shared_ptr<IWriter>> const &targets)
+    {
+        bool has_sync_target = false;
+        for (auto const &target : targets)
+            has_sync_target |= target->is_sync();
+        if (!has_sync_target)
+            return;
+        // Data must reach their connections before waiting for their writing:
+        flush();
+        for (auto const &target : targets)
+        {
+            if (target->is_sync())
+                target->wait_written(target->get_last_write_ticket());
+        }
+    }
+
+    void EncodingStage::set_image_encoding_thread_number(unsigned thread_number)
+    {
+        // Avoid pushing images while pool is being resized:
+        std::lock_guard<std::mutex> encoding_is_process(_encoding_is_being_process);
+        _image_encoding_pool.set_thread_number(thread_number);
+    }
+
+    void EncodingStage::set_raw_message_validation(bool validate)
+    {
+        _validate_raw_messages = validate;
+    }
+
+    void EncodingStage::set_image_channel_options(std::string const &channel_name, ImageChannelOptions const &options)
+    {
+        std::lock_guard<std::mutex> lg(_image_channel_options_mtx);
+        _image_channel_options[channel_name] = options;
+    }
+
+    //
+    // Pushing functions
+    //
+    void EncodingStage::push_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
+    {
+        queue_image(targets, identifier, image, timestamp, get_steady_time_ns(), frame_id);
+        wait_sync_targets(targets);
+    }
+
+    void EncodingStage::push_raw_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, std::string const &frame_id)
+    {
+        ImageWaitingToBeEncoded image_to_write;
+        image_to_write.targets = targets;
+        image_to_write.identifier = identifier;
+        image_to_write.image = image;
+        image_to_write.timestamp = timestamp;
+        image_to_write.enqueue_time = get_steady_time_ns();
+        image_to_write.frame_id = frame_id;
+        image_to_write.is_raw = true;
+        {
+            std::lock_guard<std::mutex> lg(_image_waiting_to_be_encoded_mtx);
+            _image_waiting_to_be_encoded.push_back(std::move(image_to_write));
+        }
+        notify_new_data();
+        wait_sync_targets(targets);
+    }
+
+    void EncodingStage::push_compressed_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, uint8_t const *data, size_t size, std::string const &format, uint64_t timestamp, std::string const &frame_id)
+    {
+        ImageWaitingToBeEncoded image_to_write;
+        image_to_write.targets = targets;
+        image_to_write.identifier = identifier;
+        image_to_write.timestamp = timestamp;
+        image_to_write.enqueue_time = get_steady_time_ns();
+        image_to_write.frame_id = frame_id;
+        image_to_write.is_raw = false;
+        // Caller buffer is not kept: messages are built right now
+        bool json_needed, protobuf_needed;
+        get_needed_encodings(targets, identifier, json_needed, protobuf_needed);
+        image_to_write.encoded_sample = make_compressed_image_sample(timestamp, frame_id, data, size, format, json_needed, protobuf_needed);
+        {
+            std::lock_guard<std::mutex> lg(_image_waiting_to_be_encoded_mtx);
+            _image_waiting_to_be_encoded.push_back(std::move(image_to_write));
+        }
+        notify_new_data();
+        wait_sync_targets(targets);
+    }
+
+    void EncodingStage::push_camera_calibration(std::vector<std::shared_ptr<IWriter>> const &targets,
+                                                std::string const &camera_identifier,
+                                                uint64_t timestamp,
+                                                std::string const &frame_id,
+                                                unsigned image_width,
+                                                unsigned image_height,
+                                                std::string const &distortion_model,
+                                                std::array<double, 5> const &D,
+                                                std::array<double, 9> const &K,
+                                                std::array<double, 9> const &R,
+                                                std::array<double, 12> const &P)
+    {
+        CameraCalibration calibration_to_encode;
+        calibration_to_encode.targets = targets;
+        calibration_to_encode.camera_identifier = camera_identifier;
+        calibration_to_encode.timestamp = timestamp;
+        calibration_to_encode.enqueue_time = get_steady_time_ns();
+        calibration_to_encode.frame_id = frame_id;
+        calibration_to_encode.image_width = image_width;
+        calibration_to_encode.image_height = image_height;
+        calibration_to_encode.distortion_model = distortion_model;
+        calibration_to_encode.D = D;
+        calibration_to_encode.K = K;
+        calibration_to_encode.R = R;
+        calibration_to_encode.P = P;
+        {
+            std::lock_guard<std::mutex> lg(_camera_calibration_waiting_to_be_encoded_mtx);
+            _camera_calibration_waiting_to_be_encoded.push_back(std::move(calibration_to_encode));
+        }
+        notify_new_data();
+        wait_sync_targets(targets);
+    }
+
+    void EncodingStage::push_raw_message(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, std::string const &serialized_message, uint64_t timestamp)
+    {
+        RawMessage raw_message_to_be_encode;
+        raw_message_to_be_encode.targets = targets;
+        raw_message_to_be_encode.identifier = identifier;
+        raw_message_to_be_encode.serialized_message = serialized_message;
+        raw_message_to_be_encode.timestamp = timestamp;
+        raw_message_to_be_encode.enqueue_time = get_steady_time_ns();
+        bool staging_is_full;
+        {
+            ProducerStaging &staging = get_producer_staging();
+            std::lock_guard<std::mutex> lg(staging.mtx);
+            staging.waiting.raw_messages.push_back(std::move(raw_message_to_be_encode));
+            staging_is_full = is_staging_full(staging);
+        }
+        notify_staged_data(staging_is_full);
+        wait_sync_targets(targets);
+    }
+
+    void EncodingStage::push_log(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &log_channel_name, uint64_t timestamp, int log_level, std::string const &message, std::string const &name, std::string const &file, uint32_t line)
+    {
+        Log log;
+        log.targets = targets;
+        log.identifier = log_channel_name;
+        log.timestamp = timestamp;
+        log.enqueue_time = get_steady_time_ns();
+        log.log_level = log_level;
+        log.message = message;
+        log.name = name;
+        log.file = file;
+        log.line = line;
+        bool staging_is_full;
+        {
+            ProducerStaging &staging = get_producer_staging();
+            std::lock_guard<std::mutex> lg(staging.mtx);
+            staging.waiting.logs.push_back(std::move(log));
+            staging_is_full = is_staging_full(staging);
+        }
+        notify_staged_data(staging_is_full);
+        wait_sync_targets(targets);
+    }
+
+    void EncodingStage::push_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, nlohmann::json const &sample, std::string const &serialized_schema, std::string const &protobuf_message_name, uint64_t timestamp)
+    {
+        Sample sample_to_encode;
+        sample_to_encode.targets = targets;
+        sample_to_encode.channel_name = channel_name;
+        sample_to_encode.sample = sample;
+        sample_to_encode.serialized_schema = &serialized_schema;
+        sample_to_encode.protobuf_message_name = protobuf_message_name;
+        sample_to_encode.timestamp = timestamp;
+        sample_to_encode.enqueue_time = get_steady_time_ns();
+        {
+            std::lock_guard<std::mutex> lg(_sample_waiting_to_be_encoded_mtx);
+            _sample_waiting_to_be_encoded.push_back(std::move(sample_to_encode));
+        }
+        notify_new_data();
+        wait_sync_targets(targets);
+    }
+
+    void EncodingStage::push_serializable_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, SampleSerializer &&serializer, std::string const &serialized_schema, std::string const &protobuf_message_name, uint64_t timestamp)
+    {
+        Sample sample_to_serialize;
+        sample_to_serialize.targets = targets;
+        sample_to_serialize.channel_name = channel_name;
+        sample_to_serialize.serializer = std::move(serializer);
+        sample_to_serialize.serialized_schema = &serialized_schema;
+        sample_to_serialize.protobuf_message_name = protobuf_message_name;
+        sample_to_serialize.timestamp = timestamp;
+        sample_to_serialize.enqueue_time = get_steady_time_ns();
+        {
+            std::lock_guard<std::mutex> lg(_sample_waiting_to_be_encoded_mtx);
+            _sample_waiting_to_be_encoded.push_back(std::move(sample_to_serialize));
+        }
+        notify_new_data();
+        wait_sync_targets(targets);
+    }
+
+    //
+    // Protected methods
+    //
+    void EncodingStage::push_channel_log(OpenedChannel &channel, uint64_t timestamp, int log_level, std::string_view message, std::string_view name, std::string_view file, uint32_t line)
+    {
+        bool staging_is_full;
+        {
+            ProducerStaging &staging = get_producer_staging();
+            std::lock_guard<std::mutex> lg(staging.mtx);
+            ChannelMessage &channel_message = get_next_channel_message(staging.waiting.channel_messages, channel, timestamp, get_steady_time_ns());
+            channel_message.text.assign(message);
+            channel_message.name.assign(name);
+            channel_message.file.assign(file);
+            channel_message.log_level = log_level;
+            channel_message.line = line;
+            staging_is_full = is_staging_full(staging);
+        }
+        notify_staged_data(staging_is_full);
+        wait_sync_targets(channel.targets);
+    }
+
+    void EncodingStage::push_channel_frame_transform(OpenedChannel &channel, uint64_t timestamp, std::string_view parent, std::string_view child, Eigen::Matrix4f const &pose)
+    {
+        bool staging_is_full;
+        {
+            ProducerStaging &staging = get_producer_staging();
+            std::lock_guard<std::mutex> lg(staging.mtx);
+            ChannelMessage &channel_message = get_next_channel_message(staging.waiting.channel_messages, channel, timestamp, get_steady_time_ns());
+            channel_message.text.assign(parent);
+            channel_message.name.assign(child);
+            channel_message.pose = pose;
+            staging_is_full = is_staging_full(staging);
+        }
+        notify_staged_data(staging_is_full);
+        wait_sync_targets(channel.targets);
+    }
+
+    void EncodingStage::push_channel_raw_message(OpenedChannel &channel, char const *serialized_message, size_t size, uint64_t timestamp)
+    {
+        bool staging_is_full;
+        {
+            ProducerStaging &staging = get_producer_staging();
+            std::lock_guard<std::mutex> lg(staging.mtx);
+            get_next_channel_message(staging.waiting.channel_messages, channel, timestamp, get_steady_time_ns()).text.assign(serialized_message, size);
+            staging_is_full = is_staging_full(staging);
+        }
+        notify_staged_data(staging_is_full);
+        wait_sync_targets(channel.targets);
+    }
+
+    void EncodingStage::push_channel_raw_message(OpenedChannel &channel, std::string &&serialized_message, uint64_t timestamp)
+    {
+        bool staging_is_full;
+        {
+            ProducerStaging &staging = get_producer_staging();
+            std::lock_guard<std::mutex> lg(staging.mtx);
+            // Message is taken as is, caller gets back a buffer it could reuse:
+            std::swap(get_next_channel_message(staging.waiting.channel_messages, channel, timestamp, get_steady_time_ns()).text, serialized_message);
+            staging_is_full = is_staging_full(staging);
+        }
+        serialized_message.clear();
+        notify_staged_data(staging_is_full);
+        wait_sync_targets(channel.targets);
+    }
+
+    void EncodingStage::push_channel_batch(OpenedChannel *const *channels, BatchItem const *items, size_t number_of_items)
+    {
+        // Messages of the batch entered the wrapper at the same time
+        uint64_t enqueue_time = get_steady_time_ns();
+        ProducerStaging &staging = get_producer_staging();
+        size_t i = 0;
+        while (i < number_of_items)
+        {
+            // Images are queued in batch order, out of the staging lock: queuing may wait for the encoding thread, which takes the staging
+            if (items[i].type == ChannelType::IMAGE)
+            {
+                queue_image(channels[i]->targets, channels[i]->channel_name, items[i].image, items[i].timestamp, enqueue_time, std::string(items[i].name));
+                i++;
+                continue;
+            }
+            bool staging_is_full;
+            {
+                std::lock_guard<std::mutex> lg(staging.mtx);
+                for (; i < number_of_items && !is_staging_full(staging) && items[i].type != ChannelType::IMAGE; i++)
+                {
+                    BatchItem const &item = items[i];
+                    ChannelMessage &channel_message = get_next_channel_message(staging.waiting.channel_messages, *channels[i], item.timestamp, enqueue_time);
+                    channel_message.text.assign(item.text);
+                    if (item.type == ChannelType::LOG)
+                    {
+                        channel_message.name.assign(item.name);
+                        channel_message.file.assign(item.file);
+                        channel_message.log_level = (int)item.log_level;
+                        channel_message.line = item.line;
+                    }
+                    else if (item.type == ChannelType::TRANSFORM)
+                    {
+                        channel_message.name.assign(item.name);
+                        channel_message.pose = item.pose;
+                    }
+                }
+                staging_is_full = is_staging_full(staging);
+            }
+            // Waits that the encoding thread takes the staged messages if they are too many
+            notify_staged_data(staging_is_full);
+        }
+        if (number_of_items)
+            wait_sync_targets(channels[0]->targets);
+    }
+
+    void EncodingStage::queue_image(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &identifier, cv::Mat const &image, uint64_t timestamp, uint64_t enqueue_time, std::string const &frame_id)
+    {
+        ImageWaitingToBeEncoded image_to_encode;
+        image_to_encode.targets = targets;
+        image_to_encode.identifier = identifier;
+        image_to_encode.image = image;
+        image_to_encode.timestamp = timestamp;
+        image_to_encode.enqueue_time = enqueue_time;
+        image_to_encode.frame_id = frame_id;
+        image_to_encode.is_raw = false;
+        {
+            std::lock_guard<std::mutex> lg(_image_waiting_to_be_encoded_mtx);
+            _image_waiting_to_be_encoded.push_back(std::move(image_to_encode));
+        }
+        notify_new_data();
+    }
+
+    EncodingStage::ChannelMessage &EncodingStage::get_next_channel_message(ChannelMessageBatch &batch, OpenedChannel &channel, uint64_t timestamp, uint64_t enqueue_time)
+    {
+        // Messages of previous batches are reused, their strings keep their capacity
+        if (batch.size == batch.messages.size())
+            batch.messages.emplace_back();
+        ChannelMessage &channel_message = batch.messages[batch.size++];
+        channel_message.channel = &channel;
+        channel_message.timestamp = timestamp;
+        channel_message.enqueue_time = enqueue_time;
+        return channel_message;
+    }
+
+    EncodingStage::ProducerStaging &EncodingStage::get_producer_staging()
+    {
+        // Staging of the calling thread is found once, it is released for another thread when the thread ends
+        struct ProducerStagingLease
+        {
+            EncodingStage const *stage = nullptr;
+            ProducerStaging *staging = nullptr;
+            ~ProducerStagingLease()
+            {
+                if (staging)
+                    staging->in_use = false;
+            }
+        };
+        thread_local ProducerStagingLease lease;
+        if (lease.stage == this)
+            return *lease.staging;
+
+        if (lease.staging)
+            lease.staging->in_use = false;
+        std::lock_guard<std::mutex> lg(_producer_stagings_mtx);
+        lease.stage = this;
+        lease.staging = nullptr;
+        for (auto &staging : _producer_stagings)
+        {
+            bool in_use = false;
+            if (staging->in_use.compare_exchange_strong(in_use, true))
+            {
+                lease.staging = staging.get();
+                break;
+            }
+        }
+        if (!lease.staging)
+        {
+            _producer_stagings.emplace_back(new ProducerStaging);
+            lease.staging = _producer_stagings.back().get();
+        }
+        return *lease.staging;
+    }
+
+    bool EncodingStage::is_staging_full(ProducerStaging const &staging)
+    {
+        StagedMessages const &waiting = staging.waiting;
+        return waiting.raw_messages.size() + waiting.logs.size() + waiting.channel_messages.size >= MAX_NUMBER_OF_STAGED_MESSAGES;
+    }
+
+    void EncodingStage::notify_new_data()
+    {
+        {
+            std::unique_lock<std::mutex> ul(_continue_encoding_mtx);
+            // Backpressure: wait that encoding thread take waiting data
+            if (++_number_of_waiting_data >= MAX_NUMBER_OF_WAITING_DATA && _continue_encoding)
+            {
+                _has_waiting_data = true;
+                _encode_notifier.notify_one();
+                _space_notifier.wait(ul, [this]()
+                                     { return _number_of_waiting_data < MAX_NUMBER_OF_WAITING_DATA || !_continue_encoding; });
+                return;
+            }
+            // Encoding thread was already woken up, it will see the new data
+            if (_has_waiting_data)
+                return;
+            _has_waiting_data = true;
+        }
+        _encode_notifier.notify_one();
+    }
+
+    void EncodingStage::notify_staged_data(bool staging_is_full)
+    {
+        if (staging_is_full)
+        {
+            // Staging is full: wait that encoding thread take it instead of growing it
+            std::unique_lock<std::mutex> ul(_continue_encoding_mtx);
+            if (!_continue_encoding)
+                return;
+            uint64_t number_of_staging_takes = _number_of_staging_takes;
+            _has_waiting_data = true;
+            _encode_notifier.notify_one();
+            _space_notifier.wait(ul, [this, number_of_staging_takes]()
+                                 { return _number_of_staging_takes != number_of_staging_takes || !_continue_encoding; });
+            return;
+        }
+        // Encoding thread was already woken up, it will see the new data: it takes stagings after resetting `_has_waiting_data`
+        if (_has_waiting_data.load(std::memory_order_relaxed) || _has_waiting_data.exchange(true))
+            return;
+        {
+            // Encoding thread is either waiting for being notified or will see `_has_waiting_data` before waiting
+            std::lock_guard<std::mutex> lg(_continue_encoding_mtx);
+        }
+        _encode_notifier.notify_one();
+    }
+
+    void EncodingStage::run()
+    {
+        uint64_t pass;
+        while (1)
+        {
+            {
+                // Sleep until data are pushed or the stage is destroyed
+                std::unique_lock<std::mutex> continue_encoding_ul(_continue_encoding_mtx);
+                _encode_notifier.wait(continue_encoding_ul, [this]()
+                                      { return _has_waiting_data || !_continue_encoding; });
+                if (!_continue_encoding)
+                    break;
+                _has_waiting_data = false;
+                _number_of_waiting_data = 0;
+                pass = ++_number_of_started_passes;
+            }
+            _space_notifier.notify_all();
+            encode_all_waiting_data();
+            uint64_t job_ticket = _image_encoding_pool.get_last_job_ticket();
+            {
+                std::lock_guard<std::mutex> continue_encoding_lg(_continue_encoding_mtx);
+                _number_of_finished_passes = pass;
+                _last_job_ticket_of_finished_pass = job_ticket;
+            }
+            _pass_notifier.notify_all();
+        }
+        // Encode data pushed before the end:
+        encode_all_waiting_data();
+    }
+
+    void EncodingStage::encode_all_waiting_data()
+    {
+        std::lock_guard<std::mutex> encoding_is_process(_encoding_is_being_process);
+        take_staged_messages();
+        encode_waiting_images();
+        prepare_camera_calibration_messages();
+        prepare_raw_message();
+        prepare_log();
+        prepare_samples();
+        prepare_channel_messages();
+    }
+
+    void EncodingStage::dispatch(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, std::string const &serialized_schema, std::string const &protobuf_message_name, EncodedSample const &encoded_sample, uint64_t timestamp, uint64_t enqueue_time)
+    {
+        for (auto &target : targets)
+        {
+            if (target->get_channel_message_encoding(channel_name) == MessageEncoding::PROTOBUF)
+            {
+                if (!encoded_sample.protobuf_payload)
+                    continue;
+                target->ensure_protobuf_schema(channel_name, protobuf_message_name);
+                target->push_payload(channel_name, encoded_sample.protobuf_payload, timestamp, enqueue_time);
+            }
+            else
+            {
+                if (!encoded_sample.json_payload)
+                    continue;
+                target->ensure_schema(channel_name, serialized_schema);
+                target->push_payload(channel_name, encoded_sample.json_payload, timestamp, enqueue_time);
+            }
+        }
+    }
+
+    void EncodingStage::get_needed_encodings(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, bool &json_needed, bool &protobuf_needed)
+    {
+        json_needed = false;
+        protobuf_needed = false;
+        for (auto &target : targets)
+        {
+            if (target->get_channel_message_encoding(channel_name) == MessageEncoding::PROTOBUF)
+                protobuf_needed = true;
+            else
+                json_needed = true;
+        }
+    }
+
+    EncodedSample EncodingStage::encode_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, nlohmann::json const &sample, std::string const &protobuf_message_name)
+    {
+        bool json_needed, protobuf_needed;
+        get_needed_encodings(targets, channel_name, json_needed, protobuf_needed);
+        EncodedSample encoded_sample;
+        if (json_needed)
+            encoded_sample.json_payload = make_payload(sample.dump());
+        if (protobuf_needed)
+        {
+            std::string serialized_sample = acquire_payload_buffer();
+            if (foxglove_json_to_protobuf(protobuf_message_name, sample, serialized_sample))
+                encoded_sample.protobuf_payload = make_payload(std::move(serialized_sample));
+            else
+                std::cerr << "[MCAPWrapper] ERROR: no protobuf definition for " << protobuf_message_name << std::endl;
+        }
+        return encoded_sample;
+    }
+
+    EncodedSample EncodingStage::serialize_sample(std::vector<std::shared_ptr<IWriter>> const &targets, std::string const &channel_name, SampleSerializer const &serializer)
+    {
+        bool json_needed, protobuf_needed;
+        get_needed_encodings(targets, channel_name, json_needed, protobuf_needed);
+        EncodedSample encoded_sample;
+        if (json_needed)
+        {
+            std::string serialized_sample = acquire_payload_buffer();
+            serializer(MessageEncoding::JSON, serialized_sample);
+            encoded_sample.json_payload = make_payload(std::move(serialized_sample));
+        }
+        if (protobuf_needed)
+        {
+            std::string serialized_sample = acquire_payload_buffer();
+            serializer(MessageEncoding::PROTOBUF, serialized_sample);
+            encoded_sample.protobuf_payload = make_payload(std::move(serialized_sample));
+        }
+        return encoded_sample;
+    }
+
+    void EncodingStage::encode_waiting_images()
+    {
+        // Copy data:
+        std::vector<ImageWaitingToBeEncoded> image_waiting_to_be_encoded;
+        {
+            std::lock_guard<std::mutex> lg(_image_waiting_to_be_encoded_mtx);
+            std::swap(image_waiting_to_be_encoded, _image_waiting_to_be_encoded);
+        }
+        // Images are encoded in parallel by the pool, they are dispatched in push order for each channel:
+        for (auto &image_data : image_waiting_to_be_encoded)
+        {
+            bool is_encoded = image_data.encoded_sample.json_payload || image_data.encoded_sample.protobuf_payload;
+            if (!image_data.is_raw && !is_encoded)
+            {
+                {
+                    std::lock_guard<std::mutex> lg(_image_channel_options_mtx);
+                    auto options = _image_channel_options.find(image_data.identifier);
+                    if (options != _image_channel_options.end())
+                        image_data.options = options->second;
+                }
+                if (image_data.options.codec == ImageCodec::RAW)
+                {
+                    std::string encoding;
+                    if (get_raw_image_encoding(image_data.image.type(), encoding))
+                        image_data.is_raw = true;
+                    else // Stay lossless:
+                        image_data.options.codec = ImageCodec::PNG;
+                }
+            }
+            std::shared_ptr<ImageWaitingToBeEncoded> image_to_encode = std::make_shared<ImageWaitingToBeEncoded>(std::move(image_data));
+            bool json_needed, protobuf_needed;
+            get_needed_encodings(image_to_encode->targets, image_to_encode->identifier, json_needed, protobuf_needed);
+            _image_encoding_pool.push_job(
+                image_to_encode->identifier,
+                [image_to_encode, is_encoded, json_needed, protobuf_needed]()
+                {
+                    if (is_encoded) // Still goes through the pool, for keeping order of the channel
+                        return image_to_encode->encoded_sample;
+                    return image_to_encode->is_raw ? encode_raw_image(*image_to_encode, json_needed, protobuf_needed)
+                                                   : encode_image(*image_to_encode, json_needed, protobuf_needed);
+                },
+                [this, image_to_encode](EncodedSample const &encoded_sample)
+                {
+                    if (image_to_encode->is_raw)
+                        dispatch(image_to_encode->targets, image_to_encode->identifier, get_raw_image_schema(), "foxglove.RawImage", encoded_sample, image_to_encode->timestamp, image_to_encode->enqueue_time);
+                    else
+                        dispatch(image_to_encode->targets, image_to_encode->identifier, get_compressed_image_schema(), "foxglove.CompressedImage", encoded_sample, image_to_encode->timestamp, image_to_encode->enqueue_time);
+                });
+        }
+    }
+
+    EncodedSample EncodingStage::encode_image(ImageWaitingToBeEncoded const &image_data, bool json_needed, bool protobuf_needed)
+    {
+        uint64_t timestamp = image_data.timestamp;
+
+        // Encode image once for all connections:
+        std::string extension, format;
+        std::vector<int> compression_params;
+        get_image_codec_parameters(image_data.options, extension, format, compression_params);
+        std::vector<uchar> encoding_buffer;
+        if (!cv::imencode(extension, image_data.image, encoding_buffer, compression_params))
+        {
+            std::cerr << "[MCAPWrapper] ERROR: failed to encode image of " << image_data.identifier << std::endl;
+            return EncodedSample();
+        }
+
+        return make_compressed_image_sample(timestamp, image_data.frame_id, encoding_buffer.data(), encoding_buffer.size(), format, json_needed, protobuf_needed);
+    }
+
+    EncodedSample EncodingStage::make_compressed_image_sample(uint64_t timestamp, std::string const &frame_id, uint8_t const *data, size_t size, std::string const &format, bool json_needed, bool protobuf_needed)
+    {
+        EncodedSample encoded_sample;
+        if (json_needed)
+        {
+            std::string image_base64_encoded = base64::encode_into<std::string>(data, data + size);
+
+            // Create message:
+            nlohmann::json image_sample;
+            image_sample["timestamp"] = nlohmann::json();
+            image_sample["timestamp"]["sec"] = timestamp / (uint64_t)1e9;
+            image_sample["timestamp"]["nsec"] = timestamp % (uint64_t)1e9;
+            image_sample["frame_id"] = frame_id;
+            image_sample["data"] = std::move(image_base64_encoded);
+            image_sample["format"] = format;
+            encoded_sample.json_payload = make_payload(image_sample.dump());
+        }
+        if (protobuf_needed)
+        {
+            // Encoded bytes are written as is, without base64:
+            std::string serialized_image = acquire_payload_buffer(size + frame_id.size() + format.size() + 64);
+            ProtobufWriter writer(serialized_image);
+            writer.write_timestamp_field(1, timestamp);
+            writer.write_string_field(4, frame_id);
+            writer.write_bytes_field(2, data, size);
+            writer.write_string_field(3, format);
+            encoded_sample.protobuf_payload = make_payload(std::move(serialized_image));
+        }
+        return encoded_sample;
+    }
+
+    void EncodingStage::get_image_codec_parameters(ImageChannelOptions const &options, std::string &extension, std::string &format, std::vector<int> &compression_params)
+    {
+        switch (options.codec)
+        {
+        case ImageCodec::PNG:
+            extension = ".png";
+            format = "png";
+            compression_params = {cv::IMWRITE_PNG_COMPRESSION, options.png_compression_level};
+            break;
+        case ImageCodec::WEBP:
+            extension = ".webp";
+            format = "webp";
+            compression_params = {cv::IMWRITE_WEBP_QUALITY, options.webp_quality};
+            break;
+        default:
+            extension = ".jpg";
+            format = "jpeg";
+            compression_params = {cv::IMWRITE_JPEG_QUALITY, options.jpeg_quality};
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 5)))
+            compression_params.push_back(cv::IMWRITE_JPEG_SAMPLING_FACTOR);
+            if (options.jpeg_chroma_subsampling == JpegChromaSubsampling::SUBSAMPLING_444)
+                compression_params.push_back(cv::IMWRITE_JPEG_SAMPLING_FACTOR_444);
+            else if (options.jpeg_chroma_subsampling == JpegChromaSubsampling::SUBSAMPLING_422)
+                compression_params.push_back(cv::IMWRITE_JPEG_SAMPLING_FACTOR_422);
+            else
+                compression_params.push_back(cv::IMWRITE_JPEG_SAMPLING_FACTOR_420);
+#endif
+            break;
+        }
+    }
+
+    EncodedSample EncodingStage::encode_raw_image(ImageWaitingToBeEncoded const &image_data, bool json_needed, bool protobuf_needed)
+    {
+        uint64_t timestamp = image_data.timestamp;
+        cv::Mat const &image = image_data.image;
+        std::string encoding;
+        get_raw_image_encoding(image.type(), encoding);
+        // Rows are written without padding:
+        size_t step = image.cols * image.elemSize();
+        size_t data_size = step * image.rows;
+
+        EncodedSample encoded_sample;
+        if (protobuf_needed)
+        {
+            // Pixels are copied once, straight from the image buffer into the message:
+            std::string serialized_image = acquire_payload_buffer(data_size + image_data.frame_id.size() + encoding.size() + 64);
+            ProtobufWriter writer(serialized_image);
+            writer.write_timestamp_field(1, timestamp);
+            writer.write_string_field(7, image_data.frame_id);
+            writer.write_fixed32_field(2, image.cols);
+            writer.write_fixed32_field(3, image.rows);
+            writer.write_string_field(4, encoding);
+            writer.write_fixed32_field(5, step);
+            writer.write_tag(6, ProtobufWireType::LENGTH_DELIMITED);
+            writer.write_varint(data_size);
+            if (image.isContinuous())
+                writer.write_raw_bytes(image.data, data_size);
+            else
+            {
+                for (int row = 0; row < image.rows; row++)
+                    writer.write_raw_bytes(image.ptr(row), step);
+            }
+            encoded_sample.protobuf_payload = make_payload(std::move(serialized_image));
+        }
+        if (json_needed)
+        {
+            std::string image_base64_encoded;
+            if (image.isContinuous())
+                image_base64_encoded = base64::encode_into<std::string>(image.data, image.data + data_size);
+            else
+            {
+                std::vector<uchar> image_buffer(data_size);
+                for (int row = 0; row < image.rows; row++)
+                    std::memcpy(image_buffer.data() + row * step, image.ptr(row), step);
+                image_base64_encoded = base64::encode_into<std::string>(image_buffer.begin(), image_buffer.end());
+            }
+
+            // Create message:
+            nlohmann::json image_sample;
+            image_sample["timestamp"] = nlohmann::json();
+            image_sample["timestamp"]["sec"] = timestamp / (uint64_t)1e9;
+            image_sample["timestamp"]["nsec"] = timestamp % (uint64_t)1e9;
+            image_sample["frame_id"] = image_data.frame_id;
+            image_sample["width"] = image.cols;
+            image_sample["height"] = image.rows;
+            image_sample["encoding"] = encoding;
+            image_sample["step"] = step;
+            image_sample["data"] = std::move(image_base64_encoded);
+            encoded_sample.json_payload = make_payload(image_sample.dump());
+        }
+        return encoded_sample;
+    }
+
+    void EncodingStage::prepare_camera_calibration_messages()
+    {
+        // Copy data:
+        std::vector<CameraCalibration> camera_calibration_waiting_to_be_encoded;
+        {
+            std::lock_guard<std::mutex> lg(_camera_calibration_waiting_to_be_encoded_mtx);
+            std::swap(camera_calibration_waiting_to_be_encoded, _camera_calibration_waiting_to_be_encoded);
+        }
+        for (auto &calibration_to_encode : camera_calibration_waiting_to_be_encoded)
+        {
+            auto serializer = [&calibration_to_encode](MessageEncoding encoding, std::string &out)
+            {
+                serialize_camera_calibration(encoding, out, calibration_to_encode.timestamp, calibration_to_encode.frame_id, calibration_to_encode.image_width, calibration_to_encode.image_height,
+                                             calibration_to_encode.distortion_model, calibration_to_encode.D, calibration_to_encode.K, calibration_to_encode.R, calibration_to_encode.P);
+            };
+            dispatch(calibration_to_encode.targets, calibration_to_encode.camera_identifier, get_camera_calibration_schema(), "foxglove.CameraCalibration",
+                     serialize_sample(calibration_to_encode.targets, calibration_to_encode.camera_identifier, serializer), calibration_to_encode.timestamp, calibration_to_encode.enqueue_time);
+        }
+    }
+
+    void EncodingStage::take_staged_messages()
+    {
+        {
+            std::lock_guard<std::mutex> lg(_producer_stagings_mtx);
+            _stagings_being_encoded.clear();
+            for (auto &staging : _producer_stagings)
+                _stagings_being_encoded.push_back(staging.get());
+        }
+        // Staged messages are swapped, not reallocated: messages taken previously are reused by producers
+        for (ProducerStaging *staging : _stagings_being_encoded)
+        {
+            std::lock_guard<std::mutex> lg(staging->mtx);
+            std::swap(staging->being_encoded, staging->waiting);
+        }
+        {
+            std::lock_guard<std::mutex> lg(_continue_encoding_mtx);
+            _number_of_staging_takes++;
+        }
+        _space_notifier.notify_all();
+    }
+
+    /**
+     * @brief Process messages staged by several producers in the order they were pushed. Messages of a producer are already
+     * in push order, they are merged by their enqueue time.
+     *
+     * @param ranges First and end message staged by each producer
+     * @param heap Heap of next message of each producer, by enqueue time. Given for reusing its memory.
+     * @param process Function called on each message
+     */
+    template <typename Message, typename Process>
+    void process_in_push_order(std::vector<std::pair<Message *, Message *>> &ranges, std::vector<std::pair<uint64_t, size_t>> &heap, Process const &process)
+    {
+        auto is_later = [](std::pair<uint64_t, size_t> const &a, std::pair<uint64_t, size_t> const &b)
+        { return a.first > b.first; };
+        heap.clear();
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            if (ranges[i].first != ranges[i].second)
+                heap.emplace_back(ranges[i].first->enqueue_time, i);
+        }
+        std::make_heap(heap.begin(), heap.end(), is_later);
+        while (!heap.empty())
+        {
+            std::pop_heap(heap.begin(), heap.end(), is_later);
+            std::pair<Message *, Message *> &range = ranges[heap.back().second];
+            process(*range.first++);
+            if (range.first == range.second)
+                heap.pop_back();
+            else
+            {
+                heap.back().first = range.first->enqueue_time;
+                std::push_heap(heap.begin(), heap.end(), is_later);
+            }
+        }
+    }
+
+    void EncodingStage::prepare_raw_message()
+    {
+        std::vector<std::pair<RawMessage *, RawMessage *>> ranges;
+        for (ProducerStaging *staging : _stagings_being_encoded)
+        {
+            std::vector<RawMessage> &raw_messages = staging->being_encoded.raw_messages;
+            ranges.emplace_back(raw_messages.data(), raw_messages.data() + raw_messages.size());
+        }
+        bool validate = _validate_raw_messages;
+        process_in_push_order(ranges, _staging_merge_heap, [this, validate](RawMessage &raw_message)
+                              { encode_raw_message(raw_message, validate); });
+        for (ProducerStaging *staging : _stagings_being_encoded)
+            staging->being_encoded.raw_messages.clear();
+    }
+
+    void EncodingStage::encode_raw_message(RawMessage &raw_message, bool validate)
+    {
+        bool schema_needed = false, json_needed = false, cbor_needed = false;
+        std::vector<bool> target_is_cbor;
+        for (auto &target : raw_message.targets)
+        {
+            schema_needed |= !target->is_schema_present(raw_message.identifier);
+            target_is_cbor.push_back(target->get_raw_channel_message_encoding(raw_message.identifier) == MessageEncoding::CBOR);
+            cbor_needed |= target_is_cbor.back();
+            json_needed |= !target_is_cbor.back();
+        }
+
+        // Message is only parsed when needed, JSON connections write it as is:
+        nlohmann::json unserialiazed_json;
+        if (schema_needed || cbor_needed)
+        {
+            try
+            {
+                unserialiazed_json = nlohmann::json::parse(raw_message.serialized_message);
+            }
+            catch (std::exception const &e)
+            { // Parse error:
+                std::cerr << "[MCAPWrapper] ERROR: failed to parse " << raw_message.serialized_message << std::endl;
+                return;
+            }
+        }
+        else if (validate && !nlohmann::json::accept(raw_message.serialized_message))
+        {
+            std::cerr << "[MCAPWrapper] ERROR: failed to parse " << raw_message.serialized_message << std::endl;
+            return;
+        }
+
+        // Schema is infered only once even if several connections need it:
+        std::string serialized_schema;
+        if (schema_needed)
+            serialized_schema = infer_schema_of_sample(raw_message.identifier, unserialiazed_json).dump();
+        // Message is serialized once per encoding:
+        EncodedSample encoded_sample;
+        if (cbor_needed)
+        {
+            std::string serialized_cbor = acquire_payload_buffer();
+            nlohmann::json::to_cbor(unserialiazed_json, serialized_cbor);
+            encoded_sample.cbor_payload = make_payload(std::move(serialized_cbor));
+        }
+        if (json_needed)
+            encoded_sample.json_payload = make_payload(std::move(raw_message.serialized_message));
+        for (unsigned i = 0; i < raw_message.targets.size(); i++)
+        {
+            if (serialized_schema.size())
+                raw_message.targets[i]->ensure_schema(raw_message.identifier, serialized_schema, target_is_cbor[i] ? "cbor" : "json");
+            raw_message.targets[i]->push_payload(raw_message.identifier, target_is_cbor[i] ? encoded_sample.cbor_payload : encoded_sample.json_payload, raw_message.timestamp, raw_message.enqueue_time);
+        }
+    }
+
+    void EncodingStage::prepare_log()
+    {
+        std::vector<std::pair<Log *, Log *>> ranges;
+        for (ProducerStaging *staging : _stagings_being_encoded)
+        {
+            std::vector<Log> &logs = staging->being_encoded.logs;
+            ranges.emplace_back(logs.data(), logs.data() + logs.size());
+        }
+        process_in_push_order(ranges, _staging_merge_heap, [this](Log &log_message)
+                              { encode_log(log_message); });
+        for (ProducerStaging *staging : _stagings_being_encoded)
+            staging->being_encoded.logs.clear();
+    }
+
+    void EncodingStage::encode_log(Log &log_message)
+    {
+        auto serializer = [&log_message](MessageEncoding encoding, std::string &out)
+        {
+            serialize_log(encoding, out, log_message.timestamp, log_message.log_level, log_message.message, log_message.name, log_message.file, log_message.line);
+        };
+        dispatch(log_message.targets, log_message.identifier, get_log_schema(), "foxglove.Log",
+                 serialize_sample(log_message.targets, log_message.identifier, serializer), log_message.timestamp, log_message.enqueue_time);
+    }
+
+    void EncodingStage::prepare_samples()
+    {
+        std::vector<Sample> sample_waiting_to_be_encoded;
+        {
+            std::lock_guard<std::mutex> lg(_sample_waiting_to_be_encoded_mtx);
+            std::swap(sample_waiting_to_be_encoded, _sample_waiting_to_be_encoded);
+        }
+
+        for (auto &sample : sample_waiting_to_be_encoded)
+        {
+            EncodedSample encoded_sample = sample.serializer ? serialize_sample(sample.targets, sample.channel_name, sample.serializer)
+                                                             : encode_sample(sample.targets, sample.channel_name, sample.sample, sample.protobuf_message_name);
+            dispatch(sample.targets, sample.channel_name, *sample.serialized_schema, sample.protobuf_message_name, encoded_sample, sample.timestamp, sample.enqueue_time);
+        }
+    }
+
+    void EncodingStage::prepare_channel_messages()
+    {
+        std::vector<std::pair<ChannelMessage *, ChannelMessage *>> ranges;
+        for (ProducerStaging *staging : _stagings_being_encoded)
+        {
+            ChannelMessageBatch &batch = staging->being_encoded.channel_messages;
+            ranges.emplace_back(batch.messages.data(), batch.messages.data() + batch.size);
+        }
+        process_in_push_order(ranges, _staging_merge_heap, [this](ChannelMessage &channel_message)
+                              { encode_channel_message(channel_message); });
+        // Messages are kept for reusing their strings
+        for (ProducerStaging *staging : _stagings_being_encoded)
+            staging->being_encoded.channel_messages.size = 0;
+    }
+
+    void EncodingStage::encode_channel_message(ChannelMessage &channel_message)
+    {
+        OpenedChannel &channel = *channel_message.channel;
+        // Channel is already resolved, message is only serialized in its encoding:
+        std::string serialized_message = acquire_payload_buffer();
+        if (channel.type == ChannelType::LOG)
+            serialize_log(channel.encoding, serialized_message, channel_message.timestamp, channel_message.log_level,
+                          channel_message.text, channel_message.name, channel_message.file, channel_message.line);
+        else if (channel.type == ChannelType::TRANSFORM)
+            serialize_frame_transform(channel.encoding, serialized_message, channel_message.timestamp, channel_message.text, channel_message.name, channel_message.pose);
+        else if (!encode_channel_raw_message(channel, channel_message.text, serialized_message))
+            return;
+        channel.writer->push_payload(channel.route, make_payload(std::move(serialized_message)), channel_message.timestamp, channel_message.enqueue_time);
+    }
+
+    bool EncodingStage::encode_channel_raw_message(OpenedChannel &channel, std::string const &serialized_message, std::string &out)
+    {
+        // Message is only parsed when needed, JSON channels write it as is:
+        nlohmann::json unserialiazed_json;
+        if (!channel.is_resolved || channel.encoding == MessageEncoding::CBOR)
+        {
+            try
+            {
+                unserialiazed_json = nlohmann::json::parse(serialized_message);
+            }
+            catch (std::exception const &e)
+            { // Parse error:
+                std::cerr << "[MCAPWrapper] ERROR: failed to parse " << serialized_message << std::endl;
+                return false;
+            }
+        }
+        else if (_validate_raw_messages && !nlohmann::json::accept(serialized_message))
+        {
+            std::cerr << "[MCAPWrapper] ERROR: failed to parse " << serialized_message << std::endl;
+            return false;
+        }
+
+        // First message of the channel gives its schema:
+        if (!channel.is_resolved)
+        {
+            channel.writer->ensure_schema(channel.channel_name, infer_schema_of_sample(channel.channel_name, unserialiazed_json).dump(),
+                                          channel.encoding == MessageEncoding::CBOR ? "cbor" : "json");
+            channel.is_resolved = channel.writer->resolve_channel(channel.channel_name, channel.route);
+            if (!channel.is_resolved)
+                return false;
+        }
+        if (channel.encoding == MessageEncoding::CBOR)
+            nlohmann::json::to_cbor(unserialiazed_json, out);
+        else
+            out.assign(serialized_message);
+        return true;
+    }
+};
@@ -0,0 +1,123 @@
+#include "internal/FileWritable.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace mcap_wrapper
+{
+    FileWritable::FileWritable(uint64_t preallocation_size, uint64_t write_behind_size)
+    {
+        _preallocation_size = preallocation_size;
+        _write_behind_size = write_behind_size;
+    }
+
+    FileWritable::~FileWritable()
+    {
+        end();
+    }
+
+    mcap::Status FileWritable::open(std::string const &file_name)
+    {
+        end();
+        _file = std::fopen(file_name.c_str(), "wb");
+        if (!_file)
+            return mcap::Status(mcap::StatusCode::OpenFailed, "failed to open file \"" + file_name + "\" for writing");
+        _allocated_size = 0;
+        _write_behind_offset = 0;
+        return mcap::StatusCode::Success;
+    }
+
+    void FileWritable::handleWrite(const std::byte *data, uint64_t size)
+    {
+        preallocate(fileno(_file), _size + size);
+        if (std::fwrite(data, 1, size, _file) != size)
+            std::cerr << "[MCAPWrapper] ERROR: failed to write " << size << " bytes to file" << std::endl;
+        _size += size;
+        // Data still buffered by stdio are handed to disk with the next window
+        write_behind(fileno(_file), _size);
+    }
+
+    void FileWritable::end()
+    {
+        if (_file)
+        {
+            std::fflush(_file);
+            free_preallocated_space(fileno(_file), _size);
+            std::fclose(_file);
+            _file = nullptr;
+        }
+        _size = 0;
+    }
+
+    uint64_t FileWritable::size() const
+    {
+        return _size;
+    }
+
+    bool FileWritable::flush()
+    {
+        return _file && std::fflush(_file) == 0;
+    }
+
+    bool FileWritable::sync()
+    {
+        if (!flush())
+            return false;
+        if (fsync(fileno(_file)) != 0)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: failed to sync file to disk" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    //
+    // Protected methods
+    //
+    void FileWritable::preallocate(int fd, uint64_t end_offset)
+    {
+#ifdef __linux__
+        if (!_preallocation_size || end_offset <= _allocated_size)
+            return;
+        // Size of the file is kept, so readers and a crash never see preallocated space as data
+        uint64_t allocated_size = (end_offset + _preallocation_size - 1) / _preallocation_size * _preallocation_size;
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, _allocated_size, allocated_size - _allocated_size) != 0)
+        {
+            std::cerr << "[MCAPWrapper] WARNING: file can not be preallocated: " << std::strerror(errno) << ". It grows by appending" << std::endl;
+            _preallocation_size = 0;
+            return;
+        }
+        _allocated_size = allocated_size;
+#endif
+    }
+
+    void FileWritable::write_behind(int fd, uint64_t end_offset)
+    {
+#ifdef __linux__
+        if (!_write_behind_size)
+            return;
+        while (end_offset >= _write_behind_offset + _write_behind_size)
+        {
+            // Writeback of the window starts now, instead of once the system has too many dirty pages and stalls every writer
+            sync_file_range(fd, _write_behind_offset, _write_behind_size, SYNC_FILE_RANGE_WRITE);
+            if (_write_behind_offset >= _write_behind_size)
+            {
+                // Window before had the time of a whole window to reach disk, it is waited for and dropped from page cache
+                uint64_t previous_offset = _write_behind_offset - _write_behind_size;
+                sync_file_range(fd, previous_offset, _write_behind_size, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+                posix_fadvise(fd, previous_offset, _write_behind_size, POSIX_FADV_DONTNEED);
+            }
+            _write_behind_offset += _write_behind_size;
+        }
+#endif
+    }
+
+    void FileWritable::free_preallocated_space(int fd, uint64_t size)
+    {
+        if (_allocated_size > size && ftruncate(fd, size) != 0)
+            std::cerr << "[MCAPWrapper] ERROR: failed to free preallocated space of file: " << std::strerror(errno) << std::endl;
+        _allocated_size = 0;
+    }
+};
@@ -0,0 +1,439 @@
+#include "internal/FoxgloveProtobufSchema.hpp"
+#include "internal/ProtobufSerializer.h"
+#include "internal/Base64.hpp"
+#include <map>
+#include <algorithm>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <cstring>
+
+namespace mcap_wrapper
+{
+    namespace
+    {
+        // Type of fields, values are the ones of `google.protobuf.FieldDescriptorProto.Type`
+        enum class FieldType
+        {
+            DOUBLE = 1,
+            INT64 = 3,
+            INT32 = 5,
+            FIXED32 = 7,
+            BOOL = 8,
+            STRING = 9,
+            MESSAGE = 11,
+            BYTES = 12,
+            UINT32 = 13,
+            ENUM = 14
+        };
+
+        typedef struct FieldDefinition
+        {
+            std::string name;      // Name of the field in .proto
+            uint32_t number;       // Field number
+            FieldType type;        // Field type
+            bool repeated;         // Is field repeated
+            std::string type_name; // Full name of message or enum type
+            std::string json_key;  // Key of the field in wrapper JSON when it differs from `name`
+        } FieldDefinition;
+
+        typedef struct EnumDefinition
+        {
+            std::string name;                               // Name of the enum, nested into its message
+            std::vector<std::pair<std::string, int>> values; // Name and number of each value
+        } EnumDefinition;
+
+        typedef struct MessageDefinition
+        {
+            std::string file_name;              // .proto file defining the message
+            std::vector<FieldDefinition> fields; // Fields of the message
+            std::vector<EnumDefinition> enums;   // Enums nested into the message
+        } MessageDefinition;
+
+        // Definitions come from https://github.com/foxglove/schemas
+        std::map<std::string, MessageDefinition> const &get_message_definitions()
+        {
+            typedef FieldType T;
+            static const std::map<std::string, MessageDefinition> definitions = {
+                {"google.protobuf.Timestamp", {"google/protobuf/timestamp.proto", {{"seconds", 1, T::INT64, false, "", "sec"}, {"nanos", 2, T::INT32, false, "", "nsec"}}, {}}},
+                {"google.protobuf.Duration", {"google/protobuf/duration.proto", {{"seconds", 1, T::INT64, false, "", "sec"}, {"nanos", 2, T::INT32, false, "", "nsec"}}, {}}},
+                {"foxglove.Vector3", {"foxglove/Vector3.proto", {{"x", 1, T::DOUBLE, false, "", ""}, {"y", 2, T::DOUBLE, false, "", ""}, {"z", 3, T::DOUBLE, false, "", ""}}, {}}},
+                {"foxglove.Quaternion", {"foxglove/Quaternion.proto", {{"x", 1, T::DOUBLE, false, "", ""}, {"y", 2, T::DOUBLE, false, "", ""}, {"z", 3, T::DOUBLE, false, "", ""}, {"w", 4, T::DOUBLE, false, "", ""}}, {}}},
+                {"foxglove.Point2", {"foxglove/Point2.proto", {{"x", 1, T::DOUBLE, false, "", ""}, {"y", 2, T::DOUBLE, false, "", ""}}, {}}},
+                {"foxglove.Point3", {"foxglove/Point3.proto", {{"x", 1, T::DOUBLE, false, "", ""}, {"y", 2, T::DOUBLE, false, "", ""}, {"z", 3, T::DOUBLE, false, "", ""}}, {}}},
+                {"foxglove.Color", {"foxglove/Color.proto", {{"r", 1, T::DOUBLE, false, "", ""}, {"g", 2, T::DOUBLE, false, "", ""}, {"b", 3, T::DOUBLE, false, "", ""}, {"a", 4, T::DOUBLE, false, "", ""}}, {}}},
+                {"foxglove.Pose", {"foxglove/Pose.proto", {{"position", 1, T::MESSAGE, false, "foxglove.Vector3", ""}, {"orientation", 2, T::MESSAGE, false, "foxglove.Quaternion", ""}}, {}}},
+                {"foxglove.KeyValuePair", {"foxglove/KeyValuePair.proto", {{"key", 1, T::STRING, false, "", ""}, {"value", 2, T::STRING, false, "", ""}}, {}}},
+                {"foxglove.CompressedImage", {"foxglove/CompressedImage.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"frame_id", 4, T::STRING, false, "", ""}, {"data", 2, T::BYTES, false, "", ""}, {"format", 3, T::STRING, false, "", ""}}, {}}},
+                {"foxglove.RawImage", {"foxglove/RawImage.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"frame_id", 7, T::STRING, false, "", ""}, {"width", 2, T::FIXED32, false, "", ""}, {"height", 3, T::FIXED32, false, "", ""}, {"encoding", 4, T::STRING, false, "", ""}, {"step", 5, T::FIXED32, false, "", ""}, {"data", 6, T::BYTES, false, "", ""}}, {}}},
+                {"foxglove.Log", {"foxglove/Log.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"level", 2, T::ENUM, false, "foxglove.Log.Level", ""}, {"message", 3, T::STRING, false, "", ""}, {"name", 4, T::STRING, false, "", ""}, {"file", 5, T::STRING, false, "", ""}, {"line", 6, T::FIXED32, false, "", ""}}, {{"Level", {{"UNKNOWN", 0}, {"DEBUG", 1}, {"INFO", 2}, {"WARNING", 3}, {"ERROR", 4}, {"FATAL", 5}}}}}},
+                {"foxglove.FrameTransform", {"foxglove/FrameTransform.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"parent_frame_id", 2, T::STRING, false, "", ""}, {"child_frame_id", 3, T::STRING, false, "", ""}, {"translation", 4, T::MESSAGE, false, "foxglove.Vector3", ""}, {"rotation", 5, T::MESSAGE, false, "foxglove.Quaternion", ""}}, {}}},
+                {"foxglove.CameraCalibration", {"foxglove/CameraCalibration.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"frame_id", 9, T::STRING, false, "", ""}, {"width", 2, T::FIXED32, false, "", ""}, {"height", 3, T::FIXED32, false, "", ""}, {"distortion_model", 4, T::STRING, false, "", ""}, {"D", 5, T::DOUBLE, true, "", ""}, {"K", 6, T::DOUBLE, true, "", ""}, {"R", 7, T::DOUBLE, true, "", ""}, {"P", 8, T::DOUBLE, true, "", ""}}, {}}},
+                {"foxglove.PosesInFrame", {"foxglove/PosesInFrame.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"frame_id", 2, T::STRING, false, "", ""}, {"poses", 3, T::MESSAGE, true, "foxglove.Pose", ""}}, {}}},
+                {"foxglove.CircleAnnotation", {"foxglove/CircleAnnotation.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"position", 2, T::MESSAGE, false, "foxglove.Point2", ""}, {"diameter", 3, T::DOUBLE, false, "", ""}, {"thickness", 4, T::DOUBLE, false, "", ""}, {"fill_color", 5, T::MESSAGE, false, "foxglove.Color", ""}, {"outline_color", 6, T::MESSAGE, false, "foxglove.Color", ""}}, {}}},
+                {"foxglove.PointsAnnotation", {"foxglove/PointsAnnotation.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"type", 2, T::ENUM, false, "foxglove.PointsAnnotation.Type", ""}, {"points", 3, T::MESSAGE, true, "foxglove.Point2", ""}, {"outline_color", 4, T::MESSAGE, false, "foxglove.Color", ""}, {"outline_colors", 5, T::MESSAGE, true, "foxglove.Color", ""}, {"fill_color", 6, T::MESSAGE, false, "foxglove.Color", ""}, {"thickness", 7, T::DOUBLE, false, "", ""}}, {{"Type", {{"UNKNOWN", 0}, {"POINTS", 1}, {"LINE_LOOP", 2}, {"LINE_STRIP", 3}, {"LINE_LIST", 4}}}}}},
+                {"foxglove.TextAnnotation", {"foxglove/TextAnnotation.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"position", 2, T::MESSAGE, false, "foxglove.Point2", ""}, {"text", 3, T::STRING, false, "", ""}, {"font_size", 4, T::DOUBLE, false, "", ""}, {"text_color", 5, T::MESSAGE, false, "foxglove.Color", ""}, {"background_color", 6, T::MESSAGE, false, "foxglove.Color", ""}}, {}}},
+                {"foxglove.ImageAnnotations", {"foxglove/ImageAnnotations.proto", {{"circles", 1, T::MESSAGE, true, "foxglove.CircleAnnotation", ""}, {"points", 2, T::MESSAGE, true, "foxglove.PointsAnnotation", ""}, {"texts", 3, T::MESSAGE, true, "foxglove.TextAnnotation", ""}}, {}}},
+                {"foxglove.ArrowPrimitive", {"foxglove/ArrowPrimitive.proto", {{"pose", 1, T::MESSAGE, false, "foxglove.Pose", ""}, {"shaft_length", 2, T::DOUBLE, false, "", ""}, {"shaft_diameter", 3, T::DOUBLE, false, "", ""}, {"head_length", 4, T::DOUBLE, false, "", ""}, {"head_diameter", 5, T::DOUBLE, false, "", ""}, {"color", 6, T::MESSAGE, false, "foxglove.Color", ""}}, {}}},
+                {"foxglove.CubePrimitive", {"foxglove/CubePrimitive.proto", {{"pose", 1, T::MESSAGE, false, "foxglove.Pose", ""}, {"size", 2, T::MESSAGE, false, "foxglove.Vector3", ""}, {"color", 3, T::MESSAGE, false, "foxglove.Color", ""}}, {}}},
+                {"foxglove.SpherePrimitive", {"foxglove/SpherePrimitive.proto", {{"pose", 1, T::MESSAGE, false, "foxglove.Pose", ""}, {"size", 2, T::MESSAGE, false, "foxglove.Vector3", ""}, {"color", 3, T::MESSAGE, false, "foxglove.Color", ""}}, {}}},
+                {"foxglove.CylinderPrimitive", {"foxglove/CylinderPrimitive.proto", {{"pose", 1, T::MESSAGE, false, "foxglove.Pose", ""}, {"size", 2, T::MESSAGE, false, "foxglove.Vector3", ""}, {"bottom_scale", 3, T::DOUBLE, false, "", ""}, {"top_scale", 4, T::DOUBLE, false, "", ""}, {"color", 5, T::MESSAGE, false, "foxglove.Color", ""}}, {}}},
+                {"foxglove.LinePrimitive", {"foxglove/LinePrimitive.proto", {{"type", 1, T::ENUM, false, "foxglove.LinePrimitive.Type", ""}, {"pose", 2, T::MESSAGE, false, "foxglove.Pose", ""}, {"thickness", 3, T::DOUBLE, false, "", ""}, {"scale_invariant", 4, T::BOOL, false, "", ""}, {"points", 5, T::MESSAGE, true, "foxglove.Point3", ""}, {"color", 6, T::MESSAGE, false, "foxglove.Color", ""}, {"colors", 7, T::MESSAGE, true, "foxglove.Color", ""}, {"indices", 8, T::FIXED32, true, "", ""}}, {{"Type", {{"LINE_STRIP", 0}, {"LINE_LOOP", 1}, {"LINE_LIST", 2}}}}}},
+                {"foxglove.TriangleListPrimitive", {"foxglove/TriangleListPrimitive.proto", {{"pose", 1, T::MESSAGE, false, "foxglove.Pose", ""}, {"points", 2, T::MESSAGE, true, "foxglove.Point3", ""}, {"color", 3, T::MESSAGE, false, "foxglove.Color", ""}, {"colors", 4, T::MESSAGE, true, "foxglove.Color", ""}, {"indices", 5, T::FIXED32, true, "", ""}}, {}}},
+                {"foxglove.TextPrimitive", {"foxglove/TextPrimitive.proto", {{"pose", 1, T::MESSAGE, false, "foxglove.Pose", ""}, {"billboard", 2, T::BOOL, false, "", ""}, {"font_size", 3, T::DOUBLE, false, "", ""}, {"scale_invariant", 4, T::BOOL, false, "", ""}, {"color", 5, T::MESSAGE, false, "foxglove.Color", ""}, {"text", 6, T::STRING, false, "", ""}}, {}}},
+                {"foxglove.ModelPrimitive", {"foxglove/ModelPrimitive.proto", {{"pose", 1, T::MESSAGE, false, "foxglove.Pose", ""}, {"scale", 2, T::MESSAGE, false, "foxglove.Vector3", ""}, {"color", 3, T::MESSAGE, false, "foxglove.Color", ""}, {"override_color", 4, T::BOOL, false, "", ""}, {"url", 5, T::STRING, false, "", ""}, {"media_type", 6, T::STRING, false, "", ""}, {"data", 7, T::BYTES, false, "", ""}}, {}}},
+                {"foxglove.SceneEntity", {"foxglove/SceneEntity.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"frame_id", 2, T::STRING, false, "", ""}, {"id", 3, T::STRING, false, "", ""}, {"lifetime", 4, T::MESSAGE, false, "google.protobuf.Duration", ""}, {"frame_locked", 5, T::BOOL, false, "", ""}, {"metadata", 6, T::MESSAGE, true, "foxglove.KeyValuePair", ""}, {"arrows", 7, T::MESSAGE, true, "foxglove.ArrowPrimitive", ""}, {"cubes", 8, T::MESSAGE, true, "foxglove.CubePrimitive", ""}, {"spheres", 9, T::MESSAGE, true, "foxglove.SpherePrimitive", ""}, {"cylinders", 10, T::MESSAGE, true, "foxglove.CylinderPrimitive", ""}, {"lines", 11, T::MESSAGE, true, "foxglove.LinePrimitive", ""}, {"triangles", 12, T::MESSAGE, true, "foxglove.TriangleListPrimitive", ""}, {"texts", 13, T::MESSAGE, true, "foxglove.TextPrimitive", ""}, {"models", 14, T::MESSAGE, true, "foxglove.ModelPrimitive", ""}}, {}}},
+                {"foxglove.SceneEntityDeletion", {"foxglove/SceneEntityDeletion.proto", {{"timestamp", 1, T::MESSAGE, false, "google.protobuf.Timestamp", ""}, {"type", 2, T::ENUM, false, "foxglove.SceneEntityDeletion.Type", ""}, {"id", 3, T::STRING, false, "", ""}}, {{"Type", {{"MATCHING_ID", 0}, {"ALL", 1}}}}}},
+                {"foxglove.SceneUpdate", {"foxglove/SceneUpdate.proto", {{"deletions", 1, T::MESSAGE, true, "foxglove.SceneEntityDeletion", ""}, {"entities", 2, T::MESSAGE, true, "foxglove.SceneEntity", ""}}, {}}},
+            };
+            return definitions;
+        }
+
+        MessageDefinition const *find_message_definition(std::string const &message_name)
+        {
+            auto &definitions = get_message_definitions();
+            auto it = definitions.find(message_name);
+            if (it == definitions.end())
+                return nullptr;
+            return &it->second;
+        }
+
+        std::string const &get_json_key(FieldDefinition const &field)
+        {
+            return field.json_key.size() ? field.json_key : field.name;
+        }
+
+        bool is_time_message(std::string const &message_name)
+        {
+            return message_name == "google.protobuf.Timestamp" || message_name == "google.protobuf.Duration";
+        }
+
+        //
+        // Descriptor set
+        //
+        void write_message_descriptor(ProtobufWriter &writer, std::string const &message_name, MessageDefinition const &definition)
+        {
+            // DescriptorProto: name = 1, field = 2, enum_type = 4
+            writer.write_string_field(1, message_name.substr(message_name.rfind('.') + 1));
+            for (auto &field : definition.fields)
+            {
+                // FieldDescriptorProto: name = 1, number = 3, label = 4, type = 5, type_name = 6, json_name = 10
+                size_t field_position = writer.begin_nested_field(2);
+                writer.write_string_field(1, field.name);
+                writer.write_varint_field(3, field.number);
+                writer.write_varint_field(4, field.repeated ? 3 : 1); // LABEL_REPEATED or LABEL_OPTIONAL
+                writer.write_varint_field(5, uint64_t(field.type));
+                if (field.type_name.size())
+                    writer.write_string_field(6, "." + field.type_name);
+                writer.write_string_field(10, field.name);
+                writer.end_nested_field(field_position);
+            }
+            for (auto &enum_definition : definition.enums)
+            {
+                // EnumDescriptorProto: name = 1, value = 2 (EnumValueDescriptorProto: name = 1, number = 2)
+                size_t enum_position = writer.begin_nested_field(4);
+                writer.write_string_field(1, enum_definition.name);
+                for (auto &value : enum_definition.values)
+                {
+                    size_t value_position = writer.begin_nested_field(2);
+                    writer.write_string_field(1, value.first);
+                    writer.write_varint_field(2, uint64_t(int64_t(value.second)));
+                    writer.end_nested_field(value_position);
+                }
+                writer.end_nested_field(enum_position);
+            }
+        }
+
+        void write_file_descriptors(ProtobufWriter &writer, std::string const &message_name, std::set<std::string> &written_messages)
+        {
+            if (written_messages.count(message_name))
+                return;
+            written_messages.insert(message_name);
+            MessageDefinition const &definition = *find_message_definition(message_name);
+            // Dependencies are written first:
+            std::vector<std::string> dependencies;
+            for (auto &field : definition.fields)
+            {
+                if (field.type != FieldType::MESSAGE)
+                    continue;
+                write_file_descriptors(writer, field.type_name, written_messages);
+                std::string const &dependency = find_message_definition(field.type_name)->file_name;
+                if (std::find(dependencies.begin(), dependencies.end(), dependency) == dependencies.end())
+                    dependencies.push_back(dependency);
+            }
+            // FileDescriptorSet: file = 1
+            // FileDescriptorProto: name = 1, package = 2, dependency = 3, message_type = 4, syntax = 12
+            size_t file_position = writer.begin_nested_field(1);
+            writer.write_string_field(1, definition.file_name);
+            writer.write_string_field(2, message_name.substr(0, message_name.rfind('.')));
+            for (auto &dependency : dependencies)
+                writer.write_string_field(3, dependency);
+            size_t message_position = writer.begin_nested_field(4);
+            write_message_descriptor(writer, message_name, definition);
+            writer.end_nested_field(message_position);
+            writer.write_string_field(12, "proto3");
+            writer.end_nested_field(file_position);
+        }
+
+        //
+        // JSON -> protobuf
+        //
+        void write_message(ProtobufWriter &writer, std::string const &message_name, nlohmann::json const &sample);
+
+        void write_value(ProtobufWriter &writer, FieldDefinition const &field, nlohmann::json const &value)
+        {
+            switch (field.type)
+            {
+            case FieldType::DOUBLE:
+                if (value.is_number())
+                    writer.write_double_field(field.number, value.get<double>());
+                break;
+            case FieldType::FIXED32:
+                if (value.is_number())
+                    writer.write_fixed32_field(field.number, value.get<uint32_t>());
+                break;
+            case FieldType::INT64:
+            case FieldType::INT32:
+            case FieldType::ENUM:
+                if (value.is_number())
+                    writer.write_varint_field(field.number, uint64_t(value.get<int64_t>())); // Negative values are sign extended
+                break;
+            case FieldType::UINT32:
+                if (value.is_number())
+                    writer.write_varint_field(field.number, value.get<uint32_t>());
+                break;
+            case FieldType::BOOL:
+                if (value.is_boolean())
+                    writer.write_varint_field(field.number, value.get<bool>());
+                break;
+            case FieldType::STRING:
+            case FieldType::BYTES:
+                if (value.is_string())
+                    writer.write_string_field(field.number, value.get_ref<std::string const &>());
+                break;
+            case FieldType::MESSAGE:
+                if (value.is_object() || (value.is_number() && is_time_message(field.type_name)))
+                {
+                    size_t position = writer.begin_nested_field(field.number);
+                    write_message(writer, field.type_name, value);
+                    writer.end_nested_field(position);
+                }
+                break;
+            }
+        }
+
+        void write_message(ProtobufWriter &writer, std::string const &message_name, nlohmann::json const &sample)
+        {
+            // Wrapper sometimes give durations as a number of nanoseconds:
+            if (sample.is_number() && is_time_message(message_name))
+            {
+                int64_t time = sample.get<int64_t>();
+                writer.write_varint_field(1, uint64_t(time / (int64_t)1e9));
+                writer.write_varint_field(2, uint64_t(time % (int64_t)1e9));
+                return;
+            }
+            MessageDefinition const &definition = *find_message_definition(message_name);
+            for (auto &field : definition.fields)
+            {
+                auto it = sample.find(get_json_key(field));
+                if (it == sample.end() || it->is_null())
+                    continue;
+                if (!field.repeated)
+                {
+                    write_value(writer, field, *it);
+                    continue;
+                }
+                if (!it->is_array() || it->empty())
+                    continue;
+                // Repeated scalars are packed (proto3 default):
+                if (field.type == FieldType::DOUBLE || field.type == FieldType::FIXED32)
+                {
+                    size_t position = writer.begin_nested_field(field.number);
+                    for (auto &value : *it)
+                    {
+                        if (!value.is_number())
+                            continue;
+                        if (field.type == FieldType::DOUBLE)
+                            writer.write_raw_double(value.get<double>());
+                        else
+                            writer.write_raw_fixed32(value.get<uint32_t>());
+                    }
+                    writer.end_nested_field(position);
+                }
+                else
+                {
+                    for (auto &value : *it)
+                        write_value(writer, field, value);
+                }
+            }
+        }
+
+        //
+        // Protobuf -> JSON
+        //
+        bool read_message(std::string const &message_name, uint8_t const *data, size_t size, nlohmann::json &out);
+
+        bool read_scalar(ProtobufReader &reader, FieldDefinition const &field, ProtobufWireType wire_type, nlohmann::json &out)
+        {
+            uint64_t value64;
+            uint32_t value32;
+            switch (field.type)
+            {
+            case FieldType::DOUBLE:
+            {
+                if (wire_type != ProtobufWireType::FIXED64 || !reader.read_fixed64(value64))
+                    return false;
+                double value;
+                std::memcpy(&value, &value64, sizeof(double));
+                out = value;
+                return true;
+            }
+            case FieldType::FIXED32:
+                if (wire_type != ProtobufWireType::FIXED32 || !reader.read_fixed32(value32))
+                    return false;
+                out = value32;
+                return true;
+            case FieldType::INT64:
+                if (wire_type != ProtobufWireType::VARINT || !reader.read_varint(value64))
+                    return false;
+                out = int64_t(value64);
+                return true;
+            case FieldType::INT32:
+            case FieldType::ENUM:
+                if (wire_type != ProtobufWireType::VARINT || !reader.read_varint(value64))
+                    return false;
+                out = int32_t(value64);
+                return true;
+            case FieldType::UINT32:
+                if (wire_type != ProtobufWireType::VARINT || !reader.read_varint(value64))
+                    return false;
+                out = uint32_t(value64);
+                return true;
+            case FieldType::BOOL:
+                if (wire_type != ProtobufWireType::VARINT || !reader.read_varint(value64))
+                    return false;
+                out = value64 != 0;
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        bool read_field(ProtobufReader &reader, FieldDefinition const &field, ProtobufWireType wire_type, nlohmann::json &out)
+        {
+            nlohmann::json &destination = out[get_json_key(field)];
+            // Length delimited values:
+            if (field.type == FieldType::STRING || field.type == FieldType::BYTES || field.type == FieldType::MESSAGE ||
+                (field.repeated && wire_type == ProtobufWireType::LENGTH_DELIMITED))
+            {
+                uint8_t const *data;
+                size_t size;
+                if (wire_type != ProtobufWireType::LENGTH_DELIMITED || !reader.read_length_delimited(data, size))
+                    return false;
+                nlohmann::json value;
+                if (field.type == FieldType::STRING)
+                    value = std::string(reinterpret_cast<char const *>(data), size);
+                else if (field.type == FieldType::BYTES)
+                    value = base64::encode_into<std::string>(data, data + size);
+                else if (field.type == FieldType::MESSAGE)
+                {
+                    if (!read_message(field.type_name, data, size, value))
+                        return false;
+                }
+                else
+                {
+                    // Packed repeated scalars:
+                    ProtobufReader packed_reader(data, size);
+                    ProtobufWireType element_wire_type = field.type == FieldType::DOUBLE    ? ProtobufWireType::FIXED64
+                                                         : field.type == FieldType::FIXED32 ? ProtobufWireType::FIXED32
+                                                                                            : ProtobufWireType::VARINT;
+                    while (!packed_reader.is_at_end())
+                    {
+                        nlohmann::json element;
+                        if (!read_scalar(packed_reader, field, element_wire_type, element))
+                            return false;
+                        destination.push_back(std::move(element));
+                    }
+                    return true;
+                }
+                if (field.repeated)
+                    destination.push_back(std::move(value));
+                else
+                    destination = std::move(value);
+                return true;
+            }
+            nlohmann::json value;
+            if (!read_scalar(reader, field, wire_type, value))
+                return false;
+            if (field.repeated)
+                destination.push_back(std::move(value));
+            else
+                destination = std::move(value);
+            return true;
+        }
+
+        bool read_message(std::string const &message_name, uint8_t const *data, size_t size, nlohmann::json &out)
+        {
+            MessageDefinition const *definition = find_message_definition(message_name);
+            if (!definition)
+                return false;
+            // Absent fields have their default value:
+            out = nlohmann::json::object();
+            for (auto &field : definition->fields)
+            {
+                if (field.repeated)
+                    out[get_json_key(field)] = nlohmann::json::array();
+                else if (field.type == FieldType::STRING || field.type == FieldType::BYTES)
+                    out[get_json_key(field)] = "";
+                else if (field.type == FieldType::BOOL)
+                    out[get_json_key(field)] = false;
+                else if (field.type != FieldType::MESSAGE)
+                    out[get_json_key(field)] = 0;
+            }
+            ProtobufReader reader(data, size);
+            uint32_t field_number;
+            ProtobufWireType wire_type;
+            while (reader.next_field(field_number, wire_type))
+            {
+                auto field = std::find_if(definition->fields.begin(), definition->fields.end(), [field_number](FieldDefinition const &f)
+                                          { return f.number == field_number; });
+                bool success = field == definition->fields.end() ? reader.skip(wire_type) : read_field(reader, *field, wire_type, out);
+                if (!success)
+                    return false;
+            }
+            return reader.is_at_end();
+        }
+    };
+
+    std::string const &get_foxglove_protobuf_schema(std::string const &message_name)
+    {
+        static std::map<std::string, std::string> schemas; // Descriptor sets are built once
+        static std::mutex schemas_mtx;
+        std::lock_guard<std::mutex> lg(schemas_mtx);
+        auto it = schemas.find(message_name);
+        if (it != schemas.end())
+            return it->second;
+        std::string &schema = schemas[message_name];
+        if (find_message_definition(message_name))
+        {
+            ProtobufWriter writer(schema);
+            std::set<std::string> written_messages;
+            write_file_descriptors(writer, message_name, written_messages);
+        }
+        return schema;
+    }
+
+    bool foxglove_json_to_protobuf(std::string const &message_name, nlohmann::json const &sample, std::string &out)
+    {
+        if (!find_message_definition(message_name))
+            return false;
+        ProtobufWriter writer(out);
+        write_message(writer, message_name, sample);
+        return true;
+    }
+
+    bool foxglove_protobuf_to_json(std::string const &message_name, uint8_t const *data, size_t size, nlohmann::json &out)
+    {
+        return read_message(message_name, data, size, out);
+    }
+};
@@ -38,7 +38,7 @@ std::string compressed_image_schema = R"({
   }
 })";
 
-std::string get_compressed_image_schema()
+std::string const &get_compressed_image_schema()
 {
     return compressed_image_schema;
 }
@@ -115,7 +115,7 @@ std::string log_schema = R"({
   }
 })";
 
-std::string get_log_schema()
+std::string const &get_log_schema()
 {
     return log_schema;
 }
@@ -1191,7 +1191,7 @@ std::string scene_update_schema = R"({
   }
 })";
 
-std::string get_scene_update_schema()
+std::string const &get_scene_update_schema()
 {
     return scene_update_schema;
 }
@@ -1270,7 +1270,7 @@ std::string frame_transform_schema = R"({
     }
   }
 })";
-std::string get_frame_transform_schema()
+std::string const &get_frame_transform_schema()
 {
     return frame_transform_schema;
 }
@@ -1351,7 +1351,7 @@ std::string camera_calibration_schema = R"({
       }
     }
   })";
-std::string get_camera_calibration_schema()
+std::string const &get_camera_calibration_schema()
 {
     return camera_calibration_schema;
 }
@@ -1437,7 +1437,7 @@ std::string poses_in_frame_schema = R"({  "title": "foxglove.PosesInFrame",
   }
 })";
 
-std::string get_poses_in_frame_schema()
+std::string const &get_poses_in_frame_schema()
 {
     return poses_in_frame_schema;
 }
@@ -1796,6 +1796,63 @@ std::string image_annotation_schema = R"({
   }
 })";
 
-std::string get_image_annotation_schema(){
+std::string const &get_image_annotation_schema(){
   return image_annotation_schema;
-}
\ No newline at end of file
+}
+std::string raw_image_schema = R"({
+  "title": "foxglove.RawImage",
+  "description": "A raw image",
+  "$comment": "Generated by https://github.com/foxglove/schemas",
+  "type": "object",
+  "properties": {
+    "timestamp": {
+      "type": "object",
+      "title": "time",
+      "properties": {
+        "sec": {
+          "type": "integer",
+          "minimum": 0
+        },
+        "nsec": {
+          "type": "integer",
+          "minimum": 0,
+          "maximum": 999999999
+        }
+      },
+      "description": "Timestamp of image"
+    },
+    "frame_id": {
+      "type": "string",
+      "description": "Frame of reference for the image. The origin of the frame is the optical center of the camera. +x points to the right in the image, +y points down, and +z points into the plane of the image."
+    },
+    "width": {
+      "type": "integer",
+      "minimum": 0,
+      "description": "Image width"
+    },
+    "height": {
+      "type": "integer",
+      "minimum": 0,
+      "description": "Image height"
+    },
+    "encoding": {
+      "type": "string",
+      "description": "Encoding of the raw image data\n\nSupported values: `8UC1`, `8UC3`, `16UC1`, `32FC1`, `bayer_bggr8`, `bayer_gbrg8`, `bayer_grbg8`, `bayer_rggb8`, `bgr8`, `bgra8`, `mono8`, `mono16`, `rgb8`, `rgba8`, `uyvy` or `yuv422`, `yuyv` or `yuv422_yuy2`"
+    },
+    "step": {
+      "type": "integer",
+      "minimum": 0,
+      "description": "Byte length of a single row"
+    },
+    "data": {
+      "type": "string",
+      "contentEncoding": "base64",
+      "description": "Raw image data"
+    }
+  }
+})";
+
+std::string const &get_raw_image_schema()
+{
+  return raw_image_schema;
+}
@@ -0,0 +1,345 @@
+#include "internal/FoxgloveSerializer.h"
+#include "internal/JsonWriter.h"
+#include "internal/ProtobufSerializer.h"
+#include <Eigen/Geometry>
+
+namespace mcap_wrapper
+{
+    namespace
+    {
+        //
+        // JSON helpers
+        //
+        void write_json_vector3(JsonWriter &writer, double x, double y, double z)
+        {
+            writer.begin_object();
+            writer.write_key("x");
+            writer.write_value(x);
+            writer.write_key("y");
+            writer.write_value(y);
+            writer.write_key("z");
+            writer.write_value(z);
+            writer.end_object();
+        }
+
+        void write_json_quaternion(JsonWriter &writer, Eigen::Quaternionf const &quaternion)
+        {
+            writer.begin_object();
+            writer.write_key("x");
+            writer.write_value(quaternion.x());
+            writer.write_key("y");
+            writer.write_value(quaternion.y());
+            writer.write_key("z");
+            writer.write_value(quaternion.z());
+            writer.write_key("w");
+            writer.write_value(quaternion.w());
+            writer.end_object();
+        }
+
+        void write_json_point2(JsonWriter &writer, std::array<int, 2> const &point)
+        {
+            writer.begin_object();
+            writer.write_key("x");
+            writer.write_value(point[0]);
+            writer.write_key("y");
+            writer.write_value(point[1]);
+            writer.end_object();
+        }
+
+        void write_json_color(JsonWriter &writer, std::array<double, 4> const &color)
+        {
+            writer.begin_object();
+            writer.write_key("r");
+            writer.write_value(color[0]);
+            writer.write_key("g");
+            writer.write_value(color[1]);
+            writer.write_key("b");
+            writer.write_value(color[2]);
+            writer.write_key("a");
+            writer.write_value(color[3]);
+            writer.end_object();
+        }
+
+        template <size_t N>
+        void write_json_array(JsonWriter &writer, std::array<double, N> const &values)
+        {
+            writer.begin_array();
+            for (double value : values)
+                writer.write_value(value);
+            writer.end_array();
+        }
+
+        //
+        // Protobuf helpers
+        //
+        void write_protobuf_vector3(ProtobufWriter &writer, uint32_t field_number, double x, double y, double z)
+        {
+            size_t position = writer.begin_nested_field(field_number);
+            writer.write_double_field(1, x);
+            writer.write_double_field(2, y);
+            writer.write_double_field(3, z);
+            writer.end_nested_field(position);
+        }
+
+        void write_protobuf_quaternion(ProtobufWriter &writer, uint32_t field_number, Eigen::Quaternionf const &quaternion)
+        {
+            size_t position = writer.begin_nested_field(field_number);
+            writer.write_double_field(1, quaternion.x());
+            writer.write_double_field(2, quaternion.y());
+            writer.write_double_field(3, quaternion.z());
+            writer.write_double_field(4, quaternion.w());
+            writer.end_nested_field(position);
+        }
+
+        void write_protobuf_point2(ProtobufWriter &writer, uint32_t field_number, std::array<int, 2> const &point)
+        {
+            size_t position = writer.begin_nested_field(field_number);
+            writer.write_double_field(1, point[0]);
+            writer.write_double_field(2, point[1]);
+            writer.end_nested_field(position);
+        }
+
+        void write_protobuf_color(ProtobufWriter &writer, uint32_t field_number, std::array<double, 4> const &color)
+        {
+            size_t position = writer.begin_nested_field(field_number);
+            writer.write_double_field(1, color[0]);
+            writer.write_double_field(2, color[1]);
+            writer.write_double_field(3, color[2]);
+            writer.write_double_field(4, color[3]);
+            writer.end_nested_field(position);
+        }
+
+        template <size_t N>
+        void write_protobuf_packed_doubles(ProtobufWriter &writer, uint32_t field_number, std::array<double, N> const &values)
+        {
+            writer.write_tag(field_number, ProtobufWireType::LENGTH_DELIMITED);
+            writer.write_varint(N * sizeof(double));
+            for (double value : values)
+                writer.write_raw_double(value);
+        }
+    };
+
+    void serialize_log(MessageEncoding encoding, std::string &out, uint64_t timestamp, int level, std::string const &message, std::string const &name, std::string const &file, uint32_t line)
+    {
+        if (encoding == MessageEncoding::PROTOBUF)
+        {
+            ProtobufWriter writer(out);
+            writer.write_timestamp_field(1, timestamp);
+            writer.write_varint_field(2, level);
+            writer.write_string_field(3, message);
+            writer.write_string_field(4, name);
+            writer.write_string_field(5, file);
+            writer.write_fixed32_field(6, line);
+            return;
+        }
+        JsonWriter writer(out);
+        writer.begin_object();
+        writer.write_key("timestamp");
+        writer.write_timestamp(timestamp);
+        writer.write_key("level");
+        writer.write_value(level);
+        writer.write_key("message");
+        writer.write_value(message);
+        writer.write_key("name");
+        writer.write_value(name);
+        writer.write_key("file");
+        writer.write_value(file);
+        writer.write_key("line");
+        writer.write_value(line);
+        writer.end_object();
+    }
+
+    void serialize_camera_calibration(MessageEncoding encoding, std::string &out, uint64_t timestamp, std::string const &frame_id, unsigned width, unsigned height,
+                                      std::string const &distortion_model, std::array<double, 5> const &D, std::array<double, 9> const &K,
+                                      std::array<double, 9> const &R, std::array<double, 12> const &P)
+    {
+        if (encoding == MessageEncoding::PROTOBUF)
+        {
+            ProtobufWriter writer(out);
+            writer.write_timestamp_field(1, timestamp);
+            writer.write_string_field(9, frame_id);
+            writer.write_fixed32_field(2, width);
+            writer.write_fixed32_field(3, height);
+            writer.write_string_field(4, distortion_model);
+            write_protobuf_packed_doubles(writer, 5, D);
+            write_protobuf_packed_doubles(writer, 6, K);
+            write_protobuf_packed_doubles(writer, 7, R);
+            write_protobuf_packed_doubles(writer, 8, P);
+            return;
+        }
+        JsonWriter writer(out);
+        writer.begin_object();
+        writer.write_key("timestamp");
+        writer.write_timestamp(timestamp);
+        writer.write_key("frame_id");
+        writer.write_value(frame_id);
+        writer.write_key("width");
+        writer.write_value(width);
+        writer.write_key("height");
+        writer.write_value(height);
+        writer.write_key("distortion_model");
+        writer.write_value(distortion_model);
+        writer.write_key("D");
+        write_json_array(writer, D);
+        writer.write_key("K");
+        write_json_array(writer, K);
+        writer.write_key("R");
+        write_json_array(writer, R);
+        writer.write_key("P");
+        write_json_array(writer, P);
+        writer.end_object();
+    }
+
+    void serialize_frame_transform(MessageEncoding encoding, std::string &out, uint64_t timestamp, std::string const &parent, std::string const &child, Eigen::Matrix4f const &pose)
+    {
+        Eigen::Quaternionf rotation(pose.block<3, 3>(0, 0));
+        if (encoding == MessageEncoding::PROTOBUF)
+        {
+            ProtobufWriter writer(out);
+            writer.write_timestamp_field(1, timestamp);
+            if (parent.size() > 1)
+                writer.write_string_field(2, parent);
+            if (child.size() > 1)
+                writer.write_string_field(3, child);
+            write_protobuf_vector3(writer, 4, pose(0, 3), pose(1, 3), pose(2, 3));
+            write_protobuf_quaternion(writer, 5, rotation);
+            return;
+        }
+        JsonWriter writer(out);
+        writer.begin_object();
+        writer.write_key("timestamp");
+        writer.write_timestamp(timestamp);
+        if (parent.size() > 1)
+        {
+            writer.write_key("parent_frame_id");
+            writer.write_value(parent);
+        }
+        if (child.size() > 1)
+        {
+            writer.write_key("child_frame_id");
+            writer.write_value(child);
+        }
+        writer.write_key("translation");
+        write_json_vector3(writer, pose(0, 3), pose(1, 3), pose(2, 3));
+        writer.write_key("rotation");
+        write_json_quaternion(writer, rotation);
+        writer.end_object();
+    }
+
+    void serialize_image_annotations(MessageEncoding encoding, std::string &out, std::vector<CircleAnnotation> const &circle_annotations,
+                                     std::vector<PointsAnnotation> const &points_annotations, std::vector<TextAnnotation> const &text_annotations)
+    {
+        if (encoding == MessageEncoding::PROTOBUF)
+        {
+            ProtobufWriter writer(out);
+            for (auto const &circle : circle_annotations)
+            {
+                size_t position = writer.begin_nested_field(1);
+                writer.write_timestamp_field(1, circle.timestamp);
+                write_protobuf_point2(writer, 2, circle.position);
+                writer.write_double_field(3, circle.diameter);
+                writer.write_double_field(4, circle.thickness);
+                write_protobuf_color(writer, 5, circle.fill_color);
+                write_protobuf_color(writer, 6, circle.outline_color);
+                writer.end_nested_field(position);
+            }
+            for (auto const &points : points_annotations)
+            {
+                size_t position = writer.begin_nested_field(2);
+                writer.write_timestamp_field(1, points.timestamp);
+                writer.write_varint_field(2, (int)points.type);
+                for (auto const &point : points.points)
+                    write_protobuf_point2(writer, 3, point);
+                write_protobuf_color(writer, 4, points.outline_color);
+                for (auto const &outline_color : points.outline_colors)
+                    write_protobuf_color(writer, 5, outline_color);
+                write_protobuf_color(writer, 6, points.fill_color);
+                writer.write_double_field(7, points.thickness);
+                writer.end_nested_field(position);
+            }
+            for (auto const &text : text_annotations)
+            {
+                size_t position = writer.begin_nested_field(3);
+                writer.write_timestamp_field(1, text.timestamp);
+                write_protobuf_point2(writer, 2, text.position);
+                writer.write_string_field(3, text.text);
+                writer.write_double_field(4, text.font_size);
+                write_protobuf_color(writer, 5, text.text_color);
+                write_protobuf_color(writer, 6, text.background_color);
+                writer.end_nested_field(position);
+            }
+            return;
+        }
+        JsonWriter writer(out);
+        writer.begin_object();
+        writer.write_key("circles");
+        writer.begin_array();
+        for (auto const &circle : circle_annotations)
+        {
+            writer.begin_object();
+            writer.write_key("timestamp");
+            writer.write_timestamp(circle.timestamp);
+            writer.write_key("position");
+            write_json_point2(writer, circle.position);
+            writer.write_key("diameter");
+            writer.write_value(circle.diameter);
+            writer.write_key("thickness");
+            writer.write_value(circle.thickness);
+            writer.write_key("fill_color");
+            write_json_color(writer, circle.fill_color);
+            writer.write_key("outline_color");
+            write_json_color(writer, circle.outline_color);
+            writer.end_object();
+        }
+        writer.end_array();
+        writer.write_key("points");
+        writer.begin_array();
+        for (auto const &points : points_annotations)
+        {
+            writer.begin_object();
+            writer.write_key("timestamp");
+            writer.write_timestamp(points.timestamp);
+            writer.write_key("type");
+            writer.write_value((int)points.type);
+            writer.write_key("points");
+            writer.begin_array();
+            for (auto const &point : points.points)
+                write_json_point2(writer, point);
+            writer.end_array();
+            writer.write_key("outline_color");
+            write_json_color(writer, points.outline_color);
+            writer.write_key("outline_colors");
+            writer.begin_array();
+            for (auto const &outline_color : points.outline_colors)
+                write_json_color(writer, outline_color);
+            writer.end_array();
+            writer.write_key("fill_color");
+            write_json_color(writer, points.fill_color);
+            writer.write_key("thickness");
+            writer.write_value(points.thickness);
+            writer.end_object();
+        }
+        writer.end_array();
+        writer.write_key("texts");
+        writer.begin_array();
+        for (auto const &text : text_annotations)
+        {
+            writer.begin_object();
+            writer.write_key("timestamp");
+            writer.write_timestamp(text.timestamp);
+            writer.write_key("position");
+            write_json_point2(writer, text.position);
+            writer.write_key("text");
+            writer.write_value(text.text);
+            writer.write_key("font_size");
+            writer.write_value(text.font_size);
+            writer.write_key("text_color");
+            write_json_color(writer, text.text_color);
+            writer.write_key("background_color");
+            write_json_color(writer, text.background_color);
+            writer.end_object();
+        }
+        writer.end_array();
+        writer.end_object();
+    }
+};
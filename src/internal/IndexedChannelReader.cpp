@@ -0,0 +1,106 @@
+#include "internal/IndexedChannelReader.h"
+#include <iostream>
+#include <algorithm>
+#include "mcap/internal.hpp"
+
+namespace mcap_wrapper
+{
+    IndexedChannelReader::IndexedChannelReader(mcap::McapReader &file_reader, mcap::ChannelId channel_id, ZstdDecompressionDictionaries const &dictionaries)
+        : _file_reader(file_reader), _channel_id(channel_id), _dictionaries(dictionaries)
+    {
+        for (mcap::ChunkIndex const &chunk_index : _file_reader.chunkIndexes())
+            if (chunk_index.messageIndexOffsets.count(channel_id))
+                _chunk_indexes.push_back(&chunk_index);
+        // Chunk indexes are sorted by start time, chunks are read in the order they were written:
+        std::sort(_chunk_indexes.begin(), _chunk_indexes.end(), [](mcap::ChunkIndex const *a, mcap::ChunkIndex const *b)
+                  { return a->chunkStartOffset < b->chunkStartOffset; });
+        next();
+    }
+
+    mcap::Message const *IndexedChannelReader::get_message() const
+    {
+        return _has_message ? &_message : nullptr;
+    }
+
+    void IndexedChannelReader::next()
+    {
+        _has_message = false;
+        while (!_has_message)
+        {
+            if (_next_message >= _message_index.records.size())
+            {
+                if (_next_chunk >= _chunk_indexes.size())
+                    return; // No more message on this channel
+                _message_index.records.clear();
+                _next_message = 0;
+                if (!read_chunk(*_chunk_indexes[_next_chunk++]))
+                    std::cerr << "[MCAPWrapper] ERROR: could not read chunk of channel " << _channel_id << ", its messages are skipped" << std::endl;
+                continue;
+            }
+            _has_message = read_message();
+            if (!_has_message)
+                std::cerr << "[MCAPWrapper] ERROR: message of channel " << _channel_id << " is corrupted, it is skipped" << std::endl;
+            _next_message++;
+        }
+    }
+
+    //
+    // Protected methods
+    //
+    bool IndexedChannelReader::read_chunk(mcap::ChunkIndex const &chunk_index)
+    {
+        mcap::IReadable &data_source = *_file_reader.dataSource();
+        // Records read point into the buffer of the data source, they are used before the next read:
+        mcap::Record record;
+        mcap::Chunk chunk;
+        if (!mcap::McapReader::ReadRecord(data_source, chunk_index.chunkStartOffset, &record).ok() || record.opcode != mcap::OpCode::Chunk ||
+            !mcap::McapReader::ParseChunk(record, &chunk).ok())
+            return false;
+        if (chunk.compression.empty())
+            _chunk_records.assign(chunk.records, chunk.records + chunk.compressedSize);
+        else if (chunk.compression == "zstd" || chunk.compression == ZSTD_DICTIONARY_COMPRESSION)
+        {
+            if (!decompress_zstd_chunk(chunk.records, chunk.compressedSize, chunk.uncompressedSize, _dictionaries, _chunk_records))
+                return false;
+        }
+#ifndef MCAP_COMPRESSION_NO_LZ4
+        else if (chunk.compression == "lz4")
+        {
+            mcap::LZ4Reader lz4_reader;
+            if (!lz4_reader.decompressAll(chunk.records, chunk.compressedSize, chunk.uncompressedSize, &_chunk_records).ok())
+                return false;
+        }
+#endif
+        else
+        {
+            std::cerr << "[MCAPWrapper] ERROR: chunk compression " << chunk.compression << " is not supported" << std::endl;
+            return false;
+        }
+
+        mcap::MessageIndex message_index;
+        if (!mcap::McapReader::ReadRecord(data_source, chunk_index.messageIndexOffsets.at(_channel_id), &record).ok() ||
+            record.opcode != mcap::OpCode::MessageIndex || !mcap::McapReader::ParseMessageIndex(record, &message_index).ok())
+            return false;
+        // Other writers may index messages by log time, they are read in the order they are in the chunk
+        std::sort(message_index.records.begin(), message_index.records.end(), [](auto const &a, auto const &b)
+                  { return a.second < b.second; });
+        _message_index = std::move(message_index);
+        return true;
+    }
+
+    bool IndexedChannelReader::read_message()
+    {
+        // Record is its opcode, its length and its data:
+        constexpr uint64_t RECORD_PREAMBLE_SIZE = 1 + 8;
+        uint64_t offset = _message_index.records[_next_message].second;
+        if (offset > _chunk_records.size() || _chunk_records.size() - offset < RECORD_PREAMBLE_SIZE)
+            return false;
+        mcap::Record record;
+        record.opcode = mcap::OpCode(_chunk_records[offset]);
+        record.dataSize = mcap::internal::ParseUint64(_chunk_records.data() + offset + 1);
+        record.data = _chunk_records.data() + offset + RECORD_PREAMBLE_SIZE;
+        if (record.opcode != mcap::OpCode::Message || record.dataSize > _chunk_records.size() - offset - RECORD_PREAMBLE_SIZE)
+            return false;
+        return mcap::McapReader::ParseMessage(record, &_message).ok() && _message.channelId == _channel_id;
+    }
+};
@@ -7,7 +7,7 @@ Internal3DObject::Internal3DObject(){
 
 }
 
-Internal3DObject::Internal3DObject(std::string object_name, std::string frame_id, bool frame_locked)
+Internal3DObject::Internal3DObject(std::string const &object_name, std::string const &frame_id, bool frame_locked)
 {
     // Copy object name
     _object_name = object_name;
@@ -38,7 +38,7 @@ void Internal3DObject::set_timestamp(uint64_t timestamp)
     _object_definition["timestamp"]["nsec"] = (uint64_t)timestamp % (uint64_t)1e9;
 }
 
-bool Internal3DObject::add_metadata(std::pair<std::string, std::string> metadata)
+bool Internal3DObject::add_metadata(std::pair<std::string, std::string> const &metadata)
 {
     nlohmann::json metadata_obj;
     metadata_obj["key"] = metadata.first;
@@ -47,7 +47,7 @@ bool Internal3DObject::add_metadata(std::pair<std::string, std::string> metadata
     return true;
 }
 
-bool Internal3DObject::add_arrow(Eigen::Matrix4f pose, double shaft_length, double shaft_diameter, double head_length, double head_diameter, std::array<double, 4> color)
+bool Internal3DObject::add_arrow(Eigen::Matrix4f const &pose, double shaft_length, double shaft_diameter, double head_length, double head_diameter, std::array<double, 4> const &color)
 {
     nlohmann::json arrow;
     arrow["pose"] = pose_serializer(pose);
@@ -55,12 +55,12 @@ bool Internal3DObject::add_arrow(Eigen::Matrix4f pose, double shaft_length, doub
     arrow["shaft_diameter"] = shaft_diameter;
     arrow["head_length"] = head_length;
     arrow["head_diameter"] = head_diameter;
-    arrow["color"] = color;
+    arrow["color"] = color_serializer(color);
     _object_definition["arrows"].push_back(arrow);
     return true;
 }
 
-bool Internal3DObject::add_cube(Eigen::Matrix4f pose, std::array<double, 3> size, std::array<double, 4> color)
+bool Internal3DObject::add_cube(Eigen::Matrix4f const &pose, std::array<double, 3> const &size, std::array<double, 4> const &color)
 {
     nlohmann::json cube;
     cube["pose"] = pose_serializer(pose);
@@ -70,7 +70,7 @@ bool Internal3DObject::add_cube(Eigen::Matrix4f pose, std::array<double, 3> size
     return true;
 }
 
-bool Internal3DObject::add_sphere(Eigen::Matrix4f pose, std::array<double, 3> size, std::array<double, 4> color)
+bool Internal3DObject::add_sphere(Eigen::Matrix4f const &pose, std::array<double, 3> const &size, std::array<double, 4> const &color)
 {
     nlohmann::json sphere;
     sphere["pose"] = pose_serializer(pose);
@@ -80,7 +80,7 @@ bool Internal3DObject::add_sphere(Eigen::Matrix4f pose, std::array<double, 3> si
     return true;
 }
 
-bool Internal3DObject::add_cylinder(Eigen::Matrix4f pose, double bottom_scale, double top_scale, std::array<double, 3> size, std::array<double, 4> color)
+bool Internal3DObject::add_cylinder(Eigen::Matrix4f const &pose, double bottom_scale, double top_scale, std::array<double, 3> const &size, std::array<double, 4> const &color)
 {
     nlohmann::json cylinder;
     cylinder["pose"] = pose_serializer(pose);
@@ -92,7 +92,7 @@ bool Internal3DObject::add_cylinder(Eigen::Matrix4f pose, double bottom_scale, d
     return true;
 }
 
-bool Internal3DObject::add_line(Eigen::Matrix4f pose, double thickness, bool scale_invariant, std::vector<Eigen::Vector3d> points, std::array<double, 4> color, std::vector<std::array<double, 4>> colors, std::vector<uint32_t> indices)
+bool Internal3DObject::add_line(Eigen::Matrix4f const &pose, double thickness, bool scale_invariant, std::vector<Eigen::Vector3d> const &points, std::array<double, 4> const &color, std::vector<std::array<double, 4>> const &colors, std::vector<uint32_t> const &indices)
 {
     nlohmann::json line;
     line["pose"] = pose_serializer(pose);
@@ -112,7 +112,7 @@ bool Internal3DObject::add_line(Eigen::Matrix4f pose, double thickness, bool sca
     return true;
 }
 
-bool Internal3DObject::add_triangle(Eigen::Matrix4f pose, std::vector<Eigen::Vector3d> points, std::array<double, 4> color, std::vector<std::array<double, 4>> colors, std::vector<uint32_t> indices)
+bool Internal3DObject::add_triangle(Eigen::Matrix4f const &pose, std::vector<Eigen::Vector3d> const &points, std::array<double, 4> const &color, std::vector<std::array<double, 4>> const &colors, std::vector<uint32_t> const &indices)
 {
     nlohmann::json triangle;
     triangle["pose"] = pose_serializer(pose);
@@ -130,7 +130,7 @@ bool Internal3DObject::add_triangle(Eigen::Matrix4f pose, std::vector<Eigen::Vec
     return true;
 }
 
-bool Internal3DObject::add_text(Eigen::Matrix4f pose, bool billboard, double font_size, bool scale_invariant, std::array<double, 4> color, std::string text_value)
+bool Internal3DObject::add_text(Eigen::Matrix4f const &pose, bool billboard, double font_size, bool scale_invariant, std::array<double, 4> const &color, std::string const &text_value)
 {
     nlohmann::json text;
     text["pose"] = pose_serializer(pose);
@@ -152,7 +152,7 @@ std::string Internal3DObject::get_id(){
     return std::to_string(object_ids[_object_name]);
 }
 
-nlohmann::json Internal3DObject::pose_serializer(Eigen::Matrix4f pose)
+nlohmann::json Internal3DObject::pose_serializer(Eigen::Matrix4f const &pose)
 {
     nlohmann::json out;
     out["position"] = nlohmann::json();
@@ -168,7 +168,7 @@ nlohmann::json Internal3DObject::pose_serializer(Eigen::Matrix4f pose)
     return out;
 }
 
-nlohmann::json Internal3DObject::vector3_serializer(std::array<double, 3> vector3)
+nlohmann::json Internal3DObject::vector3_serializer(std::array<double, 3> const &vector3)
 {
     nlohmann::json out;
     out["x"] = vector3[0];
@@ -177,7 +177,7 @@ nlohmann::json Internal3DObject::vector3_serializer(std::array<double, 3> vector
     return out;
 }
 
-nlohmann::json Internal3DObject::vector3_serializer(Eigen::Vector3d vector3)
+nlohmann::json Internal3DObject::vector3_serializer(Eigen::Vector3d const &vector3)
 {
     nlohmann::json out;
     out["x"] = vector3[0];
@@ -186,7 +186,7 @@ nlohmann::json Internal3DObject::vector3_serializer(Eigen::Vector3d vector3)
     return out;
 }
 
-nlohmann::json Internal3DObject::color_serializer(std::array<double, 4> color)
+nlohmann::json Internal3DObject::color_serializer(std::array<double, 4> const &color)
 {
     nlohmann::json out;
     out["r"] = color[0];
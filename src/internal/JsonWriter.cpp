@@ -0,0 +1,152 @@
+#include "internal/JsonWriter.h"
+#include <charconv>
+#include <cmath>
+
+namespace mcap_wrapper
+{
+    JsonWriter::JsonWriter(std::string &buffer) : _buffer(buffer)
+    {
+    }
+
+    void JsonWriter::begin_object()
+    {
+        write_separator();
+        _buffer.push_back('{');
+        _needs_comma = false;
+    }
+
+    void JsonWriter::end_object()
+    {
+        _buffer.push_back('}');
+        _needs_comma = true;
+    }
+
+    void JsonWriter::begin_array()
+    {
+        write_separator();
+        _buffer.push_back('[');
+        _needs_comma = false;
+    }
+
+    void JsonWriter::end_array()
+    {
+        _buffer.push_back(']');
+        _needs_comma = true;
+    }
+
+    void JsonWriter::write_key(char const *key)
+    {
+        write_separator();
+        _buffer.push_back('"');
+        _buffer += key;
+        _buffer += "\":";
+        _needs_comma = false;
+    }
+
+    void JsonWriter::write_value(double value)
+    {
+        write_separator();
+        _needs_comma = true;
+        if (!std::isfinite(value))
+        {
+            _buffer += "null";
+            return;
+        }
+        // Shortest representation that reads back the same double:
+        char characters[32];
+        char *end = std::to_chars(characters, characters + sizeof(characters), value).ptr;
+        _buffer.append(characters, end);
+        // Keep it a floating point number for JSON parsers:
+        for (char *character = characters; character < end; character++)
+            if (*character == '.' || *character == 'e')
+                return;
+        _buffer += ".0";
+    }
+
+    void JsonWriter::write_value(int64_t value)
+    {
+        write_separator();
+        _needs_comma = true;
+        char characters[24];
+        _buffer.append(characters, std::to_chars(characters, characters + sizeof(characters), value).ptr);
+    }
+
+    void JsonWriter::write_value(uint64_t value)
+    {
+        write_separator();
+        _needs_comma = true;
+        char characters[24];
+        _buffer.append(characters, std::to_chars(characters, characters + sizeof(characters), value).ptr);
+    }
+
+    void JsonWriter::write_value(int value)
+    {
+        write_value(int64_t(value));
+    }
+
+    void JsonWriter::write_value(unsigned value)
+    {
+        write_value(uint64_t(value));
+    }
+
+    void JsonWriter::write_value(std::string const &value)
+    {
+        static char const hexadecimal_digits[] = "0123456789abcdef";
+        write_separator();
+        _needs_comma = true;
+        _buffer.push_back('"');
+        for (unsigned char character : value)
+        {
+            switch (character)
+            {
+            case '"':
+                _buffer += "\\\"";
+                break;
+            case '\\':
+                _buffer += "\\\\";
+                break;
+            case '\n':
+                _buffer += "\\n";
+                break;
+            case '\r':
+                _buffer += "\\r";
+                break;
+            case '\t':
+                _buffer += "\\t";
+                break;
+            case '\b':
+                _buffer += "\\b";
+                break;
+            case '\f':
+                _buffer += "\\f";
+                break;
+            default:
+                if (character < 0x20)
+                {
+                    _buffer += "\\u00";
+                    _buffer.push_back(hexadecimal_digits[character >> 4]);
+                    _buffer.push_back(hexadecimal_digits[character & 0xF]);
+                }
+                else
+                    _buffer.push_back(char(character));
+            }
+        }
+        _buffer.push_back('"');
+    }
+
+    void JsonWriter::write_timestamp(uint64_t timestamp)
+    {
+        begin_object();
+        write_key("sec");
+        write_value(timestamp / (uint64_t)1e9);
+        write_key("nsec");
+        write_value(timestamp % (uint64_t)1e9);
+        end_object();
+    }
+
+    void JsonWriter::write_separator()
+    {
+        if (_needs_comma)
+            _buffer.push_back(',');
+    }
+};
@@ -0,0 +1,63 @@
+#include "internal/LatencyHistogram.h"
+
+namespace mcap_wrapper
+{
+    LatencyHistogram::LatencyHistogram()
+    {
+        for (auto &bucket : _buckets)
+            bucket = 0;
+        _count = 0;
+    }
+
+    void LatencyHistogram::record(uint64_t latency_ns)
+    {
+        _buckets[get_bucket_index(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t LatencyHistogram::get_count() const
+    {
+        return _count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LatencyHistogram::get_percentile(double percentile) const
+    {
+        uint64_t count = get_count();
+        if (count == 0)
+            return 0;
+        uint64_t rank = (uint64_t)(percentile / 100.0 * count);
+        if (rank >= count)
+            rank = count - 1;
+        uint64_t cumulated_count = 0;
+        for (unsigned i = 0; i < NUMBER_OF_BUCKETS; i++)
+        {
+            cumulated_count += _buckets[i].load(std::memory_order_relaxed);
+            if (cumulated_count > rank)
+                return get_bucket_upper_bound(i);
+        }
+        return get_bucket_upper_bound(NUMBER_OF_BUCKETS - 1);
+    }
+
+    //
+    // Protected methods
+    //
+    unsigned LatencyHistogram::get_bucket_index(uint64_t latency_ns)
+    {
+        // Small values have their own bucket
+        if (latency_ns < 16)
+            return latency_ns;
+        // Other are split by power of two then in 8 sub buckets
+        unsigned most_significant_bit = 63 - __builtin_clzll(latency_ns);
+        unsigned sub_bucket = (latency_ns >> (most_significant_bit - 3)) & 7;
+        return 16 + (most_significant_bit - 4) * 8 + sub_bucket;
+    }
+
+    uint64_t LatencyHistogram::get_bucket_upper_bound(unsigned bucket_index)
+    {
+        if (bucket_index < 16)
+            return bucket_index;
+        unsigned most_significant_bit = (bucket_index - 16) / 8 + 4;
+        uint64_t sub_bucket = (bucket_index - 16) % 8;
+        return ((8 + sub_bucket + 1) << (most_significant_bit - 3)) - 1;
+    }
+};
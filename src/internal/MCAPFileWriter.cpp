@@ -1,8 +1,10 @@
 #include "internal/MCAPFileWriter.h"
+#include "internal/FoxgloveProtobufSchema.hpp"
+#include <cstdio>
 
 namespace mcap_wrapper
 {
-    MCAPFileWriter::MCAPFileWriter()
+    MCAPFileWriter::MCAPFileWriter(unsigned queue_capacity) : _data_queue(queue_capacity)
     {
         _continue_writing = false;
     }
@@ -17,10 +19,18 @@ namespace mcap_wrapper
         if (_continue_writing)
         {
             _continue_writing = false;
-            _write_notifier.notify_all();
+            // Reject new data, writing thread stops once waiting data are written
+            _data_queue.close();
             _writing_thread->join();
-            _file_writer.close();
+            {
+                std::lock_guard<std::mutex> file_writer_lg(_file_writer_mtx);
+                _file_writer.close();
+                // Connection may still be referenced by registry copies of other threads, only an empty shell is kept alive
+                _file.reset();
+            }
             delete _writing_thread;
+            _data_queue.clear();
+            complete_all_write_futures();
         }
         return true;
     }
@@ -30,20 +40,30 @@ namespace mcap_wrapper
         return _continue_writing;
     }
 
-    bool MCAPFileWriter::open(std::string file_name)
+    bool MCAPFileWriter::open(std::string file_name, FileConnectionOptions const &options)
     {
         // Close file if it already open
         if (is_open())
             close();
 
         // Create file (erase previous one if it existed)
-        mcap::McapWriterOptions options("");
-        mcap::Status open_status = _file_writer.open(file_name, options);
+        if (options.write_method == FileWriteMethod::IO_URING)
+            _file = std::make_unique<UringFileWritable>(options.io_buffer_size, options.io_buffer_count, options.direct_io, options.preallocation_size, options.write_behind_size);
+        else
+            _file = std::make_unique<FileWritable>(options.preallocation_size, options.write_behind_size);
+        mcap::Status open_status = _file->open(file_name);
         if (open_status.code == mcap::StatusCode::Success)
         {
+            if (!_file_writer.open(*_file, options))
+            {
+                _file->end();
+                std::remove(file_name.c_str());
+                return false;
+            }
             // Create writing thread:
-            _writing_thread = new std::thread(&MCAPFileWriter::run, this);
             _continue_writing = true;
+            _data_queue.open();
+            _writing_thread = new std::thread(&MCAPFileWriter::run, this);
             return true;
         }
         else
@@ -52,39 +72,33 @@ namespace mcap_wrapper
     }
 
 
-    void MCAPFileWriter::push_sample(std::string channel_name, nlohmann::json sample, uint64_t timestamp)
+    void MCAPFileWriter::push_payload(ChannelRoute const &route, Payload const &payload, uint64_t timestamp, uint64_t enqueue_time)
     {
-        if (!is_schema_present(channel_name))
-            infer_schema(channel_name, sample);
-        
-        // If we are in sync mode we wait that current write was proceed
-        if(is_write_sync){
-            std::lock_guard lg(write_is_being_process);
-        }
-
-        mcap::Message msg;
-        msg.channelId = _all_channels[channel_name].id;
+        MessageToWrite message_to_write;
+        mcap::Message &msg = message_to_write.message;
+        msg.channelId = route.channel_id;
         // Since we do not know when data is emitted we set `publishTime` equal to `logTime`
         msg.logTime = timestamp;
         msg.publishTime = timestamp;
         msg.sequence = 0; // Not pertinent here
-        std::string serialized_sample = sample.dump();
-        std::byte *data_bytes = new std::byte[serialized_sample.size()];
-        memcpy(data_bytes, reinterpret_cast<const std::byte *>(serialized_sample.data()), serialized_sample.size());
-        msg.data = data_bytes;
-        msg.dataSize = serialized_sample.size();
-        // Push the sample into write queue
-        std::lock_guard<std::mutex> data_queue_lg(_data_queue_mtx);
-        _data_queue.push(msg);
-        // Notify writing thread that some work need to be perform:
-        _write_notifier.notify_all();
-
-        // If we are in sync mode we wait that data was wrote
-        if(is_write_sync){
-            std::mutex mtx;
-            std::unique_lock ul(mtx);
-            write_finished_adviser.wait_for(ul, std::chrono::seconds(1)); // 1 second of timeout to avoid blocking
-        }
+        // Payload is shared with other connections, it is not copied:
+        msg.data = reinterpret_cast<const std::byte *>(payload->data());
+        msg.dataSize = payload->size();
+        message_to_write.payload = payload;
+        message_to_write.enqueue_time = enqueue_time;
+        // Push the sample into write queue, backpressure policy is applied if it is full
+        _data_queue.push(std::move(message_to_write), *route.queue_state);
+    }
+
+    ConnectionQueueControl &MCAPFileWriter::get_queue()
+    {
+        return _data_queue;
+    }
+
+    bool MCAPFileWriter::flush()
+    {
+        IWriter::flush();
+        return flush_file(_fsync_policy != FsyncPolicy::NEVER);
     }
 
     //
@@ -92,53 +106,55 @@ namespace mcap_wrapper
     //
     void MCAPFileWriter::run()
     {
-        while (1)
+        // Sleep until data are pushed, stop once file is closed and every data written
+        std::vector<MessageToWrite> data_to_write;
+        while (_data_queue.wait_and_pop_all(data_to_write, _batching_window_us))
         {
-            std::mutex sleep_until_new_data_mtx;
-            std::unique_lock<std::mutex> sleep_until_new_data_ul(sleep_until_new_data_mtx);
-            _write_notifier.wait_for(sleep_until_new_data_ul, std::chrono::milliseconds(16));
-
-            // Encode waiting images:
-            encode_waiting_images();
-            prepare_camera_calibration_messages();
-            prepare_raw_message();
-            prepare_log();
-            
-            // Check ending condition
-            if (!_continue_writing && _data_queue.size() == 0) // Check that no data are being waiting to be writted
-                break;
-
-            // Take mutex of write is process for inform every sync source that data are currently write:
-            std::lock_guard write_is_process(write_is_being_process);
-            
-            // Protect `_data_queue` and copy it data
-            std::queue<mcap::Message> data_to_write;
-            {
-                std::lock_guard<std::mutex> data_queue_lg(_data_queue_mtx);
-                std::swap(_data_queue, data_to_write);
-            }
-
+            WriteTicket last_popped_ticket = _data_queue.get_last_popped_ticket();
             // Write data:
-            while (data_to_write.size())
+            for (auto &message_to_write : data_to_write)
             {
-                // Pop data
-                mcap::Message data = data_to_write.front();
-                data_to_write.pop();
                 // Write it to file
-                std::lock_guard<std::mutex> file_writer_lg(_file_writer_mtx);
-                mcap::Status write_status = _file_writer.write(data);
-                if (write_status.code != mcap::StatusCode::Success)
-                    std::cerr << "Error occur in MCAP message writing. Message: " << write_status.message << std::endl;
-                // Delete previous allocated data:
-                delete data.data;
+                {
+                    std::lock_guard<std::mutex> file_writer_lg(_file_writer_mtx);
+                    mcap::Status write_status = _file_writer.write(message_to_write.message);
+                    if (write_status.code != mcap::StatusCode::Success)
+                        std::cerr << "Error occur in MCAP message writing. Message: " << write_status.message << std::endl;
+                }
+                _write_latency.record(get_steady_time_ns() - message_to_write.enqueue_time);
             }
 
-            // Notify all sync that data were wrote
-            write_finished_adviser.notify_all();
+            if (_fsync_policy == FsyncPolicy::ON_EVERY_WRITE)
+                sync_written_data();
+
+            // Complete futures of written messages
+            notify_messages_written(last_popped_ticket);
+            // Release payloads if no other connection use them
+            data_to_write.clear();
         }
     }
 
-    void MCAPFileWriter::create_schema(std::string channel_name, nlohmann::json schema)
+    bool MCAPFileWriter::flush_file(bool sync_to_disk)
+    {
+        std::lock_guard<std::mutex> file_writer_lg(_file_writer_mtx);
+        if (!_continue_writing)
+            return false;
+        // Messages of the chunk in progress are only in memory:
+        _file_writer.closeLastChunk();
+        return sync_to_disk ? _file->sync() : _file->flush();
+    }
+
+    bool MCAPFileWriter::sync_written_data()
+    {
+        std::lock_guard<std::mutex> file_writer_lg(_file_writer_mtx);
+        if (!_continue_writing)
+            return false;
+        // Closing the chunk in progress at each batch would write tiny chunks and wait for every chunk being compressed
+        std::unique_lock<std::mutex> output_lock = _file_writer.lock_output();
+        return _file->sync();
+    }
+
+    void MCAPFileWriter::create_schema(std::string const &channel_name, nlohmann::json const &schema, std::string const &message_encoding)
     {
         std::lock_guard<std::mutex> file_writer_lg(_file_writer_mtx);
         
@@ -148,9 +164,24 @@ namespace mcap_wrapper
             schema_title = schema["title"];
         mcap::Schema schema_obj(schema_title, "jsonschema", schema.dump());
         _file_writer.addSchema(schema_obj);
-        mcap::Channel channel_obj(channel_name, "json", schema_obj.id);
+        mcap::Channel channel_obj(channel_name, message_encoding, schema_obj.id);
+        _file_writer.addChannel(channel_obj);
+        // Add it to existing schema:
+        std::lock_guard<std::mutex> all_channels_lg(_all_channels_mtx);
+        _all_channels[channel_name] = channel_obj;
+    }
+
+    void MCAPFileWriter::create_protobuf_schema(std::string const &channel_name, std::string const &message_name)
+    {
+        std::lock_guard<std::mutex> file_writer_lg(_file_writer_mtx);
+
+        // Schema is the descriptor set of the message:
+        mcap::Schema schema_obj(message_name, "protobuf", get_foxglove_protobuf_schema(message_name));
+        _file_writer.addSchema(schema_obj);
+        mcap::Channel channel_obj(channel_name, "protobuf", schema_obj.id);
         _file_writer.addChannel(channel_obj);
         // Add it to existing schema:
+        std::lock_guard<std::mutex> all_channels_lg(_all_channels_mtx);
         _all_channels[channel_name] = channel_obj;
     }
    
@@ -27,17 +27,25 @@ namespace mcap_wrapper
             if (read_summary_status.code == mcap::StatusCode::Success)
             {
                 std::unordered_map<mcap::ChannelId, mcap::ChannelPtr> all_channels = _file_reader.channels();
+                // Messages are read in file order. With message indexes each channel only reads chunks holding its messages, decompressed
+                // in buffers of its own reader with zstd dictionaries of the file. Otherwise every chunk is read.
+                std::vector<mcap::ChunkIndex> const &chunk_indexes = _file_reader.chunkIndexes();
+                bool has_message_indexes = chunk_indexes.size() && chunk_indexes[0].messageIndexLength;
+                if (has_message_indexes)
+                    load_zstd_dictionaries();
                 for (auto [channel_id, channel_ptr] : all_channels)
                 {
                     // Determine type of channel:
                     std::string channel_name = channel_ptr->topic; // Channel name
                     mcap::SchemaId channel_shema_id = channel_ptr->schemaId;
                     mcap::SchemaPtr corresponding_schema = _file_reader.schema(channel_shema_id);
-                    std::string schema_name = corresponding_schema->name;
+                    std::string schema_name = corresponding_schema ? corresponding_schema->name : ""; // Schema is optional for CBOR channels
                     // Parse type from schema name
                     MCAPReaderChannelType corresponding_type = MCAPReaderChannelType::RAW_JSON;
                     if (schema_name == "foxglove.CompressedImage")
                         corresponding_type = MCAPReaderChannelType::IMAGE;
+                    else if (schema_name == "foxglove.RawImage")
+                        corresponding_type = MCAPReaderChannelType::RAW_IMAGE;
                     else if (schema_name == "foxglove.Log")
                         corresponding_type = MCAPReaderChannelType::LOG;
                     else if (schema_name == "foxglove.SceneUpdate")
@@ -46,8 +54,15 @@ namespace mcap_wrapper
                         corresponding_type = MCAPReaderChannelType::TRANSFORM;
                     // Add it to type:
                     _channels_description[channel_name] = corresponding_type;
+                    _channels_message_encoding[channel_name] = channel_ptr->messageEncoding;
+                    _channels_schema_name[channel_name] = schema_name;
 
                     // Get iterator
+                    if (has_message_indexes)
+                    {
+                        _channel_readers[channel_name] = std::make_shared<IndexedChannelReader>(_file_reader, channel_id, _zstd_dictionaries);
+                        continue;
+                    }
                     mcap::ReadMessageOptions read_channel_options;
                     read_channel_options.topicFilter = [=](std::string_view read_channel_name)
                     {
@@ -86,40 +101,76 @@ namespace mcap_wrapper
             return false; // File is not open
         if (!_channels_description.count(channel_name))
             return false; // Channel not present in file
-        if (*_channel_iterator[channel_name] == _channel_message_view[channel_name]->end())
+        if (!get_current_message(channel_name))
             return false; // No more message on this channel
+        // Binary messages (protobuf, CBOR) are given as JSON text:
+        if (_channels_message_encoding[channel_name] != "json")
+        {
+            nlohmann::json parsed_message;
+            if (!read_next_json(channel_name, parsed_message))
+                return false;
+            out_message = parsed_message.dump();
+            return true;
+        }
         // Read message:
-        out_message = std::string(reinterpret_cast<const char *>((*_channel_iterator[channel_name])->message.data),
-                                  (*_channel_iterator[channel_name])->message.dataSize);
+        mcap::Message const &message = *get_current_message(channel_name);
+        out_message = std::string(reinterpret_cast<const char *>(message.data), message.dataSize);
 
         // Increment iterators:
-        (*_channel_iterator[channel_name])++;
+        move_to_next_message(channel_name);
         return true;
     }
 
+    bool MCAPReaderImpl::get_next_message(std::string channel_name, nlohmann::json &out_message)
+    {
+        if (!_is_file_open)
+            return false; // File is not open
+        if (!_channels_description.count(channel_name))
+            return false; // Channel not present in file
+        if (!get_current_message(channel_name))
+            return false; // No more message on this channel
+        return read_next_json(channel_name, out_message);
+    }
+
     bool MCAPReaderImpl::get_next_image(std::string channel_name, cv::Mat &out_image)
     {
         if (!_is_file_open)
             return false; // File is not open
         if (!_channels_description.count(channel_name))
             return false; // Channel not present in file
-        if (_channels_description[channel_name] != MCAPReaderChannelType::IMAGE)
+        if (_channels_description[channel_name] != MCAPReaderChannelType::IMAGE && _channels_description[channel_name] != MCAPReaderChannelType::RAW_IMAGE)
             return false; // Channel is not image type
-        if (*_channel_iterator[channel_name] == _channel_message_view[channel_name]->end())
+        if (!get_current_message(channel_name))
             return false; // No more message on this channel
+        if (_channels_description[channel_name] == MCAPReaderChannelType::RAW_IMAGE)
+            return read_next_raw_image(channel_name, out_image);
+        // Protobuf image: encoded image is directly read from message (field `data`)
+        if (_channels_message_encoding[channel_name] == "protobuf")
+        {
+            mcap::Message const &message = *get_current_message(channel_name);
+            ProtobufReader reader(reinterpret_cast<uint8_t const *>(message.data), message.dataSize);
+            uint32_t field_number;
+            ProtobufWireType wire_type;
+            uint8_t const *image_data = nullptr;
+            size_t image_size = 0;
+            bool success = true;
+            while (success && reader.next_field(field_number, wire_type))
+                success = field_number == 2 && wire_type == ProtobufWireType::LENGTH_DELIMITED ? reader.read_length_delimited(image_data, image_size) : reader.skip(wire_type);
+            if (success && image_data)
+                out_image = cv::imdecode(cv::Mat(1, image_size, CV_8UC1, const_cast<uint8_t *>(image_data)), cv::IMREAD_UNCHANGED);
+            // Message is skipped even if it is malformed or has no image, so next call reads the next one
+            move_to_next_message(channel_name);
+            return success && image_data;
+        }
         // Read message:
-        std::string message(reinterpret_cast<const char *>((*_channel_iterator[channel_name])->message.data),
-                                  (*_channel_iterator[channel_name])->message.dataSize);
-        // Parse it:
-        nlohmann::json parsed_message = nlohmann::json::parse(message);
+        nlohmann::json parsed_message;
+        if (!read_next_json(channel_name, parsed_message))
+            return false;
         if(!parsed_message.count("data"))
             return false; // No image present for this data
 
         std::vector<uchar> encoded_buffer = base64::decode_into<std::vector<uchar>>(parsed_message["data"].get<std::string>());
         out_image = cv::imdecode(encoded_buffer, cv::IMREAD_UNCHANGED);
-
-        // Increment iterators:
-        (*_channel_iterator[channel_name])++;
         return true;
     }
 
@@ -131,18 +182,142 @@ namespace mcap_wrapper
             return false; // Channel not present in file
         if (_channels_description[channel_name] != MCAPReaderChannelType::LOG)
             return false; // Channel is not log type
-        if (*_channel_iterator[channel_name] == _channel_message_view[channel_name]->end())
+        if (!get_current_message(channel_name))
             return false; // No more message on this channel
         // Read message:
-        std::string message(reinterpret_cast<const char *>((*_channel_iterator[channel_name])->message.data),
-                                  (*_channel_iterator[channel_name])->message.dataSize);
-        // Parse it:
-        nlohmann::json parsed_message = nlohmann::json::parse(message);
+        nlohmann::json parsed_message;
+        if (!read_next_json(channel_name, parsed_message))
+            return false;
         if(!parsed_message.count("message"))
             return false; // No log message present for this data
         out_log = parsed_message["message"];
+        return true;
+    }
+
+    //
+    // Protected methods
+    //
+    mcap::Message const *MCAPReaderImpl::get_current_message(std::string const &channel_name)
+    {
+        auto channel_reader = _channel_readers.find(channel_name);
+        if (channel_reader != _channel_readers.end())
+            return channel_reader->second->get_message();
+        if (*_channel_iterator[channel_name] == _channel_message_view[channel_name]->end())
+            return nullptr;
+        return &(*_channel_iterator[channel_name])->message;
+    }
+
+    void MCAPReaderImpl::move_to_next_message(std::string const &channel_name)
+    {
+        auto channel_reader = _channel_readers.find(channel_name);
+        if (channel_reader != _channel_readers.end())
+            channel_reader->second->next();
+        else
+            (*_channel_iterator[channel_name])++;
+    }
+
+    void MCAPReaderImpl::load_zstd_dictionaries()
+    {
+        auto [metadata_index, metadata_index_end] = _file_reader.metadataIndexes().equal_range(ZSTD_DICTIONARY_METADATA_NAME);
+        for (; metadata_index != metadata_index_end; metadata_index++)
+        {
+            mcap::Record record;
+            mcap::Metadata metadata;
+            if (!mcap::McapReader::ReadRecord(*_file_reader.dataSource(), metadata_index->second.offset, &record).ok() || record.opcode != mcap::OpCode::Metadata ||
+                !mcap::McapReader::ParseMetadata(record, &metadata).ok() || !add_zstd_dictionary_from_metadata(metadata, _zstd_dictionaries))
+                std::cerr << "Could not read zstd dictionary of file, chunks compressed with it can not be read" << std::endl;
+        }
+    }
+
+    bool MCAPReaderImpl::read_next_raw_image(std::string const &channel_name, cv::Mat &out_image)
+    {
+        if (_channels_message_encoding[channel_name] != "protobuf")
+        {
+            nlohmann::json parsed_message;
+            if (!read_next_json(channel_name, parsed_message) || !parsed_message.count("data"))
+                return false; // No image present for this data
+            std::vector<uchar> image_buffer = base64::decode_into<std::vector<uchar>>(parsed_message["data"].get<std::string>());
+            return build_raw_image(parsed_message.value("width", 0u), parsed_message.value("height", 0u), parsed_message.value("encoding", ""),
+                                   parsed_message.value("step", 0u), image_buffer.data(), image_buffer.size(), out_image);
+        }
+        // Protobuf image: pixels are directly read from message
+        mcap::Message const &message = *get_current_message(channel_name);
+        ProtobufReader reader(reinterpret_cast<uint8_t const *>(message.data), message.dataSize);
+        uint32_t field_number;
+        ProtobufWireType wire_type;
+        uint32_t width = 0, height = 0, step = 0;
+        std::string encoding;
+        uint8_t const *image_data = nullptr;
+        size_t image_size = 0;
+        bool success = true;
+        while (success && reader.next_field(field_number, wire_type))
+        {
+            if (field_number == 2 && wire_type == ProtobufWireType::FIXED32)
+                success = reader.read_fixed32(width);
+            else if (field_number == 3 && wire_type == ProtobufWireType::FIXED32)
+                success = reader.read_fixed32(height);
+            else if (field_number == 5 && wire_type == ProtobufWireType::FIXED32)
+                success = reader.read_fixed32(step);
+            else if (field_number == 4 && wire_type == ProtobufWireType::LENGTH_DELIMITED)
+            {
+                uint8_t const *encoding_data;
+                size_t encoding_size;
+                success = reader.read_length_delimited(encoding_data, encoding_size);
+                if (success)
+                    encoding.assign(reinterpret_cast<char const *>(encoding_data), encoding_size);
+            }
+            else if (field_number == 6 && wire_type == ProtobufWireType::LENGTH_DELIMITED)
+                success = reader.read_length_delimited(image_data, image_size);
+            else
+                success = reader.skip(wire_type);
+        }
+        success = success && build_raw_image(width, height, encoding, step, image_data, image_size, out_image);
         // Increment iterators:
-        (*_channel_iterator[channel_name])++;
+        move_to_next_message(channel_name);
+        return success;
+    }
+
+    bool MCAPReaderImpl::build_raw_image(uint32_t width, uint32_t height, std::string const &encoding, uint32_t step, uint8_t const *data, size_t size, cv::Mat &out_image)
+    {
+        int opencv_type;
+        if (!get_raw_image_opencv_type(encoding, opencv_type))
+        {
+            std::cerr << "Raw image encoding " << encoding << " is not supported" << std::endl;
+            return false;
+        }
+        out_image = cv::Mat(height, width, opencv_type);
+        size_t row_size = width * out_image.elemSize();
+        if (step < row_size || (height && size < (size_t)step * (height - 1) + row_size))
+            return false; // Malformed image
+        // Rows are copied as is, no decoding needed:
+        for (uint32_t row = 0; row < height; row++)
+            std::memcpy(out_image.ptr(row), data + row * step, row_size);
         return true;
     }
+
+    bool MCAPReaderImpl::read_next_json(std::string const &channel_name, nlohmann::json &out_json)
+    {
+        mcap::Message const &message = *get_current_message(channel_name);
+        bool success = true;
+        uint8_t const *data = reinterpret_cast<uint8_t const *>(message.data);
+        if (_channels_message_encoding[channel_name] == "protobuf")
+            success = foxglove_protobuf_to_json(_channels_schema_name[channel_name], data, message.dataSize, out_json);
+        else
+        {
+            try
+            {
+                if (_channels_message_encoding[channel_name] == "cbor")
+                    out_json = nlohmann::json::from_cbor(data, data + message.dataSize);
+                else
+                    out_json = nlohmann::json::parse(data, data + message.dataSize);
+            }
+            catch (std::exception const &e)
+            {
+                success = false;
+            }
+        }
+        // Increment iterators:
+        move_to_next_message(channel_name);
+        return success;
+    }
 };
\ No newline at end of file
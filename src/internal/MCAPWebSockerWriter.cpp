@@ -1,8 +1,9 @@
 #include "internal/MCAPWebSocketWriter.h"
+#include "internal/FoxgloveProtobufSchema.hpp"
 
 namespace mcap_wrapper
 {
-    MCAPWebSocketWriter::MCAPWebSocketWriter()
+    MCAPWebSocketWriter::MCAPWebSocketWriter(unsigned queue_capacity) : _data_queue(queue_capacity)
     {
     }
     MCAPWebSocketWriter::~MCAPWebSocketWriter()
@@ -32,8 +33,9 @@ namespace mcap_wrapper
         _server_writer->start(url, port);
         is_server_open = true;
 
-        _writing_thread = new std::thread(&MCAPWebSocketWriter::run, this);
         _continue_writing = true;
+        _data_queue.open();
+        _writing_thread = new std::thread(&MCAPWebSocketWriter::run, this);
         return true;
 
     }
@@ -45,15 +47,20 @@ namespace mcap_wrapper
     bool MCAPWebSocketWriter::close()
     {
         if(is_server_open){
+            // Send data that are still waiting before stopping the server
+            _continue_writing = false;
+            _data_queue.close();
+            _writing_thread->join();
+            delete _writing_thread;
+            _data_queue.clear();
+            complete_all_write_futures();
+
             std::vector<foxglove::ChannelId> all_ids_presents;
             for(auto id: _all_channels)
                 all_ids_presents.push_back(id.second.id);
             _server_writer->removeChannels(all_ids_presents);
             _server_writer->stop();
             is_server_open = false;
-            _continue_writing = false;
-            _writing_thread->join();
-            delete _writing_thread;
         }
         return true;
     }
@@ -63,7 +70,7 @@ namespace mcap_wrapper
         return is_server_open;
     }
 
-    void MCAPWebSocketWriter::create_schema(std::string channel_name, nlohmann::json schema)
+    void MCAPWebSocketWriter::create_schema(std::string const &channel_name, nlohmann::json const &schema, std::string const &message_encoding)
     {
         std::lock_guard<std::mutex> file_writer_lg(_server_writer_mtx);
         // Create schema and channel:
@@ -73,47 +80,61 @@ namespace mcap_wrapper
 
         foxglove::ChannelWithoutId channel;
         channel.topic = channel_name;
-        channel.encoding = "json";
+        channel.encoding = message_encoding;
         channel.schemaName = schema_title;
         channel.schema = schema.dump();
         std::vector<foxglove::ChannelWithoutId> all_channel_obj;
         all_channel_obj.push_back(channel);
         std::vector<foxglove::ChannelId> channel_ids = _server_writer->addChannels(all_channel_obj);
         // Add it to existing schema:
+        std::lock_guard<std::mutex> all_channels_lg(_all_channels_mtx);
         for(auto id: channel_ids){
             mcap::Channel c;
             c.id = id;
+            c.messageEncoding = channel.encoding;
             _all_channels[channel_name] = c;
         }
     }
 
-    void MCAPWebSocketWriter::push_sample(std::string channel_name, nlohmann::json sample, uint64_t timestamp)
+    void MCAPWebSocketWriter::create_protobuf_schema(std::string const &channel_name, std::string const &message_name)
     {
-        if (!is_schema_present(channel_name))
-            infer_schema(channel_name, sample);
-
-        // If we are in sync mode we wait that current write was proceed
-        if(is_write_sync){
-            std::lock_guard lg(write_is_being_process);
-        }
-    
-        std::pair<foxglove::ChannelId,nlohmann::json> data_sample;
-        data_sample.first = _all_channels[channel_name].id;
-        data_sample.second = sample;
-        // Push the sample into write queue
-        std::lock_guard<std::mutex> data_queue_lg(_data_queue_mtx);
-        _data_queue.push(data_sample);
-        // Notify writing thread that some work need to be perform:
-        _write_notifier.notify_all();
-
-        // If we are in sync mode we wait that data was wrote
-        if(is_write_sync){
-            std::mutex mtx;
-            std::unique_lock ul(mtx);
-            write_finished_adviser.wait_for(ul, std::chrono::seconds(1)); // 1 second of timeout to avoid blocking
+        std::lock_guard<std::mutex> file_writer_lg(_server_writer_mtx);
+        // Binary descriptor set is sent base64 encoded:
+        std::string const &descriptor_set = get_foxglove_protobuf_schema(message_name);
+        foxglove::ChannelWithoutId channel;
+        channel.topic = channel_name;
+        channel.encoding = "protobuf";
+        channel.schemaName = message_name;
+        channel.schema = foxglove::base64Encode(descriptor_set);
+        channel.schemaEncoding = "protobuf";
+        std::vector<foxglove::ChannelWithoutId> all_channel_obj;
+        all_channel_obj.push_back(channel);
+        std::vector<foxglove::ChannelId> channel_ids = _server_writer->addChannels(all_channel_obj);
+        // Add it to existing schema:
+        std::lock_guard<std::mutex> all_channels_lg(_all_channels_mtx);
+        for(auto id: channel_ids){
+            mcap::Channel c;
+            c.id = id;
+            c.messageEncoding = channel.encoding;
+            _all_channels[channel_name] = c;
         }
     }
 
+    void MCAPWebSocketWriter::push_payload(ChannelRoute const &route, Payload const &payload, uint64_t timestamp, uint64_t enqueue_time)
+    {
+        MessageToWrite message_to_write;
+        message_to_write.channel_id = route.channel_id;
+        message_to_write.payload = payload;
+        message_to_write.enqueue_time = enqueue_time;
+        // Push the sample into write queue, backpressure policy is applied if it is full
+        _data_queue.push(std::move(message_to_write), *route.queue_state);
+    }
+
+    ConnectionQueueControl &MCAPWebSocketWriter::get_queue()
+    {
+        return _data_queue;
+    }
+
     // Deffine operator= for std::mutex and std::conditionnal variable
     MCAPWebSocketWriter &MCAPWebSocketWriter::operator=(const MCAPWebSocketWriter &object)
     {
@@ -122,52 +143,28 @@ namespace mcap_wrapper
 
     // Function used to write thing asynchronous
     void MCAPWebSocketWriter::run(){
-        while (1)
+        // Sleep until data are pushed, stop once server is closed and every data sent
+        std::vector<MessageToWrite> data_to_write;
+        while (_data_queue.wait_and_pop_all(data_to_write, _batching_window_us))
         {
-            std::mutex sleep_until_new_data_mtx;
-            std::unique_lock<std::mutex> sleep_until_new_data_ul(sleep_until_new_data_mtx);
-            _write_notifier.wait_for(sleep_until_new_data_ul, std::chrono::milliseconds(16));
-
-            // Encode waiting images:
-            encode_waiting_images();
-            prepare_camera_calibration_messages();
-            prepare_raw_message();
-            prepare_log();
-
-            // Check ending condition
-            if (!_continue_writing && _data_queue.size() == 0) // Check that no data are being waiting to be writted
-                break;
-
-            // Take mutex of write is process for inform every sync source that data are currently write:
-            std::lock_guard write_is_process(write_is_being_process);
-
-            
-
-
-            // Protect `_data_queue` and copy it data
-            std::queue<std::pair<foxglove::ChannelId,nlohmann::json>> data_to_write;
-            {
-                std::lock_guard<std::mutex> data_queue_lg(_data_queue_mtx);
-                std::swap(_data_queue, data_to_write);
-            }
-
+            WriteTicket last_popped_ticket = _data_queue.get_last_popped_ticket();
             // Write data:
-            while (data_to_write.size())
+            for (auto &data : data_to_write)
             {
-                // Pop data
-                std::pair<foxglove::ChannelId,nlohmann::json> data = data_to_write.front();
-                data_to_write.pop();
                 // Write it to remote clients
-                std::lock_guard<std::mutex> server_writer_lg(_server_writer_mtx);
-                auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-                std::string serialized_data = data.second.dump();
-                _server_writer->broadcastMessage(data.first, now, reinterpret_cast<const uint8_t*>(serialized_data.data()),
-                               serialized_data.size());
-                
+                {
+                    std::lock_guard<std::mutex> server_writer_lg(_server_writer_mtx);
+                    auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+                    _server_writer->broadcastMessage(data.channel_id, now, reinterpret_cast<const uint8_t*>(data.payload->data()),
+                                   data.payload->size());
+                }
+                _write_latency.record(get_steady_time_ns() - data.enqueue_time);
             }
 
-            // Notify all sync that data were wrote
-            write_finished_adviser.notify_all();
+            // Complete futures of sent messages
+            notify_messages_written(last_popped_ticket);
+            // Release payloads if no other connection use them
+            data_to_write.clear();
         }
     }
 
@@ -0,0 +1,168 @@
+#include "internal/PayloadPool.h"
+#include <algorithm>
+
+namespace mcap_wrapper
+{
+    namespace
+    {
+        // Payload owning its buffer, gives it back to the pool when released
+        typedef struct PooledPayload
+        {
+            std::string data;
+            ~PooledPayload()
+            {
+                PayloadPool::get_instance().release_buffer(std::move(data));
+            }
+        } PooledPayload;
+
+        // Allocator of payloads and their reference counts, used with `std::allocate_shared`
+        template <typename T>
+        struct PayloadBlockAllocator
+        {
+            typedef T value_type;
+            PayloadBlockAllocator(PayloadPool *pool) : pool(pool) {}
+            template <typename U>
+            PayloadBlockAllocator(PayloadBlockAllocator<U> const &other) : pool(other.pool) {}
+            T *allocate(size_t n) { return static_cast<T *>(pool->allocate_block(n * sizeof(T))); }
+            void deallocate(T *block, size_t n) { pool->deallocate_block(block, n * sizeof(T)); }
+            template <typename U>
+            bool operator==(PayloadBlockAllocator<U> const &other) const { return pool == other.pool; }
+            template <typename U>
+            bool operator!=(PayloadBlockAllocator<U> const &other) const { return pool != other.pool; }
+
+            PayloadPool *pool;
+        };
+    };
+
+    Payload make_payload(std::string &&serialized_data)
+    {
+        return PayloadPool::get_instance().make_payload(std::move(serialized_data));
+    }
+
+    std::string acquire_payload_buffer(size_t expected_size)
+    {
+        return PayloadPool::get_instance().acquire_buffer(expected_size);
+    }
+
+    PayloadPool &PayloadPool::get_instance()
+    {
+        static PayloadPool *pool = new PayloadPool();
+        return *pool;
+    }
+
+    std::string PayloadPool::acquire_buffer(size_t expected_size)
+    {
+        _number_of_acquisitions++;
+        size_t size_class = 0;
+        while (size_class < NUMBER_OF_SIZE_CLASSES && get_size_class_size(size_class) < expected_size)
+            size_class++;
+        if (size_class == NUMBER_OF_SIZE_CLASSES)
+        { // Too big for being pooled:
+            std::string buffer;
+            buffer.reserve(expected_size);
+            return buffer;
+        }
+        {
+            // Unknown sizes may also take a buffer of the next class:
+            std::lock_guard<std::mutex> lg(_buffers_mtx);
+            size_t last_size_class = (expected_size == 0 && size_class + 1 < NUMBER_OF_SIZE_CLASSES) ? size_class + 1 : size_class;
+            for (size_t i = size_class; i <= last_size_class; i++)
+            {
+                if (_buffers[i].empty())
+                    continue;
+                std::string buffer = std::move(_buffers[i].back());
+                _buffers[i].pop_back();
+                _pooled_bytes -= buffer.capacity();
+                _number_of_hits++;
+                return buffer;
+            }
+        }
+        // Capacity is the size of the class so that the buffer comes back to it once released:
+        std::string buffer;
+        buffer.reserve(get_size_class_size(size_class));
+        return buffer;
+    }
+
+    void PayloadPool::release_buffer(std::string &&buffer)
+    {
+        size_t capacity = buffer.capacity();
+        _payload_bytes -= capacity;
+        // Small buffers have no memory to reuse, big ones would keep too much memory
+        if (capacity < SMALLEST_SIZE_CLASS || capacity >= 2 * get_size_class_size(NUMBER_OF_SIZE_CLASSES - 1))
+            return;
+        size_t size_class = get_size_class(capacity);
+        buffer.clear();
+        {
+            std::lock_guard<std::mutex> lg(_buffers_mtx);
+            std::vector<std::string> &buffers = _buffers[size_class];
+            size_t max_number_of_buffers = std::min(MAX_BUFFERS_PER_SIZE_CLASS, MAX_POOLED_BYTES_PER_SIZE_CLASS / get_size_class_size(size_class));
+            if (buffers.size() >= max_number_of_buffers)
+                return;
+            if (buffers.capacity() < max_number_of_buffers)
+                buffers.reserve(max_number_of_buffers);
+            buffers.push_back(std::move(buffer));
+        }
+        update_high_water_mark(_max_pooled_bytes, _pooled_bytes += capacity);
+    }
+
+    Payload PayloadPool::make_payload(std::string &&serialized_data)
+    {
+        std::shared_ptr<PooledPayload> pooled_payload = std::allocate_shared<PooledPayload>(PayloadBlockAllocator<PooledPayload>(this));
+        pooled_payload->data = std::move(serialized_data);
+        update_high_water_mark(_max_payload_bytes, _payload_bytes += pooled_payload->data.capacity());
+        // Payload shares ownership of `pooled_payload` while pointing to its data:
+        return Payload(pooled_payload, &pooled_payload->data);
+    }
+
+    size_t PayloadPool::get_size_class(size_t capacity)
+    {
+        size_t size_class = 0;
+        while (size_class + 1 < NUMBER_OF_SIZE_CLASSES && get_size_class_size(size_class + 1) <= capacity)
+            size_class++;
+        return size_class;
+    }
+
+    size_t PayloadPool::get_size_class_size(size_t size_class)
+    {
+        return SMALLEST_SIZE_CLASS << (2 * size_class);
+    }
+
+    void PayloadPool::update_high_water_mark(std::atomic<size_t> &high_water_mark, size_t value)
+    {
+        size_t current = high_water_mark;
+        while (current < value && !high_water_mark.compare_exchange_weak(current, value))
+            ;
+    }
+
+    void *PayloadPool::allocate_block(size_t size)
+    {
+        if (size > BLOCK_SIZE)
+            return ::operator new(size);
+        {
+            std::lock_guard<std::mutex> lg(_blocks_mtx);
+            if (!_blocks.empty())
+            {
+                void *block = _blocks.back();
+                _blocks.pop_back();
+                return block;
+            }
+        }
+        return ::operator new(BLOCK_SIZE);
+    }
+
+    void PayloadPool::deallocate_block(void *block, size_t size)
+    {
+        if (size <= BLOCK_SIZE)
+        {
+            std::lock_guard<std::mutex> lg(_blocks_mtx);
+            if (_blocks.size() < MAX_NUMBER_OF_BLOCKS)
+            {
+                if (_blocks.capacity() < MAX_NUMBER_OF_BLOCKS)
+                    _blocks.reserve(MAX_NUMBER_OF_BLOCKS);
+                _blocks.push_back(block);
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+};
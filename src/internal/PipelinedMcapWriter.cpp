@@ -0,0 +1,517 @@
+#include "internal/PipelinedMcapWriter.h"
+#include <iostream>
+#include <algorithm>
+#include "mcap/crc32.hpp"
+#include "mcap/internal.hpp"
+
+namespace mcap_wrapper
+{
+    PipelinedMcapWriter::PipelinedMcapWriter()
+    {
+    }
+
+    PipelinedMcapWriter::~PipelinedMcapWriter()
+    {
+        close();
+    }
+
+    bool PipelinedMcapWriter::open(mcap::IWritable &output, FileConnectionOptions const &options)
+    {
+        close();
+        if (options.chunk_size == 0 && options.chunk_groups.size())
+        {
+            std::cerr << "[MCAPWrapper] ERROR: chunk groups require chunks, chunk size can not be 0" << std::endl;
+            return false;
+        }
+        std::vector<ChunkStream> streams(1 + options.chunk_groups.size());
+        if (options.chunk_size == 0 && options.dictionary_training_messages)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: zstd dictionaries require chunks, chunk size can not be 0" << std::endl;
+            return false;
+        }
+        if (!get_chunk_stream(options.compression, options.compression_level, options.chunk_size, options.dictionary_training_messages, streams[0]))
+            return false;
+        for (unsigned i = 0; i < options.chunk_groups.size(); i++)
+        {
+            ChunkGroup const &group = options.chunk_groups[i];
+            if (group.chunk_size == 0)
+            {
+                std::cerr << "[MCAPWrapper] ERROR: chunk size of a chunk group can not be 0" << std::endl;
+                return false;
+            }
+            if (!get_chunk_stream(group.compression, group.compression_level, group.chunk_size, group.dictionary_training_messages, streams[1 + i]))
+                return false;
+        }
+        _streams = std::move(streams);
+        _options = options;
+        _output = &output;
+        _statistics = mcap::Statistics{};
+        _next_chunk_sequence = 0;
+        _next_chunk_to_write = 0;
+
+        // Each thread compresses one chunk while as many are filled or wait to be written:
+        _max_number_of_chunks = 2 * options.compression_threads + 1;
+        _continue_compressing = true;
+        if (options.chunk_size)
+            for (unsigned i = 0; i < options.compression_threads; i++)
+                _compression_threads.emplace_back(&PipelinedMcapWriter::run, this);
+
+        mcap::McapWriterOptions default_options("");
+        mcap::McapWriter::writeMagic(output);
+        mcap::McapWriter::write(output, mcap::Header{default_options.profile, default_options.library});
+        return true;
+    }
+
+    void PipelinedMcapWriter::close()
+    {
+        if (!_output)
+            return;
+        closeLastChunk();
+        {
+            std::lock_guard<std::mutex> lg(_chunks_mtx);
+            _continue_compressing = false;
+        }
+        _chunk_submitted_notifier.notify_all();
+        for (auto &thread : _compression_threads)
+            thread.join();
+        _compression_threads.clear();
+
+        write_summary();
+        _output->end();
+        _output = nullptr;
+
+        _schemas.clear();
+        _channels.clear();
+        _written_schemas.clear();
+        _chunk_indexes.clear();
+        _metadata_indexes.clear();
+        _streams.clear();
+        _channel_streams.clear();
+    }
+
+    void PipelinedMcapWriter::addSchema(mcap::Schema &schema)
+    {
+        schema.id = uint16_t(_schemas.size() + 1);
+        _schemas.push_back(schema);
+    }
+
+    void PipelinedMcapWriter::addChannel(mcap::Channel &channel)
+    {
+        channel.id = uint16_t(_channels.size() + 1);
+        _channels.push_back(channel);
+        // First group matching the channel, or the stream of channels matching no group:
+        std::string schema_name = channel.schemaId && channel.schemaId <= _schemas.size() ? _schemas[channel.schemaId - 1].name : "";
+        unsigned stream_index = 0;
+        for (unsigned i = 0; i < _options.chunk_groups.size() && stream_index == 0; i++)
+        {
+            ChunkGroup const &group = _options.chunk_groups[i];
+            if (std::find(group.channel_names.begin(), group.channel_names.end(), channel.topic) != group.channel_names.end() ||
+                std::find(group.schema_names.begin(), group.schema_names.end(), schema_name) != group.schema_names.end())
+                stream_index = 1 + i;
+        }
+        _channel_streams.push_back(stream_index);
+    }
+
+    mcap::Status PipelinedMcapWriter::write(mcap::Message const &message)
+    {
+        if (!_output)
+            return mcap::StatusCode::NotOpen;
+        if (message.channelId == 0 || message.channelId > _channels.size())
+            return mcap::Status(mcap::StatusCode::InvalidChannelId, "invalid channel id " + std::to_string(message.channelId));
+        unsigned stream_index = _channel_streams[message.channelId - 1];
+        ChunkStream &stream = _streams[stream_index];
+        if (stream.chunk_size && !stream.current_chunk)
+            stream.current_chunk = take_free_chunk(stream_index);
+        mcap::IWritable &output = stream.chunk_size ? *stream.current_chunk->records : *_output;
+
+        // Write out channel, and its schema if the stream does not have it yet, the first time the channel is used:
+        auto &channel_message_counts = _statistics.channelMessageCounts;
+        auto channel_message_count = channel_message_counts.find(message.channelId);
+        if (channel_message_count == channel_message_counts.end())
+        {
+            mcap::Channel const &channel = _channels[message.channelId - 1];
+            if (channel.schemaId != 0 && !stream.written_schemas.count(channel.schemaId))
+            {
+                if (channel.schemaId > _schemas.size())
+                    return mcap::Status(mcap::StatusCode::InvalidSchemaId, "invalid schema id " + std::to_string(channel.schemaId));
+                mcap::McapWriter::write(output, _schemas[channel.schemaId - 1]);
+                stream.written_schemas.insert(channel.schemaId);
+                if (_written_schemas.insert(channel.schemaId).second)
+                    _statistics.schemaCount++;
+            }
+            mcap::McapWriter::write(output, channel);
+            channel_message_count = channel_message_counts.emplace(message.channelId, 0).first;
+            _statistics.channelCount++;
+        }
+
+        uint64_t message_offset = output.size();
+        mcap::McapWriter::write(output, message);
+
+        if (_statistics.messageCount == 0)
+        {
+            _statistics.messageStartTime = message.logTime;
+            _statistics.messageEndTime = message.logTime;
+        }
+        _statistics.messageStartTime = std::min(_statistics.messageStartTime, message.logTime);
+        _statistics.messageEndTime = std::max(_statistics.messageEndTime, message.logTime);
+        _statistics.messageCount++;
+        channel_message_count->second++;
+
+        if (stream.chunk_size)
+        {
+            PendingChunk &chunk = *stream.current_chunk;
+            mcap::MessageIndex &message_index = chunk.message_indexes[message.channelId];
+            message_index.channelId = message.channelId;
+            message_index.records.emplace_back(message.logTime, message_offset);
+            chunk.start_time = std::min(chunk.start_time, message.logTime);
+            chunk.end_time = std::max(chunk.end_time, message.logTime);
+            if (stream.dictionary_training_messages)
+            {
+                // Dictionary is trained on message records as they are in chunks, with their headers, training on data only gives
+                // dictionaries that compress chunks worse than without dictionary
+                uint64_t record_size = chunk.records->size() - message_offset;
+                stream.dictionary_samples.append(reinterpret_cast<const char *>(chunk.records->data() + message_offset), record_size);
+                stream.dictionary_sample_sizes.push_back(record_size);
+                if (stream.dictionary_sample_sizes.size() >= stream.dictionary_training_messages)
+                    train_dictionary(stream);
+            }
+            if (chunk.records->size() >= stream.chunk_size)
+                submit_current_chunk(stream);
+        }
+        return mcap::StatusCode::Success;
+    }
+
+    void PipelinedMcapWriter::closeLastChunk()
+    {
+        if (!_output)
+            return;
+        for (auto &stream : _streams)
+            if (stream.current_chunk && !stream.current_chunk->records->empty())
+                submit_current_chunk(stream);
+        std::unique_lock<std::mutex> ul(_chunks_mtx);
+        _chunk_written_notifier.wait(ul, [this]()
+                                     { return _chunks_in_flight == 0; });
+    }
+
+    std::unique_lock<std::mutex> PipelinedMcapWriter::lock_output()
+    {
+        return std::unique_lock<std::mutex>(_output_write_mtx);
+    }
+
+    //
+    // Protected methods
+    //
+    void PipelinedMcapWriter::run()
+    {
+        while (1)
+        {
+            std::unique_ptr<PendingChunk> chunk;
+            {
+                std::unique_lock<std::mutex> ul(_chunks_mtx);
+                _chunk_submitted_notifier.wait(ul, [this]()
+                                               { return _chunks_to_compress.size() || !_continue_compressing; });
+                if (_chunks_to_compress.empty())
+                    break;
+                chunk = std::move(_chunks_to_compress.front());
+                _chunks_to_compress.pop_front();
+            }
+            compress_chunk(*chunk);
+            finish_chunk(std::move(chunk));
+        }
+    }
+
+    bool PipelinedMcapWriter::get_chunk_stream(FileCompression compression, FileCompressionLevel compression_level, uint64_t chunk_size, unsigned dictionary_training_messages, ChunkStream &out)
+    {
+        if (dictionary_training_messages && compression != FileCompression::ZSTD)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: dictionaries are only available with zstd compression" << std::endl;
+            return false;
+        }
+        switch (compression)
+        {
+        case FileCompression::NONE:
+            out.compression = mcap::Compression::None;
+            break;
+        case FileCompression::LZ4:
+#ifdef MCAP_COMPRESSION_NO_LZ4
+            std::cerr << "[MCAPWrapper] ERROR: LZ4 compression is not available in this build" << std::endl;
+            return false;
+#endif
+            out.compression = mcap::Compression::Lz4;
+            break;
+        case FileCompression::ZSTD:
+#ifdef MCAP_COMPRESSION_NO_ZSTD
+            std::cerr << "[MCAPWrapper] ERROR: zstd compression is not available in this build" << std::endl;
+            return false;
+#endif
+            out.compression = mcap::Compression::Zstd;
+            break;
+        }
+        switch (compression_level)
+        {
+        case FileCompressionLevel::FASTEST:
+            out.compression_level = mcap::CompressionLevel::Fastest;
+            break;
+        case FileCompressionLevel::FAST:
+            out.compression_level = mcap::CompressionLevel::Fast;
+            break;
+        case FileCompressionLevel::DEFAULT:
+            out.compression_level = mcap::CompressionLevel::Default;
+            break;
+        case FileCompressionLevel::SLOW:
+            out.compression_level = mcap::CompressionLevel::Slow;
+            break;
+        case FileCompressionLevel::SLOWEST:
+            out.compression_level = mcap::CompressionLevel::Slowest;
+            break;
+        }
+        out.chunk_size = chunk_size;
+        out.dictionary_training_messages = dictionary_training_messages;
+        return true;
+    }
+
+    void PipelinedMcapWriter::train_dictionary(ChunkStream &stream)
+    {
+        // Zstd advises a dictionary about 100 times smaller than the samples. Bigger dictionaries compress chunks of small messages worse
+        constexpr size_t MIN_DICTIONARY_SIZE = 1024;
+        constexpr size_t MAX_DICTIONARY_SIZE = 4 * 1024;
+
+        std::string dictionary;
+        size_t dictionary_size = std::min(MAX_DICTIONARY_SIZE, std::max(MIN_DICTIONARY_SIZE, stream.dictionary_samples.size() / 100));
+        if (train_zstd_dictionary(stream.dictionary_samples, stream.dictionary_sample_sizes, dictionary_size, dictionary))
+        {
+            stream.dictionary = create_zstd_compression_dictionary(dictionary, stream.compression_level);
+            if (stream.dictionary)
+                stream.dictionary_to_write = std::move(dictionary);
+            else
+                std::cerr << "[MCAPWrapper] ERROR: trained zstd dictionary is invalid" << std::endl;
+        }
+        // Chunks of the stream are compressed without dictionary if training failed
+        stream.dictionary_training_messages = 0;
+        std::string().swap(stream.dictionary_samples);
+        std::vector<size_t>().swap(stream.dictionary_sample_sizes);
+    }
+
+    std::unique_ptr<PipelinedMcapWriter::PendingChunk> PipelinedMcapWriter::take_free_chunk(unsigned stream_index)
+    {
+        ChunkStream &stream = _streams[stream_index];
+        {
+            std::unique_lock<std::mutex> ul(_chunks_mtx);
+            // Bound memory used by chunks waiting for compression
+            _chunk_written_notifier.wait(ul, [this, &stream]()
+                                         { return stream.free_chunks.size() || stream.number_of_chunks < _max_number_of_chunks; });
+            if (stream.free_chunks.size())
+            {
+                std::unique_ptr<PendingChunk> chunk = std::move(stream.free_chunks.back());
+                stream.free_chunks.pop_back();
+                return chunk;
+            }
+            stream.number_of_chunks++;
+        }
+        std::unique_ptr<PendingChunk> chunk = std::make_unique<PendingChunk>();
+        chunk->stream_index = stream_index;
+        switch (stream.compression)
+        {
+#ifndef MCAP_COMPRESSION_NO_LZ4
+        case mcap::Compression::Lz4:
+            chunk->records = std::make_unique<mcap::LZ4Writer>(stream.compression_level, stream.chunk_size);
+            break;
+#endif
+#ifndef MCAP_COMPRESSION_NO_ZSTD
+        case mcap::Compression::Zstd:
+            // Chunks allocated before training of the dictionary use it once it is trained
+            if (stream.dictionary_training_messages || stream.dictionary)
+                chunk->records = std::make_unique<ZstdDictionaryChunkWriter>(stream.compression_level, stream.chunk_size);
+            else
+                chunk->records = std::make_unique<mcap::ZStdWriter>(stream.compression_level, stream.chunk_size);
+            break;
+#endif
+        default:
+            chunk->records = std::make_unique<mcap::BufferWriter>();
+            break;
+        }
+        // Checksum is computed by compression threads, on the whole chunk:
+        chunk->records->crcEnabled = false;
+        return chunk;
+    }
+
+    void PipelinedMcapWriter::submit_current_chunk(ChunkStream &stream)
+    {
+        std::unique_ptr<PendingChunk> &chunk = stream.current_chunk;
+        chunk->sequence = _next_chunk_sequence++;
+        chunk->uses_dictionary = bool(stream.dictionary);
+        if (stream.dictionary)
+        {
+            static_cast<ZstdDictionaryChunkWriter &>(*chunk->records).set_dictionary(stream.dictionary);
+            // Dictionary is written before the first chunk compressed with it
+            chunk->dictionary = std::move(stream.dictionary_to_write);
+            stream.dictionary_to_write.clear();
+        }
+        {
+            std::lock_guard<std::mutex> lg(_chunks_mtx);
+            _chunks_in_flight++;
+            if (_compression_threads.size())
+                _chunks_to_compress.push_back(std::move(chunk));
+        }
+        if (chunk)
+        {
+            // No compression thread, chunk is compressed and written by the writing thread
+            compress_chunk(*chunk);
+            finish_chunk(std::move(chunk));
+        }
+        else
+            _chunk_submitted_notifier.notify_one();
+    }
+
+    void PipelinedMcapWriter::compress_chunk(PendingChunk &chunk)
+    {
+        // Both LZ4 and ZSTD recommend ~1KB as the minimum size for compressed data
+        constexpr uint64_t MIN_COMPRESSION_SIZE = 1024;
+        // Throw away any compression results that save less than 2% of the original size
+        constexpr double MIN_COMPRESSION_RATIO = 1.02;
+
+        mcap::IChunkWriter &records = *chunk.records;
+        chunk.compressed = false;
+        if (_streams[chunk.stream_index].compression != mcap::Compression::None && records.size() >= MIN_COMPRESSION_SIZE)
+        {
+            records.end();
+            chunk.compressed = double(records.size()) / double(records.compressedSize()) >= MIN_COMPRESSION_RATIO;
+        }
+        chunk.crc = 0;
+        if (_options.chunk_crc)
+            chunk.crc = mcap::internal::crc32Final(mcap::internal::crc32Update(mcap::internal::CRC32_INIT, records.data(), records.size()));
+    }
+
+    void PipelinedMcapWriter::finish_chunk(std::unique_ptr<PendingChunk> chunk)
+    {
+        std::vector<std::unique_ptr<PendingChunk>> chunks_to_write;
+        {
+            std::lock_guard<std::mutex> lg(_output_mtx);
+            _compressed_chunks[chunk->sequence] = std::move(chunk);
+            // Another thread is writing, it will write this chunk too if it is next
+            if (_is_writing_chunks)
+                return;
+            _is_writing_chunks = true;
+        }
+        while (1)
+        {
+            {
+                std::lock_guard<std::mutex> lg(_output_mtx);
+                while (_compressed_chunks.size() && _compressed_chunks.begin()->first == _next_chunk_to_write)
+                {
+                    chunks_to_write.push_back(std::move(_compressed_chunks.begin()->second));
+                    _compressed_chunks.erase(_compressed_chunks.begin());
+                    _next_chunk_to_write++;
+                }
+                if (chunks_to_write.empty())
+                {
+                    _is_writing_chunks = false;
+                    break;
+                }
+            }
+            // Write outside of the lock, so compression threads can hand their chunks meanwhile
+            {
+                std::lock_guard<std::mutex> output_write_lg(_output_write_mtx);
+                for (auto &chunk_to_write : chunks_to_write)
+                    write_chunk(*chunk_to_write);
+            }
+            for (auto &chunk_to_write : chunks_to_write)
+            {
+                chunk_to_write->records->clear();
+                chunk_to_write->start_time = mcap::MaxTime;
+                chunk_to_write->end_time = 0;
+                chunk_to_write->dictionary.clear();
+            }
+            {
+                std::lock_guard<std::mutex> lg(_chunks_mtx);
+                _chunks_in_flight -= chunks_to_write.size();
+                for (auto &chunk_to_write : chunks_to_write)
+                    _streams[chunk_to_write->stream_index].free_chunks.push_back(std::move(chunk_to_write));
+            }
+            chunks_to_write.clear();
+            _chunk_written_notifier.notify_all();
+        }
+    }
+
+    void PipelinedMcapWriter::write_chunk(PendingChunk &chunk)
+    {
+        mcap::IWritable &output = *_output;
+        mcap::IChunkWriter &records = *chunk.records;
+        mcap::Compression compression = chunk.compressed ? _streams[chunk.stream_index].compression : mcap::Compression::None;
+        uint64_t compressed_size = chunk.compressed ? records.compressedSize() : records.size();
+        std::string compression_string = mcap::internal::CompressionString(compression);
+        if (chunk.compressed && chunk.uses_dictionary)
+            compression_string = ZSTD_DICTIONARY_COMPRESSION;
+        if (chunk.dictionary.size())
+        {
+            mcap::Metadata metadata = make_zstd_dictionary_metadata(chunk.dictionary);
+            _metadata_indexes.emplace_back(metadata, output.size());
+            mcap::McapWriter::write(output, metadata);
+            _statistics.metadataCount++;
+        }
+
+        mcap::ChunkIndex chunk_index;
+        chunk_index.chunkStartOffset = output.size();
+        mcap::McapWriter::write(output, mcap::Chunk{chunk.start_time, chunk.end_time, records.size(), chunk.crc, compression_string,
+                                                    compressed_size, chunk.compressed ? records.compressedData() : records.data()});
+        chunk_index.chunkLength = output.size() - chunk_index.chunkStartOffset;
+
+        uint64_t message_index_offset = output.size();
+        for (auto &[channel_id, message_index] : chunk.message_indexes)
+        {
+            // Indexes of channels seen in previous chunks are kept, to reuse their allocation
+            if (message_index.records.empty())
+                continue;
+            chunk_index.messageIndexOffsets.emplace(channel_id, output.size());
+            mcap::McapWriter::write(output, message_index);
+            message_index.records.clear();
+        }
+        chunk_index.messageIndexLength = output.size() - message_index_offset;
+        chunk_index.messageStartTime = chunk.start_time;
+        chunk_index.messageEndTime = chunk.end_time;
+        chunk_index.compression = compression_string;
+        chunk_index.compressedSize = compressed_size;
+        chunk_index.uncompressedSize = records.size();
+        _chunk_indexes.push_back(std::move(chunk_index));
+        _statistics.chunkCount++;
+    }
+
+    void PipelinedMcapWriter::write_summary()
+    {
+        mcap::IWritable &output = *_output;
+        mcap::McapWriter::write(output, mcap::DataEnd{output.crc()});
+        output.crcEnabled = true;
+        output.resetCrc();
+
+        uint64_t summary_start = output.size();
+        uint64_t schema_start = output.size();
+        for (auto const &schema : _schemas)
+            mcap::McapWriter::write(output, schema);
+        uint64_t channel_start = output.size();
+        for (auto const &channel : _channels)
+            mcap::McapWriter::write(output, channel);
+        uint64_t statistics_start = output.size();
+        mcap::McapWriter::write(output, _statistics);
+        uint64_t chunk_index_start = output.size();
+        for (auto const &chunk_index : _chunk_indexes)
+            mcap::McapWriter::write(output, chunk_index);
+        uint64_t metadata_index_start = output.size();
+        for (auto const &metadata_index : _metadata_indexes)
+            mcap::McapWriter::write(output, metadata_index);
+        uint64_t summary_offset_start = output.size();
+
+        if (_schemas.size())
+            mcap::McapWriter::write(output, mcap::SummaryOffset{mcap::OpCode::Schema, schema_start, channel_start - schema_start});
+        if (_channels.size())
+            mcap::McapWriter::write(output, mcap::SummaryOffset{mcap::OpCode::Channel, channel_start, statistics_start - channel_start});
+        mcap::McapWriter::write(output, mcap::SummaryOffset{mcap::OpCode::Statistics, statistics_start, chunk_index_start - statistics_start});
+        if (_chunk_indexes.size())
+            mcap::McapWriter::write(output, mcap::SummaryOffset{mcap::OpCode::ChunkIndex, chunk_index_start, metadata_index_start - chunk_index_start});
+        if (_metadata_indexes.size())
+            mcap::McapWriter::write(output, mcap::SummaryOffset{mcap::OpCode::MetadataIndex, metadata_index_start, summary_offset_start - metadata_index_start});
+
+        mcap::McapWriter::write(output, mcap::Footer{summary_start, summary_offset_start}, true);
+        mcap::McapWriter::writeMagic(output);
+        output.crcEnabled = false;
+    }
+};
@@ -0,0 +1,197 @@
+#include "internal/ProtobufSerializer.h"
+#include <cstring>
+
+namespace mcap_wrapper
+{
+    //
+    // Writer
+    //
+    ProtobufWriter::ProtobufWriter(std::string &buffer) : _buffer(buffer)
+    {
+    }
+
+    void ProtobufWriter::write_varint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            _buffer.push_back(char((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        _buffer.push_back(char(value));
+    }
+
+    void ProtobufWriter::write_tag(uint32_t field_number, ProtobufWireType wire_type)
+    {
+        write_varint((uint64_t(field_number) << 3) | uint64_t(wire_type));
+    }
+
+    void ProtobufWriter::write_varint_field(uint32_t field_number, uint64_t value)
+    {
+        write_tag(field_number, ProtobufWireType::VARINT);
+        write_varint(value);
+    }
+
+    void ProtobufWriter::write_double_field(uint32_t field_number, double value)
+    {
+        write_tag(field_number, ProtobufWireType::FIXED64);
+        write_raw_double(value);
+    }
+
+    void ProtobufWriter::write_fixed32_field(uint32_t field_number, uint32_t value)
+    {
+        write_tag(field_number, ProtobufWireType::FIXED32);
+        write_raw_fixed32(value);
+    }
+
+    void ProtobufWriter::write_bytes_field(uint32_t field_number, void const *data, size_t size)
+    {
+        write_tag(field_number, ProtobufWireType::LENGTH_DELIMITED);
+        write_varint(size);
+        _buffer.append(reinterpret_cast<char const *>(data), size);
+    }
+
+    void ProtobufWriter::write_string_field(uint32_t field_number, std::string const &value)
+    {
+        write_bytes_field(field_number, value.data(), value.size());
+    }
+
+    void ProtobufWriter::write_timestamp_field(uint32_t field_number, uint64_t timestamp)
+    {
+        size_t position = begin_nested_field(field_number);
+        write_varint_field(1, timestamp / (uint64_t)1e9);
+        write_varint_field(2, timestamp % (uint64_t)1e9);
+        end_nested_field(position);
+    }
+
+    size_t ProtobufWriter::begin_nested_field(uint32_t field_number)
+    {
+        write_tag(field_number, ProtobufWireType::LENGTH_DELIMITED);
+        // One byte is reserved for the length, it is enough for most nested messages
+        _buffer.push_back(0);
+        return _buffer.size() - 1;
+    }
+
+    void ProtobufWriter::end_nested_field(size_t position)
+    {
+        uint64_t length = _buffer.size() - position - 1;
+        if (length < 0x80)
+        {
+            _buffer[position] = char(length);
+            return;
+        }
+        // Length needs more than the reserved byte, content is shifted:
+        char length_bytes[10];
+        size_t number_of_bytes = 0;
+        while (length >= 0x80)
+        {
+            length_bytes[number_of_bytes++] = char((length & 0x7F) | 0x80);
+            length >>= 7;
+        }
+        length_bytes[number_of_bytes++] = char(length);
+        _buffer.replace(position, 1, length_bytes, number_of_bytes);
+    }
+
+    void ProtobufWriter::write_raw_double(double value)
+    {
+        // Protobuf is little endian as every platform supported by the wrapper
+        char bytes[sizeof(double)];
+        std::memcpy(bytes, &value, sizeof(double));
+        _buffer.append(bytes, sizeof(double));
+    }
+
+    void ProtobufWriter::write_raw_fixed32(uint32_t value)
+    {
+        char bytes[sizeof(uint32_t)];
+        std::memcpy(bytes, &value, sizeof(uint32_t));
+        _buffer.append(bytes, sizeof(uint32_t));
+    }
+
+    void ProtobufWriter::write_raw_bytes(void const *data, size_t size)
+    {
+        _buffer.append(reinterpret_cast<char const *>(data), size);
+    }
+
+    //
+    // Reader
+    //
+    ProtobufReader::ProtobufReader(uint8_t const *data, size_t size) : _data(data), _end(data + size)
+    {
+    }
+
+    bool ProtobufReader::next_field(uint32_t &field_number, ProtobufWireType &wire_type)
+    {
+        uint64_t tag;
+        if (is_at_end() || !read_varint(tag))
+            return false;
+        field_number = uint32_t(tag >> 3);
+        wire_type = ProtobufWireType(tag & 0x7);
+        return field_number != 0;
+    }
+
+    bool ProtobufReader::read_varint(uint64_t &value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64 && _data < _end; shift += 7)
+        {
+            uint8_t byte = *_data++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool ProtobufReader::read_fixed32(uint32_t &value)
+    {
+        if (_end - _data < 4)
+            return false;
+        std::memcpy(&value, _data, 4);
+        _data += 4;
+        return true;
+    }
+
+    bool ProtobufReader::read_fixed64(uint64_t &value)
+    {
+        if (_end - _data < 8)
+            return false;
+        std::memcpy(&value, _data, 8);
+        _data += 8;
+        return true;
+    }
+
+    bool ProtobufReader::read_length_delimited(uint8_t const *&data, size_t &size)
+    {
+        uint64_t length;
+        if (!read_varint(length) || length > uint64_t(_end - _data))
+            return false;
+        data = _data;
+        size = length;
+        _data += length;
+        return true;
+    }
+
+    bool ProtobufReader::skip(ProtobufWireType wire_type)
+    {
+        uint64_t value64;
+        uint32_t value32;
+        uint8_t const *data;
+        size_t size;
+        switch (wire_type)
+        {
+        case ProtobufWireType::VARINT:
+            return read_varint(value64);
+        case ProtobufWireType::FIXED64:
+            return read_fixed64(value64);
+        case ProtobufWireType::LENGTH_DELIMITED:
+            return read_length_delimited(data, size);
+        case ProtobufWireType::FIXED32:
+            return read_fixed32(value32);
+        }
+        return false; // Groups are not supported
+    }
+
+    bool ProtobufReader::is_at_end() const
+    {
+        return _data >= _end;
+    }
+};
@@ -0,0 +1,39 @@
+#include "internal/RawImage.h"
+#include <map>
+
+namespace mcap_wrapper
+{
+    bool get_raw_image_encoding(int opencv_type, std::string &encoding)
+    {
+        // OpenCV store color images in BGR order
+        static const std::map<int, std::string> encodings = {
+            {CV_8UC1, "mono8"},
+            {CV_8UC3, "bgr8"},
+            {CV_8UC4, "bgra8"},
+            {CV_16UC1, "16UC1"},
+            {CV_32FC1, "32FC1"}};
+        auto it = encodings.find(opencv_type);
+        if (it == encodings.end())
+            return false;
+        encoding = it->second;
+        return true;
+    }
+
+    bool get_raw_image_opencv_type(std::string const &encoding, int &opencv_type)
+    {
+        static const std::map<std::string, int> opencv_types = {
+            {"mono8", CV_8UC1},
+            {"8UC1", CV_8UC1},
+            {"bgr8", CV_8UC3},
+            {"8UC3", CV_8UC3},
+            {"bgra8", CV_8UC4},
+            {"mono16", CV_16UC1},
+            {"16UC1", CV_16UC1},
+            {"32FC1", CV_32FC1}};
+        auto it = opencv_types.find(encoding);
+        if (it == opencv_types.end())
+            return false;
+        opencv_type = it->second;
+        return true;
+    }
+};
@@ -0,0 +1,121 @@
+#include "internal/Trajectory.h"
+#include "internal/ProtobufSerializer.h"
+#include "internal/json.hpp"
+#include <Eigen/Geometry>
+
+namespace mcap_wrapper
+{
+    void Trajectory::set_options(TrajectoryOptions const &options)
+    {
+        _options = options;
+    }
+
+    std::string Trajectory::add_pose(uint64_t timestamp, Eigen::Matrix4f const &pose, std::string const &frame_id, MessageEncoding encoding)
+    {
+        if (encoding != _serialized_encoding)
+            rebuild_serialized_poses(encoding);
+        std::string serialized_pose = serialize_pose(pose, encoding);
+
+        // Update history:
+        bool is_kept = _number_of_added_poses++ % std::max(_options.decimation, 1u) == 0;
+        if (is_kept)
+        {
+            _poses.push_back({timestamp, pose, serialized_pose.size()});
+            _serialized_poses += serialized_pose;
+        }
+        remove_old_poses(timestamp);
+
+        // Build message, latest pose is written even if it is not kept:
+        std::string message;
+        if (encoding == MessageEncoding::PROTOBUF)
+        {
+            message.reserve(_serialized_poses.size() + serialized_pose.size() + frame_id.size() + 32);
+            ProtobufWriter writer(message);
+            writer.write_timestamp_field(1, timestamp);
+            writer.write_string_field(2, frame_id);
+            writer.write_raw_bytes(_serialized_poses.data(), _serialized_poses.size());
+            if (!is_kept)
+                writer.write_raw_bytes(serialized_pose.data(), serialized_pose.size());
+        }
+        else
+        {
+            // Same layout than nlohmann::json::dump (keys sorted):
+            std::string serialized_frame_id = nlohmann::json(frame_id).dump();
+            message.reserve(_serialized_poses.size() + serialized_pose.size() + serialized_frame_id.size() + 96);
+            message += "{\"frame_id\":";
+            message += serialized_frame_id;
+            message += ",\"poses\":[";
+            message += _serialized_poses;
+            if (!is_kept)
+                message += serialized_pose;
+            if (message.back() == ',')
+                message.pop_back();
+            message += "],\"timestamp\":{\"nsec\":";
+            message += std::to_string(timestamp % (uint64_t)1e9);
+            message += ",\"sec\":";
+            message += std::to_string(timestamp / (uint64_t)1e9);
+            message += "}}";
+        }
+        return message;
+    }
+
+    std::string Trajectory::serialize_pose(Eigen::Matrix4f const &pose, MessageEncoding encoding)
+    {
+        Eigen::Quaternionf orientation(pose.block<3, 3>(0, 0));
+        if (encoding == MessageEncoding::PROTOBUF)
+        {
+            // One element of the repeated `poses` field of PosesInFrame:
+            std::string serialized_pose;
+            ProtobufWriter writer(serialized_pose);
+            size_t pose_position = writer.begin_nested_field(3);
+            size_t position_position = writer.begin_nested_field(1);
+            writer.write_double_field(1, pose(0, 3));
+            writer.write_double_field(2, pose(1, 3));
+            writer.write_double_field(3, pose(2, 3));
+            writer.end_nested_field(position_position);
+            size_t orientation_position = writer.begin_nested_field(2);
+            writer.write_double_field(1, orientation.x());
+            writer.write_double_field(2, orientation.y());
+            writer.write_double_field(3, orientation.z());
+            writer.write_double_field(4, orientation.w());
+            writer.end_nested_field(orientation_position);
+            writer.end_nested_field(pose_position);
+            return serialized_pose;
+        }
+        nlohmann::json pose_json;
+        pose_json["position"]["x"] = pose(0, 3);
+        pose_json["position"]["y"] = pose(1, 3);
+        pose_json["position"]["z"] = pose(2, 3);
+        pose_json["orientation"]["x"] = orientation.x();
+        pose_json["orientation"]["y"] = orientation.y();
+        pose_json["orientation"]["z"] = orientation.z();
+        pose_json["orientation"]["w"] = orientation.w();
+        return pose_json.dump() + ",";
+    }
+
+    void Trajectory::remove_old_poses(uint64_t timestamp)
+    {
+        size_t removed_size = 0;
+        while (_poses.size() &&
+               ((_options.max_poses && _poses.size() > _options.max_poses) ||
+                (_options.max_duration_ns && _poses.front().timestamp + _options.max_duration_ns < timestamp)))
+        {
+            removed_size += _poses.front().serialized_size;
+            _poses.pop_front();
+        }
+        if (removed_size)
+            _serialized_poses.erase(0, removed_size);
+    }
+
+    void Trajectory::rebuild_serialized_poses(MessageEncoding encoding)
+    {
+        _serialized_encoding = encoding;
+        _serialized_poses.clear();
+        for (auto &pose : _poses)
+        {
+            std::string serialized_pose = serialize_pose(pose.pose, encoding);
+            pose.serialized_size = serialized_pose.size();
+            _serialized_poses += serialized_pose;
+        }
+    }
+};
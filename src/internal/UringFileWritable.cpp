@@ -0,0 +1,374 @@
+#include "internal/UringFileWritable.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define MCAP_WRAPPER_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#ifndef O_DIRECT
+#define O_DIRECT 0 // Only used with io_uring
+#endif
+
+namespace mcap_wrapper
+{
+    // Direct IO requires buffers, sizes and file offsets aligned on the logical block size of the disk, at most a page
+    static constexpr uint64_t IO_ALIGNMENT = 4096;
+
+    UringFileWritable::UringFileWritable(uint64_t buffer_size, unsigned buffer_count, bool direct_io, uint64_t preallocation_size, uint64_t write_behind_size)
+        : FileWritable(preallocation_size, write_behind_size)
+    {
+        _buffer_size = std::max(IO_ALIGNMENT, (buffer_size + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT);
+        _buffer_count = std::max(1u, buffer_count);
+        _direct_io = direct_io;
+    }
+
+    UringFileWritable::~UringFileWritable()
+    {
+        end();
+    }
+
+    mcap::Status UringFileWritable::open(std::string const &file_name)
+    {
+        end();
+        if (!setup_ring())
+        {
+            std::cerr << "[MCAPWrapper] WARNING: io_uring is not available, " << file_name << " is written with stdio" << std::endl;
+            return FileWritable::open(file_name);
+        }
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        _fd = _direct_io ? ::open(file_name.c_str(), flags | O_DIRECT, 0666) : -1;
+        if (_direct_io && _fd < 0 && errno == EINVAL)
+            std::cerr << "[MCAPWrapper] WARNING: file system of " << file_name << " does not support direct IO, it is written through page cache" << std::endl;
+        if (_fd >= 0)
+            _buffered_fd = ::open(file_name.c_str(), O_WRONLY | O_CLOEXEC);
+        else
+            _fd = _buffered_fd = ::open(file_name.c_str(), flags, 0666);
+        if (_fd < 0 || _buffered_fd < 0)
+        {
+            std::string error = std::strerror(errno);
+            if (_fd >= 0)
+                ::close(_fd);
+            _fd = _buffered_fd = -1;
+            release_ring();
+            return mcap::Status(mcap::StatusCode::OpenFailed, "failed to open file \"" + file_name + "\" for writing: " + error);
+        }
+        _current_buffer = 0;
+        _uring_size = 0;
+        _write_failed = false;
+        _allocated_size = 0;
+        _write_behind_offset = 0;
+        return mcap::StatusCode::Success;
+    }
+
+    void UringFileWritable::handleWrite(const std::byte *data, uint64_t size)
+    {
+        if (_ring_fd < 0)
+        {
+            FileWritable::handleWrite(data, size);
+            return;
+        }
+        _uring_size += size;
+        preallocate(_buffered_fd, _uring_size);
+        while (size)
+        {
+            Buffer &buffer = _buffers[_current_buffer];
+            uint64_t copied_size = std::min(size, _buffer_size - buffer.size);
+            std::memcpy(buffer.data + buffer.size, data, copied_size);
+            buffer.size += copied_size;
+            data += copied_size;
+            size -= copied_size;
+            if (buffer.size == _buffer_size)
+            {
+                // Buffer is written while next one is filled
+                submit_write(_current_buffer);
+                uint64_t next_file_offset = buffer.file_offset + buffer.size;
+                _current_buffer = (_current_buffer + 1) % _buffer_count;
+                wait_for_buffer(_current_buffer);
+                Buffer &next_buffer = _buffers[_current_buffer];
+                next_buffer.size = 0;
+                next_buffer.written = 0;
+                next_buffer.file_offset = next_file_offset;
+            }
+        }
+    }
+
+    void UringFileWritable::end()
+    {
+        if (_ring_fd < 0)
+        {
+            FileWritable::end();
+            return;
+        }
+        if (_fd >= 0)
+        {
+            write_partial_buffer();
+            free_preallocated_space(_buffered_fd, _uring_size);
+            if (_buffered_fd != _fd)
+                ::close(_buffered_fd);
+            ::close(_fd);
+            _fd = _buffered_fd = -1;
+        }
+        release_ring();
+        _uring_size = 0;
+    }
+
+    uint64_t UringFileWritable::size() const
+    {
+        if (_ring_fd < 0)
+            return FileWritable::size();
+        return _uring_size;
+    }
+
+    bool UringFileWritable::flush()
+    {
+        if (_ring_fd < 0)
+            return FileWritable::flush();
+        bool success = write_partial_buffer() && !_write_failed;
+        _write_failed = false;
+        return success;
+    }
+
+    bool UringFileWritable::sync()
+    {
+        if (_ring_fd < 0)
+            return FileWritable::sync();
+        if (!flush())
+            return false;
+        if (fsync(_fd) != 0)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: failed to sync file to disk" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool UringFileWritable::is_using_io_uring() const
+    {
+        return _ring_fd >= 0;
+    }
+
+    //
+    // Protected methods
+    //
+#ifdef MCAP_WRAPPER_IO_URING
+    bool UringFileWritable::setup_ring()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        _ring_fd = syscall(__NR_io_uring_setup, _buffer_count, &params);
+        if (_ring_fd < 0)
+            return false; // Kernel older than 5.1, or io_uring disabled
+
+        // Map submission and completion rings, which are in the same mapping on kernels >= 5.4:
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+        _sq_ring = sq_ring == MAP_FAILED ? nullptr : sq_ring;
+        void *cq_ring = single_mmap ? sq_ring : mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+        _cq_ring = cq_ring == MAP_FAILED ? nullptr : cq_ring;
+        void *sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+        _sqes = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe *>(sqes);
+        _memory = static_cast<std::byte *>(std::aligned_alloc(IO_ALIGNMENT, _buffer_size * _buffer_count));
+        if (!_sq_ring || !_cq_ring || !_sqes || !_memory)
+        {
+            release_ring();
+            return false;
+        }
+        char *sq_ring_bytes = static_cast<char *>(_sq_ring);
+        char *cq_ring_bytes = static_cast<char *>(_cq_ring);
+        _sq_head = reinterpret_cast<unsigned *>(sq_ring_bytes + params.sq_off.head);
+        _sq_tail = reinterpret_cast<unsigned *>(sq_ring_bytes + params.sq_off.tail);
+        _sq_mask = reinterpret_cast<unsigned *>(sq_ring_bytes + params.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned *>(sq_ring_bytes + params.sq_off.array);
+        _cq_head = reinterpret_cast<unsigned *>(cq_ring_bytes + params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned *>(cq_ring_bytes + params.cq_off.tail);
+        _cq_mask = reinterpret_cast<unsigned *>(cq_ring_bytes + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe *>(cq_ring_bytes + params.cq_off.cqes);
+
+        _buffers.assign(_buffer_count, Buffer());
+        std::vector<iovec> buffer_vectors(_buffer_count);
+        for (unsigned i = 0; i < _buffer_count; i++)
+        {
+            _buffers[i].data = _memory + i * _buffer_size;
+            buffer_vectors[i].iov_base = _buffers[i].data;
+            buffer_vectors[i].iov_len = _buffer_size;
+        }
+        // Registered buffers are pinned once instead of at each write. Registration fails above the locked memory limit of the process,
+        // which is small by default before kernel 5.12, vectored writes are used then
+        _registered_buffers = syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_BUFFERS, buffer_vectors.data(), _buffer_count) == 0;
+        return true;
+    }
+
+    void UringFileWritable::release_ring()
+    {
+        if (_sqes)
+            munmap(_sqes, _sqes_size);
+        if (_cq_ring && _cq_ring != _sq_ring)
+            munmap(_cq_ring, _cq_ring_size);
+        if (_sq_ring)
+            munmap(_sq_ring, _sq_ring_size);
+        _sqes = nullptr;
+        _cq_ring = _sq_ring = nullptr;
+        if (_ring_fd >= 0)
+            ::close(_ring_fd); // Unregister buffers
+        _ring_fd = -1;
+        _registered_buffers = false;
+        std::free(_memory);
+        _memory = nullptr;
+        _buffers.clear();
+    }
+
+    void UringFileWritable::submit_write(unsigned buffer_index)
+    {
+        Buffer &buffer = _buffers[buffer_index];
+        unsigned tail = *_sq_tail;
+        unsigned index = tail & *_sq_mask;
+        io_uring_sqe &sqe = _sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.fd = _fd;
+        sqe.off = buffer.file_offset + buffer.written;
+        if (_registered_buffers)
+        {
+            sqe.opcode = IORING_OP_WRITE_FIXED;
+            sqe.addr = reinterpret_cast<uint64_t>(buffer.data + buffer.written);
+            sqe.len = uint32_t(buffer.size - buffer.written);
+            sqe.buf_index = uint16_t(buffer_index);
+        }
+        else
+        {
+            // IORING_OP_WRITE requires kernel 5.6, vectored writes are available with io_uring itself. Vector is kept until completion
+            buffer.vector.iov_base = buffer.data + buffer.written;
+            buffer.vector.iov_len = buffer.size - buffer.written;
+            sqe.opcode = IORING_OP_WRITEV;
+            sqe.addr = reinterpret_cast<uint64_t>(&buffer.vector);
+            sqe.len = 1;
+        }
+        sqe.user_data = buffer_index;
+        _sq_array[index] = index;
+        __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        buffer.in_flight = true;
+
+        int result;
+        do
+            result = syscall(__NR_io_uring_enter, _ring_fd, 1, 0, 0, nullptr, 0);
+        while (result < 0 && errno == EINTR);
+        if (result < 0)
+        {
+            std::cerr << "[MCAPWrapper] ERROR: failed to submit write of " << buffer.size - buffer.written << " bytes to file: " << std::strerror(errno) << std::endl;
+            __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+            buffer.in_flight = false;
+            _write_failed = true;
+        }
+    }
+
+    void UringFileWritable::reap_completions(bool wait)
+    {
+        if (wait)
+        {
+            int result;
+            do
+                result = syscall(__NR_io_uring_enter, _ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            while (result < 0 && errno == EINTR);
+        }
+        unsigned head = *_cq_head;
+        while (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE))
+        {
+            io_uring_cqe const &cqe = _cqes[head & *_cq_mask];
+            unsigned buffer_index = unsigned(cqe.user_data);
+            int result = cqe.res;
+            Buffer &buffer = _buffers[buffer_index];
+            head++;
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+            buffer.in_flight = false;
+            if (result <= 0)
+            {
+                std::cerr << "[MCAPWrapper] ERROR: failed to write " << buffer.size - buffer.written << " bytes to file: "
+                          << (result < 0 ? std::strerror(-result) : "nothing written") << std::endl;
+                _write_failed = true;
+                continue;
+            }
+            buffer.written += result;
+            // Rest of a short write, e.g. interrupted by a signal, is written again
+            if (buffer.written < buffer.size)
+                submit_write(buffer_index);
+            else if (_buffered_fd == _fd)
+                write_behind(_fd, buffer.file_offset + buffer.size);
+        }
+    }
+#else
+    bool UringFileWritable::setup_ring()
+    {
+        return false;
+    }
+
+    void UringFileWritable::release_ring()
+    {
+    }
+
+    void UringFileWritable::submit_write(unsigned buffer_index)
+    {
+    }
+
+    void UringFileWritable::reap_completions(bool wait)
+    {
+    }
+#endif
+
+    void UringFileWritable::wait_for_buffer(unsigned buffer_index)
+    {
+        while (_buffers[buffer_index].in_flight)
+            reap_completions(true);
+    }
+
+    void UringFileWritable::wait_for_all_buffers()
+    {
+        for (unsigned i = 0; i < _buffer_count; i++)
+            wait_for_buffer(i);
+    }
+
+    bool UringFileWritable::write_partial_buffer()
+    {
+        if (_fd < 0)
+            return false;
+        wait_for_all_buffers();
+        Buffer &buffer = _buffers[_current_buffer];
+        if (buffer.size == 0)
+            return true;
+        if (_buffered_fd == _fd)
+        {
+            submit_write(_current_buffer);
+            wait_for_buffer(_current_buffer);
+            buffer.file_offset += buffer.size;
+            buffer.size = 0;
+            buffer.written = 0;
+            return true;
+        }
+        // Direct IO only writes whole blocks: filled part is written through page cache and kept in the buffer, which is written
+        // again at the same offset once it is full
+        for (uint64_t written = 0; written < buffer.size;)
+        {
+            ssize_t result = pwrite(_buffered_fd, buffer.data + written, buffer.size - written, buffer.file_offset + written);
+            if (result < 0 && errno == EINTR)
+                continue;
+            if (result <= 0)
+            {
+                std::cerr << "[MCAPWrapper] ERROR: failed to write " << buffer.size - written << " bytes to file: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            written += result;
+        }
+        return true;
+    }
+};
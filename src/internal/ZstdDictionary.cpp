@@ -0,0 +1,266 @@
+#include "internal/ZstdDictionary.h"
+#include <iostream>
+#include <stdexcept>
+#include "internal/Base64.hpp"
+#ifndef MCAP_COMPRESSION_NO_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace mcap_wrapper
+{
+#ifndef MCAP_COMPRESSION_NO_ZSTD
+    ZstdDictionaryChunkWriter::ZstdDictionaryChunkWriter(mcap::CompressionLevel compression_level, uint64_t chunk_size)
+    {
+        _context = ZSTD_createCCtx();
+        _compression_level = get_zstd_compression_level(compression_level);
+        _uncompressed_buffer.reserve(chunk_size);
+    }
+
+    ZstdDictionaryChunkWriter::~ZstdDictionaryChunkWriter()
+    {
+        ZSTD_freeCCtx(_context);
+    }
+
+    void ZstdDictionaryChunkWriter::set_dictionary(ZstdCompressionDictionary const &dictionary)
+    {
+        _dictionary = dictionary;
+    }
+
+    void ZstdDictionaryChunkWriter::handleWrite(const std::byte *data, uint64_t size)
+    {
+        _uncompressed_buffer.insert(_uncompressed_buffer.end(), data, data + size);
+    }
+
+    void ZstdDictionaryChunkWriter::end()
+    {
+        _compressed_buffer.resize(ZSTD_compressBound(_uncompressed_buffer.size()));
+        size_t compressed_size;
+        if (_dictionary)
+            compressed_size = ZSTD_compress_usingCDict(_context, _compressed_buffer.data(), _compressed_buffer.size(), _uncompressed_buffer.data(),
+                                                       _uncompressed_buffer.size(), _dictionary.get());
+        else
+            compressed_size = ZSTD_compressCCtx(_context, _compressed_buffer.data(), _compressed_buffer.size(), _uncompressed_buffer.data(),
+                                                _uncompressed_buffer.size(), _compression_level);
+        if (ZSTD_isError(compressed_size))
+        {
+            // Chunk is kept uncompressed, a compression ratio of 1 is always rejected
+            std::cerr << "[MCAPWrapper] ERROR: zstd compression of chunk failed: " << ZSTD_getErrorName(compressed_size) << std::endl;
+            _compressed_buffer = _uncompressed_buffer;
+            return;
+        }
+        _compressed_buffer.resize(compressed_size);
+    }
+
+    uint64_t ZstdDictionaryChunkWriter::size() const
+    {
+        return _uncompressed_buffer.size();
+    }
+
+    uint64_t ZstdDictionaryChunkWriter::compressedSize() const
+    {
+        return _compressed_buffer.size();
+    }
+
+    bool ZstdDictionaryChunkWriter::empty() const
+    {
+        return _compressed_buffer.empty() && _uncompressed_buffer.empty();
+    }
+
+    void ZstdDictionaryChunkWriter::handleClear()
+    {
+        _uncompressed_buffer.clear();
+        _compressed_buffer.clear();
+    }
+
+    const std::byte *ZstdDictionaryChunkWriter::data() const
+    {
+        return _uncompressed_buffer.data();
+    }
+
+    const std::byte *ZstdDictionaryChunkWriter::compressedData() const
+    {
+        return _compressed_buffer.data();
+    }
+
+    bool train_zstd_dictionary(std::string const &samples, std::vector<size_t> const &sample_sizes, size_t max_size, std::string &out_dictionary)
+    {
+        out_dictionary.resize(max_size);
+        size_t dictionary_size = ZDICT_trainFromBuffer(out_dictionary.data(), out_dictionary.size(), samples.data(), sample_sizes.data(), sample_sizes.size());
+        if (ZDICT_isError(dictionary_size))
+        {
+            std::cerr << "[MCAPWrapper] ERROR: zstd dictionary training failed: " << ZDICT_getErrorName(dictionary_size) << std::endl;
+            out_dictionary.clear();
+            return false;
+        }
+        out_dictionary.resize(dictionary_size);
+        return true;
+    }
+
+    ZstdCompressionDictionary create_zstd_compression_dictionary(std::string const &dictionary, mcap::CompressionLevel compression_level)
+    {
+        ZSTD_CDict *compression_dictionary = ZSTD_createCDict(dictionary.data(), dictionary.size(), get_zstd_compression_level(compression_level));
+        if (!compression_dictionary)
+            return nullptr;
+        return ZstdCompressionDictionary(compression_dictionary, [](ZSTD_CDict const *dictionary)
+                                         { ZSTD_freeCDict(const_cast<ZSTD_CDict *>(dictionary)); });
+    }
+
+    uint32_t get_zstd_dictionary_id(std::string const &dictionary)
+    {
+        return ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+    }
+
+    bool add_zstd_dictionary_from_metadata(mcap::Metadata const &metadata, ZstdDecompressionDictionaries &dictionaries)
+    {
+        auto encoded_dictionary = metadata.metadata.find("dictionary");
+        if (metadata.name != ZSTD_DICTIONARY_METADATA_NAME || encoded_dictionary == metadata.metadata.end())
+            return false;
+        std::string dictionary;
+        try
+        {
+            dictionary = base64::from_base64(encoded_dictionary->second);
+        }
+        catch (std::runtime_error const &e)
+        {
+            return false;
+        }
+        uint32_t dictionary_id = get_zstd_dictionary_id(dictionary);
+        ZSTD_DDict *decompression_dictionary = dictionary_id ? ZSTD_createDDict(dictionary.data(), dictionary.size()) : nullptr;
+        if (!decompression_dictionary)
+            return false;
+        dictionaries[dictionary_id] = std::shared_ptr<ZSTD_DDict const>(decompression_dictionary, [](ZSTD_DDict const *dictionary)
+                                                                        { ZSTD_freeDDict(const_cast<ZSTD_DDict *>(dictionary)); });
+        return true;
+    }
+
+    bool decompress_zstd_chunk(const std::byte *data, uint64_t size, uint64_t uncompressed_size, ZstdDecompressionDictionaries const &dictionaries, std::vector<std::byte> &out_records)
+    {
+        out_records.resize(uncompressed_size);
+        size_t decompressed_size;
+        uint32_t dictionary_id = ZSTD_getDictID_fromFrame(data, size);
+        if (dictionary_id)
+        {
+            auto dictionary = dictionaries.find(dictionary_id);
+            if (dictionary == dictionaries.end())
+            {
+                std::cerr << "[MCAPWrapper] ERROR: zstd dictionary " << dictionary_id << " of chunk is missing from file" << std::endl;
+                return false;
+            }
+            // Context is kept by each thread, decompression of a chunk allocates it otherwise
+            thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            decompressed_size = ZSTD_decompress_usingDDict(context.get(), out_records.data(), out_records.size(), data, size, dictionary->second.get());
+        }
+        else
+            decompressed_size = ZSTD_decompress(out_records.data(), out_records.size(), data, size);
+        return !ZSTD_isError(decompressed_size) && decompressed_size == uncompressed_size;
+    }
+#else
+    ZstdDictionaryChunkWriter::ZstdDictionaryChunkWriter(mcap::CompressionLevel compression_level, uint64_t chunk_size)
+    {
+        _compression_level = get_zstd_compression_level(compression_level);
+    }
+
+    ZstdDictionaryChunkWriter::~ZstdDictionaryChunkWriter()
+    {
+    }
+
+    void ZstdDictionaryChunkWriter::set_dictionary(ZstdCompressionDictionary const &dictionary)
+    {
+    }
+
+    void ZstdDictionaryChunkWriter::handleWrite(const std::byte *data, uint64_t size)
+    {
+        _uncompressed_buffer.insert(_uncompressed_buffer.end(), data, data + size);
+    }
+
+    void ZstdDictionaryChunkWriter::end()
+    {
+        _compressed_buffer = _uncompressed_buffer;
+    }
+
+    uint64_t ZstdDictionaryChunkWriter::size() const
+    {
+        return _uncompressed_buffer.size();
+    }
+
+    uint64_t ZstdDictionaryChunkWriter::compressedSize() const
+    {
+        return _compressed_buffer.size();
+    }
+
+    bool ZstdDictionaryChunkWriter::empty() const
+    {
+        return _compressed_buffer.empty() && _uncompressed_buffer.empty();
+    }
+
+    void ZstdDictionaryChunkWriter::handleClear()
+    {
+        _uncompressed_buffer.clear();
+        _compressed_buffer.clear();
+    }
+
+    const std::byte *ZstdDictionaryChunkWriter::data() const
+    {
+        return _uncompressed_buffer.data();
+    }
+
+    const std::byte *ZstdDictionaryChunkWriter::compressedData() const
+    {
+        return _compressed_buffer.data();
+    }
+
+    bool train_zstd_dictionary(std::string const &samples, std::vector<size_t> const &sample_sizes, size_t max_size, std::string &out_dictionary)
+    {
+        std::cerr << "[MCAPWrapper] ERROR: zstd dictionaries are not available in this build" << std::endl;
+        return false;
+    }
+
+    ZstdCompressionDictionary create_zstd_compression_dictionary(std::string const &dictionary, mcap::CompressionLevel compression_level)
+    {
+        return nullptr;
+    }
+
+    uint32_t get_zstd_dictionary_id(std::string const &dictionary)
+    {
+        return 0;
+    }
+
+    bool add_zstd_dictionary_from_metadata(mcap::Metadata const &metadata, ZstdDecompressionDictionaries &dictionaries)
+    {
+        return false;
+    }
+
+    bool decompress_zstd_chunk(const std::byte *data, uint64_t size, uint64_t uncompressed_size, ZstdDecompressionDictionaries const &dictionaries, std::vector<std::byte> &out_records)
+    {
+        std::cerr << "[MCAPWrapper] ERROR: zstd decompression is not available in this build" << std::endl;
+        return false;
+    }
+#endif
+
+    int get_zstd_compression_level(mcap::CompressionLevel compression_level)
+    {
+        switch (compression_level)
+        {
+        case mcap::CompressionLevel::Fastest:
+            return -5;
+        case mcap::CompressionLevel::Fast:
+            return -3;
+        case mcap::CompressionLevel::Slow:
+            return 5;
+        case mcap::CompressionLevel::Slowest:
+            return 19;
+        default:
+            return 1;
+        }
+    }
+
+    mcap::Metadata make_zstd_dictionary_metadata(std::string const &dictionary)
+    {
+        mcap::Metadata metadata;
+        metadata.name = ZSTD_DICTIONARY_METADATA_NAME;
+        metadata.metadata["id"] = std::to_string(get_zstd_dictionary_id(dictionary));
+        metadata.metadata["dictionary"] = base64::to_base64(dictionary);
+        return metadata;
+    }
+};
@@ -1,4 +1,5 @@
 #include "internal/utils.hpp"
+#include <chrono>
 
 namespace mcap_wrapper{
 
@@ -67,4 +68,28 @@ namespace mcap_wrapper{
 
         return out;
     }
+
+    nlohmann::json infer_schema_of_sample(std::string const &channel_name, nlohmann::json const &sample)
+    {
+        // Check if additionnal informations are provided:
+        std::string description = "Geneated by wrapper based on provided JSON";
+        if (sample.count("__private_foxglove_description__"))
+            description = sample["__private_foxglove_description__"];
+        std::string comment = "";
+        if (sample.count("__private_foxglove_comment__"))
+            comment = sample["__private_foxglove_comment__"];
+
+        // Create schema:
+        nlohmann::json foxglove_schema;
+        foxglove_schema["title"] = channel_name;
+        foxglove_schema["description"] = description;
+        foxglove_schema["$comment"] = comment;
+        foxglove_schema["type"] = "object";
+        foxglove_schema["properties"] = infer_property_of_sample(sample);
+        return foxglove_schema;
+    }
+
+    uint64_t get_steady_time_ns(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 };
\ No newline at end of file
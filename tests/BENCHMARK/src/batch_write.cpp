@@ -0,0 +1,62 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include "MCAPWriter.h"
+
+// Replay bursts of IMU samples (raw JSON) by channel name, by channel handle and with `write_batch`, and report the time spent
+// by the producer per message. Bursts are spaced so that the previous one is encoded: producer never waits for the encoding thread.
+int main(int argc, char **argv)
+{
+    unsigned number_of_bursts = 200;
+    unsigned burst_size = 1000;
+
+    // Samples of a burst, serialized once:
+    std::vector<std::string> imu_samples;
+    for (unsigned i = 0; i < burst_size; i++)
+        imu_samples.push_back("{\"acceleration\": {\"x\": " + std::to_string(0.01 * i) + ", \"y\": 0.02, \"z\": 9.81}, \"angular_velocity\": {\"x\": 0.001, \"y\": " + std::to_string(0.002 * i) + ", \"z\": 0.0}}");
+
+    std::cout << std::setw(10) << "api" << std::setw(16) << "push (ns)" << std::endl;
+    for (std::string api : {"name", "handle", "batch"})
+    {
+        std::string connection_name = "batch_write_" + api + ".mcap";
+        mcap_wrapper::open_file_connection(connection_name);
+        mcap_wrapper::ChannelHandle imu_channel = mcap_wrapper::open_channel(connection_name, "/imu", mcap_wrapper::ChannelType::RAW_JSON);
+        std::vector<mcap_wrapper::BatchItem> burst(burst_size);
+        for (unsigned i = 0; i < burst_size; i++)
+        {
+            burst[i].type = mcap_wrapper::ChannelType::RAW_JSON;
+            burst[i].channel_name = "/imu";
+            burst[i].text = imu_samples[i];
+        }
+
+        double push_time_ns = 0;
+        for (unsigned burst_number = 0; burst_number < number_of_bursts; burst_number++)
+        {
+            uint64_t timestamp = uint64_t(burst_number) * burst_size;
+            auto push_start = std::chrono::steady_clock::now();
+            if (api == "batch")
+            {
+                for (unsigned i = 0; i < burst_size; i++)
+                    burst[i].timestamp = timestamp + i;
+                mcap_wrapper::write_batch(connection_name, burst);
+            }
+            else
+            {
+                for (unsigned i = 0; i < burst_size; i++)
+                {
+                    if (api == "handle")
+                        mcap_wrapper::write_JSON(imu_channel, imu_samples[i], timestamp + i);
+                    else
+                        mcap_wrapper::write_JSON_to(connection_name, "/imu", imu_samples[i], timestamp + i);
+                }
+            }
+            push_time_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - push_start).count();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        mcap_wrapper::close_file_connection(connection_name);
+
+        std::cout << std::setw(10) << api << std::setw(16) << std::fixed << std::setprecision(1) << push_time_ns / (number_of_bursts * burst_size) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "MCAPWriter.h"
+
+// Write logs round robin on 50 channels of one connection, by channel name then by channel handle, and report
+// the push time and the throughput of the connection from the first push until the file is closed.
+int main(int argc, char **argv)
+{
+    unsigned number_of_channels = 50;
+    unsigned number_of_messages = 200000;
+
+    std::cout << std::setw(10) << "api" << std::setw(16) << "push (ns)" << std::setw(16) << "total (ns)" << std::setw(16) << "messages/s" << std::endl;
+    for (bool use_handles : {false, true})
+    {
+        std::string connection_name = use_handles ? "channel_handle.mcap" : "channel_name.mcap";
+        mcap_wrapper::open_file_connection(connection_name);
+        std::vector<std::string> channel_names;
+        std::vector<mcap_wrapper::ChannelHandle> channels;
+        for (unsigned i = 0; i < number_of_channels; i++)
+        {
+            channel_names.push_back("/robot/sensor_" + std::to_string(i) + "/log");
+            if (use_handles)
+                channels.push_back(mcap_wrapper::open_channel(connection_name, channel_names.back(), mcap_wrapper::ChannelType::LOG));
+        }
+
+        double push_time_ns = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < number_of_messages; i++)
+        {
+            unsigned channel = i % number_of_channels;
+            auto push_start = std::chrono::steady_clock::now();
+            if (use_handles)
+                mcap_wrapper::write_log(channels[channel], i, mcap_wrapper::LOG_LEVEL::INFO, "benchmark message", "benchmark", __FILE__, __LINE__);
+            else
+                mcap_wrapper::write_log_to(connection_name, channel_names[channel], i, mcap_wrapper::LOG_LEVEL::INFO, "benchmark message", "benchmark", __FILE__, __LINE__);
+            push_time_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - push_start).count();
+        }
+        mcap_wrapper::close_file_connection(connection_name);
+        double total_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / number_of_messages;
+
+        std::cout << std::setw(10) << (use_handles ? "handle" : "name") << std::setw(16) << std::fixed << std::setprecision(1) << push_time_ns / number_of_messages
+                  << std::setw(16) << total_ns << std::setw(16) << std::setprecision(0) << 1e9 / total_ns << std::endl;
+    }
+    return 0;
+}
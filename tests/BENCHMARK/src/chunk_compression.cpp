@@ -0,0 +1,58 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "MCAPWriter.h"
+
+// High-bandwidth recording: raw images and raw JSON written to a zstd file connection (level 5), with chunks compressed by the writing
+// thread or by background threads. Report the uncompressed throughput, from the first push until the file is closed, and the
+// latency of messages between push and write.
+int main(int argc, char **argv)
+{
+    unsigned number_of_images = 150;
+    unsigned number_of_json_per_image = 20;
+    // Smooth image with sensor noise, as written by cameras:
+    cv::Mat image(480, 640, CV_8UC3);
+    for (int row = 0; row < image.rows; row++)
+    {
+        uint8_t *pixels = image.ptr<uint8_t>(row);
+        for (int column = 0; column < image.cols; column++)
+        {
+            pixels[3 * column] = row % 256;
+            pixels[3 * column + 1] = column % 256;
+            pixels[3 * column + 2] = (row + column + rand() % 8) % 256;
+        }
+    }
+    double bytes_per_iteration = image.total() * image.elemSize() + number_of_json_per_image * 64.;
+
+    std::cout << std::setw(10) << "threads" << std::setw(12) << "time (ms)" << std::setw(12) << "MB/s" << std::setw(14) << "p50 (us)" << std::setw(14) << "p99 (us)" << std::endl;
+    for (unsigned compression_threads : {0, 1, 2, 4})
+    {
+        std::string file_name = "chunk_compression_" + std::to_string(compression_threads) + ".mcap";
+        mcap_wrapper::FileConnectionOptions options;
+        options.compression_level = mcap_wrapper::FileCompressionLevel::SLOW;
+        options.compression_threads = compression_threads;
+        mcap_wrapper::open_file_connection(file_name, options);
+        mcap_wrapper::ChannelHandle json_channel = mcap_wrapper::open_channel(file_name, "sample_json", mcap_wrapper::ChannelType::RAW_JSON);
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < number_of_images; i++)
+        {
+            uint64_t timestamp = uint64_t(i) * 33000000;
+            mcap_wrapper::write_raw_image_to(file_name, "sample_image", image, timestamp);
+            for (unsigned j = 0; j < number_of_json_per_image; j++)
+                mcap_wrapper::write_JSON(json_channel, "{\"random_value\":" + std::to_string(rand() % 1024) + ",\"fixed_value\":\"fixed\"}", timestamp + j);
+        }
+        mcap_wrapper::flush(file_name);
+        mcap_wrapper::ConnectionStatistics statistics;
+        mcap_wrapper::get_connection_statistics(file_name, statistics);
+        mcap_wrapper::close_file_connection(file_name);
+        double time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::setw(10) << compression_threads << std::setw(12) << std::fixed << std::setprecision(0) << time_ms
+                  << std::setw(12) << number_of_images * bytes_per_iteration / time_ms / 1e3 << std::setw(14) << statistics.latency_p50_ns / 1e3
+                  << std::setw(14) << statistics.latency_p99_ns / 1e3 << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <sys/resource.h>
+#include <opencv2/core.hpp>
+#include "MCAPWriter.h"
+#include "MCAPReader.h"
+
+// Recording of noisy raw images in protobuf, which do not compress, mixed with small JSON telemetry. All channels in the same zstd chunks,
+// against images in their own uncompressed 4 MB chunks and telemetry in 1 MB zstd chunks. Report the time to write the file, its
+// size, the CPU time of the whole process while writing and the time to read back only the telemetry.
+double get_process_cpu_time_ms()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned number_of_images = 400;
+    unsigned number_of_telemetry_per_image = 100;
+    cv::Mat image(480, 640, CV_8UC3);
+    for (int row = 0; row < image.rows; row++)
+    {
+        uint8_t *pixels = image.ptr<uint8_t>(row);
+        for (int column = 0; column < 3 * image.cols; column++)
+            pixels[column] = rand() % 256;
+    }
+
+    mcap_wrapper::FileConnectionOptions grouped_options;
+    grouped_options.chunk_size = 1024 * 1024;
+    grouped_options.chunk_groups.resize(1);
+    grouped_options.chunk_groups[0].schema_names = {"foxglove.RawImage"};
+    grouped_options.chunk_groups[0].compression = mcap_wrapper::FileCompression::NONE;
+    grouped_options.chunk_groups[0].chunk_size = 4 * 1024 * 1024;
+
+    std::cout << std::setw(10) << "chunks" << std::setw(14) << "write (ms)" << std::setw(14) << "cpu (ms)" << std::setw(14) << "size (MB)" << std::setw(14) << "read (ms)" << std::endl;
+    for (auto const &[name, options] : {std::make_pair(std::string("shared"), mcap_wrapper::FileConnectionOptions()), std::make_pair(std::string("grouped"), grouped_options)})
+    {
+        std::string file_name = "chunk_groups_" + name + ".mcap";
+        auto start = std::chrono::steady_clock::now();
+        double cpu_start_ms = get_process_cpu_time_ms();
+        mcap_wrapper::open_file_connection(file_name, options);
+        mcap_wrapper::set_connection_message_encoding(file_name, mcap_wrapper::MessageEncoding::PROTOBUF);
+        mcap_wrapper::ChannelHandle telemetry_channel = mcap_wrapper::open_channel(file_name, "/imu", mcap_wrapper::ChannelType::RAW_JSON);
+        for (unsigned i = 0; i < number_of_images; i++)
+        {
+            uint64_t timestamp = uint64_t(i) * 100000000;
+            mcap_wrapper::write_raw_image_to(file_name, "/camera", image, timestamp);
+            for (unsigned j = 0; j < number_of_telemetry_per_image; j++)
+                mcap_wrapper::write_JSON(telemetry_channel, "{\"acceleration\":{\"x\":0.01,\"y\":0.02,\"z\":9.81},\"sample\":" + std::to_string(j) + "}", timestamp + j * 1000000);
+        }
+        mcap_wrapper::close_file_connection(file_name);
+        double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        double cpu_ms = get_process_cpu_time_ms() - cpu_start_ms;
+        double size = std::ifstream(file_name, std::ios::binary | std::ios::ate).tellg();
+
+        start = std::chrono::steady_clock::now();
+        mcap_wrapper::MCAPReader reader(file_name);
+        std::string telemetry;
+        unsigned number_of_telemetry = 0;
+        while (reader.get_next_message("/imu", telemetry))
+            number_of_telemetry++;
+        double read_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (number_of_telemetry != number_of_images * number_of_telemetry_per_image)
+            std::cerr << "Only " << number_of_telemetry << " telemetry messages read from " << file_name << std::endl;
+
+        std::cout << std::setw(10) << name << std::setw(14) << std::fixed << std::setprecision(0) << write_ms << std::setw(14) << cpu_ms << std::setw(14) << std::setprecision(1) << size / 1024 / 1024
+                  << std::setw(14) << std::setprecision(0) << read_ms << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "MCAPWriter.h"
+
+// Write the same recording (raw JSON, logs and frame transforms as in unit test, plus raw images) with several compression and
+// chunking settings. Report the throughput, from the first push until the file is closed, and the size of the file.
+double run(std::string const &file_name, mcap_wrapper::FileConnectionOptions const &options, unsigned number_of_iterations, cv::Mat const &image)
+{
+    if (!mcap_wrapper::open_file_connection(file_name, options))
+        return -1.;
+    mcap_wrapper::ChannelHandle json_channel = mcap_wrapper::open_channel(file_name, "sample_json", mcap_wrapper::ChannelType::RAW_JSON);
+    mcap_wrapper::ChannelHandle log_channel = mcap_wrapper::open_channel(file_name, "sample_log", mcap_wrapper::ChannelType::LOG);
+    mcap_wrapper::ChannelHandle transform_channel = mcap_wrapper::open_channel(file_name, "sample_transform", mcap_wrapper::ChannelType::TRANSFORM);
+    Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+    srand(0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < number_of_iterations; i++)
+    {
+        uint64_t timestamp = uint64_t(i) * 1000000;
+        mcap_wrapper::write_JSON(json_channel, "{\"random_value\":" + std::to_string(rand() % 1024) + ",\"fixed_value\":\"This is a fixed value\"}", timestamp);
+        mcap_wrapper::write_log(log_channel, timestamp, mcap_wrapper::LOG_LEVEL::INFO, "This is a log number " + std::to_string(i), "LOG", __FILE__, __LINE__);
+        pose(0, 3) = 0.01f * i;
+        mcap_wrapper::add_frame_transform(transform_channel, timestamp, "world", "robot", pose);
+        if (i % 50 == 0)
+            mcap_wrapper::write_raw_image_to(file_name, "sample_image", image, timestamp);
+    }
+    mcap_wrapper::close_file_connection(file_name);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    unsigned number_of_iterations = 50000;
+    // Smooth image with sensor noise, as written by cameras:
+    cv::Mat image(240, 320, CV_8UC3);
+    for (int row = 0; row < image.rows; row++)
+    {
+        uint8_t *pixels = image.ptr<uint8_t>(row);
+        for (int column = 0; column < image.cols; column++)
+        {
+            pixels[3 * column] = row % 256;
+            pixels[3 * column + 1] = column % 256;
+            pixels[3 * column + 2] = (row + column + rand() % 8) % 256;
+        }
+    }
+
+    auto make_options = [](mcap_wrapper::FileCompression compression, mcap_wrapper::FileCompressionLevel level, uint64_t chunk_size, bool chunk_crc)
+    {
+        mcap_wrapper::FileConnectionOptions options;
+        options.compression = compression;
+        options.compression_level = level;
+        options.chunk_size = chunk_size;
+        options.chunk_crc = chunk_crc;
+        return options;
+    };
+    using mcap_wrapper::FileCompression;
+    using mcap_wrapper::FileCompressionLevel;
+    std::vector<std::pair<std::string, mcap_wrapper::FileConnectionOptions>> all_options = {
+        {"none", make_options(FileCompression::NONE, FileCompressionLevel::DEFAULT, 768 * 1024, true)},
+        {"none_no_chunk", make_options(FileCompression::NONE, FileCompressionLevel::DEFAULT, 0, true)},
+        {"lz4_fast", make_options(FileCompression::LZ4, FileCompressionLevel::FAST, 768 * 1024, true)},
+        {"lz4_default", make_options(FileCompression::LZ4, FileCompressionLevel::DEFAULT, 768 * 1024, true)},
+        {"zstd_fastest", make_options(FileCompression::ZSTD, FileCompressionLevel::FASTEST, 768 * 1024, true)},
+        {"zstd_default", make_options(FileCompression::ZSTD, FileCompressionLevel::DEFAULT, 768 * 1024, true)},
+        {"zstd_slowest", make_options(FileCompression::ZSTD, FileCompressionLevel::SLOWEST, 768 * 1024, true)},
+        {"zstd_4MB_chunk", make_options(FileCompression::ZSTD, FileCompressionLevel::DEFAULT, 4 * 1024 * 1024, true)},
+        {"zstd_no_crc", make_options(FileCompression::ZSTD, FileCompressionLevel::DEFAULT, 768 * 1024, false)}};
+
+    std::cout << std::setw(16) << "setting" << std::setw(12) << "time (ms)" << std::setw(16) << "messages/s" << std::setw(14) << "size (KB)" << std::setw(10) << "ratio" << std::endl;
+    double uncompressed_size = 0;
+    for (auto const &[name, options] : all_options)
+    {
+        std::string file_name = "file_options_" + name + ".mcap";
+        double time_ms = run(file_name, options, number_of_iterations, image);
+        if (time_ms < 0)
+        {
+            std::cout << std::setw(16) << name << "  not available" << std::endl;
+            continue;
+        }
+        double size = std::ifstream(file_name, std::ios::binary | std::ios::ate).tellg();
+        if (uncompressed_size == 0)
+            uncompressed_size = size;
+        double number_of_messages = 3. * number_of_iterations + number_of_iterations / 50;
+        std::cout << std::setw(16) << name << std::setw(12) << std::fixed << std::setprecision(0) << time_ms << std::setw(16) << number_of_messages / time_ms * 1e3
+                  << std::setw(14) << size / 1024 << std::setw(10) << std::setprecision(2) << uncompressed_size / size << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <opencv2/core.hpp>
+#include "MCAPWriter.h"
+
+// Sustained recording of mixed data (raw 720p images and JSON telemetry) to an uncompressed file connection, written with stdio,
+// io_uring and io_uring with direct IO. Report the throughput from the first push until the file is closed. Size of the recording
+// is 10 GB by default, or the number of GB given as first argument.
+int main(int argc, char **argv)
+{
+    double recording_size_gb = argc > 1 ? std::atof(argv[1]) : 10.;
+    unsigned number_of_json_per_image = 30;
+    cv::Mat image(720, 1280, CV_8UC3);
+    for (int row = 0; row < image.rows; row++)
+    {
+        uint8_t *pixels = image.ptr<uint8_t>(row);
+        for (int column = 0; column < 3 * image.cols; column++)
+            pixels[column] = rand() % 256;
+    }
+    std::string json = "{\"acceleration\":{\"x\":0.01,\"y\":0.02,\"z\":9.81},\"angular_velocity\":{\"x\":0.001,\"y\":0.002,\"z\":0.003}}";
+    double bytes_per_image = image.total() * image.elemSize() + number_of_json_per_image * json.size();
+    uint64_t number_of_images = recording_size_gb * 1e9 / bytes_per_image;
+
+    mcap_wrapper::FileConnectionOptions stdio_options;
+    stdio_options.compression = mcap_wrapper::FileCompression::NONE;
+    stdio_options.chunk_size = 4 * 1024 * 1024;
+    mcap_wrapper::FileConnectionOptions uring_options = stdio_options;
+    uring_options.write_method = mcap_wrapper::FileWriteMethod::IO_URING;
+    mcap_wrapper::FileConnectionOptions direct_options = uring_options;
+    direct_options.direct_io = true;
+
+    std::cout << std::setw(16) << "method" << std::setw(12) << "size (GB)" << std::setw(12) << "time (s)" << std::setw(12) << "MB/s" << std::endl;
+    for (auto const &[name, options] : {std::make_pair(std::string("stdio"), stdio_options), std::make_pair(std::string("io_uring"), uring_options),
+                                        std::make_pair(std::string("io_uring direct"), direct_options)})
+    {
+        std::string file_name = "io_uring_throughput.mcap";
+        auto start = std::chrono::steady_clock::now();
+        mcap_wrapper::open_file_connection(file_name, options);
+        mcap_wrapper::set_connection_message_encoding(file_name, mcap_wrapper::MessageEncoding::PROTOBUF);
+        mcap_wrapper::ChannelHandle imu_channel = mcap_wrapper::open_channel(file_name, "/imu", mcap_wrapper::ChannelType::RAW_JSON);
+        for (uint64_t i = 0; i < number_of_images; i++)
+        {
+            uint64_t timestamp = i * 33000000;
+            mcap_wrapper::write_raw_image_to(file_name, "/camera", image, timestamp);
+            for (unsigned j = 0; j < number_of_json_per_image; j++)
+                mcap_wrapper::write_JSON(imu_channel, json, timestamp + j * 1000000);
+        }
+        mcap_wrapper::close_file_connection(file_name);
+        double time_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::remove(file_name.c_str());
+
+        std::cout << std::setw(16) << name << std::setw(12) << std::fixed << std::setprecision(1) << number_of_images * bytes_per_image / 1e9
+                  << std::setw(12) << time_s << std::setw(12) << std::setprecision(0) << number_of_images * bytes_per_image / time_s / 1e6 << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include "MCAPWriter.h"
+
+// Push logs at a fixed rate and report the latency between the push and the write into file.
+// A batching window of 16 ms reproduce the behaviour of the former polling writer.
+int main(int argc, char **argv)
+{
+    unsigned number_of_messages = 5000;
+    unsigned push_period_us = 500; // 2 kHz
+    std::vector<unsigned> all_batching_windows_us = {0, 1000, 16000};
+
+    std::cout << std::setw(20) << "batching window (us)" << std::setw(12) << "messages" << std::setw(14) << "p50 (us)" << std::setw(14) << "p99 (us)" << std::endl;
+    for (unsigned batching_window_us : all_batching_windows_us)
+    {
+        std::string connection_name = "latency_" + std::to_string(batching_window_us) + ".mcap";
+        mcap_wrapper::open_file_connection(connection_name);
+        mcap_wrapper::set_connection_batching_window(connection_name, batching_window_us);
+
+        for (unsigned i = 0; i < number_of_messages; i++)
+        {
+            uint64_t timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+            mcap_wrapper::write_log_to(connection_name, "latency_log", timestamp, mcap_wrapper::LOG_LEVEL::INFO, "message " + std::to_string(i), "benchmark", __FILE__, __LINE__);
+            std::this_thread::sleep_for(std::chrono::microseconds(push_period_us));
+        }
+        // Statistics are read once every message is written, connection is removed by closing it
+        mcap_wrapper::flush(connection_name);
+        mcap_wrapper::ConnectionStatistics statistics;
+        mcap_wrapper::get_connection_statistics(connection_name, statistics);
+        mcap_wrapper::close_file_connection(connection_name);
+        std::cout << std::setw(20) << batching_window_us << std::setw(12) << statistics.written_messages
+                  << std::setw(14) << statistics.latency_p50_ns / 1e3 << std::setw(14) << statistics.latency_p99_ns / 1e3 << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <ctime>
+#include "MCAPWriter.h"
+
+// Several producer threads push bursts of logs on opened channels (`write_log`) and of raw JSON by channel name (`write_JSON_to`)
+// at the same time. Report the rate at which messages are accepted by producers, from the start of the burst until every producer
+// returned, and the CPU time spent by producers per message. Connection is flushed between bursts, outside of the measure.
+int main(int argc, char **argv)
+{
+    unsigned number_of_bursts = 20;
+    unsigned burst_size = 1000; // Per producer
+    std::string json = "{\"acceleration\": {\"x\": 0.01, \"y\": 0.02, \"z\": 9.81}, \"angular_velocity\": {\"x\": 0.001, \"y\": 0.002, \"z\": 0.0}}";
+
+    std::cout << std::setw(14) << "api" << std::setw(12) << "producers" << std::setw(16) << "push (ns)" << std::setw(16) << "cpu (ns)" << std::setw(16) << "messages/s" << std::endl;
+    for (std::string api : {"write_log", "write_JSON_to"})
+    {
+        for (unsigned number_of_producers : {1, 2, 4, 8, 16})
+        {
+            std::string connection_name = "producer_scaling_" + api + "_" + std::to_string(number_of_producers) + ".mcap";
+            mcap_wrapper::open_file_connection(connection_name);
+            std::vector<mcap_wrapper::ChannelHandle> log_channels;
+            for (unsigned producer = 0; producer < number_of_producers; producer++)
+                log_channels.push_back(mcap_wrapper::open_channel(connection_name, "/log_" + std::to_string(producer), mcap_wrapper::ChannelType::LOG));
+
+            double push_time_ns = 0;
+            std::atomic<uint64_t> producer_cpu_time_ns{0};
+            for (unsigned burst_number = 0; burst_number < number_of_bursts; burst_number++)
+            {
+                std::atomic<bool> start{false};
+                std::vector<std::thread> producers;
+                for (unsigned producer = 0; producer < number_of_producers; producer++)
+                {
+                    producers.emplace_back([&, producer]()
+                                           {
+                        std::string channel_name = "/imu_" + std::to_string(producer);
+                        while (!start)
+                            std::this_thread::yield();
+                        timespec cpu_start, cpu_end;
+                        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+                        uint64_t timestamp = uint64_t(burst_number) * burst_size;
+                        for (unsigned i = 0; i < burst_size; i++)
+                        {
+                            if (api == "write_log")
+                                mcap_wrapper::write_log(log_channels[producer], timestamp + i, mcap_wrapper::LOG_LEVEL::INFO, "benchmark message", "benchmark", __FILE__, __LINE__);
+                            else
+                                mcap_wrapper::write_JSON_to(connection_name, channel_name, json, timestamp + i);
+                        }
+                        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+                        producer_cpu_time_ns += (cpu_end.tv_sec - cpu_start.tv_sec) * 1000000000ull + cpu_end.tv_nsec - cpu_start.tv_nsec; });
+                }
+                auto push_start = std::chrono::steady_clock::now();
+                start = true;
+                for (auto &producer : producers)
+                    producer.join();
+                push_time_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - push_start).count();
+                mcap_wrapper::flush(connection_name);
+            }
+            mcap_wrapper::close_file_connection(connection_name);
+
+            double number_of_messages = double(number_of_bursts) * burst_size * number_of_producers;
+            std::cout << std::setw(14) << api << std::setw(12) << number_of_producers << std::setw(16) << std::fixed << std::setprecision(1) << push_time_ns / number_of_messages
+                      << std::setw(16) << producer_cpu_time_ns / number_of_messages << std::setw(16) << std::setprecision(0) << number_of_messages / push_time_ns * 1e9 << std::endl;
+        }
+    }
+    return 0;
+}
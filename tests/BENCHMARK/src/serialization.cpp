@@ -0,0 +1,58 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include "MCAPWriter.h"
+
+// Push fixed Foxglove messages (logs, calibrations, transforms, image annotations) and report the throughput of the
+// connection, from the first push until the file is closed, for each message encoding.
+double run(mcap_wrapper::MessageEncoding encoding, std::string const &name, unsigned number_of_messages, std::function<void(std::string const &, uint64_t)> const &push)
+{
+    std::string connection_name = "serialization_" + name + (encoding == mcap_wrapper::MessageEncoding::JSON ? "_json" : "_protobuf") + ".mcap";
+    mcap_wrapper::open_file_connection(connection_name);
+    mcap_wrapper::set_connection_message_encoding(connection_name, encoding);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < number_of_messages; i++)
+        push(connection_name, i);
+    mcap_wrapper::close_file_connection(connection_name);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / number_of_messages;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned number_of_messages = 100000;
+
+    Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+    pose(0, 3) = 1.5f;
+    std::array<double, 5> D = {0.1, -0.2, 0.001, 0.002, 0.05};
+    std::array<double, 9> K = {700., 0., 640., 0., 700., 360., 0., 0., 1.};
+    std::array<double, 9> R = {1., 0., 0., 0., 1., 0., 0., 0., 1.};
+    std::array<double, 12> P = {700., 0., 640., 0., 0., 700., 360., 0., 0., 0., 1., 0.};
+    std::vector<mcap_wrapper::CircleAnnotation> circles(4, mcap_wrapper::CircleAnnotation{0, {100, 200}, 20., 2., {1., 0., 0., 1.}, {0., 1., 0., 1.}});
+    std::vector<mcap_wrapper::PointsAnnotation> points(2, mcap_wrapper::PointsAnnotation{0, mcap_wrapper::PointAnnotationType::LINE_STRIP, {{0, 0}, {10, 10}, {20, 0}, {30, 10}}, {1., 1., 0., 1.}, {}, {0., 0., 0., 0.}, 1.});
+    std::vector<mcap_wrapper::TextAnnotation> texts(2, mcap_wrapper::TextAnnotation{0, {50, 50}, "object \"42\"", 12., {1., 1., 1., 1.}, {0., 0., 0., 0.5}});
+
+    std::vector<std::pair<std::string, std::function<void(std::string const &, uint64_t)>>> all_messages = {
+        {"log", [](std::string const &connection_name, uint64_t i)
+         { mcap_wrapper::write_log_to(connection_name, "log", i, mcap_wrapper::LOG_LEVEL::INFO, "benchmark message", "benchmark", __FILE__, __LINE__); }},
+        {"calibration", [&](std::string const &connection_name, uint64_t i)
+         { mcap_wrapper::write_camera_calibration_to(connection_name, "camera", i, "camera", 1280, 720, "plumb_bob", D, K, R, P); }},
+        {"transform", [&](std::string const &connection_name, uint64_t i)
+         { mcap_wrapper::add_frame_transform_to(connection_name, "transform", i, "world", "robot", pose); }},
+        {"annotation", [&](std::string const &connection_name, uint64_t i)
+         { mcap_wrapper::add_image_annotation_to(connection_name, "annotations", circles, points, texts, i); }}};
+
+    std::cout << std::setw(14) << "message" << std::setw(14) << "encoding" << std::setw(16) << "ns/message" << std::setw(16) << "messages/s" << std::endl;
+    for (auto const &[name, push] : all_messages)
+    {
+        for (mcap_wrapper::MessageEncoding encoding : {mcap_wrapper::MessageEncoding::JSON, mcap_wrapper::MessageEncoding::PROTOBUF})
+        {
+            double ns_per_message = run(encoding, name, number_of_messages, push);
+            std::cout << std::setw(14) << name << std::setw(14) << (encoding == mcap_wrapper::MessageEncoding::JSON ? "json" : "protobuf")
+                      << std::setw(16) << std::fixed << std::setprecision(1) << ns_per_message << std::setw(16) << std::setprecision(0) << 1e9 / ns_per_message << std::endl;
+        }
+    }
+    return 0;
+}
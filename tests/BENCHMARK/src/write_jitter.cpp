@@ -0,0 +1,64 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <opencv2/core.hpp>
+#include "MCAPWriter.h"
+
+// Steady rate recording of raw 720p images at 30 images per second to an uncompressed file connection, with default options and
+// with preallocation and write-behind. Report the duration of each push and the latency of the wrapper between push and write,
+// whose tail shows stalls of the writes to disk. Size of the recording is 4 GB by default, or the number of GB given as first argument.
+int main(int argc, char **argv)
+{
+    double recording_size_gb = argc > 1 ? std::atof(argv[1]) : 4.;
+    unsigned images_per_second = 30;
+    cv::Mat image(720, 1280, CV_8UC3);
+    for (int row = 0; row < image.rows; row++)
+    {
+        uint8_t *pixels = image.ptr<uint8_t>(row);
+        for (int column = 0; column < 3 * image.cols; column++)
+            pixels[column] = rand() % 256;
+    }
+    uint64_t number_of_images = recording_size_gb * 1e9 / (image.total() * image.elemSize());
+
+    mcap_wrapper::FileConnectionOptions default_options;
+    default_options.compression = mcap_wrapper::FileCompression::NONE;
+    default_options.compression_threads = 0;
+    mcap_wrapper::FileConnectionOptions tuned_options = default_options;
+    tuned_options.preallocation_size = 64 * 1024 * 1024;
+    tuned_options.write_behind_size = 8 * 1024 * 1024;
+
+    std::cout << std::setw(26) << "options" << std::setw(14) << "push p50 (us)" << std::setw(14) << "push p99 (us)" << std::setw(14) << "push max (ms)"
+              << std::setw(16) << "write p50 (ms)" << std::setw(16) << "write p99 (ms)" << std::setw(10) << "dropped" << std::endl;
+    for (auto const &[name, options] : {std::make_pair(std::string("default"), default_options), std::make_pair(std::string("preallocation+write-behind"), tuned_options)})
+    {
+        std::string file_name = "write_jitter.mcap";
+        std::vector<double> push_durations_us;
+        push_durations_us.reserve(number_of_images);
+        mcap_wrapper::open_file_connection(file_name, options);
+        mcap_wrapper::set_connection_message_encoding(file_name, mcap_wrapper::MessageEncoding::PROTOBUF);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < number_of_images; i++)
+        {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(i * 1000000000 / images_per_second));
+            auto push_start = std::chrono::steady_clock::now();
+            mcap_wrapper::write_raw_image_to(file_name, "/camera", image, i * 1000000000 / images_per_second);
+            push_durations_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - push_start).count());
+        }
+        mcap_wrapper::flush(file_name);
+        mcap_wrapper::ConnectionStatistics statistics;
+        mcap_wrapper::get_connection_statistics(file_name, statistics);
+        mcap_wrapper::close_file_connection(file_name);
+        std::remove(file_name.c_str());
+
+        std::sort(push_durations_us.begin(), push_durations_us.end());
+        std::cout << std::setw(26) << name << std::fixed << std::setprecision(0) << std::setw(14) << push_durations_us[push_durations_us.size() / 2]
+                  << std::setw(14) << push_durations_us[push_durations_us.size() * 99 / 100] << std::setprecision(1) << std::setw(14) << push_durations_us.back() / 1000.
+                  << std::setw(16) << statistics.latency_p50_ns / 1e6 << std::setw(16) << statistics.latency_p99_ns / 1e6 << std::setw(10) << statistics.dropped_messages << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
+#include "MCAPWriter.h"
+#include "MCAPReader.h"
+
+// Small repetitive JSON and logs written to zstd chunks, with or without a dictionary trained on the first 1000 messages of each channel
+// group, for small and default chunks. Report the time to write the file, its size, the ratio to the size of the messages and the time
+// to read it back.
+int main(int argc, char **argv)
+{
+    unsigned number_of_messages = 200000;
+    std::cout << std::setw(12) << "dictionary" << std::setw(12) << "chunk (KB)" << std::setw(14) << "write (ms)" << std::setw(14) << "size (KB)"
+              << std::setw(10) << "ratio" << std::setw(14) << "read (ms)" << std::endl;
+    for (uint64_t chunk_size : {4 * 1024, 16 * 1024, 768 * 1024})
+    {
+        for (unsigned dictionary_training_messages : {0, 1000})
+        {
+            mcap_wrapper::FileConnectionOptions options;
+            options.chunk_size = chunk_size;
+            options.dictionary_training_messages = dictionary_training_messages;
+            options.chunk_groups.resize(1);
+            options.chunk_groups[0].schema_names = {"foxglove.Log"};
+            options.chunk_groups[0].chunk_size = chunk_size;
+            options.chunk_groups[0].dictionary_training_messages = dictionary_training_messages;
+            std::string file_name = "zstd_dictionary_" + std::to_string(chunk_size / 1024) + "_" + std::to_string(dictionary_training_messages) + ".mcap";
+
+            double message_bytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            mcap_wrapper::open_file_connection(file_name, options);
+            mcap_wrapper::ChannelHandle status_channel = mcap_wrapper::open_channel(file_name, "/status", mcap_wrapper::ChannelType::RAW_JSON);
+            for (unsigned i = 0; i < number_of_messages; i++)
+            {
+                uint64_t timestamp = uint64_t(i) * 1000000;
+                std::string status = "{\"header\":{\"frame_id\":\"base_link\",\"sequence\":" + std::to_string(i) + "},\"battery\":{\"voltage\":" + std::to_string(24000 + rand() % 1000) +
+                                     ",\"charging\":false},\"mode\":\"autonomous\",\"errors\":[],\"cpu_load\":" + std::to_string(rand() % 100) + "}";
+                std::string log = "Planner step " + std::to_string(i) + " done in " + std::to_string(rand() % 50) + " ms";
+                message_bytes += status.size() + log.size();
+                mcap_wrapper::write_JSON(status_channel, status, timestamp);
+                mcap_wrapper::write_log_to(file_name, "/log", timestamp, mcap_wrapper::LOG_LEVEL::INFO, log, "planner", "planner.cpp", 128);
+            }
+            mcap_wrapper::close_file_connection(file_name);
+            double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            double size = std::ifstream(file_name, std::ios::binary | std::ios::ate).tellg();
+
+            start = std::chrono::steady_clock::now();
+            mcap_wrapper::MCAPReader reader(file_name);
+            std::string message;
+            unsigned number_of_read_messages = 0;
+            while (reader.get_next_message("/status", message))
+                number_of_read_messages++;
+            while (reader.get_next_logs("/log", message))
+                number_of_read_messages++;
+            double read_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (number_of_read_messages != 2 * number_of_messages)
+                std::cerr << "Only " << number_of_read_messages << " messages read from " << file_name << std::endl;
+
+            std::cout << std::setw(12) << (dictionary_training_messages ? "yes" : "no") << std::setw(12) << chunk_size / 1024 << std::setw(14) << std::fixed << std::setprecision(0)
+                      << write_ms << std::setw(14) << size / 1024 << std::setw(10) << std::setprecision(2) << message_bytes / size << std::setw(14) << std::setprecision(0) << read_ms << std::endl;
+        }
+    }
+    return 0;
+}
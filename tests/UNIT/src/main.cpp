@@ -1,5 +1,8 @@
 #include <iostream>
 #include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
@@ -10,10 +13,28 @@
 double calculatePSNR(const cv::Mat& I1, const cv::Mat& I2);
 double computeMean(const std::vector<double>& vec);
 
+// Allocations are counted for checking that writes on opened channels do not allocate
+std::atomic<uint64_t> number_of_allocations{0};
+thread_local uint64_t number_of_thread_allocations = 0;
+void *operator new(size_t size)
+{
+    number_of_allocations++;
+    number_of_thread_allocations++;
+    void *memory = std::malloc(size);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
 int main(int argc, char **argv)
 {
     // Create MCAP file:
     mcap_wrapper::open_file_connection("test.mcap");
+    mcap_wrapper::TrajectoryOptions trajectory_options;
+    trajectory_options.max_poses = 5;
+    mcap_wrapper::set_connection_trajectory_options("test.mcap", "sample_trajectory", trajectory_options);
 
     // Open reference image:
     std::string reference_image_path = RESSOURCE_PATH; // `RESSOURCE_PATH` is defined in cmake
@@ -48,6 +69,8 @@ int main(int argc, char **argv)
         mean_push_raw_message_runtime.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(json_t1 - json_t0).count());
 
         pushed_json_values.push_back(sample_json);
+        // Invalid JSON is dropped:
+        mcap_wrapper::write_JSON_to_all("sample_json", "{\"invalid\": ", current_timestamp);
         // Image:
         cv::Mat sample_image = reference_image.clone();
         int kernel_size = std::max(3, rand()%7);
@@ -67,6 +90,10 @@ int main(int argc, char **argv)
         mean_push_log_runtime.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(log_t1 - log_t0).count());
 
         pushed_logs.push_back(log);
+        // Position:
+        Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+        pose(0, 3) = i;
+        mcap_wrapper::add_position_to_all("sample_trajectory", current_timestamp, pose);
         // Little sleep
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
@@ -133,8 +160,22 @@ int main(int argc, char **argv)
         }
         pushed_logs.erase(pushed_logs.begin());
     }
+
+    // Only the last 5 poses are kept:
+    std::string serialized_poses;
+    unsigned number_of_trajectories = 0;
+    while(reader.get_next_message("sample_trajectory", serialized_poses)){
+        nlohmann::json poses = nlohmann::json::parse(serialized_poses)["poses"];
+        unsigned expected_size = std::min(number_of_trajectories + 1, 5u);
+        if(poses.size() != expected_size || poses[0]["position"]["x"].get<float>() != float(number_of_trajectories + 1 - expected_size) ||
+           poses.back()["position"]["x"].get<float>() != float(number_of_trajectories)){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved trajectory is not the expected one" << std::endl;
+            return 1;
+        }
+        number_of_trajectories++;
+    }
     
-    if(pushed_images.size() > 0 || pushed_json_values.size() > 0 || pushed_logs.size() == 0){
+    if(pushed_images.size() > 0 || pushed_json_values.size() > 0 || pushed_logs.size() == 0 || number_of_trajectories != iteration_number){
         std::cerr << "Test failed !" << std::endl << "Not all data were read" << std::endl;
         std::cerr << "Number of log not read: " << pushed_logs.size() << std::endl;
         std::cerr << "Number of image not read: " << mean_push_image_runtime.size() << std::endl;
@@ -142,10 +183,600 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // Protobuf and CBOR encodings:
+    mcap_wrapper::open_file_connection("test_protobuf.mcap");
+    mcap_wrapper::set_connection_message_encoding("test_protobuf.mcap", mcap_wrapper::MessageEncoding::PROTOBUF);
+    mcap_wrapper::set_connection_raw_message_encoding("test_protobuf.mcap", mcap_wrapper::MessageEncoding::CBOR);
+    std::vector<std::string> pushed_protobuf_logs;
+    std::vector<nlohmann::json> pushed_cbor_values;
+    std::vector<cv::Mat> pushed_raw_images;
+    mcap_wrapper::ImageChannelOptions png_options;
+    png_options.codec = mcap_wrapper::ImageCodec::PNG;
+    png_options.png_compression_level = 12;
+    if(mcap_wrapper::set_image_channel_options("sample_png_image", png_options)){
+        std::cerr << "Test failed !" << std::endl << "REASON: invalid image options were accepted" << std::endl;
+        return 1;
+    }
+    png_options.png_compression_level = 1;
+    mcap_wrapper::set_image_channel_options("sample_png_image", png_options);
+    trajectory_options = mcap_wrapper::TrajectoryOptions();
+    trajectory_options.decimation = 2;
+    mcap_wrapper::set_connection_trajectory_options("test_protobuf.mcap", "sample_trajectory", trajectory_options);
+    std::vector<uchar> reference_png;
+    cv::imencode(".png", reference_image, reference_png);
+    for (unsigned i = 0; i < iteration_number; i++)
+    {
+        uint64_t current_timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+        nlohmann::json sample_json;
+        sample_json["random_value"] = rand()%1024;
+        sample_json["float_value"] = rand() / 7.;
+        mcap_wrapper::write_JSON_to("test_protobuf.mcap", "sample_json", sample_json.dump(), current_timestamp);
+        pushed_cbor_values.push_back(sample_json);
+        mcap_wrapper::write_image_to("test_protobuf.mcap", "sample_image", reference_image, current_timestamp);
+        mcap_wrapper::write_image_to("test_protobuf.mcap", "sample_png_image", reference_image, current_timestamp);
+        mcap_wrapper::write_compressed_image_to("test_protobuf.mcap", "sample_compressed_image", reference_png.data(), reference_png.size(), "png", current_timestamp);
+        std::string protobuf_log = "This is a protobuf log: #" + std::to_string(i);
+        mcap_wrapper::write_log_to("test_protobuf.mcap", "sample_log", current_timestamp, mcap_wrapper::LOG_LEVEL::INFO, protobuf_log, "LOG", "tests/UNIT/src/main.cpp", 42);
+        pushed_protobuf_logs.push_back(protobuf_log);
+        cv::Mat depth_image(48, 64, CV_16UC1);
+        for (int row = 0; row < depth_image.rows; row++)
+            for (int col = 0; col < depth_image.cols; col++)
+                depth_image.ptr<uint16_t>(row)[col] = rand() % 65536;
+        mcap_wrapper::write_raw_image_to("test_protobuf.mcap", "sample_depth", depth_image, current_timestamp);
+        pushed_raw_images.push_back(depth_image);
+        Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+        pose(0, 3) = i;
+        mcap_wrapper::add_position_to("test_protobuf.mcap", "sample_trajectory", current_timestamp, pose);
+    }
+    mcap_wrapper::close_file_connection("test_protobuf.mcap");
+
+    mcap_wrapper::MCAPReader protobuf_reader("test_protobuf.mcap");
+    unsigned number_of_protobuf_images = 0;
+    while(protobuf_reader.get_next_image("sample_image", image)){
+        if(calculatePSNR(image, reference_image) < 45){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved protobuf image is not the same" << std::endl;
+            return 1;
+        }
+        number_of_protobuf_images++;
+    }
+    unsigned number_of_png_images = 0;
+    while(protobuf_reader.get_next_image("sample_png_image", image)){
+        // PNG is lossless:
+        if(image.type() != reference_image.type() || image.size() != reference_image.size() ||
+           std::memcmp(image.data, reference_image.data, image.total() * image.elemSize()) != 0){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved PNG image is not the same" << std::endl;
+            return 1;
+        }
+        number_of_png_images++;
+    }
+    unsigned number_of_compressed_images = 0;
+    while(protobuf_reader.get_next_image("sample_compressed_image", image)){
+        // Given PNG is written as is:
+        if(image.type() != reference_image.type() || image.size() != reference_image.size() ||
+           std::memcmp(image.data, reference_image.data, image.total() * image.elemSize()) != 0){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved compressed image is not the same" << std::endl;
+            return 1;
+        }
+        number_of_compressed_images++;
+    }
+    while(protobuf_reader.get_next_logs("sample_log", log)){
+        if(pushed_protobuf_logs.empty() || pushed_protobuf_logs[0] != log){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved protobuf log is not the same" << std::endl;
+            return 1;
+        }
+        pushed_protobuf_logs.erase(pushed_protobuf_logs.begin());
+    }
+    while(protobuf_reader.get_next_message("sample_json", serialized_json)){
+        if(pushed_cbor_values.empty() || pushed_cbor_values[0].dump() != nlohmann::json::parse(serialized_json).dump()){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved CBOR json is not the same" << std::endl;
+            return 1;
+        }
+        pushed_cbor_values.erase(pushed_cbor_values.begin());
+    }
+    cv::Mat depth_image;
+    while(protobuf_reader.get_next_image("sample_depth", depth_image)){
+        // Raw images are lossless:
+        if(pushed_raw_images.empty() || depth_image.type() != CV_16UC1 || depth_image.rows != pushed_raw_images[0].rows || depth_image.cols != pushed_raw_images[0].cols ||
+           std::memcmp(depth_image.data, pushed_raw_images[0].data, depth_image.total() * depth_image.elemSize()) != 0){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved raw image is not the same" << std::endl;
+            return 1;
+        }
+        pushed_raw_images.erase(pushed_raw_images.begin());
+    }
+    // One pose out of two is kept, latest one is always written:
+    unsigned number_of_protobuf_trajectories = 0;
+    while(protobuf_reader.get_next_message("sample_trajectory", serialized_json)){
+        nlohmann::json poses = nlohmann::json::parse(serialized_json)["poses"];
+        unsigned i = number_of_protobuf_trajectories;
+        if(poses.size() != i / 2 + 1 + i % 2 || poses.back()["position"]["x"].get<float>() != float(i) || poses[0]["position"]["x"].get<float>() != 0.f){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved protobuf trajectory is not the expected one" << std::endl;
+            return 1;
+        }
+        number_of_protobuf_trajectories++;
+    }
+    if(number_of_protobuf_images != iteration_number || number_of_protobuf_trajectories != iteration_number || number_of_png_images != iteration_number || number_of_compressed_images != iteration_number || pushed_protobuf_logs.size() > 0 || pushed_cbor_values.size() > 0 || pushed_raw_images.size() > 0){
+        std::cerr << "Test failed !" << std::endl << "REASON: not all protobuf data were read" << std::endl;
+        return 1;
+    }
+
+    // Channel handles:
+    mcap_wrapper::open_file_connection("test_handle.mcap");
+    mcap_wrapper::ChannelHandle log_channel = mcap_wrapper::open_channel("test_handle.mcap", "sample_log", mcap_wrapper::ChannelType::LOG);
+    mcap_wrapper::ChannelHandle json_channel = mcap_wrapper::open_channel("test_handle.mcap", "sample_json", mcap_wrapper::ChannelType::RAW_JSON);
+    mcap_wrapper::ChannelHandle transform_channel = mcap_wrapper::open_channel("test_handle.mcap", "sample_transform", mcap_wrapper::ChannelType::TRANSFORM);
+    if(log_channel == mcap_wrapper::INVALID_CHANNEL_HANDLE || json_channel == mcap_wrapper::INVALID_CHANNEL_HANDLE || transform_channel == mcap_wrapper::INVALID_CHANNEL_HANDLE ||
+       mcap_wrapper::open_channel("unknown_connection", "sample_log", mcap_wrapper::ChannelType::LOG) != mcap_wrapper::INVALID_CHANNEL_HANDLE ||
+       mcap_wrapper::write_log(json_channel, 0, mcap_wrapper::LOG_LEVEL::INFO, "", "", "", 0) || mcap_wrapper::write_JSON(mcap_wrapper::INVALID_CHANNEL_HANDLE, "{}", 0)){
+        std::cerr << "Test failed !" << std::endl << "REASON: invalid channel handles were accepted" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> pushed_handle_logs;
+    std::vector<nlohmann::json> pushed_handle_json;
+    for (unsigned i = 0; i < iteration_number; i++)
+    {
+        uint64_t current_timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+        std::string handle_log = "This is a handle log: #" + std::to_string(i);
+        mcap_wrapper::write_log(log_channel, current_timestamp, mcap_wrapper::LOG_LEVEL::INFO, handle_log, "LOG", "tests/UNIT/src/main.cpp", 42);
+        pushed_handle_logs.push_back(handle_log);
+        nlohmann::json sample_json;
+        sample_json["random_value"] = rand()%1024;
+        mcap_wrapper::write_JSON(json_channel, sample_json.dump(), current_timestamp);
+        pushed_handle_json.push_back(sample_json);
+        Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+        pose(0, 3) = i;
+        mcap_wrapper::add_frame_transform(transform_channel, current_timestamp, "world", "robot", pose);
+    }
+    mcap_wrapper::close_file_connection("test_handle.mcap");
+    if(mcap_wrapper::write_log(log_channel, 0, mcap_wrapper::LOG_LEVEL::INFO, "", "", "", 0) || mcap_wrapper::close_channel(json_channel)){
+        std::cerr << "Test failed !" << std::endl << "REASON: handles of a closed connection were accepted" << std::endl;
+        return 1;
+    }
+    // Slots of closed channels and connections are reused, more channels than slots are opened over time:
+    mcap_wrapper::open_file_connection("test_handle_reopen.mcap");
+    for (unsigned i = 0; i < 5000; i++)
+    {
+        mcap_wrapper::ChannelHandle reopened_channel = mcap_wrapper::open_channel("test_handle_reopen.mcap", "sample_log", mcap_wrapper::ChannelType::LOG);
+        if(!mcap_wrapper::write_log(reopened_channel, i, mcap_wrapper::LOG_LEVEL::INFO, "reopened", "", "", 0) || !mcap_wrapper::close_channel(reopened_channel) ||
+           mcap_wrapper::write_log(reopened_channel, i, mcap_wrapper::LOG_LEVEL::INFO, "reopened", "", "", 0)){
+            std::cerr << "Test failed !" << std::endl << "REASON: channel opened " << i << " times could not be written and closed" << std::endl;
+            return 1;
+        }
+    }
+    for (unsigned i = 0; i < 5000; i++)
+    {
+        mcap_wrapper::open_file_connection("test_handle_reopen.mcap");
+        mcap_wrapper::BatchItem reopened_item;
+        reopened_item.channel_name = "sample_json";
+        reopened_item.text = "{\"value\": 1}";
+        if(!mcap_wrapper::write_batch("test_handle_reopen.mcap", &reopened_item, 1)){
+            std::cerr << "Test failed !" << std::endl << "REASON: batch written to a connection opened " << i << " times failed" << std::endl;
+            return 1;
+        }
+    }
+    mcap_wrapper::close_file_connection("test_handle_reopen.mcap");
+
+    mcap_wrapper::MCAPReader handle_reader("test_handle.mcap");
+    while(handle_reader.get_next_logs("sample_log", log)){
+        if(pushed_handle_logs.empty() || pushed_handle_logs[0] != log){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved handle log is not the same" << std::endl;
+            return 1;
+        }
+        pushed_handle_logs.erase(pushed_handle_logs.begin());
+    }
+    while(handle_reader.get_next_message("sample_json", serialized_json)){
+        if(pushed_handle_json.empty() || pushed_handle_json[0].dump() != nlohmann::json::parse(serialized_json).dump()){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved handle json is not the same" << std::endl;
+            return 1;
+        }
+        pushed_handle_json.erase(pushed_handle_json.begin());
+    }
+    unsigned number_of_handle_transforms = 0;
+    while(handle_reader.get_next_message("sample_transform", serialized_json)){
+        if(nlohmann::json::parse(serialized_json)["translation"]["x"].get<float>() != float(number_of_handle_transforms)){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved handle transform is not the same" << std::endl;
+            return 1;
+        }
+        number_of_handle_transforms++;
+    }
+    if(pushed_handle_logs.size() > 0 || pushed_handle_json.size() > 0 || number_of_handle_transforms != iteration_number){
+        std::cerr << "Test failed !" << std::endl << "REASON: not all handle data were read" << std::endl;
+        return 1;
+    }
+
+    // Batch of heterogeneous messages:
+    mcap_wrapper::open_file_connection("test_batch.mcap");
+    std::vector<std::string> batch_json(iteration_number);
+    std::vector<mcap_wrapper::BatchItem> batch(3 * iteration_number);
+    for (unsigned i = 0; i < iteration_number; i++)
+    {
+        batch_json[i] = "{\"value\": " + std::to_string(i) + "}";
+        batch[3 * i].type = mcap_wrapper::ChannelType::RAW_JSON;
+        batch[3 * i].channel_name = "batch_json";
+        batch[3 * i].timestamp = i;
+        batch[3 * i].text = batch_json[i];
+        batch[3 * i + 1].type = mcap_wrapper::ChannelType::LOG;
+        batch[3 * i + 1].channel_name = "batch_log";
+        batch[3 * i + 1].timestamp = i;
+        batch[3 * i + 1].text = "This is a batch log";
+        batch[3 * i + 1].name = "LOG";
+        batch[3 * i + 1].file = "tests/UNIT/src/main.cpp";
+        batch[3 * i + 2].type = mcap_wrapper::ChannelType::TRANSFORM;
+        batch[3 * i + 2].channel_name = "batch_transform";
+        batch[3 * i + 2].timestamp = i;
+        batch[3 * i + 2].text = "world";
+        batch[3 * i + 2].name = "robot";
+        batch[3 * i + 2].pose(0, 3) = i;
+    }
+    if(!mcap_wrapper::write_batch("test_batch.mcap", batch) || mcap_wrapper::write_batch("unknown_connection", batch)){
+        std::cerr << "Test failed !" << std::endl << "REASON: write_batch failed" << std::endl;
+        return 1;
+    }
+    mcap_wrapper::close_file_connection("test_batch.mcap");
+    mcap_wrapper::MCAPReader batch_reader("test_batch.mcap");
+    unsigned number_of_batch_json = 0, number_of_batch_logs = 0, number_of_batch_transforms = 0;
+    while(batch_reader.get_next_message("batch_json", serialized_json)){
+        if(nlohmann::json::parse(serialized_json)["value"].get<unsigned>() != number_of_batch_json++){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved batch json is not the same" << std::endl;
+            return 1;
+        }
+    }
+    while(batch_reader.get_next_logs("batch_log", log))
+        number_of_batch_logs++;
+    while(batch_reader.get_next_message("batch_transform", serialized_json)){
+        if(nlohmann::json::parse(serialized_json)["translation"]["x"].get<float>() != float(number_of_batch_transforms++)){
+            std::cerr << "Test failed !" << std::endl << "REASON: retrieved batch transform is not the same" << std::endl;
+            return 1;
+        }
+    }
+    if(number_of_batch_json != iteration_number || number_of_batch_logs != iteration_number || number_of_batch_transforms != iteration_number){
+        std::cerr << "Test failed !" << std::endl << "REASON: not all batch data were read" << std::endl;
+        return 1;
+    }
+
+    // Sync mode, write futures and flush:
+    mcap_wrapper::open_file_connection("test_sync.mcap");
+    mcap_wrapper::set_connection_to_be_sync("test_sync.mcap", true);
+    mcap_wrapper::set_connection_fsync_policy("test_sync.mcap", mcap_wrapper::FsyncPolicy::ON_FLUSH);
+    mcap_wrapper::ConnectionStatistics sync_statistics;
+    std::vector<double> sync_write_runtime;
+    for (unsigned i = 0; i < 100; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        mcap_wrapper::write_log_to("test_sync.mcap", "sync_log", i, mcap_wrapper::LOG_LEVEL::INFO, "This is a sync log", "LOG", "tests/UNIT/src/main.cpp", 42);
+        sync_write_runtime.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count());
+        mcap_wrapper::get_connection_statistics("test_sync.mcap", sync_statistics);
+        if(sync_statistics.written_messages != i + 1){
+            std::cerr << "Test failed !" << std::endl << "REASON: sync write returned before its message was written" << std::endl;
+            return 1;
+        }
+    }
+    mcap_wrapper::set_connection_to_be_sync("test_sync.mcap", false);
+    mcap_wrapper::write_log_to("test_sync.mcap", "sync_log", 100, mcap_wrapper::LOG_LEVEL::INFO, "This is an async log", "LOG", "tests/UNIT/src/main.cpp", 42);
+    std::future<void> write_future;
+    if(!mcap_wrapper::get_write_future("test_sync.mcap", write_future) || write_future.wait_for(std::chrono::seconds(5)) != std::future_status::ready){
+        std::cerr << "Test failed !" << std::endl << "REASON: write future was not completed" << std::endl;
+        return 1;
+    }
+    std::ifstream sync_file_before_flush("test_sync.mcap", std::ios::binary | std::ios::ate);
+    std::streamoff size_before_flush = sync_file_before_flush.tellg();
+    if(!mcap_wrapper::flush("test_sync.mcap") || mcap_wrapper::flush("unknown_connection")){
+        std::cerr << "Test failed !" << std::endl << "REASON: flush failed" << std::endl;
+        return 1;
+    }
+    std::ifstream sync_file_after_flush("test_sync.mcap", std::ios::binary | std::ios::ate);
+    if(sync_file_after_flush.tellg() <= size_before_flush){
+        std::cerr << "Test failed !" << std::endl << "REASON: flushed messages were not written to the file" << std::endl;
+        return 1;
+    }
+    // Sync batch of images and logs returns once the whole batch is written:
+    mcap_wrapper::set_connection_to_be_sync("test_sync.mcap", true);
+    std::vector<mcap_wrapper::BatchItem> sync_batch(8);
+    for (unsigned i = 0; i < sync_batch.size(); i++)
+    {
+        sync_batch[i].type = i % 2 ? mcap_wrapper::ChannelType::LOG : mcap_wrapper::ChannelType::IMAGE;
+        sync_batch[i].channel_name = i % 2 ? "sync_log" : "sync_image";
+        sync_batch[i].timestamp = 200 + i;
+        sync_batch[i].text = "This is a sync batch log";
+        sync_batch[i].name = "LOG";
+        sync_batch[i].image = reference_image;
+    }
+    mcap_wrapper::get_connection_statistics("test_sync.mcap", sync_statistics);
+    uint64_t written_messages_before_batch = sync_statistics.written_messages;
+    mcap_wrapper::write_batch("test_sync.mcap", sync_batch);
+    mcap_wrapper::get_connection_statistics("test_sync.mcap", sync_statistics);
+    if(sync_statistics.written_messages != written_messages_before_batch + sync_batch.size()){
+        std::cerr << "Test failed !" << std::endl << "REASON: sync batch returned before its messages were written" << std::endl;
+        return 1;
+    }
+    mcap_wrapper::close_file_connection("test_sync.mcap");
+
+    // Writes on opened channels do not allocate once warm:
+    mcap_wrapper::open_file_connection("test_allocation.mcap");
+    log_channel = mcap_wrapper::open_channel("test_allocation.mcap", "sample_log", mcap_wrapper::ChannelType::LOG);
+    json_channel = mcap_wrapper::open_channel("test_allocation.mcap", "sample_json", mcap_wrapper::ChannelType::RAW_JSON);
+    transform_channel = mcap_wrapper::open_channel("test_allocation.mcap", "sample_transform", mcap_wrapper::ChannelType::TRANSFORM);
+    std::string reused_json;
+    Eigen::Matrix4f allocation_pose = Eigen::Matrix4f::Identity();
+    unsigned number_of_warm_up_messages = 20000, number_of_counted_messages = 1000;
+    uint64_t number_of_producer_allocations = 0, number_of_total_allocations = 0;
+    for (unsigned i = 0; i < number_of_warm_up_messages + number_of_counted_messages; i++)
+    {
+        if(i == number_of_warm_up_messages){
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            number_of_producer_allocations = number_of_thread_allocations;
+            number_of_total_allocations = number_of_allocations;
+        }
+        mcap_wrapper::write_log(log_channel, i, mcap_wrapper::LOG_LEVEL::INFO, "This is a log that does not allocate", "LOG", "tests/UNIT/src/main.cpp", 42);
+        reused_json.append("{\"value\": ");
+        reused_json.append(i % 2 ? "1" : "2");
+        reused_json.append(", \"fixed_value\": \"This is a fixed value\"}");
+        mcap_wrapper::write_JSON(json_channel, std::move(reused_json), i);
+        allocation_pose(0, 3) = i;
+        mcap_wrapper::add_frame_transform(transform_channel, i, "world", "robot", allocation_pose);
+    }
+    number_of_producer_allocations = number_of_thread_allocations - number_of_producer_allocations;
+    number_of_total_allocations = number_of_allocations - number_of_total_allocations;
+    mcap_wrapper::close_file_connection("test_allocation.mcap");
+    if(number_of_producer_allocations != 0){
+        std::cerr << "Test failed !" << std::endl << "REASON: " << number_of_producer_allocations << " allocations for " << 3 * number_of_counted_messages << " writes on opened channels" << std::endl;
+        return 1;
+    }
+    mcap_wrapper::PayloadPoolStatistics payload_pool_statistics;
+    mcap_wrapper::get_payload_pool_statistics(payload_pool_statistics);
+    if(payload_pool_statistics.number_of_hits == 0 || payload_pool_statistics.number_of_hits > payload_pool_statistics.number_of_acquisitions || payload_pool_statistics.max_pooled_bytes < payload_pool_statistics.pooled_bytes){
+        std::cerr << "Test failed !" << std::endl << "REASON: inconsistent payload pool statistics: " << payload_pool_statistics.number_of_hits << " hits for " << payload_pool_statistics.number_of_acquisitions << " acquisitions" << std::endl;
+        return 1;
+    }
+
+    // Compression and chunking of file connections:
+    mcap_wrapper::FileConnectionOptions uncompressed_options;
+    uncompressed_options.compression = mcap_wrapper::FileCompression::NONE;
+    uncompressed_options.chunk_size = 0;
+    mcap_wrapper::FileConnectionOptions archive_options;
+    archive_options.compression_level = mcap_wrapper::FileCompressionLevel::SLOWEST;
+    archive_options.chunk_size = 4 * 1024 * 1024;
+    archive_options.chunk_crc = false;
+    archive_options.compression_threads = 0;
+    // Small chunks, many of them compressed at the same time and written in order:
+    mcap_wrapper::FileConnectionOptions pipelined_options;
+    pipelined_options.chunk_size = 1024;
+    pipelined_options.compression_threads = 4;
+    // Small io_uring buffers, reused many times, with and without direct IO:
+    mcap_wrapper::FileConnectionOptions uring_options;
+    uring_options.write_method = mcap_wrapper::FileWriteMethod::IO_URING;
+    uring_options.io_buffer_size = 4096;
+    uring_options.io_buffer_count = 2;
+    mcap_wrapper::FileConnectionOptions uring_direct_options = uring_options;
+    uring_direct_options.direct_io = true;
+    // Small preallocation extents and write-behind windows, crossed many times:
+    mcap_wrapper::FileConnectionOptions preallocated_options;
+    preallocated_options.preallocation_size = 64 * 1024;
+    preallocated_options.write_behind_size = 16 * 1024;
+    mcap_wrapper::FileConnectionOptions uring_preallocated_options = uring_options;
+    uring_preallocated_options.preallocation_size = preallocated_options.preallocation_size;
+    uring_preallocated_options.write_behind_size = preallocated_options.write_behind_size;
+    for (auto const &[file_name, file_options] : {std::make_pair(std::string("test_uncompressed.mcap"), uncompressed_options), std::make_pair(std::string("test_archive.mcap"), archive_options),
+                                                  std::make_pair(std::string("test_pipelined.mcap"), pipelined_options), std::make_pair(std::string("test_uring.mcap"), uring_options),
+                                                  std::make_pair(std::string("test_uring_direct.mcap"), uring_direct_options), std::make_pair(std::string("test_preallocated.mcap"), preallocated_options),
+                                                  std::make_pair(std::string("test_uring_preallocated.mcap"), uring_preallocated_options)})
+    {
+        if(!mcap_wrapper::open_file_connection(file_name, file_options)){
+            std::cerr << "Test failed !" << std::endl << "REASON: could not open " << file_name << " with file options" << std::endl;
+            return 1;
+        }
+        for (unsigned i = 0; i < iteration_number; i++)
+        {
+            mcap_wrapper::write_log_to(file_name, "options_log", i, mcap_wrapper::LOG_LEVEL::INFO, "This is a log written with file options", "LOG", "tests/UNIT/src/main.cpp", 42);
+            // Data written so far reach the file, including a partially filled buffer
+            if (i == iteration_number / 2)
+                mcap_wrapper::flush(file_name);
+        }
+        mcap_wrapper::close_file_connection(file_name);
+        mcap_wrapper::MCAPReader options_reader(file_name);
+        unsigned number_of_options_logs = 0;
+        while(options_reader.get_next_logs("options_log", log))
+            number_of_options_logs++;
+        if(number_of_options_logs != iteration_number){
+            std::cerr << "Test failed !" << std::endl << "REASON: " << number_of_options_logs << " logs read from " << file_name << " instead of " << iteration_number << std::endl;
+            return 1;
+        }
+    }
+
+    // A channel flooding a full queue only replaces its own waiting messages, the waiting message of a quiet channel is kept:
+    mcap_wrapper::set_default_connection_queue_capacity(4);
+    mcap_wrapper::open_file_connection("test_keep_latest.mcap");
+    mcap_wrapper::set_default_connection_queue_capacity(4096);
+    mcap_wrapper::set_connection_backpressure_policy("test_keep_latest.mcap", mcap_wrapper::BackpressurePolicy::KEEP_LATEST_PER_CHANNEL);
+    mcap_wrapper::set_connection_batching_window("test_keep_latest.mcap", 200000);
+    mcap_wrapper::write_log_to("test_keep_latest.mcap", "quiet_log", 0, mcap_wrapper::LOG_LEVEL::INFO, "quiet", "LOG", "tests/UNIT/src/main.cpp", 42);
+    for (unsigned i = 0; i < 1000; i++)
+        mcap_wrapper::write_log_to("test_keep_latest.mcap", "flood_log", i + 1, mcap_wrapper::LOG_LEVEL::INFO, "flood #" + std::to_string(i), "LOG", "tests/UNIT/src/main.cpp", 42);
+    mcap_wrapper::flush("test_keep_latest.mcap");
+    mcap_wrapper::ConnectionStatistics keep_latest_statistics;
+    mcap_wrapper::get_connection_statistics("test_keep_latest.mcap", keep_latest_statistics);
+    mcap_wrapper::close_file_connection("test_keep_latest.mcap");
+    {
+        mcap_wrapper::MCAPReader keep_latest_reader("test_keep_latest.mcap");
+        unsigned number_of_quiet_logs = 0;
+        while(keep_latest_reader.get_next_logs("quiet_log", log))
+            number_of_quiet_logs++;
+        std::string last_flood_log;
+        while(keep_latest_reader.get_next_logs("flood_log", log))
+            last_flood_log = log;
+        if(!keep_latest_statistics.dropped_messages || number_of_quiet_logs != 1 || last_flood_log != "flood #999"){
+            std::cerr << "Test failed !" << std::endl << "REASON: flooding channel evicted quiet channel (" << number_of_quiet_logs << " quiet logs) or lost its latest message (" << last_flood_log << ")" << std::endl;
+            return 1;
+        }
+    }
+
+    mcap_wrapper::FileConnectionOptions grouped_options;
+    grouped_options.chunk_size = 1024;
+    grouped_options.chunk_groups.resize(2);
+    grouped_options.chunk_groups[0].schema_names = {"foxglove.Log"};
+    grouped_options.chunk_groups[0].compression = mcap_wrapper::FileCompression::NONE;
+    grouped_options.chunk_groups[0].chunk_size = 2048;
+    grouped_options.chunk_groups[1].channel_names = {"grouped_json"};
+    grouped_options.chunk_groups[1].chunk_size = 512;
+    if(!mcap_wrapper::open_file_connection("test_grouped.mcap", grouped_options)){
+        std::cerr << "Test failed !" << std::endl << "REASON: could not open test_grouped.mcap with chunk groups" << std::endl;
+        return 1;
+    }
+    for (unsigned i = 0; i < iteration_number; i++)
+    {
+        mcap_wrapper::write_log_to("test_grouped.mcap", "grouped_log", i, mcap_wrapper::LOG_LEVEL::INFO, "This is a log written in its own chunks", "LOG", "tests/UNIT/src/main.cpp", 42);
+        mcap_wrapper::write_JSON_to("test_grouped.mcap", "grouped_json", "{\"value\":" + std::to_string(i) + "}", i);
+        mcap_wrapper::write_JSON_to("test_grouped.mcap", "ungrouped_json", "{\"value\":" + std::to_string(i) + "}", i);
+    }
+    mcap_wrapper::close_file_connection("test_grouped.mcap");
+    mcap_wrapper::MCAPReader grouped_reader("test_grouped.mcap");
+    unsigned number_of_grouped_logs = 0;
+    while(grouped_reader.get_next_logs("grouped_log", log))
+        number_of_grouped_logs++;
+    for (std::string json_channel : {"grouped_json", "ungrouped_json"})
+    {
+        unsigned number_of_grouped_json = 0;
+        while(grouped_reader.get_next_message(json_channel, serialized_json)){
+            if(nlohmann::json::parse(serialized_json)["value"] != number_of_grouped_json){
+                std::cerr << "Test failed !" << std::endl << "REASON: message " << number_of_grouped_json << " of " << json_channel << " read out of order" << std::endl;
+                return 1;
+            }
+            number_of_grouped_json++;
+        }
+        if(number_of_grouped_json != iteration_number){
+            std::cerr << "Test failed !" << std::endl << "REASON: " << number_of_grouped_json << " messages of " << json_channel << " read instead of " << iteration_number << std::endl;
+            return 1;
+        }
+    }
+    if(number_of_grouped_logs != iteration_number){
+        std::cerr << "Test failed !" << std::endl << "REASON: " << number_of_grouped_logs << " logs read from test_grouped.mcap instead of " << iteration_number << std::endl;
+        return 1;
+    }
+
+    // Small JSON and logs compressed with zstd dictionaries trained on their first messages:
+    mcap_wrapper::FileConnectionOptions dictionary_options;
+    dictionary_options.chunk_size = 4096;
+    dictionary_options.dictionary_training_messages = 100;
+    dictionary_options.chunk_groups.resize(1);
+    dictionary_options.chunk_groups[0].schema_names = {"foxglove.Log"};
+    dictionary_options.chunk_groups[0].dictionary_training_messages = 50;
+    dictionary_options.chunk_groups[0].chunk_size = 4096;
+    unsigned number_of_dictionary_messages = 1000;
+    if(!mcap_wrapper::open_file_connection("test_dictionary.mcap", dictionary_options)){
+        std::cerr << "Test failed !" << std::endl << "REASON: could not open test_dictionary.mcap with zstd dictionaries" << std::endl;
+        return 1;
+    }
+    for (unsigned i = 0; i < number_of_dictionary_messages; i++)
+    {
+        mcap_wrapper::write_log_to("test_dictionary.mcap", "dictionary_log", i, mcap_wrapper::LOG_LEVEL::INFO, "Log number " + std::to_string(i) + " compressed with a dictionary", "LOG", "tests/UNIT/src/main.cpp", 42);
+        mcap_wrapper::write_JSON_to("test_dictionary.mcap", "dictionary_json", "{\"value\":" + std::to_string(i) + ",\"status\":\"nominal\",\"temperature\":" + std::to_string(rand() % 100) + "}", i);
+    }
+    mcap_wrapper::close_file_connection("test_dictionary.mcap");
+    mcap_wrapper::MCAPReader dictionary_reader("test_dictionary.mcap");
+    unsigned number_of_dictionary_logs = 0;
+    while(dictionary_reader.get_next_logs("dictionary_log", log)){
+        if(log != "Log number " + std::to_string(number_of_dictionary_logs) + " compressed with a dictionary"){
+            std::cerr << "Test failed !" << std::endl << "REASON: log " << number_of_dictionary_logs << " of test_dictionary.mcap is corrupted" << std::endl;
+            return 1;
+        }
+        number_of_dictionary_logs++;
+    }
+    unsigned number_of_dictionary_json = 0;
+    while(dictionary_reader.get_next_message("dictionary_json", serialized_json)){
+        if(nlohmann::json::parse(serialized_json)["value"] != number_of_dictionary_json){
+            std::cerr << "Test failed !" << std::endl << "REASON: JSON " << number_of_dictionary_json << " of test_dictionary.mcap is corrupted" << std::endl;
+            return 1;
+        }
+        number_of_dictionary_json++;
+    }
+    if(number_of_dictionary_logs != number_of_dictionary_messages || number_of_dictionary_json != number_of_dictionary_messages){
+        std::cerr << "Test failed !" << std::endl << "REASON: " << number_of_dictionary_logs << " logs and " << number_of_dictionary_json << " JSON read from test_dictionary.mcap instead of " << number_of_dictionary_messages << std::endl;
+        return 1;
+    }
+    // Messages written out of log time order, across chunks, are read in the order they were written:
+    mcap_wrapper::FileConnectionOptions log_time_options;
+    log_time_options.chunk_size = 2048;
+    unsigned number_of_log_time_messages = 1000;
+    mcap_wrapper::open_file_connection("test_log_time.mcap", log_time_options);
+    for (unsigned i = 0; i < number_of_log_time_messages; i++)
+    {
+        uint64_t log_time = (i * 7919) % number_of_log_time_messages;
+        mcap_wrapper::write_JSON_to("test_log_time.mcap", "log_time_json", "{\"value\":" + std::to_string(i) + "}", log_time);
+    }
+    mcap_wrapper::close_file_connection("test_log_time.mcap");
+    mcap_wrapper::MCAPReader log_time_reader("test_log_time.mcap");
+    unsigned number_of_log_time_json = 0;
+    while(log_time_reader.get_next_message("log_time_json", serialized_json)){
+        if(nlohmann::json::parse(serialized_json)["value"] != number_of_log_time_json){
+            std::cerr << "Test failed !" << std::endl << "REASON: message " << number_of_log_time_json << " of test_log_time.mcap is not in write order" << std::endl;
+            return 1;
+        }
+        number_of_log_time_json++;
+    }
+    if(number_of_log_time_json != number_of_log_time_messages){
+        std::cerr << "Test failed !" << std::endl << "REASON: " << number_of_log_time_json << " messages read from test_log_time.mcap instead of " << number_of_log_time_messages << std::endl;
+        return 1;
+    }
+    dictionary_options.compression = mcap_wrapper::FileCompression::NONE;
+    if(mcap_wrapper::open_file_connection("test_dictionary_none.mcap", dictionary_options)){
+        std::cerr << "Test failed !" << std::endl << "REASON: dictionary accepted without zstd compression" << std::endl;
+        return 1;
+    }
+
+    // Connections opened and closed while other threads write to them:
+    unsigned number_of_registry_producers = 16, number_of_registry_cycles = 32, number_of_registry_connections = 4;
+    std::atomic<bool> registry_producers_continue{true};
+    std::atomic<uint64_t> number_of_accepted_registry_logs{0};
+    std::vector<std::thread> registry_producers;
+    for (unsigned producer = 0; producer < number_of_registry_producers; producer++)
+    {
+        registry_producers.emplace_back([&, producer]()
+                                        {
+            std::string connection_name = "registry_" + std::to_string(producer % number_of_registry_connections);
+            for (uint64_t i = 0; registry_producers_continue; i++)
+            {
+                if (mcap_wrapper::write_log_to(connection_name, "registry_log", i, mcap_wrapper::LOG_LEVEL::INFO, "This is a log written while connections are opened and closed", "LOG", "tests/UNIT/src/main.cpp", 42))
+                    number_of_accepted_registry_logs++;
+                if (i % 8 == 0)
+                    mcap_wrapper::write_log_to_all("registry_all_log", i, mcap_wrapper::LOG_LEVEL::INFO, "This is a log written to all connections", "LOG", "tests/UNIT/src/main.cpp", 42);
+            } });
+    }
+    for (unsigned cycle = 0; cycle < number_of_registry_cycles; cycle++)
+    {
+        std::string connection_name = "registry_" + std::to_string(cycle % number_of_registry_connections);
+        // Opening a connection with the name of an opened one replaces it
+        mcap_wrapper::open_file_connection("test_registry_" + std::to_string(cycle) + ".mcap", connection_name);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (cycle % 2)
+            mcap_wrapper::close_file_connection(connection_name);
+    }
+    for (unsigned connection = 0; connection < number_of_registry_connections; connection++)
+        mcap_wrapper::close_file_connection("registry_" + std::to_string(connection));
+    registry_producers_continue = false;
+    for (auto &registry_producer : registry_producers)
+        registry_producer.join();
+    if(mcap_wrapper::write_log_to("registry_0", "registry_log", 0, mcap_wrapper::LOG_LEVEL::INFO, "This is a log to a closed connection", "LOG", "tests/UNIT/src/main.cpp", 42) || mcap_wrapper::flush("registry_0")){
+        std::cerr << "Test failed !" << std::endl << "REASON: closed connection is still registered" << std::endl;
+        return 1;
+    }
+    uint64_t number_of_read_registry_logs = 0;
+    for (unsigned cycle = 0; cycle < number_of_registry_cycles; cycle++)
+    {
+        mcap_wrapper::MCAPReader registry_reader("test_registry_" + std::to_string(cycle) + ".mcap");
+        while(registry_reader.get_next_logs("registry_log", log))
+            number_of_read_registry_logs++;
+    }
+    if(number_of_read_registry_logs == 0 || number_of_read_registry_logs > number_of_accepted_registry_logs){
+        std::cerr << "Test failed !" << std::endl << "REASON: " << number_of_read_registry_logs << " logs read for " << number_of_accepted_registry_logs << " accepted while connections were opened and closed" << std::endl;
+        return 1;
+    }
+
     std::cout << "All Test succeed ! All good !" << std::endl;
     std::cout << "Mean log push time " << computeMean(mean_push_log_runtime) <<  " ns " << std::endl;
     std::cout << "Mean image push time " << computeMean(mean_push_image_runtime) << " ns " <<  std::endl;
     std::cout << "Mean raw json push time " << computeMean(mean_push_raw_message_runtime) << " ns " <<  std::endl;
+    std::cout << "Mean sync log write time " << computeMean(sync_write_runtime) << " ns " <<  std::endl;
+    std::cout << "Allocations per message on opened channels (all threads) " << double(number_of_total_allocations) / (3 * number_of_counted_messages) << std::endl;
+    std::cout << "Payload pool hit rate " << payload_pool_statistics.hit_rate << ", pooled memory high-water mark " << payload_pool_statistics.max_pooled_bytes << " bytes" << std::endl;
     return 0;
 }
 